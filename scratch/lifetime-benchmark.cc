@@ -0,0 +1,502 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Network lifetime benchmark of AODV and AODV_EO, on the grid of wirelessExample.cc:
+ *
+ *                       s
+ *
+ *  n  n  n  n  n
+ *    n  n  n  n  n
+ *  n  n  n  n  n
+ *
+ * rows x columns battery powered grid nodes, every other line shifted by 50 m, and a
+ * mains powered sink above the grid. numClients randomly chosen grid nodes send CBR UDP
+ * traffic to the sink until the network dies or maxTime is reached.
+ *
+ * Reported per protocol: time of first node depletion, of 10% and 50% of the nodes depleted,
+ * time of network partition (first time an alive node can no longer reach the sink), and
+ * delivered bits per joule of energy consumed by all grid nodes.  "-" means not reached.
+ *
+ * Both protocols run with the same seed, run number and client choice.  AODV_EO options can
+ * be set on the command line, e.g.
+ *
+ *   ./waf --run "lifetime-benchmark --rows=4 --columns=4 --initialEnergy=50
+ *                --ns3::aodv_eo::RoutingProtocol::EnergyBalancing=true"
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/wifi-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/aodv-module.h"
+#include "ns3/aodv_eo-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/energy-module.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+NS_LOG_COMPONENT_DEFINE ("LifetimeBenchmark");
+
+using namespace ns3;
+
+/// Lifetime figures of one run, negative times were not reached
+struct LifetimeResult
+{
+  std::string protocol;
+  double firstDepletion;
+  double tenPercentDepletion;
+  double halfDepletion;
+  double partition;
+  uint32_t received;
+  double energy;
+  double bitsPerJoule;
+};
+
+/**
+ * \brief Network lifetime benchmark.
+ */
+class LifetimeBenchmark
+{
+public:
+  LifetimeBenchmark ();
+  /// Configure script parameters, \return true on successful configuration
+  bool Configure (int argc, char **argv);
+  /// Run simulation with protocol "aodv" or "aodv_eo"
+  LifetimeResult Run (std::string protocol);
+  /// Report results
+  void Report (std::ostream & os, std::vector<LifetimeResult> const & results) const;
+  /// Protocols to compare
+  std::vector<std::string> GetProtocols () const;
+
+private:
+  // parameters
+  /// Number of node rows
+  uint32_t rows;
+  /// Number of node columns
+  uint32_t columns;
+  /// Horizontal spacing between nodes, m
+  double hSpacing;
+  /// Vertical spacing between nodes, m
+  double vSpacing;
+  /// Radio range, m
+  double range;
+  /// Initial energy of grid nodes, J
+  double initialEnergy;
+  /// Number of sending grid nodes
+  uint32_t numClients;
+  /// UDP payload size, bytes
+  uint32_t packetSize;
+  /// Sending rate of every client, bps
+  double bitrate;
+  /// Time limit, s
+  double maxTime;
+  /// RNG seed
+  uint32_t seed;
+  /// RNG run number
+  uint32_t run;
+  /// "aodv", "aodv_eo" or "both"
+  std::string protocol;
+  /// Print client nodes
+  bool verbose;
+
+  // network of the current run
+  NodeContainer grid;
+  NodeContainer sink;
+  NetDeviceContainer devices;
+  EnergySourceContainer sources;
+  Ptr<UdpServer> server;
+  /// Depletion state of grid nodes
+  std::vector<bool> depleted;
+  /// Depletion times
+  std::vector<double> depletionTimes;
+  /// Partition time, negative while not partitioned
+  double partitionTime;
+
+  void CreateNodes ();
+  void CreateDevices ();
+  void InstallEnergy ();
+  void InstallInternetStack (std::string protocol);
+  void InstallApplications ();
+  /// RemainingEnergy trace sink of grid node context
+  void RemainingEnergy (std::string context, double oldValue, double remainingEnergy);
+  /// Check that some alive grid node can't reach the sink
+  bool IsPartitioned () const;
+  /// Return time when fraction of the grid nodes were depleted, negative if not reached
+  double GetDepletionTime (double fraction) const;
+};
+
+int main (int argc, char **argv)
+{
+  LifetimeBenchmark benchmark;
+  if (!benchmark.Configure (argc, argv))
+    NS_FATAL_ERROR ("Configuration failed. Aborted.");
+
+  std::vector<LifetimeResult> results;
+  std::vector<std::string> protocols = benchmark.GetProtocols ();
+  for (std::vector<std::string>::const_iterator i = protocols.begin (); i != protocols.end (); ++i)
+    {
+      results.push_back (benchmark.Run (*i));
+    }
+  benchmark.Report (std::cout, results);
+  return 0;
+}
+
+//-----------------------------------------------------------------------------
+LifetimeBenchmark::LifetimeBenchmark () :
+  rows (5),
+  columns (5),
+  hSpacing (200),
+  vSpacing (150),
+  range (250),
+  initialEnergy (100),
+  numClients (3),
+  packetSize (500),
+  bitrate (80000),
+  maxTime (1000),
+  seed (1),
+  run (1),
+  protocol ("both"),
+  verbose (false),
+  partitionTime (-1)
+{
+}
+
+bool
+LifetimeBenchmark::Configure (int argc, char **argv)
+{
+  CommandLine cmd;
+
+  cmd.AddValue ("rows", "Number of node rows.", rows);
+  cmd.AddValue ("columns", "Number of node columns.", columns);
+  cmd.AddValue ("hSpacing", "Horizontal spacing between nodes, m.", hSpacing);
+  cmd.AddValue ("vSpacing", "Vertical spacing between nodes, m.", vSpacing);
+  cmd.AddValue ("range", "Radio range, m.", range);
+  cmd.AddValue ("initialEnergy", "Initial energy of grid nodes, J.", initialEnergy);
+  cmd.AddValue ("numClients", "Number of sending grid nodes.", numClients);
+  cmd.AddValue ("packetSize", "UDP payload size, bytes.", packetSize);
+  cmd.AddValue ("bitrate", "Sending rate of every client, bps.", bitrate);
+  cmd.AddValue ("maxTime", "Time limit, s.", maxTime);
+  cmd.AddValue ("seed", "RNG seed.", seed);
+  cmd.AddValue ("run", "RNG run number.", run);
+  cmd.AddValue ("protocol", "Routing protocol: aodv, aodv_eo or both.", protocol);
+  cmd.AddValue ("verbose", "Print client nodes.", verbose);
+
+  cmd.Parse (argc, argv);
+  if (rows * columns == 0 || numClients == 0 || numClients > rows * columns)
+    {
+      std::cerr << "Need at least one node and between 1 and rows * columns clients\n";
+      return false;
+    }
+  if (protocol != "aodv" && protocol != "aodv_eo" && protocol != "both")
+    {
+      std::cerr << "Unknown protocol " << protocol << "\n";
+      return false;
+    }
+  return true;
+}
+
+std::vector<std::string>
+LifetimeBenchmark::GetProtocols () const
+{
+  std::vector<std::string> protocols;
+  if (protocol == "aodv" || protocol == "both")
+    protocols.push_back ("aodv");
+  if (protocol == "aodv_eo" || protocol == "both")
+    protocols.push_back ("aodv_eo");
+  return protocols;
+}
+
+LifetimeResult
+LifetimeBenchmark::Run (std::string protocol)
+{
+  // Same random numbers for every protocol
+  RngSeedManager::SetSeed (seed);
+  RngSeedManager::SetRun (run);
+
+  grid = NodeContainer ();
+  sink = NodeContainer ();
+  devices = NetDeviceContainer ();
+  sources = EnergySourceContainer ();
+  depleted.assign (rows * columns, false);
+  depletionTimes.clear ();
+  partitionTime = -1;
+
+  CreateNodes ();
+  CreateDevices ();
+  InstallEnergy ();
+  InstallInternetStack (protocol);
+  InstallApplications ();
+
+  std::cout << "Running " << protocol << " on " << rows << "x" << columns << " grid, "
+            << numClients << " clients, " << initialEnergy << " J per node ...\n";
+  Simulator::Stop (Seconds (maxTime));
+  Simulator::Run ();
+
+  LifetimeResult result;
+  result.protocol = protocol;
+  result.firstDepletion = GetDepletionTime (0);
+  result.tenPercentDepletion = GetDepletionTime (0.1);
+  result.halfDepletion = GetDepletionTime (0.5);
+  result.partition = partitionTime;
+  result.received = server->GetReceived ();
+  result.energy = 0;
+  for (uint32_t i = 0; i < sources.GetN (); ++i)
+    {
+      result.energy += sources.Get (i)->GetInitialEnergy () - sources.Get (i)->GetRemainingEnergy ();
+    }
+  result.bitsPerJoule = (result.energy > 0) ? result.received * packetSize * 8.0 / result.energy : 0;
+
+  Simulator::Destroy ();
+  server = 0;
+  return result;
+}
+
+void
+LifetimeBenchmark::Report (std::ostream & os, std::vector<LifetimeResult> const & results) const
+{
+  os << "\n" << std::setw (10) << "Protocol" << std::setw (12) << "First(s)" << std::setw (12) << "10%(s)"
+     << std::setw (12) << "50%(s)" << std::setw (14) << "Partition(s)" << std::setw (10) << "Received"
+     << std::setw (12) << "Energy(J)" << std::setw (12) << "Bits/J" << "\n";
+  for (std::vector<LifetimeResult>::const_iterator i = results.begin (); i != results.end (); ++i)
+    {
+      double times[4] = { i->firstDepletion, i->tenPercentDepletion, i->halfDepletion, i->partition };
+      os << std::setw (10) << i->protocol;
+      for (uint32_t k = 0; k < 4; ++k)
+        {
+          std::ostringstream t;
+          if (times[k] < 0)
+            t << "-";
+          else
+            t << std::fixed << std::setprecision (1) << times[k];
+          os << std::setw (k == 3 ? 14 : 12) << t.str ();
+        }
+      os << std::setw (10) << i->received << std::setw (12) << std::fixed << std::setprecision (1) << i->energy
+         << std::setw (12) << std::setprecision (0) << i->bitsPerJoule << "\n";
+      os.unsetf (std::ios::fixed);
+    }
+}
+
+void
+LifetimeBenchmark::CreateNodes ()
+{
+  grid.Create (rows * columns);
+  sink.Create (1);
+
+  // Grid of wirelessExample.cc: lines of "rows" nodes, every other line shifted by 50 m
+  double screenY = 1000;
+  Ptr<ListPositionAllocator> positionAlloc = CreateObject<ListPositionAllocator> ();
+  double xPos = 0;
+  double height = vSpacing;
+  for (uint32_t j = 0; j < columns; j++)
+    {
+      for (uint32_t i = 0; i < rows; i++)
+        {
+          positionAlloc->Add (Vector (xPos, screenY - height, 0.0));
+          xPos += hSpacing;
+        }
+      height += vSpacing;
+      xPos = (j % 2 == 0) ? 50 : 0;
+    }
+  // Static sink centered above the top line, within range of its middle node
+  positionAlloc->Add (Vector ((rows - 1) * hSpacing / 2, screenY - vSpacing + (range - 50), 0.0));
+
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator (positionAlloc);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (grid);
+  mobility.Install (sink);
+}
+
+void
+LifetimeBenchmark::CreateDevices ()
+{
+  std::string phyMode = "DsssRate1Mbps";
+  // disable fragmentation and RTS/CTS for frames below 2200 bytes
+  Config::SetDefault ("ns3::WifiRemoteStationManager::FragmentationThreshold", StringValue ("2200"));
+  Config::SetDefault ("ns3::WifiRemoteStationManager::RtsCtsThreshold", StringValue ("2200"));
+  // Set non-unicast data rate to be the same as that of unicast
+  Config::SetDefault ("ns3::WifiRemoteStationManager::NonUnicastMode", StringValue (phyMode));
+
+  WifiHelper wifi;
+  wifi.SetStandard (WIFI_PHY_STANDARD_80211b);
+  wifi.SetRemoteStationManager ("ns3::AarfWifiManager");
+  YansWifiPhyHelper wifiPhy = YansWifiPhyHelper::Default ();
+  YansWifiChannelHelper wifiChannel;
+  wifiChannel.SetPropagationDelay ("ns3::ConstantSpeedPropagationDelayModel");
+  wifiChannel.AddPropagationLoss ("ns3::RangePropagationLossModel", "MaxRange", DoubleValue (range));
+  wifiPhy.SetChannel (wifiChannel.Create ());
+  NqosWifiMacHelper wifiMac = NqosWifiMacHelper::Default ();
+  wifiMac.SetType ("ns3::AdhocWifiMac");
+  devices = wifi.Install (wifiPhy, wifiMac, grid);
+  devices.Add (wifi.Install (wifiPhy, wifiMac, sink));
+  wifi.AssignStreams (devices, 0);
+}
+
+void
+LifetimeBenchmark::InstallEnergy ()
+{
+  BasicEnergySourceHelper basicSourceHelper;
+  basicSourceHelper.Set ("BasicEnergySourceInitialEnergyJ", DoubleValue (initialEnergy));
+  sources = basicSourceHelper.Install (grid);
+  WifiRadioEnergyModelHelper radioEnergyHelper;
+  radioEnergyHelper.Set ("TxCurrentA", DoubleValue (0.0174));
+  NetDeviceContainer gridDevices;
+  for (uint32_t i = 0; i < grid.GetN (); ++i)
+    {
+      gridDevices.Add (devices.Get (i));
+    }
+  radioEnergyHelper.Install (gridDevices, sources);
+  for (uint32_t i = 0; i < sources.GetN (); ++i)
+    {
+      std::ostringstream context;
+      context << i;
+      sources.Get (i)->TraceConnect ("RemainingEnergy", context.str (),
+                                     MakeCallback (&LifetimeBenchmark::RemainingEnergy, this));
+    }
+}
+
+void
+LifetimeBenchmark::InstallInternetStack (std::string protocol)
+{
+  AodvHelper aodv;
+  AodvEOHelper aodvEo;
+  InternetStackHelper stack;
+  if (protocol == "aodv")
+    stack.SetRoutingHelper (aodv);
+  else
+    stack.SetRoutingHelper (aodvEo);
+  stack.Install (grid);
+  stack.Install (sink);
+  NodeContainer all (grid, sink);
+  if (protocol == "aodv")
+    aodv.AssignStreams (all, 100);
+  else
+    aodvEo.AssignStreams (all, 100);
+
+  Ipv4AddressHelper address;
+  address.SetBase ("10.1.1.0", "255.255.255.0");
+  address.Assign (devices);
+}
+
+void
+LifetimeBenchmark::InstallApplications ()
+{
+  uint16_t port = 80;
+  server = CreateObject<UdpServer> ();
+  server->SetAttribute ("Port", UintegerValue (port));
+  server->SetStartTime (Seconds (0));
+  sink.Get (0)->AddApplication (server);
+
+  Ipv4Address sinkAddress = sink.Get (0)->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+  // Draw clients without repetition from a fixed stream
+  Ptr<UniformRandomVariable> random = CreateObject<UniformRandomVariable> ();
+  random->SetStream (200);
+  std::vector<uint32_t> candidates;
+  for (uint32_t i = 0; i < grid.GetN (); ++i)
+    {
+      candidates.push_back (i);
+    }
+  for (uint32_t c = 0; c < numClients; ++c)
+    {
+      uint32_t k = random->GetInteger (0, candidates.size () - 1);
+      uint32_t node = candidates[k];
+      candidates.erase (candidates.begin () + k);
+
+      Ptr<UdpClient> client = CreateObject<UdpClient> ();
+      client->SetRemote (sinkAddress, port);
+      client->SetAttribute ("MaxPackets", UintegerValue (std::numeric_limits<uint32_t>::max ()));
+      client->SetAttribute ("PacketSize", UintegerValue (packetSize));
+      client->SetAttribute ("Interval", TimeValue (Seconds (packetSize * 8.0 / bitrate)));
+      // Let hellos settle, spread starts
+      client->SetStartTime (Seconds (1 + random->GetValue (0, 1)));
+      grid.Get (node)->AddApplication (client);
+      if (verbose)
+        {
+          std::cout << "Client on node " << node << "\n";
+        }
+    }
+}
+
+void
+LifetimeBenchmark::RemainingEnergy (std::string context, double oldValue, double remainingEnergy)
+{
+  uint32_t index = std::atoi (context.c_str ());
+  if (depleted[index])
+    return;
+  // BasicEnergySource reports depletion at its low battery threshold
+  DoubleValue threshold;
+  sources.Get (index)->GetAttribute ("BasicEnergySourceLowBatteryThreshold", threshold);
+  if (remainingEnergy > threshold.Get () * sources.Get (index)->GetInitialEnergy ())
+    return;
+  depleted[index] = true;
+  depletionTimes.push_back (Simulator::Now ().GetSeconds ());
+  NS_LOG_INFO (Simulator::Now ().GetSeconds () << "s node " << index << " depleted");
+  if (partitionTime < 0 && IsPartitioned ())
+    {
+      partitionTime = Simulator::Now ().GetSeconds ();
+    }
+  // Nothing left to measure
+  if (partitionTime >= 0 && GetDepletionTime (0.5) >= 0)
+    {
+      Simulator::Stop ();
+    }
+}
+
+bool
+LifetimeBenchmark::IsPartitioned () const
+{
+  // Nodes don't move, so connectivity only changes when nodes deplete
+  std::vector<Vector> positions;
+  for (uint32_t i = 0; i < grid.GetN (); ++i)
+    {
+      positions.push_back (grid.Get (i)->GetObject<MobilityModel> ()->GetPosition ());
+    }
+  Vector sinkPosition = sink.Get (0)->GetObject<MobilityModel> ()->GetPosition ();
+  std::vector<bool> reached (grid.GetN (), false);
+  std::deque<uint32_t> queue;
+  for (uint32_t i = 0; i < grid.GetN (); ++i)
+    {
+      if (!depleted[i] && CalculateDistance (positions[i], sinkPosition) <= range)
+        {
+          reached[i] = true;
+          queue.push_back (i);
+        }
+    }
+  while (!queue.empty ())
+    {
+      uint32_t n = queue.front ();
+      queue.pop_front ();
+      for (uint32_t i = 0; i < grid.GetN (); ++i)
+        {
+          if (!depleted[i] && !reached[i] && CalculateDistance (positions[i], positions[n]) <= range)
+            {
+              reached[i] = true;
+              queue.push_back (i);
+            }
+        }
+    }
+  for (uint32_t i = 0; i < grid.GetN (); ++i)
+    {
+      if (!depleted[i] && !reached[i])
+        return true;
+    }
+  // All nodes dead counts as partitioned
+  return std::find (depleted.begin (), depleted.end (), false) == depleted.end ();
+}
+
+double
+LifetimeBenchmark::GetDepletionTime (double fraction) const
+{
+  uint32_t needed = std::max<uint32_t> (1, (uint32_t) std::ceil (fraction * grid.GetN ()));
+  if (depletionTimes.size () < needed)
+    return -1;
+  return depletionTimes[needed - 1];
+}
@@ -23,6 +23,7 @@
 #include "ns3/names.h"
 #include "ns3/ptr.h"
 #include "ns3/ipv4-list-routing.h"
+#include "ns3/simulator.h"
 
 namespace ns3
 {
@@ -93,4 +94,25 @@ AodvEOHelper::AssignStreams (NodeContainer c, int64_t stream)
   return (currentStream - stream);
 }
 
+void
+AodvEOHelper::PrintEnergyAccountingAllAt (Time printTime, Ptr<OutputStreamWrapper> stream)
+{
+  for (uint32_t i = 0; i < NodeList::GetNNodes (); i++)
+    {
+      Ptr<Node> node = NodeList::GetNode (i);
+      Simulator::Schedule (printTime, &AodvEOHelper::PrintEnergyAccounting, node, stream);
+    }
+}
+
+void
+AodvEOHelper::PrintEnergyAccounting (Ptr<Node> node, Ptr<OutputStreamWrapper> stream)
+{
+  // Create () aggregates the routing protocol to the node
+  Ptr<aodv_eo::RoutingProtocol> aodv_eo = node->GetObject<aodv_eo::RoutingProtocol> ();
+  if (aodv_eo)
+    {
+      aodv_eo->PrintEnergyAccounting (stream);
+    }
+}
+
 }
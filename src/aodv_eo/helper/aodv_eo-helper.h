@@ -74,8 +74,18 @@ public:
    * \return the number of stream indices assigned by this helper
    */
   int64_t AssignStreams (NodeContainer c, int64_t stream);
+  /**
+   * \brief prints the radio energy per AODV_EO message type and data flow of all nodes
+   * at a particular time, e.g. at the end of the simulation. Needs the EnergyAccounting
+   * attribute of ns3::aodv_eo::RoutingProtocol.
+   * \param printTime the time at which the accounting is printed.
+   * \param stream The output stream object to use
+   */
+  static void PrintEnergyAccountingAllAt (Time printTime, Ptr<OutputStreamWrapper> stream);
 
 private:
+  /// Print radio energy of node to stream, if it runs AODV_EO
+  static void PrintEnergyAccounting (Ptr<Node> node, Ptr<OutputStreamWrapper> stream);
   /** the factory to create AODV_EO routing object */
   ObjectFactory m_agentFactory;
 };
@@ -0,0 +1,149 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "aodv_eo-deadline-scheduler.h"
+#include "ns3/log.h"
+#include <algorithm>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE ("Aodv_EO_DeadlineScheduler");
+
+namespace aodv_eo
+{
+
+DeadlineScheduler::DeadlineScheduler () :
+  m_armedAt (Seconds (0)), m_expiring (false)
+{
+}
+
+DeadlineScheduler::~DeadlineScheduler ()
+{
+  Simulator::Cancel (m_event);
+}
+
+void
+DeadlineScheduler::Schedule (uint8_t kind, Ipv4Address addr, Time delay)
+{
+  NS_LOG_FUNCTION (this << (uint16_t) kind << addr << delay.GetSeconds ());
+  Key key (kind, addr);
+  Time deadline = Simulator::Now () + std::max (delay, Seconds (0));
+  std::map<Key, Time>::iterator i = m_deadlines.find (key);
+  if (i != m_deadlines.end ())
+    {
+      Unqueue (key, i->second);
+      i->second = deadline;
+    }
+  else
+    {
+      m_deadlines.insert (std::make_pair (key, deadline));
+    }
+  m_queue.insert (std::make_pair (deadline, key));
+  Rearm ();
+}
+
+void
+DeadlineScheduler::Cancel (uint8_t kind, Ipv4Address addr)
+{
+  NS_LOG_FUNCTION (this << (uint16_t) kind << addr);
+  Key key (kind, addr);
+  std::map<Key, Time>::iterator i = m_deadlines.find (key);
+  if (i == m_deadlines.end ())
+    return;
+  Unqueue (key, i->second);
+  m_deadlines.erase (i);
+  Rearm ();
+}
+
+bool
+DeadlineScheduler::IsRunning (uint8_t kind, Ipv4Address addr) const
+{
+  return (m_deadlines.find (Key (kind, addr)) != m_deadlines.end ());
+}
+
+Time
+DeadlineScheduler::GetDelayLeft (uint8_t kind, Ipv4Address addr) const
+{
+  std::map<Key, Time>::const_iterator i = m_deadlines.find (Key (kind, addr));
+  if (i == m_deadlines.end ())
+    return Seconds (0);
+  return i->second - Simulator::Now ();
+}
+
+void
+DeadlineScheduler::Clear ()
+{
+  m_deadlines.clear ();
+  m_queue.clear ();
+  Simulator::Cancel (m_event);
+}
+
+void
+DeadlineScheduler::Unqueue (Key const & key, Time deadline)
+{
+  std::pair<std::multimap<Time, Key>::iterator, std::multimap<Time, Key>::iterator> range =
+    m_queue.equal_range (deadline);
+  for (std::multimap<Time, Key>::iterator j = range.first; j != range.second; ++j)
+    {
+      if (j->second == key)
+        {
+          m_queue.erase (j);
+          return;
+        }
+    }
+}
+
+void
+DeadlineScheduler::Rearm ()
+{
+  if (m_expiring)
+    return;
+  if (m_queue.empty ())
+    {
+      Simulator::Cancel (m_event);
+      return;
+    }
+  Time earliest = m_queue.begin ()->first;
+  if (m_event.IsRunning () && m_armedAt == earliest)
+    return;
+  Simulator::Cancel (m_event);
+  m_armedAt = earliest;
+  m_event = Simulator::Schedule (earliest - Simulator::Now (), &DeadlineScheduler::Expire, this);
+}
+
+void
+DeadlineScheduler::Expire ()
+{
+  NS_LOG_FUNCTION (this);
+  m_expiring = true;
+  while (!m_queue.empty () && m_queue.begin ()->first <= Simulator::Now ())
+    {
+      Key key = m_queue.begin ()->second;
+      m_queue.erase (m_queue.begin ());
+      m_deadlines.erase (key);
+      // Handler is allowed to schedule and cancel deadlines
+      if (!m_handler.IsNull ())
+        {
+          m_handler (key.first, key.second);
+        }
+    }
+  m_expiring = false;
+  Rearm ();
+}
+
+}
+}
@@ -0,0 +1,93 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef AODV_EO_DEADLINE_SCHEDULER_H
+#define AODV_EO_DEADLINE_SCHEDULER_H
+
+#include "ns3/ipv4-address.h"
+#include "ns3/simulator.h"
+#include "ns3/event-id.h"
+#include "ns3/callback.h"
+#include <map>
+#include <utility>
+
+namespace ns3
+{
+namespace aodv_eo
+{
+/**
+ * \ingroup aodv_eo
+ *
+ * \brief Multiplexes soft-state deadlines of a node onto a single simulator event.
+ *
+ * Each deadline is identified by a (kind, address) pair, e.g. (RREQ retry, destination).
+ * Only the earliest deadline has a simulator event; when it expires all due deadlines
+ * are handed to the expire callback and the event is re-armed for the next one.
+ * Nothing is scheduled while no deadline is pending.
+ */
+class DeadlineScheduler
+{
+public:
+  /// Callback invoked with (kind, address) of an expired deadline
+  typedef Callback<void, uint8_t, Ipv4Address> ExpireCallback;
+
+  /// c-tor
+  DeadlineScheduler ();
+  /// d-tor, cancels pending event
+  ~DeadlineScheduler ();
+
+  /// Set expire callback
+  void SetCallback (ExpireCallback cb) { m_handler = cb; }
+  /// Schedule deadline (kind, addr) to expire after delay, replacing the pending one if any
+  void Schedule (uint8_t kind, Ipv4Address addr, Time delay);
+  /// Cancel deadline (kind, addr) if it is pending
+  void Cancel (uint8_t kind, Ipv4Address addr);
+  /// Check that deadline (kind, addr) is pending
+  bool IsRunning (uint8_t kind, Ipv4Address addr) const;
+  /// Return time left until deadline (kind, addr) expires, zero if it is not pending
+  Time GetDelayLeft (uint8_t kind, Ipv4Address addr) const;
+  /// Cancel all deadlines
+  void Clear ();
+  /// Return number of pending deadlines
+  uint32_t GetSize () const { return m_deadlines.size (); }
+
+private:
+  /// Deadline identifier
+  typedef std::pair<uint8_t, Ipv4Address> Key;
+  /// Remove key from ordered deadline queue
+  void Unqueue (Key const & key, Time deadline);
+  /// Make the simulator event match the earliest deadline
+  void Rearm ();
+  /// Process all due deadlines
+  void Expire ();
+
+  /// Expire callback
+  ExpireCallback m_handler;
+  /// Pending deadlines: key -> absolute expiration time
+  std::map<Key, Time> m_deadlines;
+  /// Pending deadlines ordered by expiration time
+  std::multimap<Time, Key> m_queue;
+  /// The only simulator event
+  EventId m_event;
+  /// Expiration time of m_event
+  Time m_armedAt;
+  /// Indicates that due deadlines are being processed, rearming is postponed
+  bool m_expiring;
+};
+
+}
+}
+#endif /* AODV_EO_DEADLINE_SCHEDULER_H */
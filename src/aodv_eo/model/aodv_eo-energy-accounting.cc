@@ -0,0 +1,261 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "aodv_eo-energy-accounting.h"
+#include "aodv_eo-packet.h"
+#include "ns3/wifi-mac-header.h"
+#include "ns3/llc-snap-header.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/udp-header.h"
+#include "ns3/ipv4-l3-protocol.h"
+#include "ns3/udp-l4-protocol.h"
+#include <iomanip>
+
+namespace ns3
+{
+namespace aodv_eo
+{
+
+/// TCP protocol number, TCP ports are read from the raw segment
+static const uint8_t TCP_PROT_NUMBER = 6;
+
+bool
+EnergyAccounting::FlowId::operator< (FlowId const & o) const
+{
+  if (m_source != o.m_source)
+    return m_source < o.m_source;
+  if (m_destination != o.m_destination)
+    return m_destination < o.m_destination;
+  if (m_protocol != o.m_protocol)
+    return m_protocol < o.m_protocol;
+  if (m_sourcePort != o.m_sourcePort)
+    return m_sourcePort < o.m_sourcePort;
+  return m_destinationPort < o.m_destinationPort;
+}
+
+EnergyAccounting::EnergyAccounting (uint16_t port) :
+  m_port (port), m_txCurrent (0.0174), m_rxCurrent (0.0197), m_voltage (3.0)
+{
+  m_monitorSnifferTxCallback = MakeCallback (&EnergyAccounting::ProcessMonitorSnifferTx, this);
+  m_monitorSnifferRxCallback = MakeCallback (&EnergyAccounting::ProcessMonitorSnifferRx, this);
+}
+
+void
+EnergyAccounting::SetRadio (double txCurrent, double rxCurrent, double voltage)
+{
+  m_txCurrent = txCurrent;
+  m_rxCurrent = rxCurrent;
+  m_voltage = voltage;
+}
+
+void
+EnergyAccounting::NotifyTx (Ptr<const Packet> frame, Time airtime)
+{
+  Charge (frame, airtime, true);
+}
+
+void
+EnergyAccounting::NotifyRx (Ptr<const Packet> frame, Time airtime)
+{
+  Charge (frame, airtime, false);
+}
+
+EnergyAccounting::Usage
+EnergyAccounting::GetUsage (FlowId const & flow) const
+{
+  std::map<FlowId, Usage>::const_iterator i = m_flows.find (flow);
+  return (i == m_flows.end ()) ? Usage () : i->second;
+}
+
+void
+EnergyAccounting::Clear ()
+{
+  for (uint32_t c = 0; c < CATEGORY_COUNT; ++c)
+    {
+      m_categories[c] = Usage ();
+    }
+  m_flows.clear ();
+}
+
+void
+EnergyAccounting::Charge (Ptr<const Packet> frame, Time airtime, bool tx)
+{
+  FlowId flow;
+  Category category = Classify (frame, flow);
+  double energy = airtime.GetSeconds () * (tx ? m_txCurrent : m_rxCurrent) * m_voltage;
+  Usage & usage = m_categories[category];
+  if (tx)
+    {
+      usage.m_txEnergy += energy;
+      usage.m_txBytes += frame->GetSize ();
+      usage.m_txFrames++;
+    }
+  else
+    {
+      usage.m_rxEnergy += energy;
+      usage.m_rxBytes += frame->GetSize ();
+      usage.m_rxFrames++;
+    }
+  if (category != DATA)
+    return;
+  Usage & flowUsage = m_flows[flow];
+  if (tx)
+    {
+      flowUsage.m_txEnergy += energy;
+      flowUsage.m_txBytes += frame->GetSize ();
+      flowUsage.m_txFrames++;
+    }
+  else
+    {
+      flowUsage.m_rxEnergy += energy;
+      flowUsage.m_rxBytes += frame->GetSize ();
+      flowUsage.m_rxFrames++;
+    }
+}
+
+EnergyAccounting::Category
+EnergyAccounting::Classify (Ptr<const Packet> frame, FlowId & flow) const
+{
+  Ptr<Packet> p = frame->Copy ();
+  WifiMacHeader mac;
+  if (p->RemoveHeader (mac) == 0 || !mac.IsData ())
+    return OTHER;
+  LlcSnapHeader llc;
+  p->RemoveHeader (llc);
+  if (llc.GetType () != Ipv4L3Protocol::PROT_NUMBER)
+    return OTHER;
+  Ipv4Header ip;
+  p->RemoveHeader (ip);
+  flow.m_source = ip.GetSource ();
+  flow.m_destination = ip.GetDestination ();
+  flow.m_protocol = ip.GetProtocol ();
+  flow.m_sourcePort = 0;
+  flow.m_destinationPort = 0;
+  if (ip.GetProtocol () == UdpL4Protocol::PROT_NUMBER)
+    {
+      UdpHeader udp;
+      p->RemoveHeader (udp);
+      flow.m_sourcePort = udp.GetSourcePort ();
+      flow.m_destinationPort = udp.GetDestinationPort ();
+      if (udp.GetDestinationPort () == m_port)
+        {
+          if (!CompactHeader::IsCompact (p))
+            {
+              // Bundles are charged to their first message
+              TypeHeader bundleType;
+              p->PeekHeader (bundleType);
+              if (bundleType.IsValid () && bundleType.Get () == AODVTYPE_BUNDLE)
+                {
+                  BundleHeader bundleHeader;
+                  p->RemoveHeader (bundleType);
+                  p->RemoveHeader (bundleHeader);
+                }
+            }
+          MessageType type;
+          bool hello = false;
+          if (!CompactHeader::PeekType (p, type, hello))
+            {
+              TypeHeader typeHeader;
+              p->RemoveHeader (typeHeader);
+              if (!typeHeader.IsValid ())
+                return OTHER;
+              type = typeHeader.Get ();
+              if (type == AODVTYPE_RREP)
+                {
+                  // Hellos are RREPs about the sender itself
+                  RrepHeader rrep;
+                  p->RemoveHeader (rrep);
+                  hello = (rrep.GetDst () == rrep.GetOrigin ());
+                }
+            }
+          switch (type)
+            {
+            case AODVTYPE_RREQ:
+              return RREQ;
+            case AODVTYPE_RREP:
+              return hello ? HELLO : RREP;
+            case AODVTYPE_RERR:
+              return RERR;
+            case AODVTYPE_RREP_ACK:
+              return RREP_ACK;
+            default:
+              return OTHER;
+            }
+        }
+    }
+  else if (ip.GetProtocol () == TCP_PROT_NUMBER && p->GetSize () >= 4)
+    {
+      uint8_t ports[4];
+      p->CopyData (ports, 4);
+      flow.m_sourcePort = (ports[0] << 8) | ports[1];
+      flow.m_destinationPort = (ports[2] << 8) | ports[3];
+    }
+  return DATA;
+}
+
+Time
+EnergyAccounting::GetAirtime (uint32_t size, uint32_t rate, WifiPreamble preamble, WifiTxVector txVector)
+{
+  Time airtime = WifiPhy::CalculatePlcpPreambleAndHeaderDuration (txVector, preamble);
+  if (rate > 0)
+    {
+      // Rate of the sniffer traces is in units of 500 kbps
+      airtime += Seconds (size * 8.0 / (rate * 500000.0));
+    }
+  return airtime;
+}
+
+void
+EnergyAccounting::ProcessMonitorSnifferTx (Ptr<const Packet> packet, uint16_t channelFreqMhz, uint16_t channelNumber,
+                                           uint32_t rate, WifiPreamble preamble, WifiTxVector txVector,
+                                           struct mpduInfo aMpdu)
+{
+  NotifyTx (packet, GetAirtime (packet->GetSize (), rate, preamble, txVector));
+}
+
+void
+EnergyAccounting::ProcessMonitorSnifferRx (Ptr<const Packet> packet, uint16_t channelFreqMhz, uint16_t channelNumber,
+                                           uint32_t rate, WifiPreamble preamble, WifiTxVector txVector,
+                                           struct mpduInfo aMpdu, struct signalNoiseDbm signalNoise)
+{
+  NotifyRx (packet, GetAirtime (packet->GetSize (), rate, preamble, txVector));
+}
+
+void
+EnergyAccounting::Print (std::ostream & os) const
+{
+  static const char * names[CATEGORY_COUNT] = { "RREQ", "RREP", "RERR", "RREP_ACK", "HELLO", "DATA", "OTHER" };
+  os << std::setw (10) << "Category" << std::setw (14) << "TxEnergy(J)" << std::setw (14) << "RxEnergy(J)"
+     << std::setw (10) << "TxFrames" << std::setw (10) << "RxFrames" << std::setw (12) << "TxBytes" << std::setw (12) << "RxBytes" << "\n";
+  for (uint32_t c = 0; c < CATEGORY_COUNT; ++c)
+    {
+      Usage const & u = m_categories[c];
+      os << std::setw (10) << names[c] << std::setw (14) << u.m_txEnergy << std::setw (14) << u.m_rxEnergy
+         << std::setw (10) << u.m_txFrames << std::setw (10) << u.m_rxFrames
+         << std::setw (12) << u.m_txBytes << std::setw (12) << u.m_rxBytes << "\n";
+    }
+  for (std::map<FlowId, Usage>::const_iterator i = m_flows.begin (); i != m_flows.end (); ++i)
+    {
+      FlowId const & f = i->first;
+      Usage const & u = i->second;
+      os << "Flow " << f.m_source << ":" << f.m_sourcePort << " -> " << f.m_destination << ":" << f.m_destinationPort
+         << " proto " << (uint16_t) f.m_protocol << "  tx " << u.m_txEnergy << " J (" << u.m_txBytes << " B)"
+         << "  rx " << u.m_rxEnergy << " J (" << u.m_rxBytes << " B)\n";
+    }
+}
+
+}
+}
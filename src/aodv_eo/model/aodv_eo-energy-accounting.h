@@ -0,0 +1,145 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef AODV_EO_ENERGY_ACCOUNTING_H
+#define AODV_EO_ENERGY_ACCOUNTING_H
+
+#include "ns3/ipv4-address.h"
+#include "ns3/nstime.h"
+#include "ns3/callback.h"
+#include "ns3/packet.h"
+#include "ns3/wifi-phy.h"
+#include <map>
+#include <ostream>
+
+namespace ns3
+{
+namespace aodv_eo
+{
+/**
+ * \ingroup aodv_eo
+ *
+ * \brief Radio energy spent by a node per AODV_EO control message type and per data flow.
+ *
+ * Every frame the PHY sends or receives is charged airtime * current * supply voltage, with the
+ * TX and RX currents of the node's WifiRadioEnergyModel.  The frame is classified by its content:
+ * an AODV_EO message (hellos are told apart from other RREPs), a data packet of a flow identified
+ * by its 5-tuple, or anything else (MAC control and management frames, other protocols).
+ * Idle and sleep energy isn't charged to anything.
+ */
+class EnergyAccounting
+{
+public:
+  /// Frame categories
+  enum Category
+  {
+    RREQ,
+    RREP,
+    RERR,
+    RREP_ACK,
+    HELLO,
+    DATA,
+    OTHER,
+    CATEGORY_COUNT
+  };
+  /// Flow 5-tuple, ports are 0 for protocols other than UDP and TCP
+  struct FlowId
+  {
+    Ipv4Address m_source;
+    Ipv4Address m_destination;
+    uint8_t m_protocol;
+    uint16_t m_sourcePort;
+    uint16_t m_destinationPort;
+    /// Comparison for use as map key
+    bool operator< (FlowId const & o) const;
+  };
+  /// Energy and volume of the frames of a category or flow
+  struct Usage
+  {
+    double m_txEnergy;  ///< J
+    double m_rxEnergy;  ///< J
+    uint64_t m_txBytes;
+    uint64_t m_rxBytes;
+    uint32_t m_txFrames;
+    uint32_t m_rxFrames;
+
+    Usage () : m_txEnergy (0), m_rxEnergy (0), m_txBytes (0), m_rxBytes (0), m_txFrames (0), m_rxFrames (0) {}
+  };
+  /// Signature of WifiPhy MonitorSnifferTx trace source
+  typedef Callback<void, Ptr<const Packet>, uint16_t, uint16_t, uint32_t, WifiPreamble,
+                   WifiTxVector, struct mpduInfo> MonitorSnifferTxCallback;
+  /// Signature of WifiPhy MonitorSnifferRx trace source
+  typedef Callback<void, Ptr<const Packet>, uint16_t, uint16_t, uint32_t, WifiPreamble,
+                   WifiTxVector, struct mpduInfo, struct signalNoiseDbm> MonitorSnifferRxCallback;
+
+  /// c-tor, currents default to those of WifiRadioEnergyModel
+  EnergyAccounting (uint16_t port = 654);
+  /// Set TX and RX currents (A) and supply voltage (V)
+  void SetRadio (double txCurrent, double rxCurrent, double voltage);
+  /// Get callback to connect to the MonitorSnifferTx trace source of the PHY
+  MonitorSnifferTxCallback GetMonitorSnifferTxCallback () const { return m_monitorSnifferTxCallback; }
+  /// Get callback to connect to the MonitorSnifferRx trace source of the PHY
+  MonitorSnifferRxCallback GetMonitorSnifferRxCallback () const { return m_monitorSnifferRxCallback; }
+  /// Charge frame sent with the given airtime
+  void NotifyTx (Ptr<const Packet> frame, Time airtime);
+  /// Charge frame received with the given airtime
+  void NotifyRx (Ptr<const Packet> frame, Time airtime);
+  /// Return usage of category
+  Usage GetUsage (Category category) const { return m_categories[category]; }
+  /// Return usage of data flow, zero if the flow is unknown
+  Usage GetUsage (FlowId const & flow) const;
+  /// Print per category and per flow usage
+  void Print (std::ostream & os) const;
+  /// Forget all usage
+  void Clear ();
+
+private:
+  /// Return category of frame, and flow if it is data
+  Category Classify (Ptr<const Packet> frame, FlowId & flow) const;
+  /// Return airtime of frame with size bytes at rate (500 kbps units)
+  static Time GetAirtime (uint32_t size, uint32_t rate, WifiPreamble preamble, WifiTxVector txVector);
+  /// Process frame sent by PHY
+  void ProcessMonitorSnifferTx (Ptr<const Packet> packet, uint16_t channelFreqMhz, uint16_t channelNumber,
+                                uint32_t rate, WifiPreamble preamble, WifiTxVector txVector,
+                                struct mpduInfo aMpdu);
+  /// Process frame received by PHY
+  void ProcessMonitorSnifferRx (Ptr<const Packet> packet, uint16_t channelFreqMhz, uint16_t channelNumber,
+                                uint32_t rate, WifiPreamble preamble, WifiTxVector txVector,
+                                struct mpduInfo aMpdu, struct signalNoiseDbm signalNoise);
+  /// Charge frame to its category and flow
+  void Charge (Ptr<const Packet> frame, Time airtime, bool tx);
+
+  /// UDP port of AODV_EO
+  uint16_t m_port;
+  /// TX current, A
+  double m_txCurrent;
+  /// RX current, A
+  double m_rxCurrent;
+  /// Supply voltage, V
+  double m_voltage;
+  /// Usage per category
+  Usage m_categories[CATEGORY_COUNT];
+  /// Usage per data flow
+  std::map<FlowId, Usage> m_flows;
+  /// PHY monitor TX callback
+  MonitorSnifferTxCallback m_monitorSnifferTxCallback;
+  /// PHY monitor RX callback
+  MonitorSnifferRxCallback m_monitorSnifferRxCallback;
+};
+
+}
+}
+#endif /* AODV_EO_ENERGY_ACCOUNTING_H */
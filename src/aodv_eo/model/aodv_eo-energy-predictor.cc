@@ -0,0 +1,79 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "aodv_eo-energy-predictor.h"
+#include "ns3/simulator.h"
+#include <algorithm>
+#include <cmath>
+
+namespace ns3
+{
+namespace aodv_eo
+{
+
+EnergyPredictor::EnergyPredictor (Time window) :
+  m_window (window), m_initialized (false), m_lastUpdate (Seconds (0)),
+  m_remaining (0), m_consumed (0), m_harvestRate (0), m_drainRate (0)
+{
+}
+
+void
+EnergyPredictor::Update (double remaining, double consumed)
+{
+  Time now = Simulator::Now ();
+  if (!m_initialized)
+    {
+      m_initialized = true;
+      m_lastUpdate = now;
+      m_remaining = remaining;
+      m_consumed = consumed;
+      return;
+    }
+  Time period = now - m_lastUpdate;
+  if (period <= Seconds (0))
+    return;
+  double drain = std::max (consumed - m_consumed, 0.0) / period.GetSeconds ();
+  // A full source discards harvested energy, so this is what the node could actually store
+  double harvest = std::max (remaining - m_remaining + consumed - m_consumed, 0.0) / period.GetSeconds ();
+  double alpha = (m_window > Seconds (0)) ? 1 - std::exp (-period.GetSeconds () / m_window.GetSeconds ()) : 1;
+  m_drainRate = alpha * drain + (1 - alpha) * m_drainRate;
+  m_harvestRate = alpha * harvest + (1 - alpha) * m_harvestRate;
+  m_lastUpdate = now;
+  m_remaining = remaining;
+  m_consumed = consumed;
+}
+
+Time
+EnergyPredictor::GetTimeToDepletion () const
+{
+  double loss = m_drainRate - m_harvestRate;
+  if (loss <= 0 || m_remaining / loss >= Time::Max ().GetSeconds ())
+    return Time::Max ();
+  return Seconds (m_remaining / loss);
+}
+
+void
+EnergyPredictor::Clear ()
+{
+  m_initialized = false;
+  m_remaining = 0;
+  m_consumed = 0;
+  m_harvestRate = 0;
+  m_drainRate = 0;
+}
+
+}
+}
@@ -0,0 +1,78 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef AODV_EO_ENERGY_PREDICTOR_H
+#define AODV_EO_ENERGY_PREDICTOR_H
+
+#include "ns3/nstime.h"
+
+namespace ns3
+{
+namespace aodv_eo
+{
+/**
+ * \ingroup aodv_eo
+ *
+ * \brief Predicted time to energy depletion of a node from its recent harvesting and drain rates.
+ *
+ * Each update gives the remaining energy of the node and the energy its devices consumed in
+ * total.  The drain rate is the consumption over the time since the previous update, the
+ * harvesting rate is what has to be added to the change of the remaining energy to explain that
+ * consumption.  Both rates are exponentially weighted moving averages with time constant Window,
+ * so that an old sample weighs less the longer the time since it was taken.
+ */
+class EnergyPredictor
+{
+public:
+  /// c-tor
+  EnergyPredictor (Time window = Seconds (30));
+  /**
+   * Fold the energy state of the node now into the rates
+   * \param remaining remaining energy of the node, J
+   * \param consumed total energy consumed by the devices of the node, J
+   */
+  void Update (double remaining, double consumed);
+  /// Return smoothed harvesting rate, W
+  double GetHarvestRate () const { return m_harvestRate; }
+  /// Return smoothed drain rate, W
+  double GetDrainRate () const { return m_drainRate; }
+  /// Return predicted time until the remaining energy reaches zero, Time::Max () if the node is not losing energy
+  Time GetTimeToDepletion () const;
+  /// Set time constant of the moving averages
+  void SetWindow (Time window) { m_window = window; }
+  /// Forget all measurements
+  void Clear ();
+
+private:
+  /// Time constant
+  Time m_window;
+  /// Indicates whether a previous update exists
+  bool m_initialized;
+  /// Time of the previous update
+  Time m_lastUpdate;
+  /// Remaining energy at the previous update
+  double m_remaining;
+  /// Consumed energy at the previous update
+  double m_consumed;
+  /// Smoothed harvesting rate
+  double m_harvestRate;
+  /// Smoothed drain rate
+  double m_drainRate;
+};
+
+}
+}
+#endif /* AODV_EO_ENERGY_PREDICTOR_H */
@@ -0,0 +1,107 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "aodv_eo-load-monitor.h"
+#include "ns3/simulator.h"
+#include <algorithm>
+
+namespace ns3
+{
+namespace aodv_eo
+{
+
+LoadMonitor::LoadMonitor (Time flowTimeout, uint32_t maxFlows, double smoothing) :
+  m_flowTimeout (flowTimeout), m_maxFlows (std::max<uint32_t> (maxFlows, 1)), m_smoothing (smoothing),
+  m_sampleStart (Seconds (0)), m_busyTime (Seconds (0)), m_busyFraction (0), m_load (0)
+{
+  m_phyStateCallback = MakeCallback (&LoadMonitor::NotifyPhyState, this);
+}
+
+void
+LoadMonitor::NotifyPhyState (Time start, Time duration, WifiPhy::State state)
+{
+  if (state != WifiPhy::TX && state != WifiPhy::RX && state != WifiPhy::CCA_BUSY)
+    return;
+  // Only the part of the period inside the current sample counts
+  if (start < m_sampleStart)
+    {
+      duration -= m_sampleStart - start;
+    }
+  if (duration > Seconds (0))
+    {
+      m_busyTime += duration;
+    }
+}
+
+void
+LoadMonitor::NotifyRelayed (Ipv4Address origin, Ipv4Address dst)
+{
+  m_flows[std::make_pair (origin, dst)] = Simulator::Now ();
+}
+
+void
+LoadMonitor::Sample (double queueOccupancy)
+{
+  Time now = Simulator::Now ();
+  Time period = now - m_sampleStart;
+  if (period <= Seconds (0))
+    return;
+  // Several interfaces may be busy at once
+  m_busyFraction = std::min (m_busyTime.GetSeconds () / period.GetSeconds (), 1.0);
+  double flows = std::min ((double) GetActiveFlows () / m_maxFlows, 1.0);
+  double queue = std::max (std::min (queueOccupancy, 1.0), 0.0);
+  double load = (queue + m_busyFraction + flows) / 3;
+  m_load = m_smoothing * load + (1 - m_smoothing) * m_load;
+  m_sampleStart = now;
+  m_busyTime = Seconds (0);
+}
+
+uint32_t
+LoadMonitor::GetActiveFlows ()
+{
+  PurgeFlows ();
+  return m_flows.size ();
+}
+
+void
+LoadMonitor::Clear ()
+{
+  m_flows.clear ();
+  m_sampleStart = Simulator::Now ();
+  m_busyTime = Seconds (0);
+  m_busyFraction = 0;
+  m_load = 0;
+}
+
+void
+LoadMonitor::PurgeFlows ()
+{
+  Time now = Simulator::Now ();
+  for (std::map<std::pair<Ipv4Address, Ipv4Address>, Time>::iterator i = m_flows.begin (); i != m_flows.end (); )
+    {
+      if (now - i->second > m_flowTimeout)
+        {
+          m_flows.erase (i++);
+        }
+      else
+        {
+          ++i;
+        }
+    }
+}
+
+}
+}
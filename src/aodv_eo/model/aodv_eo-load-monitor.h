@@ -0,0 +1,102 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef AODV_EO_LOAD_MONITOR_H
+#define AODV_EO_LOAD_MONITOR_H
+
+#include "ns3/ipv4-address.h"
+#include "ns3/nstime.h"
+#include "ns3/callback.h"
+#include "ns3/wifi-phy.h"
+#include <map>
+#include <utility>
+#include <algorithm>
+
+namespace ns3
+{
+namespace aodv_eo
+{
+/**
+ * \ingroup aodv_eo
+ *
+ * \brief Smoothed estimate of the forwarding load of a node.
+ *
+ * The instantaneous load is the mean of three fractions measured over a sample period:
+ * MAC queue occupancy, time the channel was busy (PHY in TX, RX or CCA_BUSY state) and
+ * number of flows relayed during the last flow timeout relative to MaxFlows.  The load
+ * reported is an exponentially weighted moving average of the samples, in [0, 1].
+ */
+class LoadMonitor
+{
+public:
+  /// Callback matching the State trace source of WifiPhyStateHelper
+  typedef Callback<void, Time, Time, WifiPhy::State> PhyStateCallback;
+
+  /// c-tor
+  LoadMonitor (Time flowTimeout = Seconds (3), uint32_t maxFlows = 4, double smoothing = 0.3);
+  /// Return callback to connect to the State trace source of the PHY
+  PhyStateCallback GetPhyStateCallback () const { return m_phyStateCallback; }
+  /// Account a PHY state period which ended now
+  void NotifyPhyState (Time start, Time duration, WifiPhy::State state);
+  /// Record that a data packet of flow origin -> dst was relayed by this node
+  void NotifyRelayed (Ipv4Address origin, Ipv4Address dst);
+  /**
+   * Close the current sample period and fold it into the smoothed load
+   * \param queueOccupancy MAC queue length divided by its capacity, in [0, 1]
+   */
+  void Sample (double queueOccupancy);
+  /// Return smoothed load in [0, 1]
+  double GetLoad () const { return m_load; }
+  /// Return channel busy fraction of the last sample period
+  double GetBusyFraction () const { return m_busyFraction; }
+  /// Return number of flows relayed during the last flow timeout
+  uint32_t GetActiveFlows ();
+  /// Set time after which a flow without relayed packets is no longer active
+  void SetFlowTimeout (Time t) { m_flowTimeout = t; }
+  /// Set number of active flows which counts as full load
+  void SetMaxFlows (uint32_t n) { m_maxFlows = std::max<uint32_t> (n, 1); }
+  /// Set weight of a new sample in the moving average
+  void SetSmoothing (double alpha) { m_smoothing = alpha; }
+  /// Forget all measurements
+  void Clear ();
+
+private:
+  /// Remove flows not active any more
+  void PurgeFlows ();
+
+  /// Relayed flows: (origin, destination) -> time of last relayed packet
+  std::map<std::pair<Ipv4Address, Ipv4Address>, Time> m_flows;
+  /// Flow timeout
+  Time m_flowTimeout;
+  /// Number of flows which counts as full load
+  uint32_t m_maxFlows;
+  /// Weight of a new sample
+  double m_smoothing;
+  /// Start of the current sample period
+  Time m_sampleStart;
+  /// Channel busy time in the current sample period
+  Time m_busyTime;
+  /// Busy fraction of the last sample period
+  double m_busyFraction;
+  /// Smoothed load
+  double m_load;
+  /// PHY state trace callback
+  PhyStateCallback m_phyStateCallback;
+};
+
+}
+}
+#endif /* AODV_EO_LOAD_MONITOR_H */
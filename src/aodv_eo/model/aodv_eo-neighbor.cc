@@ -28,7 +28,9 @@
 
 #include "aodv_eo-neighbor.h"
 #include "ns3/log.h"
+#include "ns3/packet.h"
 #include <algorithm>
+#include <limits>
 
 
 namespace ns3
@@ -39,11 +41,19 @@ NS_LOG_COMPONENT_DEFINE ("AodvEONeighbors");
 namespace aodv_eo
 {
 Neighbors::Neighbors (Time delay) : 
+  m_weakLinkThreshold (-std::numeric_limits<double>::infinity ()),
+  m_weakLinkHysteresis (0),
+  m_helloInterval (delay),
+  m_windowSize (10),
+  m_txPowerStart (0),
+  m_txPowerEnd (0),
+  m_txPowerLevels (0),
   m_ntimer (Timer::CANCEL_ON_DESTROY)
 {
   m_ntimer.SetDelay (delay);
   m_ntimer.SetFunction (&Neighbors::Purge, this);
   m_txErrorCallback = MakeCallback (&Neighbors::ProcessTxError, this);
+  m_monitorSnifferRxCallback = MakeCallback (&Neighbors::ProcessMonitorSnifferRx, this);
 }
 
 bool
@@ -118,15 +128,25 @@ Neighbors::Purge ()
         }
     }
   m_nb.erase (std::remove_if (m_nb.begin (), m_nb.end (), pred), m_nb.end ());
-  m_ntimer.Cancel ();
-  m_ntimer.Schedule ();
+  ScheduleTimer ();
 }
 
 void
 Neighbors::ScheduleTimer ()
 {
-  m_ntimer.Cancel ();
-  m_ntimer.Schedule ();
+  if (m_scheduleCallback.IsNull ())
+    {
+      m_ntimer.Cancel ();
+      m_ntimer.Schedule ();
+      return;
+    }
+  if (m_nb.empty ())
+    return;
+  Time earliest = m_nb.front ().m_expireTime;
+  for (std::vector<Neighbor>::const_iterator i = m_nb.begin (); i != m_nb.end (); ++i)
+    earliest = std::min (earliest, i->m_expireTime);
+  // CloseNeighbor needs expire time to be strictly in the past
+  m_scheduleCallback (earliest - Simulator::Now () + NanoSeconds (1));
 }
 
 void
@@ -170,6 +190,237 @@ Neighbors::ProcessTxError (WifiMacHeader const & hdr)
     }
   Purge ();
 }
+
+bool
+Neighbors::IsWeakLink (Ipv4Address addr) const
+{
+  for (std::vector<Neighbor>::const_iterator i = m_nb.begin (); i != m_nb.end (); ++i)
+    {
+      if (i->m_neighborAddress == addr)
+        return i->m_weak;
+    }
+  return false;
+}
+
+bool
+Neighbors::GetSignal (Ipv4Address addr, double & signal) const
+{
+  for (std::vector<Neighbor>::const_iterator i = m_nb.begin (); i != m_nb.end (); ++i)
+    {
+      if (i->m_neighborAddress == addr && i->m_signalSamples > 0)
+        {
+          signal = i->m_signal;
+          return true;
+        }
+    }
+  return false;
+}
+
+void
+Neighbors::UpdateSignal (Mac48Address mac, double signal)
+{
+  for (std::vector<Neighbor>::iterator i = m_nb.begin (); i != m_nb.end (); ++i)
+    {
+      if (i->m_hardwareAddress != mac)
+        continue;
+      double previous = i->m_signal;
+      // Exponential moving average, fast start
+      double alpha = std::max (0.25, 1.0 / (i->m_signalSamples + 1));
+      i->m_signal = (i->m_signalSamples == 0) ? signal : (1 - alpha) * i->m_signal + alpha * signal;
+      i->m_signalSamples++;
+      if (i->m_weak)
+        {
+          if (i->m_signal > m_weakLinkThreshold + m_weakLinkHysteresis)
+            {
+              NS_LOG_LOGIC ("Link to " << i->m_neighborAddress << " recovered, signal " << i->m_signal << " dBm");
+              i->m_weak = false;
+            }
+        }
+      // Report the link only while its signal keeps falling below the threshold
+      else if (i->m_signal < m_weakLinkThreshold && i->m_signalSamples > 1 && i->m_signal < previous)
+        {
+          NS_LOG_LOGIC ("Link to " << i->m_neighborAddress << " is getting weak, signal " << i->m_signal << " dBm");
+          i->m_weak = true;
+          if (!m_handleWeakLink.IsNull ())
+            {
+              m_handleWeakLink (i->m_neighborAddress);
+            }
+        }
+      return;
+    }
+}
+
+void
+Neighbors::ProcessMonitorSnifferRx (Ptr<const Packet> packet, uint16_t channelFreqMhz, uint16_t channelNumber,
+                                    uint32_t rate, WifiPreamble preamble, WifiTxVector txVector,
+                                    struct mpduInfo aMpdu, struct signalNoiseDbm signalNoise)
+{
+  WifiMacHeader hdr;
+  if (packet->PeekHeader (hdr) == 0 || !hdr.IsData ())
+    return;
+  if (m_txPowerLevels > 0)
+    {
+      double txPower = m_txPowerStart;
+      if (m_txPowerLevels > 1)
+        {
+          uint32_t level = std::min<uint32_t> (txVector.GetTxPowerLevel (), m_txPowerLevels - 1);
+          txPower += level * (m_txPowerEnd - m_txPowerStart) / (m_txPowerLevels - 1);
+        }
+      for (std::vector<Neighbor>::iterator i = m_nb.begin (); i != m_nb.end (); ++i)
+        {
+          if (i->m_hardwareAddress == hdr.GetAddr2 ())
+            {
+              double loss = txPower - signalNoise.signal;
+              double alpha = std::max (0.25, 1.0 / (i->m_pathLossSamples + 1));
+              i->m_pathLoss = (i->m_pathLossSamples == 0) ? loss : (1 - alpha) * i->m_pathLoss + alpha * loss;
+              i->m_pathLossSamples++;
+              break;
+            }
+        }
+      // Signal the frame would have had at full power
+      UpdateSignal (hdr.GetAddr2 (), signalNoise.signal + m_txPowerEnd - txPower);
+    }
+  else
+    {
+      UpdateSignal (hdr.GetAddr2 (), signalNoise.signal);
+    }
+  // Broadcast frames like hellos are sent at a basic rate, unicast data shows the rate the link can carry
+  if (hdr.GetAddr1 ().IsGroup ())
+    return;
+  for (std::vector<Neighbor>::iterator i = m_nb.begin (); i != m_nb.end (); ++i)
+    {
+      if (i->m_hardwareAddress == hdr.GetAddr2 ())
+        {
+          // Rate is reported in units of 500 kbps
+          i->m_rate = rate * 500000ull;
+        }
+    }
+}
+
+void
+Neighbors::RecordHello (Ipv4Address addr)
+{
+  for (std::vector<Neighbor>::iterator i = m_nb.begin (); i != m_nb.end (); ++i)
+    {
+      if (i->m_neighborAddress == addr)
+        {
+          i->m_helloTimes.push_back (Simulator::Now ());
+          while (i->m_helloTimes.size () > m_windowSize)
+            i->m_helloTimes.pop_front ();
+          return;
+        }
+    }
+}
+
+void
+Neighbors::SetForwardRatio (Ipv4Address addr, uint8_t ratio)
+{
+  for (std::vector<Neighbor>::iterator i = m_nb.begin (); i != m_nb.end (); ++i)
+    {
+      if (i->m_neighborAddress == addr)
+        i->m_forwardRatio = ratio;
+    }
+}
+
+uint8_t
+Neighbors::GetReverseRatio (Ipv4Address addr) const
+{
+  for (std::vector<Neighbor>::const_iterator i = m_nb.begin (); i != m_nb.end (); ++i)
+    {
+      if (i->m_neighborAddress != addr)
+        continue;
+      Time windowStart = Simulator::Now () - m_windowSize * m_helloInterval;
+      uint32_t received = 0;
+      for (std::deque<Time>::const_iterator t = i->m_helloTimes.begin (); t != i->m_helloTimes.end (); ++t)
+        {
+          if (*t > windowStart)
+            received++;
+        }
+      return (uint8_t) (255 * std::min (received, m_windowSize) / m_windowSize);
+    }
+  return 0;
+}
+
+bool
+Neighbors::GetDeliveryRatios (Ipv4Address addr, double & forward, double & reverse) const
+{
+  for (std::vector<Neighbor>::const_iterator i = m_nb.begin (); i != m_nb.end (); ++i)
+    {
+      if (i->m_neighborAddress == addr)
+        {
+          forward = i->m_forwardRatio / 255.0;
+          reverse = GetReverseRatio (addr) / 255.0;
+          return true;
+        }
+    }
+  return false;
+}
+
+void
+Neighbors::GetReverseRatios (std::map<Ipv4Address, uint8_t> & ratios) const
+{
+  for (std::vector<Neighbor>::const_iterator i = m_nb.begin (); i != m_nb.end (); ++i)
+    {
+      ratios[i->m_neighborAddress] = GetReverseRatio (i->m_neighborAddress);
+    }
+}
+
+bool
+Neighbors::GetPathLoss (Ipv4Address addr, double & loss) const
+{
+  for (std::vector<Neighbor>::const_iterator i = m_nb.begin (); i != m_nb.end (); ++i)
+    {
+      if (i->m_neighborAddress == addr && i->m_pathLossSamples > 0)
+        {
+          loss = i->m_pathLoss;
+          return true;
+        }
+    }
+  return false;
+}
+
+Mac48Address
+Neighbors::GetHardwareAddress (Ipv4Address addr) const
+{
+  for (std::vector<Neighbor>::const_iterator i = m_nb.begin (); i != m_nb.end (); ++i)
+    {
+      if (i->m_neighborAddress == addr)
+        return i->m_hardwareAddress;
+    }
+  return Mac48Address ();
+}
+
+uint64_t
+Neighbors::GetRate (Ipv4Address addr) const
+{
+  for (std::vector<Neighbor>::const_iterator i = m_nb.begin (); i != m_nb.end (); ++i)
+    {
+      if (i->m_neighborAddress == addr)
+        return i->m_rate;
+    }
+  return 0;
+}
+
+void
+Neighbors::SetEnergy (Ipv4Address addr, uint32_t energy)
+{
+  for (std::vector<Neighbor>::iterator i = m_nb.begin (); i != m_nb.end (); ++i)
+    {
+      if (i->m_neighborAddress == addr)
+        i->m_energy = energy;
+    }
+}
+
+uint32_t
+Neighbors::GetEnergy (Ipv4Address addr) const
+{
+  for (std::vector<Neighbor>::const_iterator i = m_nb.begin (); i != m_nb.end (); ++i)
+    {
+      if (i->m_neighborAddress == addr)
+        return i->m_energy;
+    }
+  return std::numeric_limits<uint32_t>::max ();
+}
 }
 }
 
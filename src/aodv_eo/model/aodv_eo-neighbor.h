@@ -34,8 +34,12 @@
 #include "ns3/ipv4-address.h"
 #include "ns3/callback.h"
 #include "ns3/wifi-mac-header.h"
+#include "ns3/wifi-phy.h"
 #include "ns3/arp-cache.h"
+#include <map>
 #include <vector>
+#include <deque>
+#include <limits>
 
 namespace ns3
 {
@@ -58,10 +62,28 @@ public:
     Mac48Address m_hardwareAddress;
     Time m_expireTime;
     bool close;
+    /// Smoothed received signal strength, dBm, valid if m_signalSamples > 0
+    double m_signal;
+    uint32_t m_signalSamples;
+    /// Signal has fallen below the warning threshold
+    bool m_weak;
+    /// Reception times of hellos within the link quality window
+    std::deque<Time> m_helloTimes;
+    /// Delivery ratio of own hellos reported by the neighbor, 0..255
+    uint8_t m_forwardRatio;
+    /// PHY rate of the last unicast data frame received from the neighbor, bps, 0 if unknown
+    uint64_t m_rate;
+    /// Smoothed path loss to the neighbor, dB, valid if m_pathLossSamples > 0
+    double m_pathLoss;
+    uint32_t m_pathLossSamples;
+    /// Energy advertised in the neighbor's hellos, maximum value if unknown
+    uint32_t m_energy;
 
     Neighbor (Ipv4Address ip, Mac48Address mac, Time t) :
       m_neighborAddress (ip), m_hardwareAddress (mac), m_expireTime (t),
-      close (false)
+      close (false), m_signal (0), m_signalSamples (0), m_weak (false),
+      m_forwardRatio (0), m_rate (0), m_pathLoss (0), m_pathLossSamples (0),
+      m_energy (std::numeric_limits<uint32_t>::max ())
     {
     }
   };
@@ -75,6 +97,8 @@ public:
   void Purge ();
   /// Schedule m_ntimer.
   void ScheduleTimer ();
+  /// Cancel m_ntimer.
+  void CancelTimer () { m_ntimer.Cancel (); }
   /// Remove all entries
   void Clear () { m_nb.clear (); }
 
@@ -84,17 +108,118 @@ public:
   void DelArpCache (Ptr<ArpCache>);
   /// Get callback to ProcessTxError
   Callback<void, WifiMacHeader const &> GetTxErrorCallback () const { return m_txErrorCallback; }
+  /// Signature of WifiPhy MonitorSnifferRx trace source
+  typedef Callback<void, Ptr<const Packet>, uint16_t, uint16_t, uint32_t, WifiPreamble,
+                   WifiTxVector, struct mpduInfo, struct signalNoiseDbm> MonitorSnifferRxCallback;
+  /// Get callback to ProcessMonitorSnifferRx
+  MonitorSnifferRxCallback GetMonitorSnifferRxCallback () const { return m_monitorSnifferRxCallback; }
+  /**
+   * Set signal strength below which the link to a neighbor is reported as weak.
+   * Link is reported again only after the signal has recovered by hysteresis dB.
+   */
+  void SetWeakLinkThreshold (double threshold, double hysteresis)
+  {
+    m_weakLinkThreshold = threshold;
+    m_weakLinkHysteresis = hysteresis;
+  }
+  /// Check that signal from neighbor with address addr is below the warning threshold
+  bool IsWeakLink (Ipv4Address addr) const;
+  /// Return smoothed signal strength (dBm) of neighbor with address addr, false if unknown
+  bool GetSignal (Ipv4Address addr, double & signal) const;
+  /// Feed one received signal strength sample of a frame transmitted by mac
+  void UpdateSignal (Mac48Address mac, double signal);
+  /// Handle weak link callback
+  void SetWeakLinkCallback (Callback<void, Ipv4Address> cb) { m_handleWeakLink = cb; }
+
+  ///\name Link quality from hello delivery ratios
+  //\{
+  /// Set link quality window: number of hellos expected per window and interval between them
+  void SetLinkQualityWindow (Time helloInterval, uint32_t size)
+  {
+    m_helloInterval = helloInterval;
+    m_windowSize = size;
+  }
+  /// Record hello received from neighbor with address addr
+  void RecordHello (Ipv4Address addr);
+  /// Set delivery ratio (0..255) of own hellos reported by neighbor with address addr
+  void SetForwardRatio (Ipv4Address addr, uint8_t ratio);
+  /// Return delivery ratio (0..255) of hellos received from neighbor with address addr within the window
+  uint8_t GetReverseRatio (Ipv4Address addr) const;
+  /**
+   * Get forward and reverse delivery ratios of the link to neighbor with address addr
+   * \return false if addr isn't a neighbor
+   */
+  bool GetDeliveryRatios (Ipv4Address addr, double & forward, double & reverse) const;
+  /// Get reverse delivery ratios of all neighbors
+  void GetReverseRatios (std::map<Ipv4Address, uint8_t> & ratios) const;
+  /// Return PHY rate (bps) of the last unicast data frame received from neighbor with address addr, 0 if unknown
+  uint64_t GetRate (Ipv4Address addr) const;
+  //\}
+
+  ///\name Path loss for transmit power control
+  //\{
+  /**
+   * Set TX power levels of the PHY, assumed the same at all nodes, and learn path loss to neighbors
+   * from the TX power level of the frames they send. Signal strength samples are then normalized
+   * to the highest level, so that weak link detection ignores power control.
+   * \param levels number of levels, 0 disables path loss learning
+   */
+  void SetTxPowerLevels (double start, double end, uint32_t levels)
+  {
+    m_txPowerStart = start;
+    m_txPowerEnd = end;
+    m_txPowerLevels = levels;
+  }
+  /// Return smoothed path loss (dB) to neighbor with address addr, false if unknown
+  bool GetPathLoss (Ipv4Address addr, double & loss) const;
+  /// Return MAC address of neighbor with address addr, Mac48Address () if unknown
+  Mac48Address GetHardwareAddress (Ipv4Address addr) const;
+  //\}
+
+  ///\name Neighbor energy from hellos
+  //\{
+  /// Set energy advertised by neighbor with address addr
+  void SetEnergy (Ipv4Address addr, uint32_t energy);
+  /// Return energy advertised by neighbor with address addr, maximum value if unknown
+  uint32_t GetEnergy (Ipv4Address addr) const;
+  //\}
  
   /// Handle link failure callback
   void SetCallback (Callback<void, Ipv4Address> cb) { m_handleLinkFailure = cb; }
   /// Handle link failure callback
   Callback<void, Ipv4Address> GetCallback () const { return m_handleLinkFailure; }
+  /**
+   * Schedule Purge() through an external scheduler instead of m_ntimer.
+   * The callback is called with the delay until the earliest neighbor expiration
+   * and nothing is scheduled while there are no neighbors.
+   */
+  void SetScheduleCallback (Callback<void, Time> cb) { m_scheduleCallback = cb; }
 
 private:
   /// link failure callback
   Callback<void, Ipv4Address> m_handleLinkFailure;
   /// TX error callback
   Callback<void, WifiMacHeader const &> m_txErrorCallback;
+  /// PHY monitor RX callback
+  MonitorSnifferRxCallback m_monitorSnifferRxCallback;
+  /// Weak link callback
+  Callback<void, Ipv4Address> m_handleWeakLink;
+  /// Signal strength threshold of weak link, dBm
+  double m_weakLinkThreshold;
+  /// Signal recovery needed to clear weak link state, dB
+  double m_weakLinkHysteresis;
+  /// Interval between hellos of a neighbor
+  Time m_helloInterval;
+  /// Number of hellos in the link quality window
+  uint32_t m_windowSize;
+  /// Lowest TX power, dBm
+  double m_txPowerStart;
+  /// Highest TX power, dBm
+  double m_txPowerEnd;
+  /// Number of TX power levels, 0 if path loss isn't learned
+  uint32_t m_txPowerLevels;
+  /// External purge scheduler, m_ntimer is used if null
+  Callback<void, Time> m_scheduleCallback;
   /// Timer for neighbor's list. Schedule Purge().
   Timer m_ntimer;
   /// vector of entries
@@ -106,6 +231,10 @@ private:
   Mac48Address LookupMacAddress (Ipv4Address);
   /// Process layer 2 TX error notification
   void ProcessTxError (WifiMacHeader const &);
+  /// Process frame received by PHY, take signal strength sample of data frames from neighbors
+  void ProcessMonitorSnifferRx (Ptr<const Packet> packet, uint16_t channelFreqMhz, uint16_t channelNumber,
+                                uint32_t rate, WifiPreamble preamble, WifiTxVector txVector,
+                                struct mpduInfo aMpdu, struct signalNoiseDbm signalNoise);
 };
 
 }
@@ -29,6 +29,8 @@
 
 #include "ns3/address-utils.h"
 #include "ns3/packet.h"
+#include <vector>
+#include <algorithm>
 
 namespace ns3
 {
@@ -45,7 +47,7 @@ TypeHeader::TypeHeader (MessageType t) :
 TypeId
 TypeHeader::GetTypeId ()
 {
-  static TypeId tid = TypeId ("ns3::aodv::TypeHeader")
+  static TypeId tid = TypeId ("ns3::aodv_eo::TypeHeader")
     .SetParent<Header> ()
     .SetGroupName("Aodv_EO")
     .AddConstructor<TypeHeader> ()
@@ -83,6 +85,7 @@ TypeHeader::Deserialize (Buffer::Iterator start)
     case AODVTYPE_RREP:
     case AODVTYPE_RERR:
     case AODVTYPE_RREP_ACK:
+    case AODVTYPE_BUNDLE:
       {
         m_type = (MessageType) type;
         break;
@@ -120,6 +123,11 @@ TypeHeader::Print (std::ostream &os) const
         os << "RREP_ACK";
         break;
       }
+    case AODVTYPE_BUNDLE:
+      {
+        os << "BUNDLE";
+        break;
+      }
     default:
       os << "UNKNOWN_TYPE";
     }
@@ -138,6 +146,83 @@ operator<< (std::ostream & os, TypeHeader const & h)
   return os;
 }
 
+//-----------------------------------------------------------------------------
+// Extensions
+//-----------------------------------------------------------------------------
+
+static uint32_t
+GetExtensionsSize (std::map<uint8_t, uint32_t> const & extensions,
+                   std::map<Ipv4Address, uint8_t> const * linkQualities = 0)
+{
+  uint32_t size = 6 * extensions.size ();
+  if (linkQualities != 0 && !linkQualities->empty ())
+    size += 2 + 5 * linkQualities->size ();
+  return (size == 0) ? 0 : 1 + size;
+}
+
+static void
+WriteExtensions (Buffer::Iterator & i, std::map<uint8_t, uint32_t> const & extensions,
+                 std::map<Ipv4Address, uint8_t> const * linkQualities = 0)
+{
+  bool withLinkQualities = (linkQualities != 0 && !linkQualities->empty ());
+  if (extensions.empty () && !withLinkQualities)
+    return;
+  i.WriteU8 ((uint8_t) (extensions.size () + (withLinkQualities ? 1 : 0)));
+  for (std::map<uint8_t, uint32_t>::const_iterator j = extensions.begin (); j != extensions.end (); ++j)
+    {
+      i.WriteU8 (j->first);
+      i.WriteU8 (4);
+      i.WriteHtonU32 (j->second);
+    }
+  if (withLinkQualities)
+    {
+      i.WriteU8 (AODVEXT_LINK_QUALITY);
+      i.WriteU8 ((uint8_t) (5 * linkQualities->size ()));
+      for (std::map<Ipv4Address, uint8_t>::const_iterator j = linkQualities->begin (); j != linkQualities->end (); ++j)
+        {
+          WriteTo (i, j->first);
+          i.WriteU8 (j->second);
+        }
+    }
+}
+
+/// Read extensions which fit in the rest of the message, a truncated extension and those after it are ignored
+static void
+ReadExtensions (Buffer::Iterator & i, std::map<uint8_t, uint32_t> & extensions,
+                std::map<Ipv4Address, uint8_t> * linkQualities = 0)
+{
+  if (i.GetRemainingSize () < 1)
+    return;
+  uint8_t count = i.ReadU8 ();
+  for (uint8_t k = 0; k < count; ++k)
+    {
+      if (i.GetRemainingSize () < 2)
+        return;
+      uint8_t type = i.ReadU8 ();
+      uint8_t length = i.ReadU8 ();
+      if (i.GetRemainingSize () < length)
+        return;
+      if (type == AODVEXT_LINK_QUALITY && linkQualities != 0 && length % 5 == 0)
+        {
+          for (uint8_t n = 0; n < length / 5; ++n)
+            {
+              Ipv4Address neighbor;
+              ReadFrom (i, neighbor);
+              (*linkQualities)[neighbor] = i.ReadU8 ();
+            }
+        }
+      else if (length == 4)
+        {
+          extensions[type] = i.ReadNtohU32 ();
+        }
+      else
+        {
+          // Unknown extension, skip it
+          i.Next (length);
+        }
+    }
+}
+
 //-----------------------------------------------------------------------------
 // RREQ
 //-----------------------------------------------------------------------------
@@ -170,7 +255,7 @@ RreqHeader::GetInstanceTypeId () const
 uint32_t
 RreqHeader::GetSerializedSize () const
 {
-  return 23;
+  return 23 + GetExtensionsSize (m_extensions);
 }
 
 void
@@ -184,12 +269,19 @@ RreqHeader::Serialize (Buffer::Iterator i) const
   i.WriteHtonU32 (m_dstSeqNo);
   WriteTo (i, m_origin);
   i.WriteHtonU32 (m_originSeqNo);
+  WriteExtensions (i, m_extensions);
 }
 
 uint32_t
 RreqHeader::Deserialize (Buffer::Iterator start)
 {
   Buffer::Iterator i = start;
+  m_extensions.clear ();
+  if (i.GetRemainingSize () < 23)
+    {
+      // Truncated, see MessageHeader::IsValid
+      return 0;
+    }
   m_flags = i.ReadU8 ();
   m_reserved = i.ReadU8 ();
   m_hopCount = i.ReadU8 ();
@@ -198,9 +290,12 @@ RreqHeader::Deserialize (Buffer::Iterator start)
   m_dstSeqNo = i.ReadNtohU32 ();
   ReadFrom (i, m_origin);
   m_originSeqNo = i.ReadNtohU32 ();
+  if (m_flags & (1 << 2))
+    {
+      ReadExtensions (i, m_extensions);
+    }
 
   uint32_t dist = i.GetDistanceFrom (start);
-  NS_ASSERT (dist == GetSerializedSize ());
   return dist;
 }
 
@@ -267,13 +362,39 @@ RreqHeader::GetUnknownSeqno () const
   return (m_flags & (1 << 3));
 }
 
+void
+RreqHeader::SetExtension (uint8_t type, uint32_t value)
+{
+  m_extensions[type] = value;
+  m_flags |= (1 << 2);
+}
+
+bool
+RreqHeader::GetExtension (uint8_t type, uint32_t & value) const
+{
+  std::map<uint8_t, uint32_t>::const_iterator i = m_extensions.find (type);
+  if (i == m_extensions.end ())
+    return false;
+  value = i->second;
+  return true;
+}
+
+void
+RreqHeader::RemoveExtension (uint8_t type)
+{
+  m_extensions.erase (type);
+  if (m_extensions.empty ())
+    m_flags &= ~(1 << 2);
+}
+
 bool
 RreqHeader::operator== (RreqHeader const & o) const
 {
   return (m_flags == o.m_flags && m_reserved == o.m_reserved &&
           m_hopCount == o.m_hopCount && m_requestID == o.m_requestID &&
           m_dst == o.m_dst && m_dstSeqNo == o.m_dstSeqNo &&
-          m_origin == o.m_origin && m_originSeqNo == o.m_originSeqNo);
+          m_origin == o.m_origin && m_originSeqNo == o.m_originSeqNo &&
+          m_extensions == o.m_extensions);
 }
 
 //-----------------------------------------------------------------------------
@@ -310,7 +431,7 @@ RrepHeader::GetInstanceTypeId () const
 uint32_t
 RrepHeader::GetSerializedSize () const
 {
-  return 19;
+  return 19 + GetExtensionsSize (m_extensions, &m_linkQualities);
 }
 
 void
@@ -323,13 +444,20 @@ RrepHeader::Serialize (Buffer::Iterator i) const
   i.WriteHtonU32 (m_dstSeqNo);
   WriteTo (i, m_origin);
   i.WriteHtonU32 (m_lifeTime);
+  WriteExtensions (i, m_extensions, &m_linkQualities);
 }
 
 uint32_t
 RrepHeader::Deserialize (Buffer::Iterator start)
 {
   Buffer::Iterator i = start;
-
+  m_extensions.clear ();
+  m_linkQualities.clear ();
+  if (i.GetRemainingSize () < 19)
+    {
+      // Truncated, see MessageHeader::IsValid
+      return 0;
+    }
   m_flags = i.ReadU8 ();
   m_prefixSize = i.ReadU8 ();
   m_hopCount = i.ReadU8 ();
@@ -337,9 +465,12 @@ RrepHeader::Deserialize (Buffer::Iterator start)
   m_dstSeqNo = i.ReadNtohU32 ();
   ReadFrom (i, m_origin);
   m_lifeTime = i.ReadNtohU32 ();
+  if (m_flags & (1 << 5))
+    {
+      ReadExtensions (i, m_extensions, &m_linkQualities);
+    }
 
   uint32_t dist = i.GetDistanceFrom (start);
-  NS_ASSERT (dist == GetSerializedSize ());
   return dist;
 }
 
@@ -395,12 +526,58 @@ RrepHeader::GetPrefixSize () const
   return m_prefixSize;
 }
 
+void
+RrepHeader::SetExtension (uint8_t type, uint32_t value)
+{
+  m_extensions[type] = value;
+  m_flags |= (1 << 5);
+}
+
+bool
+RrepHeader::GetExtension (uint8_t type, uint32_t & value) const
+{
+  std::map<uint8_t, uint32_t>::const_iterator i = m_extensions.find (type);
+  if (i == m_extensions.end ())
+    return false;
+  value = i->second;
+  return true;
+}
+
+void
+RrepHeader::RemoveExtension (uint8_t type)
+{
+  m_extensions.erase (type);
+  if (m_extensions.empty () && m_linkQualities.empty ())
+    m_flags &= ~(1 << 5);
+}
+
+bool
+RrepHeader::AddLinkQuality (Ipv4Address neighbor, uint8_t ratio)
+{
+  if (m_linkQualities.size () >= MAX_LINK_QUALITIES && m_linkQualities.find (neighbor) == m_linkQualities.end ())
+    return false;
+  m_linkQualities[neighbor] = ratio;
+  m_flags |= (1 << 5);
+  return true;
+}
+
+bool
+RrepHeader::GetLinkQuality (Ipv4Address neighbor, uint8_t & ratio) const
+{
+  std::map<Ipv4Address, uint8_t>::const_iterator i = m_linkQualities.find (neighbor);
+  if (i == m_linkQualities.end ())
+    return false;
+  ratio = i->second;
+  return true;
+}
+
 bool
 RrepHeader::operator== (RrepHeader const & o) const
 {
   return (m_flags == o.m_flags && m_prefixSize == o.m_prefixSize &&
           m_hopCount == o.m_hopCount && m_dst == o.m_dst && m_dstSeqNo == o.m_dstSeqNo &&
-          m_origin == o.m_origin && m_lifeTime == o.m_lifeTime);
+          m_origin == o.m_origin && m_lifeTime == o.m_lifeTime &&
+          m_extensions == o.m_extensions && m_linkQualities == o.m_linkQualities);
 }
 
 void
@@ -409,6 +586,8 @@ RrepHeader::SetHello (Ipv4Address origin, uint32_t srcSeqNo, Time lifetime)
   m_flags = 0;
   m_prefixSize = 0;
   m_hopCount = 0;
+  m_extensions.clear ();
+  m_linkQualities.clear ();
   m_dst = origin;
   m_dstSeqNo = srcSeqNo;
   m_origin = origin;
@@ -494,7 +673,7 @@ operator<< (std::ostream & os, RrepAckHeader const & h )
 // RERR
 //-----------------------------------------------------------------------------
 RerrHeader::RerrHeader () :
-  m_flag (0), m_reserved (0)
+  m_flag (0), m_reserved (0), m_first (0), m_count (0)
 {
 }
 
@@ -529,11 +708,10 @@ RerrHeader::Serialize (Buffer::Iterator i ) const
   i.WriteU8 (m_flag);
   i.WriteU8 (m_reserved);
   i.WriteU8 (GetDestCount ());
-  std::map<Ipv4Address, uint32_t>::const_iterator j;
-  for (j = m_unreachableDstSeqNo.begin (); j != m_unreachableDstSeqNo.end (); ++j)
+  for (Iterator j = Begin (); j != End (); ++j)
     {
-      WriteTo (i, (*j).first);
-      i.WriteHtonU32 ((*j).second);
+      WriteTo (i, j->first);
+      i.WriteHtonU32 (j->second);
     }
 }
 
@@ -544,14 +722,16 @@ RerrHeader::Deserialize (Buffer::Iterator start )
   m_flag = i.ReadU8 ();
   m_reserved = i.ReadU8 ();
   uint8_t dest = i.ReadU8 ();
-  m_unreachableDstSeqNo.clear ();
+  m_overflow.clear ();
+  m_first = 0;
+  m_count = 0;
   Ipv4Address address;
   uint32_t seqNo;
-  for (uint8_t k = 0; k < dest; ++k)
+  for (uint8_t k = 0; k < dest && i.GetRemainingSize () >= 8; ++k)
     {
       ReadFrom (i, address);
       seqNo = i.ReadNtohU32 ();
-      m_unreachableDstSeqNo.insert (std::make_pair (address, seqNo));
+      AddUnDestination (address, seqNo);
     }
 
   uint32_t dist = i.GetDistanceFrom (start);
@@ -563,10 +743,9 @@ void
 RerrHeader::Print (std::ostream &os ) const
 {
   os << "Unreachable destination (ipv4 address, seq. number):";
-  std::map<Ipv4Address, uint32_t>::const_iterator j;
-  for (j = m_unreachableDstSeqNo.begin (); j != m_unreachableDstSeqNo.end (); ++j)
+  for (Iterator j = Begin (); j != End (); ++j)
     {
-      os << (*j).first << ", " << (*j).second;
+      os << j->first << ", " << j->second;
     }
   os << "No delete flag " << (*this).GetNoDelete ();
 }
@@ -586,32 +765,71 @@ RerrHeader::GetNoDelete () const
   return (m_flag & (1 << 0));
 }
 
+static bool
+IsAddressLess (RerrHeader::UnreachableDestination const & un, Ipv4Address const & address)
+{
+  return un.first < address;
+}
+
 bool
 RerrHeader::AddUnDestination (Ipv4Address dst, uint32_t seqNo )
 {
-  if (m_unreachableDstSeqNo.find (dst) != m_unreachableDstSeqNo.end ())
-    return true;
+  Iterator end = End ();
+  Iterator j = end;
+  // Destinations mostly come in increasing order, from a map
+  if (GetDestCount () > 0 && !((end - 1)->first < dst))
+    {
+      j = std::lower_bound (Begin (), end, dst, IsAddressLess);
+      if (j != end && j->first == dst)
+        return true;
+    }
 
-  NS_ASSERT (GetDestCount () < 255); // can't support more than 255 destinations in single RERR
-  m_unreachableDstSeqNo.insert (std::make_pair (dst, seqNo));
+  NS_ASSERT (GetDestCount () < MAX_DESTINATIONS); // can't support more than 255 destinations in single RERR
+  uint32_t index = j - GetStorage ();
+  if (m_overflow.empty () && m_count == INLINE_DESTINATIONS)
+    {
+      m_overflow.reserve (2 * INLINE_DESTINATIONS);
+      m_overflow.assign (m_inline + m_first, m_inline + m_count);
+      index -= m_first;
+      m_count -= m_first;
+      m_first = 0;
+    }
+  UnreachableDestination un (dst, seqNo);
+  if (m_overflow.empty ())
+    {
+      std::copy_backward (m_inline + index, m_inline + m_count, m_inline + m_count + 1);
+      m_inline[index] = un;
+    }
+  else
+    {
+      m_overflow.insert (m_overflow.begin () + index, un);
+    }
+  ++m_count;
   return true;
 }
 
 bool
 RerrHeader::RemoveUnDestination (std::pair<Ipv4Address, uint32_t> & un )
 {
-  if (m_unreachableDstSeqNo.empty ())
+  if (GetDestCount () == 0)
     return false;
-  std::map<Ipv4Address, uint32_t>::iterator i = m_unreachableDstSeqNo.begin ();
-  un = *i;
-  m_unreachableDstSeqNo.erase (i);
+  un = *Begin ();
+  ++m_first;
+  if (m_first == m_count)
+    {
+      m_overflow.clear ();
+      m_first = 0;
+      m_count = 0;
+    }
   return true;
 }
 
 void
 RerrHeader::Clear ()
 {
-  m_unreachableDstSeqNo.clear ();
+  m_overflow.clear ();
+  m_first = 0;
+  m_count = 0;
   m_flag = 0;
   m_reserved = 0;
 }
@@ -621,22 +839,641 @@ RerrHeader::operator== (RerrHeader const & o ) const
 {
   if (m_flag != o.m_flag || m_reserved != o.m_reserved || GetDestCount () != o.GetDestCount ())
     return false;
+  return std::equal (Begin (), End (), o.Begin ());
+}
+
+std::ostream &
+operator<< (std::ostream & os, RerrHeader const & h )
+{
+  h.Print (os);
+  return os;
+}
+
+//-----------------------------------------------------------------------------
+// Type and message in one header
+//-----------------------------------------------------------------------------
+
+template <>
+TypeId
+RreqMessage::GetTypeId ()
+{
+  static TypeId tid = TypeId ("ns3::aodv_eo::RreqMessage")
+    .SetParent<Header> ()
+    .SetGroupName("Aodv_EO")
+    .AddConstructor<RreqMessage> ()
+  ;
+  return tid;
+}
+
+template <>
+TypeId
+RrepMessage::GetTypeId ()
+{
+  static TypeId tid = TypeId ("ns3::aodv_eo::RrepMessage")
+    .SetParent<Header> ()
+    .SetGroupName("Aodv_EO")
+    .AddConstructor<RrepMessage> ()
+  ;
+  return tid;
+}
+
+template <>
+TypeId
+RerrMessage::GetTypeId ()
+{
+  static TypeId tid = TypeId ("ns3::aodv_eo::RerrMessage")
+    .SetParent<Header> ()
+    .SetGroupName("Aodv_EO")
+    .AddConstructor<RerrMessage> ()
+  ;
+  return tid;
+}
+
+template <>
+TypeId
+RrepAckMessage::GetTypeId ()
+{
+  static TypeId tid = TypeId ("ns3::aodv_eo::RrepAckMessage")
+    .SetParent<Header> ()
+    .SetGroupName("Aodv_EO")
+    .AddConstructor<RrepAckMessage> ()
+  ;
+  return tid;
+}
+
+NS_OBJECT_ENSURE_REGISTERED (RreqMessage);
+NS_OBJECT_ENSURE_REGISTERED (RrepMessage);
+NS_OBJECT_ENSURE_REGISTERED (RerrMessage);
+NS_OBJECT_ENSURE_REGISTERED (RrepAckMessage);
+
+//-----------------------------------------------------------------------------
+// Compact encoding
+//-----------------------------------------------------------------------------
+
+static uint32_t
+GetVarintSize (uint32_t value)
+{
+  uint32_t size = 1;
+  while (value >= 0x80)
+    {
+      value >>= 7;
+      ++size;
+    }
+  return size;
+}
+
+static void
+WriteVarint (Buffer::Iterator & i, uint32_t value)
+{
+  while (value >= 0x80)
+    {
+      i.WriteU8 ((uint8_t) (value | 0x80));
+      value >>= 7;
+    }
+  i.WriteU8 ((uint8_t) value);
+}
 
-  std::map<Ipv4Address, uint32_t>::const_iterator j = m_unreachableDstSeqNo.begin ();
-  std::map<Ipv4Address, uint32_t>::const_iterator k = o.m_unreachableDstSeqNo.begin ();
-  for (uint8_t i = 0; i < GetDestCount (); ++i)
+/// Read variable length integer, \return false if the buffer ends before it
+static bool
+ReadVarint (Buffer::Iterator & i, uint32_t & value)
+{
+  value = 0;
+  for (uint32_t shift = 0; shift < 35; shift += 7)
     {
-      if ((j->first != k->first) || (j->second != k->second))
+      if (i.GetRemainingSize () < 1)
         return false;
+      uint8_t octet = i.ReadU8 ();
+      value |= (uint32_t) (octet & 0x7f) << shift;
+      if (!(octet & 0x80))
+        break;
+    }
+  return true;
+}
+
+/// Map difference of sequence numbers to an unsigned integer, small for small differences of either sign
+static uint32_t
+EncodeDelta (uint32_t value, uint32_t reference)
+{
+  int32_t delta = (int32_t) (value - reference);
+  return ((uint32_t) delta << 1) ^ (uint32_t) (delta >> 31);
+}
+
+static uint32_t
+DecodeDelta (uint32_t encoded, uint32_t reference)
+{
+  return reference + ((encoded >> 1) ^ (0 - (encoded & 1)));
+}
+
+/// Compact first octet
+enum CompactBits
+{
+  COMPACT_MARKER = 0x80,
+  COMPACT_SHORT = 0x10,
+  COMPACT_EXTENSIONS = 0x08,
+  COMPACT_RREQ_G = 0x04,
+  COMPACT_RREQ_D = 0x02,
+  COMPACT_RREQ_U = 0x01,
+  COMPACT_RREP_A = 0x04,
+  COMPACT_RREP_H = 0x02,
+  COMPACT_RREP_P = 0x01,
+  COMPACT_RERR_N = 0x01
+};
+
+CompactHeader::CompactHeader (Ipv4Address local, Ipv4Mask mask) :
+  m_type (AODVTYPE_RREQ), m_local (local), m_mask (mask), m_valid (true)
+{
+}
+
+NS_OBJECT_ENSURE_REGISTERED (CompactHeader);
+
+TypeId
+CompactHeader::GetTypeId ()
+{
+  static TypeId tid = TypeId ("ns3::aodv_eo::CompactHeader")
+    .SetParent<Header> ()
+    .SetGroupName("Aodv_EO")
+    .AddConstructor<CompactHeader> ()
+  ;
+  return tid;
+}
+
+TypeId
+CompactHeader::GetInstanceTypeId () const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+CompactHeader::GetShortAddressSize () const
+{
+  uint16_t prefix = m_mask.GetPrefixLength ();
+  return (prefix == 16 || prefix == 24) ? (32 - prefix) / 8 : 0;
+}
+
+uint32_t
+CompactHeader::GetAddressSize () const
+{
+  uint32_t size = GetShortAddressSize ();
+  if (size == 0)
+    return 4;
+  std::vector<Ipv4Address> addresses;
+  switch (m_type)
+    {
+    case AODVTYPE_RREQ:
+      addresses.push_back (m_rreq.m_dst);
+      addresses.push_back (m_rreq.m_origin);
+      break;
+    case AODVTYPE_RREP:
+      addresses.push_back (m_rrep.m_dst);
+      addresses.push_back (m_rrep.m_origin);
+      break;
+    case AODVTYPE_RERR:
+      for (RerrHeader::Iterator j = m_rerr.Begin (); j != m_rerr.End (); ++j)
+        {
+          addresses.push_back (j->first);
+        }
+      break;
+    default:
+      break;
+    }
+  if (addresses.empty ())
+    {
+      // Spare the prefix length octet
+      return 4;
+    }
+  for (std::vector<Ipv4Address>::const_iterator j = addresses.begin (); j != addresses.end (); ++j)
+    {
+      if (!m_mask.IsMatch (*j, m_local))
+        return 4;
+    }
+  return size;
+}
+
+bool
+CompactHeader::IsHello () const
+{
+  return m_type == AODVTYPE_RREP && m_rrep.m_dst == m_rrep.m_origin;
+}
+
+void
+CompactHeader::WriteAddress (Buffer::Iterator & i, Ipv4Address address, uint32_t size) const
+{
+  if (size == 4)
+    WriteTo (i, address);
+  else if (size == 2)
+    i.WriteHtonU16 ((uint16_t) address.Get ());
+  else
+    i.WriteU8 ((uint8_t) address.Get ());
+}
+
+bool
+CompactHeader::ReadAddress (Buffer::Iterator & i, uint32_t size, Ipv4Address & address) const
+{
+  if (i.GetRemainingSize () < size)
+    return false;
+  if (size == 4)
+    {
+      ReadFrom (i, address);
+      return true;
+    }
+  // Network part of the sender's subnet, which the receiver shares
+  uint32_t network = m_local.Get () & (0xffffffff << (8 * size));
+  uint32_t host = (size == 2) ? i.ReadNtohU16 () : i.ReadU8 ();
+  address = Ipv4Address (network | host);
+  return true;
+}
+
+void
+CompactHeader::WriteHead (Buffer::Iterator & i, uint8_t first, uint32_t address) const
+{
+  i.WriteU8 (first);
+  if (address != 4)
+    i.WriteU8 ((uint8_t) m_mask.GetPrefixLength ());
+}
+
+uint32_t
+CompactHeader::GetSerializedSize () const
+{
+  uint32_t address = GetAddressSize ();
+  // First octet and, with short addresses, prefix length of the sender
+  uint32_t size = (address != 4) ? 2 : 1;
+  switch (m_type)
+    {
+    case AODVTYPE_RREQ:
+      size += 1 + GetVarintSize (m_rreq.m_requestID) + 2 * address + GetVarintSize (m_rreq.m_dstSeqNo)
+        + GetVarintSize (EncodeDelta (m_rreq.m_originSeqNo, m_rreq.m_requestID))
+        + GetExtensionsSize (m_rreq.m_extensions);
+      break;
+    case AODVTYPE_RREP:
+      size += 1 + (m_rrep.m_prefixSize != 0 ? 1 : 0) + address + GetVarintSize (m_rrep.m_dstSeqNo)
+        + (IsHello () ? 0 : address) + GetVarintSize (m_rrep.m_lifeTime)
+        + GetExtensionsSize (m_rrep.m_extensions, &m_rrep.m_linkQualities);
+      break;
+    case AODVTYPE_RERR:
+      {
+        size += 1;
+        uint32_t previous = 0;
+        for (RerrHeader::Iterator j = m_rerr.Begin (); j != m_rerr.End (); ++j)
+          {
+            size += address + GetVarintSize (EncodeDelta (j->second, previous));
+            previous = j->second;
+          }
+        break;
+      }
+    default:
+      break;
+    }
+  return size;
+}
+
+void
+CompactHeader::Serialize (Buffer::Iterator i) const
+{
+  uint32_t address = GetAddressSize ();
+  uint8_t first = COMPACT_MARKER | (((uint8_t) m_type - 1) << 5);
+  if (address != 4)
+    first |= COMPACT_SHORT;
+  switch (m_type)
+    {
+    case AODVTYPE_RREQ:
+      {
+        if (!m_rreq.m_extensions.empty ())
+          first |= COMPACT_EXTENSIONS;
+        if (m_rreq.GetGratiousRrep ())
+          first |= COMPACT_RREQ_G;
+        if (m_rreq.GetDestinationOnly ())
+          first |= COMPACT_RREQ_D;
+        if (m_rreq.GetUnknownSeqno ())
+          first |= COMPACT_RREQ_U;
+        WriteHead (i, first, address);
+        i.WriteU8 (m_rreq.m_hopCount);
+        WriteVarint (i, m_rreq.m_requestID);
+        WriteAddress (i, m_rreq.m_dst, address);
+        WriteVarint (i, m_rreq.m_dstSeqNo);
+        WriteAddress (i, m_rreq.m_origin, address);
+        WriteVarint (i, EncodeDelta (m_rreq.m_originSeqNo, m_rreq.m_requestID));
+        WriteExtensions (i, m_rreq.m_extensions);
+        break;
+      }
+    case AODVTYPE_RREP:
+      {
+        if (!m_rrep.m_extensions.empty () || !m_rrep.m_linkQualities.empty ())
+          first |= COMPACT_EXTENSIONS;
+        if (m_rrep.GetAckRequired ())
+          first |= COMPACT_RREP_A;
+        if (IsHello ())
+          first |= COMPACT_RREP_H;
+        if (m_rrep.m_prefixSize != 0)
+          first |= COMPACT_RREP_P;
+        WriteHead (i, first, address);
+        i.WriteU8 (m_rrep.m_hopCount);
+        if (m_rrep.m_prefixSize != 0)
+          i.WriteU8 (m_rrep.m_prefixSize);
+        WriteAddress (i, m_rrep.m_dst, address);
+        WriteVarint (i, m_rrep.m_dstSeqNo);
+        if (!IsHello ())
+          WriteAddress (i, m_rrep.m_origin, address);
+        WriteVarint (i, m_rrep.m_lifeTime);
+        WriteExtensions (i, m_rrep.m_extensions, &m_rrep.m_linkQualities);
+        break;
+      }
+    case AODVTYPE_RERR:
+      {
+        if (m_rerr.GetNoDelete ())
+          first |= COMPACT_RERR_N;
+        WriteHead (i, first, address);
+        i.WriteU8 (m_rerr.GetDestCount ());
+        uint32_t previous = 0;
+        for (RerrHeader::Iterator j = m_rerr.Begin (); j != m_rerr.End (); ++j)
+          {
+            WriteAddress (i, j->first, address);
+            WriteVarint (i, EncodeDelta (j->second, previous));
+            previous = j->second;
+          }
+        break;
+      }
+    default:
+      WriteHead (i, first, address);
+    }
+}
+
+uint32_t
+CompactHeader::Deserialize (Buffer::Iterator start)
+{
+  Buffer::Iterator i = start;
+  m_valid = false;
+  if (i.GetRemainingSize () < 1)
+    return 0;
+  uint8_t first = i.ReadU8 ();
+  m_type = (MessageType) (((first >> 5) & 0x03) + 1);
+  if (!(first & COMPACT_MARKER))
+    return i.GetDistanceFrom (start);
+  uint32_t address = 4;
+  if (first & COMPACT_SHORT)
+    {
+      if (i.GetRemainingSize () < 1)
+        return i.GetDistanceFrom (start);
+      // Short addresses are the host part within the subnet of the sender
+      uint8_t prefix = i.ReadU8 ();
+      if (prefix != 16 && prefix != 24)
+        return i.GetDistanceFrom (start);
+      address = (32 - prefix) / 8;
+    }
+
+  m_valid = true;
+  switch (m_type)
+    {
+    case AODVTYPE_RREQ:
+      {
+        m_rreq = RreqHeader ();
+        m_rreq.SetGratiousRrep (first & COMPACT_RREQ_G);
+        m_rreq.SetDestinationOnly (first & COMPACT_RREQ_D);
+        m_rreq.SetUnknownSeqno (first & COMPACT_RREQ_U);
+        uint32_t originSeqNo = 0;
+        m_valid = (i.GetRemainingSize () >= 1);
+        if (m_valid)
+          m_rreq.m_hopCount = i.ReadU8 ();
+        m_valid = m_valid && ReadVarint (i, m_rreq.m_requestID) && ReadAddress (i, address, m_rreq.m_dst)
+          && ReadVarint (i, m_rreq.m_dstSeqNo) && ReadAddress (i, address, m_rreq.m_origin)
+          && ReadVarint (i, originSeqNo);
+        if (!m_valid)
+          break;
+        m_rreq.m_originSeqNo = DecodeDelta (originSeqNo, m_rreq.m_requestID);
+        if (first & COMPACT_EXTENSIONS)
+          {
+            m_rreq.m_flags |= (1 << 2);
+            ReadExtensions (i, m_rreq.m_extensions);
+          }
+        break;
+      }
+    case AODVTYPE_RREP:
+      {
+        m_rrep = RrepHeader ();
+        m_rrep.SetAckRequired (first & COMPACT_RREP_A);
+        m_valid = (i.GetRemainingSize () >= ((first & COMPACT_RREP_P) ? 2u : 1u));
+        if (!m_valid)
+          break;
+        m_rrep.m_hopCount = i.ReadU8 ();
+        if (first & COMPACT_RREP_P)
+          m_rrep.m_prefixSize = i.ReadU8 ();
+        m_valid = ReadAddress (i, address, m_rrep.m_dst) && ReadVarint (i, m_rrep.m_dstSeqNo);
+        if (m_valid && (first & COMPACT_RREP_H))
+          m_rrep.m_origin = m_rrep.m_dst;
+        else
+          m_valid = m_valid && ReadAddress (i, address, m_rrep.m_origin);
+        m_valid = m_valid && ReadVarint (i, m_rrep.m_lifeTime);
+        if (!m_valid)
+          break;
+        if (first & COMPACT_EXTENSIONS)
+          {
+            m_rrep.m_flags |= (1 << 5);
+            ReadExtensions (i, m_rrep.m_extensions, &m_rrep.m_linkQualities);
+          }
+        break;
+      }
+    case AODVTYPE_RERR:
+      {
+        m_rerr.Clear ();
+        m_rerr.SetNoDelete (first & COMPACT_RERR_N);
+        m_valid = (i.GetRemainingSize () >= 1);
+        if (!m_valid)
+          break;
+        uint8_t count = i.ReadU8 ();
+        uint32_t previous = 0;
+        for (uint8_t k = 0; k < count && m_valid; ++k)
+          {
+            Ipv4Address dst;
+            uint32_t seqNo = 0;
+            m_valid = ReadAddress (i, address, dst) && ReadVarint (i, seqNo);
+            if (m_valid)
+              {
+                seqNo = DecodeDelta (seqNo, previous);
+                m_rerr.AddUnDestination (dst, seqNo);
+                previous = seqNo;
+              }
+          }
+        break;
+      }
+    default:
+      break;
+    }
+  return i.GetDistanceFrom (start);
+}
+
+void
+CompactHeader::Print (std::ostream &os) const
+{
+  os << "compact " << TypeHeader (m_type) << " ";
+  switch (m_type)
+    {
+    case AODVTYPE_RREQ:
+      m_rreq.Print (os);
+      break;
+    case AODVTYPE_RREP:
+      m_rrep.Print (os);
+      break;
+    case AODVTYPE_RERR:
+      m_rerr.Print (os);
+      break;
+    default:
+      break;
+    }
+}
 
-      j++;
-      k++;
+bool
+CompactHeader::Compress (Ptr<Packet> packet)
+{
+  TypeHeader tHeader;
+  if (packet->GetSize () < tHeader.GetSerializedSize ())
+    return false;
+  packet->PeekHeader (tHeader);
+  if (!tHeader.IsValid () || tHeader.Get () == AODVTYPE_BUNDLE)
+    return false;
+  packet->RemoveHeader (tHeader);
+  m_type = tHeader.Get ();
+  m_valid = true;
+  switch (m_type)
+    {
+    case AODVTYPE_RREQ:
+      packet->RemoveHeader (m_rreq);
+      break;
+    case AODVTYPE_RREP:
+      packet->RemoveHeader (m_rrep);
+      break;
+    case AODVTYPE_RERR:
+      packet->RemoveHeader (m_rerr);
+      break;
+    case AODVTYPE_RREP_ACK:
+      {
+        RrepAckHeader ack;
+        packet->RemoveHeader (ack);
+        break;
+      }
+    default:
+      break;
     }
+  packet->AddHeader (*this);
   return true;
 }
 
+bool
+CompactHeader::Decompress (Ptr<Packet> packet)
+{
+  if (!IsCompact (packet))
+    return false;
+  packet->RemoveHeader (*this);
+  if (!m_valid)
+    return false;
+  switch (m_type)
+    {
+    case AODVTYPE_RREQ:
+      packet->AddHeader (RreqMessage (m_rreq));
+      break;
+    case AODVTYPE_RREP:
+      packet->AddHeader (RrepMessage (m_rrep));
+      break;
+    case AODVTYPE_RERR:
+      packet->AddHeader (RerrMessage (m_rerr));
+      break;
+    case AODVTYPE_RREP_ACK:
+      packet->AddHeader (RrepAckMessage ());
+      break;
+    default:
+      break;
+    }
+  return true;
+}
+
+bool
+CompactHeader::PeekType (Ptr<const Packet> packet, MessageType & type, bool & hello)
+{
+  uint8_t first;
+  if (packet->GetSize () < 1 || packet->CopyData (&first, 1) != 1 || !(first & COMPACT_MARKER))
+    return false;
+  type = (MessageType) (((first >> 5) & 0x03) + 1);
+  hello = (type == AODVTYPE_RREP && (first & COMPACT_RREP_H));
+  return true;
+}
+
+bool
+CompactHeader::IsCompact (Ptr<const Packet> packet)
+{
+  MessageType type;
+  bool hello;
+  return PeekType (packet, type, hello);
+}
+
 std::ostream &
-operator<< (std::ostream & os, RerrHeader const & h )
+operator<< (std::ostream & os, CompactHeader const & h)
+{
+  h.Print (os);
+  return os;
+}
+
+//-----------------------------------------------------------------------------
+// Bundle
+//-----------------------------------------------------------------------------
+
+BundleHeader::BundleHeader (uint16_t length) :
+  m_length (length)
+{
+}
+
+NS_OBJECT_ENSURE_REGISTERED (BundleHeader);
+
+TypeId
+BundleHeader::GetTypeId ()
+{
+  static TypeId tid = TypeId ("ns3::aodv_eo::BundleHeader")
+    .SetParent<Header> ()
+    .SetGroupName("Aodv_EO")
+    .AddConstructor<BundleHeader> ()
+  ;
+  return tid;
+}
+
+TypeId
+BundleHeader::GetInstanceTypeId () const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+BundleHeader::GetSerializedSize () const
+{
+  return 2;
+}
+
+void
+BundleHeader::Serialize (Buffer::Iterator i) const
+{
+  i.WriteHtonU16 (m_length);
+}
+
+uint32_t
+BundleHeader::Deserialize (Buffer::Iterator start)
+{
+  Buffer::Iterator i = start;
+  m_length = i.ReadNtohU16 ();
+  uint32_t dist = i.GetDistanceFrom (start);
+  NS_ASSERT (dist == GetSerializedSize ());
+  return dist;
+}
+
+void
+BundleHeader::Print (std::ostream &os) const
+{
+  os << "message length " << m_length;
+}
+
+bool
+BundleHeader::operator== (BundleHeader const & o) const
+{
+  return m_length == o.m_length;
+}
+
+std::ostream &
+operator<< (std::ostream & os, BundleHeader const & h)
 {
   h.Print (os);
   return os;
@@ -33,17 +33,45 @@
 #include "ns3/enum.h"
 #include "ns3/ipv4-address.h"
 #include <map>
+#include <vector>
 #include "ns3/nstime.h"
+#include "ns3/packet.h"
 
 namespace ns3 {
 namespace aodv_eo {
 
+class CompactHeader;
+
 enum MessageType
 {
   AODVTYPE_RREQ  = 1,   //!< AODVTYPE_RREQ
   AODVTYPE_RREP  = 2,   //!< AODVTYPE_RREP
   AODVTYPE_RERR  = 3,   //!< AODVTYPE_RERR
-  AODVTYPE_RREP_ACK = 4 //!< AODVTYPE_RREP_ACK
+  AODVTYPE_RREP_ACK = 4, //!< AODVTYPE_RREP_ACK
+  AODVTYPE_BUNDLE = 64  //!< Several messages in one packet, see BundleHeader
+};
+
+/**
+* \ingroup aodv_eo
+* \brief Types of RREQ and RREP extensions
+*
+* Extensions follow the message when its E flag is set. The E flag isn't part of RFC 3561, it is
+* a reserved bit of the flags octet (bit 2 of RREQ, bit 5 of RREP):
+  \verbatim
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  |     Count     |     Type      |    Length     |  Value ...
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  \endverbatim
+* Count is the number of Type-Length-Value triples that follow. Receivers ignore a triple
+* which doesn't fit in the message and the triples after it.
+*/
+enum ExtensionType
+{
+  AODVEXT_PATH_ENERGY = 64,     //!< Minimum residual energy of the nodes on the path, mJ
+  AODVEXT_PATH_METRIC = 65,     //!< Accumulated link metric of the path (ETX or ETT)
+  AODVEXT_LINK_QUALITY = 66,    //!< Hello only: list of neighbor address and hello delivery ratio pairs
+  AODVEXT_BANDWIDTH = 67,       //!< Rate requested by the flow the route is discovered for, kbps
+  AODVEXT_PATH_LIFETIME = 68    //!< Minimum predicted time to energy depletion of the nodes on the path, s
 };
 
 /**
@@ -83,7 +111,7 @@ std::ostream & operator<< (std::ostream & os, TypeHeader const & h);
   0                   1                   2                   3
   0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-  |     Type      |J|R|G|D|U|   Reserved          |   Hop Count   |
+  |     Type      |J|R|G|D|U|E|  Reserved         |   Hop Count   |
   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
   |                            RREQ ID                            |
   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
@@ -136,9 +164,17 @@ public:
   void SetUnknownSeqno (bool f);
   bool GetUnknownSeqno () const;
 
+  // Extensions
+  /// Add extension or replace value of existing extension of the same type
+  void SetExtension (uint8_t type, uint32_t value);
+  /// Get value of extension, return false if there is no such extension
+  bool GetExtension (uint8_t type, uint32_t & value) const;
+  void RemoveExtension (uint8_t type);
+
   bool operator== (RreqHeader const & o) const;
 private:
-  uint8_t        m_flags;          ///< |J|R|G|D|U| bit flags, see RFC
+  friend class CompactHeader;
+  uint8_t        m_flags;          ///< |J|R|G|D|U|E| bit flags, see RFC
   uint8_t        m_reserved;       ///< Not used
   uint8_t        m_hopCount;       ///< Hop Count
   uint32_t       m_requestID;      ///< RREQ ID
@@ -146,6 +182,7 @@ private:
   uint32_t       m_dstSeqNo;       ///< Destination Sequence Number
   Ipv4Address    m_origin;         ///< Originator IP Address
   uint32_t       m_originSeqNo;    ///< Source Sequence Number
+  std::map<uint8_t, uint32_t> m_extensions; ///< Extensions, map type -> value
 };
 
 std::ostream & operator<< (std::ostream & os, RreqHeader const &);
@@ -157,7 +194,7 @@ std::ostream & operator<< (std::ostream & os, RreqHeader const &);
   0                   1                   2                   3
   0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-  |     Type      |R|A|    Reserved     |Prefix Sz|   Hop Count   |
+  |     Type      |R|A|E|   Reserved    |Prefix Sz|   Hop Count   |
   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
   |                     Destination IP address                    |
   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
@@ -202,24 +239,44 @@ public:
   void SetPrefixSize (uint8_t sz);
   uint8_t GetPrefixSize () const;
 
+  // Extensions
+  /// Add extension or replace value of existing extension of the same type
+  void SetExtension (uint8_t type, uint32_t value);
+  /// Get value of extension, return false if there is no such extension
+  bool GetExtension (uint8_t type, uint32_t & value) const;
+  void RemoveExtension (uint8_t type);
+
+  /**
+   * Add delivery ratio of hellos received from neighbor, scaled to 0..255 (hello only)
+   * \return false if there is no room for another neighbor
+   */
+  bool AddLinkQuality (Ipv4Address neighbor, uint8_t ratio);
+  /// Get delivery ratio of hellos received from neighbor, return false if neighbor isn't listed
+  bool GetLinkQuality (Ipv4Address neighbor, uint8_t & ratio) const;
+  /// Maximum number of neighbors in link quality extension
+  static const uint32_t MAX_LINK_QUALITIES = 51;
+
   /// Configure RREP to be a Hello message
   void SetHello (Ipv4Address src, uint32_t srcSeqNo, Time lifetime);
 
   bool operator== (RrepHeader const & o) const;
 private:
-  uint8_t       m_flags;                  ///< A - acknowledgment required flag
+  friend class CompactHeader;
+  uint8_t       m_flags;                  ///< A - acknowledgment required flag, E - extensions flag
   uint8_t       m_prefixSize;         ///< Prefix Size
   uint8_t             m_hopCount;         ///< Hop Count
   Ipv4Address   m_dst;              ///< Destination IP Address
   uint32_t      m_dstSeqNo;         ///< Destination Sequence Number
   Ipv4Address     m_origin;           ///< Source IP Address
   uint32_t      m_lifeTime;         ///< Lifetime (in milliseconds)
+  std::map<uint8_t, uint32_t> m_extensions; ///< Extensions, map type -> value
+  std::map<Ipv4Address, uint8_t> m_linkQualities; ///< Link quality extension, map neighbor -> delivery ratio
 };
 
 std::ostream & operator<< (std::ostream & os, RrepHeader const &);
 
 /**
-* \ingroup aodv
+* \ingroup aodv_eo
 * \brief Route Reply Acknowledgment (RREP-ACK) Message Format
   \verbatim
   0                   1
@@ -287,29 +344,264 @@ public:
   void SetNoDelete (bool f);
   bool GetNoDelete () const;
 
+  /// Unreachable destination address and its sequence number
+  typedef std::pair<Ipv4Address, uint32_t> UnreachableDestination;
+  /// Iterator over unreachable destinations, in increasing address order
+  typedef UnreachableDestination const * Iterator;
+
   /**
    * Add unreachable node address and its sequence number in RERR header
    *\return false if we already added maximum possible number of unreachable destinations
    */
   bool AddUnDestination (Ipv4Address dst, uint32_t seqNo);
+  /**
+   * Add unreachable destinations of range [first, last) of address, sequence number pairs
+   * until the header holds the maximum number of destinations
+   * \return iterator to the first destination not added
+   */
+  template <typename InputIterator>
+  InputIterator AddUnDestinations (InputIterator first, InputIterator last);
   /** Delete pair (address + sequence number) from REER header, if the number of unreachable destinations > 0
    * \return true on success
    */
   bool RemoveUnDestination (std::pair<Ipv4Address, uint32_t> & un);
+  /// Return iterator to the first unreachable destination
+  Iterator Begin () const { return GetStorage () + m_first; }
+  /// Return iterator past the last unreachable destination
+  Iterator End () const { return GetStorage () + m_count; }
   /// Clear header
   void Clear ();
   /// Return number of unreachable destinations in RERR message
-  uint8_t GetDestCount () const { return (uint8_t)m_unreachableDstSeqNo.size (); }
+  uint8_t GetDestCount () const { return m_count - m_first; }
   bool operator== (RerrHeader const & o) const;
+
+  /// Maximum number of unreachable destinations in one RERR
+  static const uint32_t MAX_DESTINATIONS = 255;
+  /// Number of unreachable destinations held without heap allocation
+  static const uint32_t INLINE_DESTINATIONS = 8;
 private:
   uint8_t m_flag;            ///< No delete flag
   uint8_t m_reserved;        ///< Not used
 
-  /// List of Unreachable destination: IP addresses and sequence numbers
-  std::map<Ipv4Address, uint32_t> m_unreachableDstSeqNo;
+  /**
+   * List of Unreachable destination: IP addresses and sequence numbers, sorted by address.
+   * Held in m_inline up to INLINE_DESTINATIONS, in m_overflow beyond.
+   */
+  UnreachableDestination m_inline[INLINE_DESTINATIONS];
+  std::vector<UnreachableDestination> m_overflow;
+  uint8_t m_first;           ///< Index of the first destination, the ones before it were removed
+  uint8_t m_count;           ///< Index past the last destination
+
+  /// Return storage of destinations
+  UnreachableDestination const * GetStorage () const { return m_overflow.empty () ? m_inline : &m_overflow[0]; }
 };
 
+template <typename InputIterator>
+InputIterator
+RerrHeader::AddUnDestinations (InputIterator first, InputIterator last)
+{
+  for (; first != last && GetDestCount () < MAX_DESTINATIONS; ++first)
+    {
+      AddUnDestination (first->first, first->second);
+    }
+  return first;
+}
+
 std::ostream & operator<< (std::ostream & os, RerrHeader const &);
+
+/**
+* \ingroup aodv_eo
+* \brief Type header and message header of type T in one header
+*
+* Same wire format as TypeHeader followed by T, but added to or removed from a packet with one
+* Packet::AddHeader or RemoveHeader, i.e. one buffer reservation, one serialization pass and one
+* metadata item instead of two. TypeHeader and the message headers remain usable on their own.
+*/
+template <MessageType Type, typename T>
+class MessageHeader : public Header
+{
+public:
+  /// c-tor
+  MessageHeader (T const & message = T ()) : m_message (message), m_valid (true) {}
+
+  // Header serialization/deserialization
+  static TypeId GetTypeId ();
+  TypeId GetInstanceTypeId () const { return GetTypeId (); }
+  uint32_t GetSerializedSize () const { return 1 + m_message.GetSerializedSize (); }
+  void Serialize (Buffer::Iterator start) const
+  {
+    start.WriteU8 ((uint8_t) Type);
+    m_message.Serialize (start);
+  }
+  uint32_t Deserialize (Buffer::Iterator start)
+  {
+    m_valid = (start.ReadU8 () == Type) && start.GetRemainingSize () >= T ().GetSerializedSize ();
+    if (!m_valid)
+      return 1;
+    return 1 + m_message.Deserialize (start);
+  }
+  void Print (std::ostream &os) const
+  {
+    os << TypeHeader (Type) << " ";
+    m_message.Print (os);
+  }
+
+  /// Return message header
+  T & GetMessage () { return m_message; }
+  T const & GetMessage () const { return m_message; }
+  /// Check that the type octet matched and the message isn't truncated, the message isn't read otherwise
+  bool IsValid () const { return m_valid; }
+private:
+  T m_message;
+  bool m_valid;
+};
+
+/// RREQ with its type header
+typedef MessageHeader<AODVTYPE_RREQ, RreqHeader> RreqMessage;
+/// RREP with its type header
+typedef MessageHeader<AODVTYPE_RREP, RrepHeader> RrepMessage;
+/// RERR with its type header
+typedef MessageHeader<AODVTYPE_RERR, RerrHeader> RerrMessage;
+/// RREP-ACK with its type header
+typedef MessageHeader<AODVTYPE_RREP_ACK, RrepAckHeader> RrepAckMessage;
+
+template <> TypeId RreqMessage::GetTypeId ();
+template <> TypeId RrepMessage::GetTypeId ();
+template <> TypeId RerrMessage::GetTypeId ();
+template <> TypeId RrepAckMessage::GetTypeId ();
+
+/**
+* \ingroup aodv_eo
+* \brief Compact encoding of control messages
+*
+* Replaces the type header and the message header of the RFC 3561 format. The type is merged
+* into the first octet, whose high bit is never set in the RFC format:
+  \verbatim
+  0 1 2 3 4 5 6 7
+  +-+-+-+-+-+-+-+-+
+  |1|Type |S|E|Flg|
+  +-+-+-+-+-+-+-+-+
+  \endverbatim
+* Type is the message type minus one. S is set when all addresses of the message are short,
+* i.e. the host part of the address within the /24 or /16 subnet of the sender (1 or 2 octets);
+* an octet with the prefix length of that subnet then follows the first one, and the receiver
+* takes the network part from its own address. E is the extensions flag, extensions follow the message in the RFC format. Sequence
+* numbers, the RREQ ID and the lifetime are variable length integers of 7 bits per octet, and
+* where possible delta encoded as signed integers: the originator sequence number against the
+* RREQ ID, and every RERR destination sequence number against the preceding one.
+*
+* RREQ:     flags G, D, U, hop count, RREQ ID, destination, destination sequence number,
+*           originator, originator sequence number
+* RREP:     flags A, H (hello, originator omitted), P (prefix size follows), hop count,
+*           [prefix size], destination, destination sequence number, [originator], lifetime (ms)
+* RERR:     flag N, destination count, destination and sequence number pairs
+* RREP-ACK: the first octet only
+*
+* Unused flags (J, R) and reserved fields aren't carried.
+*/
+class CompactHeader : public Header
+{
+public:
+  /**
+   * c-tor
+   * \param local address of the interface the message is sent or received on
+   * \param mask mask of the interface, short addresses are sent with /24 and /16 masks only
+   */
+  CompactHeader (Ipv4Address local = Ipv4Address (), Ipv4Mask mask = Ipv4Mask::GetZero ());
+
+  // Header serialization/deserialization
+  static TypeId GetTypeId ();
+  TypeId GetInstanceTypeId () const;
+  uint32_t GetSerializedSize () const;
+  void Serialize (Buffer::Iterator start) const;
+  uint32_t Deserialize (Buffer::Iterator start);
+  void Print (std::ostream &os) const;
+
+  /// Return type
+  MessageType GetType () const { return m_type; }
+  /// Check that the message could be decoded
+  bool IsValid () const { return m_valid; }
+
+  /**
+   * Replace type and message header of packet in the RFC format by the compact header
+   * \return false if packet doesn't start with a valid type header, it is left unchanged then
+   */
+  bool Compress (Ptr<Packet> packet);
+  /**
+   * Replace compact header of packet by type and message header in the RFC format
+   * \return false if the message can't be decoded
+   */
+  bool Decompress (Ptr<Packet> packet);
+  /**
+   * Check that packet starts with a compact header and peek type of its message
+   * \param hello set if the message is a hello
+   */
+  static bool PeekType (Ptr<const Packet> packet, MessageType & type, bool & hello);
+  /// Check that packet starts with a compact header
+  static bool IsCompact (Ptr<const Packet> packet);
+
+private:
+  MessageType m_type;
+  Ipv4Address m_local;            ///< Interface address, base of short addresses
+  Ipv4Mask m_mask;                ///< Interface mask
+  bool m_valid;
+  RreqHeader m_rreq;
+  RrepHeader m_rrep;
+  RerrHeader m_rerr;
+
+  /// Return octets per address: 1 or 2 if all addresses are short, else 4
+  uint32_t GetAddressSize () const;
+  /// Return octets per short address of the interface subnet, 0 if not /24 or /16
+  uint32_t GetShortAddressSize () const;
+  bool IsHello () const;
+  /// Write first octet and, with short addresses, prefix length of the interface subnet
+  void WriteHead (Buffer::Iterator & i, uint8_t first, uint32_t address) const;
+  void WriteAddress (Buffer::Iterator & i, Ipv4Address address, uint32_t size) const;
+  /// Read address of size octets, \return false if the buffer ends before it
+  bool ReadAddress (Buffer::Iterator & i, uint32_t size, Ipv4Address & address) const;
+};
+
+std::ostream & operator<< (std::ostream & os, CompactHeader const &);
+
+/**
+* \ingroup aodv_eo
+* \brief Length of a message in a bundle
+*
+* A bundle carries several control messages of one sender in one packet, in the spirit of
+* RFC 5444. It starts with a type header of type AODVTYPE_BUNDLE, followed by the messages,
+* each with its type header, in either encoding, and preceded by its length:
+  \verbatim
+  0                   1                   2                   3
+  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  |  Type = 64    |            Length             |  Message ...
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  |            Length             |  Message ...
+  +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+  \endverbatim
+*/
+class BundleHeader : public Header
+{
+public:
+  /// c-tor
+  BundleHeader (uint16_t length = 0);
+
+  // Header serialization/deserialization
+  static TypeId GetTypeId ();
+  TypeId GetInstanceTypeId () const;
+  uint32_t GetSerializedSize () const;
+  void Serialize (Buffer::Iterator start) const;
+  uint32_t Deserialize (Buffer::Iterator start);
+  void Print (std::ostream &os) const;
+
+  /// Return length of the message that follows
+  uint16_t GetLength () const { return m_length; }
+  bool operator== (BundleHeader const & o) const;
+private:
+  uint16_t m_length;
+};
+
+std::ostream & operator<< (std::ostream & os, BundleHeader const &);
 }
 }
 #endif /* AODV_EO_PACKET_H */
@@ -0,0 +1,101 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "aodv_eo-reservation.h"
+#include "ns3/simulator.h"
+#include <algorithm>
+
+namespace ns3
+{
+namespace aodv_eo
+{
+
+void
+ReservationTable::Reserve (Ipv4Address origin, Ipv4Address dst, uint64_t rate, Time lifetime)
+{
+  Purge ();
+  std::pair<std::map<std::pair<Ipv4Address, Ipv4Address>, Reservation>::iterator, bool> i =
+    m_reservations.insert (std::make_pair (std::make_pair (origin, dst), Reservation ()));
+  if (i.second)
+    {
+      i.first->second.m_made = Simulator::Now ();
+    }
+  i.first->second.m_rate = rate;
+  i.first->second.m_expire = Simulator::Now () + lifetime;
+}
+
+bool
+ReservationTable::Refresh (Ipv4Address origin, Ipv4Address dst, Time lifetime)
+{
+  Purge ();
+  std::map<std::pair<Ipv4Address, Ipv4Address>, Reservation>::iterator i =
+    m_reservations.find (std::make_pair (origin, dst));
+  if (i == m_reservations.end ())
+    return false;
+  i->second.m_expire = std::max (i->second.m_expire, Simulator::Now () + lifetime);
+  return true;
+}
+
+uint64_t
+ReservationTable::GetReservation (Ipv4Address origin, Ipv4Address dst, Time since)
+{
+  Purge ();
+  std::map<std::pair<Ipv4Address, Ipv4Address>, Reservation>::const_iterator i =
+    m_reservations.find (std::make_pair (origin, dst));
+  return (i == m_reservations.end () || i->second.m_made < since) ? 0 : i->second.m_rate;
+}
+
+uint64_t
+ReservationTable::GetReserved (Time since)
+{
+  Purge ();
+  uint64_t reserved = 0;
+  for (std::map<std::pair<Ipv4Address, Ipv4Address>, Reservation>::const_iterator i =
+         m_reservations.begin (); i != m_reservations.end (); ++i)
+    {
+      if (i->second.m_made >= since)
+        reserved += i->second.m_rate;
+    }
+  return reserved;
+}
+
+uint32_t
+ReservationTable::GetSize ()
+{
+  Purge ();
+  return m_reservations.size ();
+}
+
+void
+ReservationTable::Purge ()
+{
+  Time now = Simulator::Now ();
+  for (std::map<std::pair<Ipv4Address, Ipv4Address>, Reservation>::iterator i =
+         m_reservations.begin (); i != m_reservations.end (); )
+    {
+      if (i->second.m_expire < now)
+        {
+          m_reservations.erase (i++);
+        }
+      else
+        {
+          ++i;
+        }
+    }
+}
+
+}
+}
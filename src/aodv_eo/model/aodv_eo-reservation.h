@@ -0,0 +1,75 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef AODV_EO_RESERVATION_H
+#define AODV_EO_RESERVATION_H
+
+#include "ns3/ipv4-address.h"
+#include "ns3/nstime.h"
+#include <map>
+#include <utility>
+
+namespace ns3
+{
+namespace aodv_eo
+{
+/**
+ * \ingroup aodv_eo
+ *
+ * \brief Soft bandwidth reservations of the flows relayed by a node.
+ *
+ * A reservation is identified by the (origin, destination) pair of its flow and
+ * expires unless it is refreshed, like a route, by the data packets of the flow.
+ */
+class ReservationTable
+{
+public:
+  /// c-tor
+  ReservationTable () {}
+  /**
+   * Reserve rate (bps) for flow origin -> dst for lifetime, replacing the rate of the previous reservation
+   * of the flow. A replaced reservation keeps the time it was first made.
+   */
+  void Reserve (Ipv4Address origin, Ipv4Address dst, uint64_t rate, Time lifetime);
+  /// Extend reservation of flow origin -> dst to at least lifetime from now, return false if there is none
+  bool Refresh (Ipv4Address origin, Ipv4Address dst, Time lifetime);
+  /// Return rate reserved for flow origin -> dst, 0 if none or if it was made before since
+  uint64_t GetReservation (Ipv4Address origin, Ipv4Address dst, Time since = Time ());
+  /// Return total rate (bps) of the reservations made at or after since
+  uint64_t GetReserved (Time since = Time ());
+  /// Return number of reservations
+  uint32_t GetSize ();
+  /// Remove all reservations
+  void Clear () { m_reservations.clear (); }
+
+private:
+  /// Remove expired reservations
+  void Purge ();
+
+  /// Reservation of a flow
+  struct Reservation
+  {
+    uint64_t m_rate;   ///< Reserved rate, bps
+    Time m_expire;     ///< Expiration time
+    Time m_made;       ///< Time the flow was first admitted
+  };
+  /// Reservations: (origin, destination) -> reservation
+  std::map<std::pair<Ipv4Address, Ipv4Address>, Reservation> m_reservations;
+};
+
+}
+}
+#endif /* AODV_EO_RESERVATION_H */
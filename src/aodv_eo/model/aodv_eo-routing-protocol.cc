@@ -29,6 +29,7 @@
   if (m_ipv4) { std::clog << "[node " << m_ipv4->GetObject<Node> ()->GetId () << "] "; } 
 
 #include "aodv_eo-routing-protocol.h"
+#include "aodv_eo-tx-power-wifi-manager.h"
 #include "ns3/log.h"
 #include "ns3/boolean.h"
 #include "ns3/random-variable-stream.h"
@@ -37,12 +38,18 @@
 #include "ns3/udp-socket-factory.h"
 #include "ns3/udp-l4-protocol.h"
 #include "ns3/udp-header.h"
+#include "ns3/ipv4-header.h"
 #include "ns3/wifi-net-device.h"
 #include "ns3/adhoc-wifi-mac.h"
+#include "ns3/wifi-mac-queue.h"
 #include "ns3/string.h"
 #include "ns3/pointer.h"
+#include "ns3/double.h"
+#include "ns3/enum.h"
+#include "ns3/energy-source-container.h"
 #include <algorithm>
 #include <limits>
+#include <cmath>
 
 namespace ns3
 {
@@ -117,6 +124,73 @@ private:
 
 NS_OBJECT_ENSURE_REGISTERED (DeferredRouteOutputTag);
 
+//-----------------------------------------------------------------------------
+/**
+ * \ingroup aodv_eo
+ * Device energy model without consumption, used to receive the depletion and recharge
+ * notifications of an energy source.
+ */
+class DepletionNotifier : public DeviceEnergyModel
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId ()
+  {
+    static TypeId tid = TypeId ("ns3::aodv_eo::DepletionNotifier")
+      .SetParent<DeviceEnergyModel> ()
+      .SetGroupName ("Aodv_EO")
+      .AddConstructor<DepletionNotifier> ()
+    ;
+    return tid;
+  }
+  /**
+   * Set callbacks
+   * \param depleted called when the energy source is depleted
+   * \param recharged called when the energy source is recharged
+   */
+  void SetCallbacks (Callback<void> depleted, Callback<void> recharged)
+  {
+    m_depleted = depleted;
+    m_recharged = recharged;
+  }
+  virtual void SetEnergySource (Ptr<EnergySource> source) {}
+  virtual double GetTotalEnergyConsumption (void) const { return 0; }
+  virtual void ChangeState (int newState) {}
+  virtual void HandleEnergyDepletion (void)
+  {
+    if (!m_depleted.IsNull ())
+      {
+        m_depleted ();
+      }
+  }
+  virtual void HandleEnergyRecharged (void)
+  {
+    if (!m_recharged.IsNull ())
+      {
+        m_recharged ();
+      }
+  }
+  virtual void HandleEnergyChanged (void) {}
+
+private:
+  virtual void DoDispose ()
+  {
+    m_depleted = MakeNullCallback<void> ();
+    m_recharged = MakeNullCallback<void> ();
+    DeviceEnergyModel::DoDispose ();
+  }
+
+  /// Depletion callback
+  Callback<void> m_depleted;
+  /// Recharge callback
+  Callback<void> m_recharged;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (DepletionNotifier);
+
 
 //-----------------------------------------------------------------------------
 RoutingProtocol::RoutingProtocol () :
@@ -143,21 +217,74 @@ RoutingProtocol::RoutingProtocol () :
   m_destinationOnly (false),
   m_gratuitousReply (true),
   m_enableHello (false),
+  m_rerrAggregationWindow (Seconds (0)),
+  m_enableLocalRepair (false),
+  m_maxRepairTtl (10),
+  m_localAddTtl (2),
+  m_enableMultipath (false),
+  m_maxPaths (3),
+  m_energyBalancing (false),
+  m_enablePreemptive (false),
+  m_preemptiveThreshold (-90),
+  m_preemptiveHysteresis (3),
+  m_linkMetric (HOP_COUNT_METRIC),
+  m_linkQualityWindow (10),
+  m_ettPacketSize (1024),
+  m_congestionAware (false),
+  m_loadSampleInterval (MilliSeconds (500)),
+  m_congestionMaxFlows (4),
+  m_congestionWeight (1),
+  m_congestionMaxDelay (MilliSeconds (40)),
+  m_congestionDropThreshold (0.8),
+  m_admissionControl (false),
+  m_channelCapacity (DataRate ("2Mbps")),
+  m_defaultFlowRate (DataRate ("0bps")),
+  m_txPowerControl (false),
+  m_txPowerMargin (10),
+  m_rxSensitivity (-96),
+  m_replyCollectionWindow (Seconds (0)),
+  m_withdrawalThreshold (0),
+  m_rejoinMargin (0.05),
+  m_shutdownOnDepletion (false),
+  m_depletionRerr (false),
+  m_harvestingAware (false),
+  m_energyRateWindow (Seconds (30)),
+  m_helloEnergy (false),
+  m_dutyCycle (false),
+  m_wakeInterval (Seconds (1)),
+  m_listenWindow (MilliSeconds (100)),
+  m_accountEnergy (false),
+  m_compactEncoding (false),
+  m_messageBundling (false),
+  m_bundleWindow (MilliSeconds (10)),
   m_routingTable (m_deletePeriod),
   m_queue (m_maxQueueLen, m_maxQueueTime),
+  m_repairQueue (m_maxQueueLen, m_maxQueueTime),
   m_requestId (0),
   m_seqNo (0),
   m_rreqIdCache (m_pathDiscoveryTime),
+  m_rreqReforwardCache (m_pathDiscoveryTime),
   m_dpd (m_pathDiscoveryTime),
   m_nb (m_helloInterval),
-  m_rreqCount (0),
-  m_rerrCount (0),
+  m_rreqBucket (m_rreqRateLimit, m_rreqRateLimit),
+  m_rerrBucket (m_rerrRateLimit, m_rerrRateLimit),
+  m_loadTimer (Timer::CANCEL_ON_DESTROY),
+  m_withdrawn (false),
+  m_depleted (false),
+  m_asleep (false),
+  m_awakeUntil (Seconds (0)),
+  m_helloPending (false),
+  m_dutyCycleTimer (Timer::CANCEL_ON_DESTROY),
   m_htimer (Timer::CANCEL_ON_DESTROY),
   m_rreqRateLimitTimer (Timer::CANCEL_ON_DESTROY),
   m_rerrRateLimitTimer (Timer::CANCEL_ON_DESTROY),
-  m_lastBcastTime (Seconds (0))
+  m_rerrAggregationTimer (Timer::CANCEL_ON_DESTROY),
+  m_coalescedTimers (false),
+  m_lastBcastTime (Seconds (0)),
+  m_nextBundleId (0)
 {
   m_nb.SetCallback (MakeCallback (&RoutingProtocol::SendRerrWhenBreaksLinkToNextHop, this));
+  m_deadlines.SetCallback (MakeCallback (&RoutingProtocol::DeadlineExpire, this));
 }
 
 TypeId
@@ -169,7 +296,8 @@ RoutingProtocol::GetTypeId (void)
     .AddConstructor<RoutingProtocol> ()
     .AddAttribute ("HelloInterval", "HELLO messages emission interval.",
                    TimeValue (Seconds (1)),
-                   MakeTimeAccessor (&RoutingProtocol::m_helloInterval),
+                   MakeTimeAccessor (&RoutingProtocol::SetHelloInterval,
+                                     &RoutingProtocol::GetHelloInterval),
                    MakeTimeChecker ())
     .AddAttribute ("TtlStart", "Initial TTL value for RREQ.",
                    UintegerValue (1),
@@ -193,11 +321,13 @@ RoutingProtocol::GetTypeId (void)
                    MakeUintegerChecker<uint32_t> ())
     .AddAttribute ("RreqRateLimit", "Maximum number of RREQ per second.",
                    UintegerValue (10),
-                   MakeUintegerAccessor (&RoutingProtocol::m_rreqRateLimit),
+                   MakeUintegerAccessor (&RoutingProtocol::SetRreqRateLimit,
+                                         &RoutingProtocol::GetRreqRateLimit),
                    MakeUintegerChecker<uint32_t> ())
     .AddAttribute ("RerrRateLimit", "Maximum number of RERR per second.",
                    UintegerValue (10),
-                   MakeUintegerAccessor (&RoutingProtocol::m_rerrRateLimit),
+                   MakeUintegerAccessor (&RoutingProtocol::SetRerrRateLimit,
+                                         &RoutingProtocol::GetRerrRateLimit),
                    MakeUintegerChecker<uint32_t> ())
     .AddAttribute ("NodeTraversalTime", "Conservative estimate of the average one hop traversal time for packets and should include "
                    "queuing delays, interrupt processing times and transfer times.",
@@ -250,7 +380,8 @@ RoutingProtocol::GetTypeId (void)
                    MakeTimeChecker ())
     .AddAttribute ("AllowedHelloLoss", "Number of hello messages which may be loss for valid link.",
                    UintegerValue (2),
-                   MakeUintegerAccessor (&RoutingProtocol::m_allowedHelloLoss),
+                   MakeUintegerAccessor (&RoutingProtocol::SetAllowedHelloLoss,
+                                         &RoutingProtocol::GetAllowedHelloLoss),
                    MakeUintegerChecker<uint16_t> ())
     .AddAttribute ("GratuitousReply", "Indicates whether a gratuitous RREP should be unicast to the node originated route discovery.",
                    BooleanValue (true),
@@ -272,11 +403,207 @@ RoutingProtocol::GetTypeId (void)
                    MakeBooleanAccessor (&RoutingProtocol::SetBroadcastEnable,
                                         &RoutingProtocol::GetBroadcastEnable),
                    MakeBooleanChecker ())
+    .AddAttribute ("RerrAggregationWindow", "Time during which unreachable destinations reported by link breaks and received RERRs "
+                   "are merged into as few RERR messages as possible per interface. Zero disables aggregation.",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&RoutingProtocol::m_rerrAggregationWindow),
+                   MakeTimeChecker ())
+    .AddAttribute ("EnableLocalRepair", "Indicates whether an intermediate node repairs a broken link locally "
+                   "instead of reporting it to the source (RFC 3561 section 6.12).",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_enableLocalRepair),
+                   MakeBooleanChecker ())
+    .AddAttribute ("MaxRepairTtl", "Maximum number of hops to a destination for which local repair is attempted = 0.3 * NetDiameter",
+                   UintegerValue (10),
+                   MakeUintegerAccessor (&RoutingProtocol::m_maxRepairTtl),
+                   MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("LocalAddTtl", "Value added to the last known hop count to the destination to get local repair RREQ TTL.",
+                   UintegerValue (2),
+                   MakeUintegerAccessor (&RoutingProtocol::m_localAddTtl),
+                   MakeUintegerChecker<uint16_t> ())
+    .AddAttribute ("EnableMultipath", "Indicates whether alternate loop-free paths learned from duplicate RREQs and RREPs "
+                   "are kept and used when the primary next hop breaks.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_enableMultipath),
+                   MakeBooleanChecker ())
+    .AddAttribute ("MaxPaths", "Maximum number of paths per destination in multipath mode, including the primary one.",
+                   UintegerValue (3),
+                   MakeUintegerAccessor (&RoutingProtocol::m_maxPaths),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("EnergyBalancing", "Indicates whether path residual energy is advertised in RREQ/RREP and traffic is "
+                   "split across multiple paths in proportion to it. Requires EnableMultipath.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_energyBalancing),
+                   MakeBooleanChecker ())
+    .AddAttribute ("EnablePreemptiveMaintenance", "Indicates whether received signal strength of neighbors is monitored "
+                   "(WifiPhy MonitorSnifferRx) and routes over fading links are rediscovered before they break.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_enablePreemptive),
+                   MakeBooleanChecker ())
+    .AddAttribute ("PreemptiveThreshold", "Smoothed signal strength (dBm) of a neighbor below which the link is about to break.",
+                   DoubleValue (-90),
+                   MakeDoubleAccessor (&RoutingProtocol::m_preemptiveThreshold),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("PreemptiveHysteresis", "Signal recovery (dB) above PreemptiveThreshold needed before a weak link "
+                   "can be reported again.",
+                   DoubleValue (3),
+                   MakeDoubleAccessor (&RoutingProtocol::m_preemptiveHysteresis),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("LinkMetric", "Metric used to select routes. ETX and ETT are measured from hello delivery ratios "
+                   "and need hellos enabled; ETT also needs the PHY rate of unicast frames from the neighbor.",
+                   EnumValue (HOP_COUNT_METRIC),
+                   MakeEnumAccessor (&RoutingProtocol::m_linkMetric),
+                   MakeEnumChecker (HOP_COUNT_METRIC, "HopCount",
+                                    ETX_METRIC, "Etx",
+                                    ETT_METRIC, "Ett"))
+    .AddAttribute ("LinkQualityWindow", "Number of hello intervals over which hello delivery ratios are measured.",
+                   UintegerValue (10),
+                   MakeUintegerAccessor (&RoutingProtocol::m_linkQualityWindow),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("EttPacketSize", "Packet size (bytes) used to compute ETT.",
+                   UintegerValue (1024),
+                   MakeUintegerAccessor (&RoutingProtocol::m_ettPacketSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("CongestionAware", "Indicates whether node load (MAC queue occupancy, channel busy time and relayed flows) "
+                   "is added to the route cost carried by RREQ/RREP and loaded nodes delay or drop RREQs.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_congestionAware),
+                   MakeBooleanChecker ())
+    .AddAttribute ("LoadSampleInterval", "Period of node load sampling.",
+                   TimeValue (MilliSeconds (500)),
+                   MakeTimeAccessor (&RoutingProtocol::m_loadSampleInterval),
+                   MakeTimeChecker ())
+    .AddAttribute ("CongestionMaxFlows", "Number of relayed flows which counts as full load.",
+                   UintegerValue (4),
+                   MakeUintegerAccessor (&RoutingProtocol::m_congestionMaxFlows),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("CongestionWeight", "Fraction of a link cost added to the route cost per unit of load of the node "
+                   "forwarding over it.",
+                   DoubleValue (1),
+                   MakeDoubleAccessor (&RoutingProtocol::m_congestionWeight),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("CongestionMaxDelay", "Delay of RREQ rebroadcast at full load, proportionally less at lower load.",
+                   TimeValue (MilliSeconds (40)),
+                   MakeTimeAccessor (&RoutingProtocol::m_congestionMaxDelay),
+                   MakeTimeChecker ())
+    .AddAttribute ("CongestionDropThreshold", "Load above which a node doesn't rebroadcast RREQs.",
+                   DoubleValue (0.8),
+                   MakeDoubleAccessor (&RoutingProtocol::m_congestionDropThreshold),
+                   MakeDoubleChecker<double> (0, 1))
+    .AddAttribute ("EnableAdmissionControl", "Indicates whether RREQs carry the rate requested by the flow and relays "
+                   "forward them only if their available bandwidth can carry it.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_admissionControl),
+                   MakeBooleanChecker ())
+    .AddAttribute ("ChannelCapacity", "Rate a relay can carry when the channel is idle, used to estimate available bandwidth.",
+                   DataRateValue (DataRate ("2Mbps")),
+                   MakeDataRateAccessor (&RoutingProtocol::m_channelCapacity),
+                   MakeDataRateChecker ())
+    .AddAttribute ("DefaultFlowRate", "Rate requested in route discovery for destinations without a rate hint (SetFlowRate). "
+                   "Zero requests no rate.",
+                   DataRateValue (DataRate ("0bps")),
+                   MakeDataRateAccessor (&RoutingProtocol::m_defaultFlowRate),
+                   MakeDataRateChecker ())
+    .AddAttribute ("EnableTxPowerControl", "Indicates whether unicast frames are sent at the lowest TX power reaching "
+                   "the next hop, learned from the frames it sends. Needs ns3::aodv_eo::TxPowerWifiManager.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_txPowerControl),
+                   MakeBooleanChecker ())
+    .AddAttribute ("TxPowerMargin", "Margin (dB) added to the lowest TX power reaching the next hop.",
+                   DoubleValue (10),
+                   MakeDoubleAccessor (&RoutingProtocol::m_txPowerMargin),
+                   MakeDoubleChecker<double> (0))
+    .AddAttribute ("RxSensitivity", "Weakest signal (dBm) neighbors receive, the lowest TX power reaching the next hop "
+                   "gives it this signal plus TxPowerMargin.",
+                   DoubleValue (-96),
+                   MakeDoubleAccessor (&RoutingProtocol::m_rxSensitivity),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("ReplyCollectionWindow", "Time after the first RREP of a route discovery during which the source "
+                   "switches to RREPs offering a route with more residual energy or a lower cost, and the destination "
+                   "answers copies of the RREQ over such routes. Nodes advertise path energy. Zero disables it.",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&RoutingProtocol::m_replyCollectionWindow),
+                   MakeTimeChecker ())
+    .AddAttribute ("RelayWithdrawalThreshold", "Fraction of its initial energy below which a node stops replying to "
+                   "RREQs from its routing table and rebroadcasting RREQs, and sends RERR for the routes it relays. "
+                   "Zero disables withdrawal.",
+                   DoubleValue (0),
+                   MakeDoubleAccessor (&RoutingProtocol::m_withdrawalThreshold),
+                   MakeDoubleChecker<double> (0, 1))
+    .AddAttribute ("RelayRejoinMargin", "Fraction of its initial energy above RelayWithdrawalThreshold a withdrawn node "
+                   "needs to relay again, so that small energy gains don't toggle relaying.",
+                   DoubleValue (0.05),
+                   MakeDoubleAccessor (&RoutingProtocol::m_rejoinMargin),
+                   MakeDoubleChecker<double> (0, 1))
+    .AddAttribute ("ShutdownOnDepletion", "Indicates whether routing shuts down (buffered packets dropped, timers "
+                   "cancelled) when an energy source of the node reports depletion.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_shutdownOnDepletion),
+                   MakeBooleanChecker ())
+    .AddAttribute ("DepletionRerr", "Indicates whether a last RERR for the routes the node relays is sent on shutdown.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_depletionRerr),
+                   MakeBooleanChecker ())
+    .AddAttribute ("HarvestingAware", "Indicates whether the path energy advertised in RREQ and RREP and used in route "
+                   "selection is the predicted time to depletion, from residual energy and recent harvesting and "
+                   "drain rates, instead of the residual energy.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_harvestingAware),
+                   MakeBooleanChecker ())
+    .AddAttribute ("EnergyRateWindow", "Time constant of the moving averages of the harvesting and drain rates.",
+                   TimeValue (Seconds (30)),
+                   MakeTimeAccessor (&RoutingProtocol::m_energyRateWindow),
+                   MakeTimeChecker ())
+    .AddAttribute ("HelloEnergy", "Indicates whether hellos carry the energy of the node, so that neighbors "
+                   "know it without route discovery.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_helloEnergy),
+                   MakeBooleanChecker ())
+    .AddAttribute ("DutyCycle", "Indicates whether a node which is on no active route and has no buffered packets "
+                   "puts its radios to sleep outside of synchronized listen windows.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_dutyCycle),
+                   MakeBooleanChecker ())
+    .AddAttribute ("WakeInterval", "Interval between the starts of listen windows, counted from simulation start.",
+                   TimeValue (Seconds (1)),
+                   MakeTimeAccessor (&RoutingProtocol::m_wakeInterval),
+                   MakeTimeChecker ())
+    .AddAttribute ("ListenWindow", "Duration of listen windows.",
+                   TimeValue (MilliSeconds (100)),
+                   MakeTimeAccessor (&RoutingProtocol::m_listenWindow),
+                   MakeTimeChecker ())
+    .AddAttribute ("EnergyAccounting", "Indicates whether the radio energy of the frames sent and received is "
+                   "accounted per AODV_EO message type and per data flow.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_accountEnergy),
+                   MakeBooleanChecker ())
+    .AddAttribute ("CompactEncoding", "Indicates whether control messages are sent in the compact encoding "
+                   "instead of the RFC 3561 format. Both encodings are always accepted.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_compactEncoding),
+                   MakeBooleanChecker ())
+    .AddAttribute ("MessageBundling", "Indicates whether jittered control messages to the same destination "
+                   "on the same interface are sent in one packet.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_messageBundling),
+                   MakeBooleanChecker ())
+    .AddAttribute ("BundleWindow", "Maximum time a message is sent before or after its own jitter to join a pending bundle.",
+                   TimeValue (MilliSeconds (10)),
+                   MakeTimeAccessor (&RoutingProtocol::m_bundleWindow),
+                   MakeTimeChecker ())
+    .AddAttribute ("CoalescedTimers", "Indicates whether hello, neighbor purge, RREQ retry, rate limit and RREP_ACK "
+                   "timers share a single per-node event armed for the earliest deadline.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&RoutingProtocol::m_coalescedTimers),
+                   MakeBooleanChecker ())
     .AddAttribute ("UniformRv",
                    "Access to the underlying UniformRandomVariable",
                    StringValue ("ns3::UniformRandomVariable"),
                    MakePointerAccessor (&RoutingProtocol::m_uniformRandomVariable),
                    MakePointerChecker<UniformRandomVariable> ())
+    .AddTraceSource ("RerrBytesSaved", "Total number of RERR bytes saved by RERR aggregation.",
+                     MakeTraceSourceAccessor (&RoutingProtocol::m_rerrBytesSaved),
+                     "ns3::TracedValueCallback::Uint64")
   ;
   return tid;
 }
@@ -286,12 +613,41 @@ RoutingProtocol::SetMaxQueueLen (uint32_t len)
 {
   m_maxQueueLen = len;
   m_queue.SetMaxQueueLen (len);
+  m_repairQueue.SetMaxQueueLen (len);
 }
 void
 RoutingProtocol::SetMaxQueueTime (Time t)
 {
   m_maxQueueTime = t;
   m_queue.SetQueueTimeout (t);
+  m_repairQueue.SetQueueTimeout (t);
+}
+void
+RoutingProtocol::SetHelloInterval (Time t)
+{
+  m_helloInterval = t;
+  // The hello lifetime changes
+  m_helloTemplates.clear ();
+}
+void
+RoutingProtocol::SetAllowedHelloLoss (uint32_t loss)
+{
+  m_allowedHelloLoss = loss;
+  m_helloTemplates.clear ();
+}
+void
+RoutingProtocol::SetRreqRateLimit (uint32_t limit)
+{
+  m_rreqRateLimit = limit;
+  m_rreqBucket.SetRate (limit);
+  m_rreqBucket.SetBurst (limit);
+}
+void
+RoutingProtocol::SetRerrRateLimit (uint32_t limit)
+{
+  m_rerrRateLimit = limit;
+  m_rerrBucket.SetRate (limit);
+  m_rerrBucket.SetBurst (limit);
 }
 
 RoutingProtocol::~RoutingProtocol ()
@@ -314,9 +670,29 @@ RoutingProtocol::DoDispose ()
       iter->first->Close ();
     }
   m_socketSubnetBroadcastAddresses.clear ();
+  m_pendingRreq.clear ();
+  m_pendingRerr.clear ();
+  m_rerrAggregates.clear ();
+  m_localRepairs.clear ();
+  m_replyWindows.clear ();
+  m_requestWindows.clear ();
+  m_deadlines.Clear ();
+  m_bundles.clear ();
+  m_helloTemplates.clear ();
+  m_rrepAckTemplate = 0;
   Ipv4RoutingProtocol::DoDispose ();
 }
 
+void
+RoutingProtocol::PrintEnergyAccounting (Ptr<OutputStreamWrapper> stream) const
+{
+  *stream->GetStream () << "Node: " << m_ipv4->GetObject<Node> ()->GetId ()
+                        << "; Time: " << Now().As (Time::S)
+                        << ", AODV_EO radio energy" << std::endl;
+  m_energyAccounting.Print (*stream->GetStream ());
+  *stream->GetStream () << std::endl;
+}
+
 void
 RoutingProtocol::PrintRoutingTable (Ptr<OutputStreamWrapper> stream) const
 {
@@ -341,18 +717,78 @@ void
 RoutingProtocol::Start ()
 {
   NS_LOG_FUNCTION (this);
+  if (m_coalescedTimers)
+    {
+      m_nb.SetScheduleCallback (MakeCallback (&RoutingProtocol::ScheduleNeighborPurge, this));
+    }
   if (m_enableHello)
     {
       m_nb.ScheduleTimer ();
     }
+  m_nb.SetLinkQualityWindow (m_helloInterval, m_linkQualityWindow);
+  if (m_enablePreemptive)
+    {
+      m_nb.SetWeakLinkThreshold (m_preemptiveThreshold, m_preemptiveHysteresis);
+      m_nb.SetWeakLinkCallback (MakeCallback (&RoutingProtocol::SendPreemptiveWarning, this));
+    }
+  if (m_withdrawalThreshold > 0)
+    {
+      // Energy sources are aggregated to the node before the simulation starts
+      Ptr<EnergySourceContainer> sources = m_ipv4->GetObject<EnergySourceContainer> ();
+      if (sources != 0)
+        {
+          for (EnergySourceContainer::Iterator i = sources->Begin (); i != sources->End (); ++i)
+            {
+              (*i)->TraceConnectWithoutContext ("RemainingEnergy",
+                                                MakeCallback (&RoutingProtocol::RemainingEnergyChanged, this));
+            }
+        }
+    }
+  if (m_harvestingAware)
+    {
+      m_energyPredictor.SetWindow (m_energyRateWindow);
+      m_energyPredictor.Clear ();
+      FindEnergyModels ();
+    }
+  if (m_shutdownOnDepletion)
+    {
+      Ptr<EnergySourceContainer> sources = m_ipv4->GetObject<EnergySourceContainer> ();
+      if (sources != 0)
+        {
+          for (EnergySourceContainer::Iterator i = sources->Begin (); i != sources->End (); ++i)
+            {
+              Ptr<DepletionNotifier> notifier = CreateObject<DepletionNotifier> ();
+              notifier->SetCallbacks (MakeCallback (&RoutingProtocol::HandleEnergyDepletion, this),
+                                      MakeCallback (&RoutingProtocol::HandleEnergyRecharged, this));
+              (*i)->AppendDeviceEnergyModel (notifier);
+            }
+        }
+    }
+  if (m_accountEnergy)
+    {
+      SetupEnergyAccounting ();
+    }
+  if (m_dutyCycle)
+    {
+      NS_ASSERT_MSG (m_listenWindow < m_wakeInterval, "ListenWindow must be shorter than WakeInterval");
+      m_dutyCycleTimer.SetFunction (&RoutingProtocol::DutyCycleTimerExpire, this);
+      DutyCycleTimerExpire ();
+    }
+  if (UseLoadMonitor ())
+    {
+      m_load.SetFlowTimeout (m_activeRouteTimeout);
+      m_load.SetMaxFlows (m_congestionMaxFlows);
+      m_load.Clear ();
+      m_loadTimer.SetFunction (&RoutingProtocol::LoadTimerExpire, this);
+      ScheduleTimer (LOAD_TIMER, Ipv4Address (), m_loadSampleInterval);
+    }
+  // Rate limit timers are only scheduled while RREQ or RERR are waiting for a token
   m_rreqRateLimitTimer.SetFunction (&RoutingProtocol::RreqRateLimitTimerExpire,
                                     this);
-  m_rreqRateLimitTimer.Schedule (Seconds (1));
-
   m_rerrRateLimitTimer.SetFunction (&RoutingProtocol::RerrRateLimitTimerExpire,
                                     this);
-  m_rerrRateLimitTimer.Schedule (Seconds (1));
-
+  m_rerrAggregationTimer.SetFunction (&RoutingProtocol::RerrAggregationTimerExpire,
+                                      this);
 }
 
 Ptr<Ipv4Route>
@@ -365,7 +801,7 @@ RoutingProtocol::RouteOutput (Ptr<Packet> p, const Ipv4Header &header,
       NS_LOG_DEBUG("Packet is == 0");
       return LoopbackRoute (header, oif); // later
     }
-  if (m_socketAddresses.empty ())
+  if (m_socketAddresses.empty () || m_depleted)
     {
       sockerr = Socket::ERROR_NOROUTETOHOST;
       NS_LOG_LOGIC ("No aodv_eo interfaces");
@@ -378,9 +814,10 @@ RoutingProtocol::RouteOutput (Ptr<Packet> p, const Ipv4Header &header,
   RoutingTableEntry rt;
   if (m_routingTable.LookupValidRoute (dst, rt))
     {
-      route = rt.GetRoute ();
+      route = SelectRoute (rt);
       NS_ASSERT (route != 0);
-      NS_LOG_DEBUG ("Exist route to " << route->GetDestination () << " from interface " << route->GetSource ());
+      ApplyTxPower (route);
+      NS_LOG_DEBUG ("Exist route to " << dst << " from interface " << route->GetSource ());
       if (oif != 0 && route->GetOutputDevice () != oif)
         {
           NS_LOG_DEBUG ("Output device doesn't match. Dropped.");
@@ -389,6 +826,11 @@ RoutingProtocol::RouteOutput (Ptr<Packet> p, const Ipv4Header &header,
         }
       UpdateRouteLifeTime (dst, m_activeRouteTimeout);
       UpdateRouteLifeTime (route->GetGateway (), m_activeRouteTimeout);
+      // Control broadcasts don't make the node active
+      if (m_dutyCycle && rt.GetNextHop () != rt.GetInterface ().GetBroadcast ())
+        {
+          KeepAwake (m_activeRouteTimeout);
+        }
       return route;
     }
 
@@ -414,12 +856,16 @@ RoutingProtocol::DeferredRouteOutput (Ptr<const Packet> p, const Ipv4Header & he
 
   QueueEntry newEntry (p, header, ucb, ecb);
   bool result = m_queue.Enqueue (newEntry);
+  if (m_dutyCycle)
+    {
+      KeepAwake (m_pathDiscoveryTime);
+    }
   if (result)
     {
       NS_LOG_LOGIC ("Add packet " << p->GetUid () << " to queue. Protocol " << (uint16_t) header.GetProtocol ());
       RoutingTableEntry rt;
       bool result = m_routingTable.LookupRoute (header.GetDestination (), rt);
-      if(!result || ((rt.GetFlag () != IN_SEARCH) && result))
+      if(!result || ((rt.GetFlag () != IN_SEARCH) && (rt.GetFlag () != IN_REPAIR) && result))
         {
           NS_LOG_LOGIC ("Send new RREQ for outbound packet to " <<header.GetDestination ());
           SendRequest (header.GetDestination ());
@@ -438,6 +884,11 @@ RoutingProtocol::RouteInput (Ptr<const Packet> p, const Ipv4Header &header,
       NS_LOG_LOGIC ("No aodv_eo interfaces");
       return false;
     }
+  if (m_depleted)
+    {
+      NS_LOG_LOGIC ("Energy depleted, drop packet " << p->GetUid ());
+      return false;
+    }
   NS_ASSERT (m_ipv4 != 0);
   NS_ASSERT (p != 0);
   // Check if input device supports IP
@@ -533,6 +984,10 @@ RoutingProtocol::RouteInput (Ptr<const Packet> p, const Ipv4Header &header,
   // Unicast local delivery
   if (m_ipv4->IsDestinationAddress (dst, iif))
     {
+      if (m_dutyCycle)
+        {
+          KeepAwake (m_activeRouteTimeout);
+        }
       UpdateRouteLifeTime (origin, m_activeRouteTimeout);
       RoutingTableEntry toOrigin;
       if (m_routingTable.LookupValidRoute (origin, toOrigin))
@@ -578,8 +1033,12 @@ RoutingProtocol::Forwarding (Ptr<const Packet> p, const Ipv4Header & header,
     {
       if (toDst.GetFlag () == VALID)
         {
-          Ptr<Ipv4Route> route = toDst.GetRoute ();
+          Ptr<Ipv4Route> route = SelectRoute (toDst);
           NS_LOG_LOGIC (route->GetSource ()<<" forwarding to " << dst << " from " << origin << " packet " << p->GetUid ());
+          if (m_dutyCycle)
+            {
+              KeepAwake (m_activeRouteTimeout);
+            }
 
           /*
            *  Each time a route is used to forward a data packet, its Active Route
@@ -601,10 +1060,30 @@ RoutingProtocol::Forwarding (Ptr<const Packet> p, const Ipv4Header & header,
 
           m_nb.Update (route->GetGateway (), m_activeRouteTimeout);
           m_nb.Update (toOrigin.GetNextHop (), m_activeRouteTimeout);
+          if (m_congestionAware)
+            {
+              m_load.NotifyRelayed (origin, dst);
+            }
+          if (m_admissionControl)
+            {
+              m_reservations.Refresh (origin, dst, m_activeRouteTimeout);
+            }
+          ApplyTxPower (route);
 
           ucb (route, p, header);
           return true;
         }
+      else if (toDst.GetFlag () == IN_REPAIR)
+        {
+          QueueEntry newEntry (p, header, ucb, ecb);
+          if (m_repairQueue.Enqueue (newEntry))
+            {
+              NS_LOG_LOGIC ("Route to " << dst << " is being repaired. Buffer packet " << p->GetUid ());
+              return true;
+            }
+          NS_LOG_DEBUG ("Drop packet " << p->GetUid () << " already buffered for local repair.");
+          return false;
+        }
       else
         {
           if (toDst.GetValidSeqNo ())
@@ -698,6 +1177,25 @@ RoutingProtocol::NotifyInterfaceUp (uint32_t i)
     return;
 
   mac->TraceConnectWithoutContext ("TxErrHeader", m_nb.GetTxErrorCallback ());
+  if (m_txPowerControl)
+    {
+      Ptr<WifiPhy> phy = wifi->GetPhy ();
+      m_nb.SetTxPowerLevels (phy->GetTxPowerStart (), phy->GetTxPowerEnd (), phy->GetNTxPower ());
+    }
+  if (m_enablePreemptive || m_linkMetric == ETT_METRIC || m_txPowerControl)
+    {
+      wifi->GetPhy ()->TraceConnectWithoutContext ("MonitorSnifferRx", m_nb.GetMonitorSnifferRxCallback ());
+    }
+  PointerValue state;
+  if (UseLoadMonitor () && wifi->GetPhy ()->GetAttributeFailSafe ("State", state) && state.Get<Object> () != 0)
+    {
+      state.Get<Object> ()->TraceConnectWithoutContext ("State", m_load.GetPhyStateCallback ());
+    }
+  if (m_accountEnergy)
+    {
+      wifi->GetPhy ()->TraceConnectWithoutContext ("MonitorSnifferTx", m_energyAccounting.GetMonitorSnifferTxCallback ());
+      wifi->GetPhy ()->TraceConnectWithoutContext ("MonitorSnifferRx", m_energyAccounting.GetMonitorSnifferRxCallback ());
+    }
 }
 
 void
@@ -716,6 +1214,21 @@ RoutingProtocol::NotifyInterfaceDown (uint32_t i)
         {
           mac->TraceDisconnectWithoutContext ("TxErrHeader",
                                               m_nb.GetTxErrorCallback ());
+          if (m_enablePreemptive || m_linkMetric == ETT_METRIC || m_txPowerControl)
+            {
+              wifi->GetPhy ()->TraceDisconnectWithoutContext ("MonitorSnifferRx",
+                                                              m_nb.GetMonitorSnifferRxCallback ());
+            }
+          PointerValue state;
+          if (UseLoadMonitor () && wifi->GetPhy ()->GetAttributeFailSafe ("State", state) && state.Get<Object> () != 0)
+            {
+              state.Get<Object> ()->TraceDisconnectWithoutContext ("State", m_load.GetPhyStateCallback ());
+            }
+          if (m_accountEnergy)
+            {
+              wifi->GetPhy ()->TraceDisconnectWithoutContext ("MonitorSnifferTx", m_energyAccounting.GetMonitorSnifferTxCallback ());
+              wifi->GetPhy ()->TraceDisconnectWithoutContext ("MonitorSnifferRx", m_energyAccounting.GetMonitorSnifferRxCallback ());
+            }
           m_nb.DelArpCache (l3->GetInterface (i)->GetArpCache ());
         }
     }
@@ -735,7 +1248,7 @@ RoutingProtocol::NotifyInterfaceDown (uint32_t i)
   if (m_socketAddresses.empty ())
     {
       NS_LOG_LOGIC ("No aodv_eo interfaces");
-      m_htimer.Cancel ();
+      CancelTimer (HELLO_TIMER, Ipv4Address ());
       m_nb.Clear ();
       m_routingTable.Clear ();
       return;
@@ -848,7 +1361,7 @@ RoutingProtocol::NotifyRemoveAddress (uint32_t i, Ipv4InterfaceAddress address)
       if (m_socketAddresses.empty ())
         {
           NS_LOG_LOGIC ("No aodv_eo interfaces");
-          m_htimer.Cancel ();
+          CancelTimer (HELLO_TIMER, Ipv4Address ());
           m_nb.Clear ();
           m_routingTable.Clear ();
           return;
@@ -929,14 +1442,27 @@ RoutingProtocol::SendRequest (Ipv4Address dst)
 {
   NS_LOG_FUNCTION ( this << dst);
   // A node SHOULD NOT originate more than RREQ_RATELIMIT RREQ messages per second.
-  if (m_rreqCount == m_rreqRateLimit)
+  // Discoveries which exceed the limit wait in FIFO order for the next token.
+  if (!m_pendingRreq.empty () || !m_rreqBucket.Consume ())
     {
-      Simulator::Schedule (m_rreqRateLimitTimer.GetDelayLeft () + MicroSeconds (100),
-                           &RoutingProtocol::SendRequest, this, dst);
+      if (std::find (m_pendingRreq.begin (), m_pendingRreq.end (), dst) == m_pendingRreq.end ())
+        {
+          m_pendingRreq.push_back (dst);
+        }
+      if (!IsTimerRunning (RREQ_RATE_LIMIT_TIMER, Ipv4Address ()) && m_rreqRateLimit > 0)
+        {
+          ScheduleTimer (RREQ_RATE_LIMIT_TIMER, Ipv4Address (), m_rreqBucket.GetDelayLeft ());
+        }
+      NS_LOG_LOGIC ("RreqRateLimit reached, RREQ to " << dst << " deferred, " << m_pendingRreq.size () << " pending");
       return;
     }
-  else
-    m_rreqCount++;
+  SendRequestMessage (dst);
+}
+
+void
+RoutingProtocol::SendRequestMessage (Ipv4Address dst)
+{
+  NS_LOG_FUNCTION ( this << dst);
   // Create RREQ header
   RreqHeader rreqHeader;
   rreqHeader.SetDst (dst);
@@ -986,10 +1512,25 @@ RoutingProtocol::SendRequest (Ipv4Address dst)
   if (m_destinationOnly)
     rreqHeader.SetDestinationOnly (true);
 
-  m_seqNo++;
+  BroadcastRequest (rreqHeader, ttl);
+  ScheduleRreqRetry (dst);
+}
+
+void
+RoutingProtocol::BroadcastRequest (RreqHeader & rreqHeader, uint16_t ttl)
+{
+  NS_LOG_FUNCTION (this << rreqHeader.GetDst () << ttl);
+  IncrementSeqNo ();
   rreqHeader.SetOriginSeqno (m_seqNo);
   m_requestId++;
   rreqHeader.SetId (m_requestId);
+  if (UsePathEnergy ())
+    rreqHeader.SetExtension (GetEnergyExtension (), GetNodeEnergy ());
+  if (UsePathMetric ())
+    rreqHeader.SetExtension (AODVEXT_PATH_METRIC, 0);
+  uint64_t rate = m_admissionControl ? GetFlowRate (rreqHeader.GetDst ()) : 0;
+  if (rate > 0)
+    rreqHeader.SetExtension (AODVEXT_BANDWIDTH, (uint32_t) std::min<uint64_t> ((rate + 999) / 1000, std::numeric_limits<uint32_t>::max ()));
 
   // Send RREQ as subnet directed broadcast from each interface used by aodv_eo
   for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j =
@@ -1005,9 +1546,7 @@ RoutingProtocol::SendRequest (Ipv4Address dst)
       SocketIpTtlTag tag;
       tag.SetTtl (ttl);
       packet->AddPacketTag (tag);
-      packet->AddHeader (rreqHeader);
-      TypeHeader tHeader (AODVTYPE_RREQ);
-      packet->AddHeader (tHeader);
+      packet->AddHeader (RreqMessage (rreqHeader));
       // Send to all-hosts broadcast if on /32 addr, subnet-directed otherwise
       Ipv4Address destination;
       if (iface.GetMask () == Ipv4Mask::GetOnes ())
@@ -1020,29 +1559,140 @@ RoutingProtocol::SendRequest (Ipv4Address dst)
         }
       NS_LOG_DEBUG ("Send RREQ with id " << rreqHeader.GetId () << " to socket");
       m_lastBcastTime = Simulator::Now ();
-      Simulator::Schedule (Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10))), &RoutingProtocol::SendTo, this, socket, packet, destination); 
+      Time jitter = Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10)));
+      ScheduleSendTo (AlignToListenWindow (jitter), socket, packet, destination);
     }
-  ScheduleRreqRetry (dst);
 }
 
 void
 RoutingProtocol::SendTo (Ptr<Socket> socket, Ptr<Packet> packet, Ipv4Address destination)
 {
-    socket->SendTo (packet, 0, InetSocketAddress (destination, AODV_EO_PORT));
+  if (m_depleted)
+    {
+      NS_LOG_LOGIC ("Energy depleted, drop AODV_EO packet to " << destination);
+      return;
+    }
+  socket->SendTo (EncodeMessage (socket, packet), 0, InetSocketAddress (destination, AODV_EO_PORT));
+}
 
+Ptr<Packet>
+RoutingProtocol::EncodeMessage (Ptr<Socket> socket, Ptr<Packet> packet) const
+{
+  if (m_compactEncoding)
+    {
+      std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator i = m_socketAddresses.find (socket);
+      if (i != m_socketAddresses.end ())
+        {
+          // The packet may be shared with other scheduled sends
+          packet = packet->Copy ();
+          CompactHeader compact (i->second.GetLocal (), i->second.GetMask ());
+          compact.Compress (packet);
+        }
+    }
+  return packet;
 }
+
 void
-RoutingProtocol::ScheduleRreqRetry (Ipv4Address dst)
+RoutingProtocol::ScheduleSendTo (Time delay, Ptr<Socket> socket, Ptr<Packet> packet, Ipv4Address destination)
 {
-  NS_LOG_FUNCTION (this << dst);
-  if (m_addressReqTimer.find (dst) == m_addressReqTimer.end ())
+  if (!m_messageBundling)
+    {
+      Simulator::Schedule (delay, &RoutingProtocol::SendTo, this, socket, packet, destination);
+      return;
+    }
+  SocketIpTtlTag tag;
+  packet->PeekPacketTag (tag);
+  Ptr<Packet> message = EncodeMessage (socket, packet);
+  BundleHeader bundleHeader;
+  TypeHeader tHeader;
+  uint32_t mtu = m_ipv4->GetMtu (m_ipv4->GetInterfaceForAddress (m_socketAddresses[socket].GetLocal ()));
+  uint32_t overhead = Ipv4Header ().GetSerializedSize () + UdpHeader ().GetSerializedSize ();
+  Time sendTime = Simulator::Now () + delay;
+  // Room for the message in a bundle sent within the window of its own send time, within the MTU
+  for (std::vector<Bundle>::iterator i = m_bundles.begin (); i != m_bundles.end (); ++i)
+    {
+      if (i->m_socket == socket && i->m_destination == destination && i->m_ttl == tag.GetTtl ()
+          && i->m_sendTime >= sendTime - m_bundleWindow && i->m_sendTime <= sendTime + m_bundleWindow
+          && i->m_size + bundleHeader.GetSerializedSize () + message->GetSize () + overhead <= mtu)
+        {
+          NS_LOG_LOGIC ("Add message to bundle to " << destination);
+          i->m_messages.push_back (message);
+          i->m_size += bundleHeader.GetSerializedSize () + message->GetSize ();
+          return;
+        }
+    }
+  Bundle bundle;
+  bundle.m_socket = socket;
+  bundle.m_destination = destination;
+  bundle.m_ttl = tag.GetTtl ();
+  bundle.m_sendTime = sendTime;
+  bundle.m_messages.push_back (message);
+  bundle.m_size = tHeader.GetSerializedSize () + bundleHeader.GetSerializedSize () + message->GetSize ();
+  bundle.m_id = m_nextBundleId++;
+  m_bundles.push_back (bundle);
+  Simulator::Schedule (delay, &RoutingProtocol::SendBundle, this, bundle.m_id);
+}
+
+void
+RoutingProtocol::SendBundle (uint32_t id)
+{
+  NS_LOG_FUNCTION (this << id);
+  std::vector<Bundle>::iterator i = m_bundles.begin ();
+  while (i != m_bundles.end () && i->m_id != id)
+    {
+      ++i;
+    }
+  if (i == m_bundles.end () || m_depleted)
+    {
+      return;
+    }
+  Bundle bundle = *i;
+  m_bundles.erase (i);
+  Ptr<Packet> packet;
+  if (bundle.m_messages.size () == 1)
+    {
+      packet = bundle.m_messages.front ();
+    }
+  else
     {
-      Timer timer (Timer::CANCEL_ON_DESTROY);
-      m_addressReqTimer[dst] = timer;
+      NS_LOG_LOGIC ("Send bundle of " << bundle.m_messages.size () << " messages to " << bundle.m_destination);
+      packet = Create<Packet> ();
+      for (std::vector<Ptr<Packet> >::const_iterator j = bundle.m_messages.begin (); j != bundle.m_messages.end (); ++j)
+        {
+          Ptr<Packet> message = (*j)->Copy ();
+          message->RemoveAllPacketTags ();
+          message->AddHeader (BundleHeader ((uint16_t) message->GetSize ()));
+          packet->AddAtEnd (message);
+        }
+      packet->AddHeader (TypeHeader (AODVTYPE_BUNDLE));
+      SocketIpTtlTag tag;
+      tag.SetTtl (bundle.m_ttl);
+      packet->AddPacketTag (tag);
     }
-  m_addressReqTimer[dst].SetFunction (&RoutingProtocol::RouteRequestTimerExpire, this);
-  m_addressReqTimer[dst].Remove ();
-  m_addressReqTimer[dst].SetArguments (dst);
+  bundle.m_socket->SendTo (packet, 0, InetSocketAddress (bundle.m_destination, AODV_EO_PORT));
+}
+
+Ptr<Packet>
+RoutingProtocol::CreateFromTemplate (std::vector<uint8_t> const & tmpl, uint8_t ttl)
+{
+  Ptr<Packet> packet = Create<Packet> (&tmpl[0], (uint32_t) tmpl.size ());
+  SocketIpTtlTag tag;
+  tag.SetTtl (ttl);
+  packet->AddPacketTag (tag);
+  return packet;
+}
+
+void
+RoutingProtocol::IncrementSeqNo ()
+{
+  m_seqNo++;
+  m_helloTemplates.clear ();
+}
+
+void
+RoutingProtocol::ScheduleRreqRetry (Ipv4Address dst)
+{
+  NS_LOG_FUNCTION (this << dst);
   RoutingTableEntry rt;
   m_routingTable.LookupRoute (dst, rt);
   Time retry;
@@ -1055,7 +1705,7 @@ RoutingProtocol::ScheduleRreqRetry (Ipv4Address dst)
       // Binary exponential backoff
       retry = std::pow<uint16_t> (2, rt.GetRreqCnt () - 1) * m_netTraversalTime;
     }
-  m_addressReqTimer[dst].Schedule (retry);
+  ScheduleTimer (RREQ_RETRY_TIMER, dst, retry);
   NS_LOG_LOGIC ("Scheduled RREQ retry in " << retry.GetSeconds () << " seconds");
 }
 
@@ -1067,25 +1717,72 @@ RoutingProtocol::RecvAodv (Ptr<Socket> socket)
   Ptr<Packet> packet = socket->RecvFrom (sourceAddress);
   InetSocketAddress inetSourceAddr = InetSocketAddress::ConvertFrom (sourceAddress);
   Ipv4Address sender = inetSourceAddr.GetIpv4 ();
-  Ipv4Address receiver;
+  Ipv4InterfaceAddress iface;
 
   if (m_socketAddresses.find (socket) != m_socketAddresses.end ())
     {
-      receiver = m_socketAddresses[socket].GetLocal ();
+      iface = m_socketAddresses[socket];
     }
   else if(m_socketSubnetBroadcastAddresses.find (socket) != m_socketSubnetBroadcastAddresses.end ())
     {
-      receiver = m_socketSubnetBroadcastAddresses[socket].GetLocal ();
+      iface = m_socketSubnetBroadcastAddresses[socket];
     }
   else
     {
       NS_ASSERT_MSG (false, "Received a packet from an unknown socket");
     }
+  Ipv4Address receiver = iface.GetLocal ();
+  if (m_depleted)
+    {
+      return;
+    }
   NS_LOG_DEBUG ("AODV node " << this << " received a AODV packet from " << sender << " to " << receiver);
 
   UpdateRouteToNeighbor (sender, receiver);
+  if (!CompactHeader::IsCompact (packet))
+    {
+      TypeHeader tHeader;
+      packet->PeekHeader (tHeader);
+      if (tHeader.IsValid () && tHeader.Get () == AODVTYPE_BUNDLE)
+        {
+          // Demultiplex messages of the bundle
+          packet->RemoveHeader (tHeader);
+          BundleHeader bundleHeader;
+          while (packet->GetSize () >= bundleHeader.GetSerializedSize ())
+            {
+              packet->RemoveHeader (bundleHeader);
+              if (bundleHeader.GetLength () == 0 || bundleHeader.GetLength () > packet->GetSize ())
+                {
+                  NS_LOG_DEBUG ("Malformed AODV_EO bundle " << packet->GetUid () << ". Drop");
+                  return; // drop
+                }
+              Ptr<Packet> message = packet->CreateFragment (0, bundleHeader.GetLength ());
+              packet->RemoveAtStart (bundleHeader.GetLength ());
+              RecvMessage (message, iface, sender);
+            }
+          return;
+        }
+    }
+  RecvMessage (packet, iface, sender);
+}
+
+void
+RoutingProtocol::RecvMessage (Ptr<Packet> packet, Ipv4InterfaceAddress iface, Ipv4Address sender)
+{
+  NS_LOG_FUNCTION (this << sender);
+  Ipv4Address receiver = iface.GetLocal ();
+  if (CompactHeader::IsCompact (packet))
+    {
+      CompactHeader compact (iface.GetLocal (), iface.GetMask ());
+      if (!compact.Decompress (packet))
+        {
+          NS_LOG_DEBUG ("Compact AODV_EO message " << packet->GetUid () << " can't be decoded. Drop");
+          return; // drop
+        }
+    }
+  // Handlers remove type and message in one header
   TypeHeader tHeader (AODVTYPE_RREQ);
-  packet->RemoveHeader (tHeader);
+  packet->PeekHeader (tHeader);
   if (!tHeader.IsValid ())
     {
       NS_LOG_DEBUG ("AODV_EO message " << packet->GetUid () << " with unknown type received: " << tHeader.Get () << ". Drop");
@@ -1095,6 +1792,13 @@ RoutingProtocol::RecvAodv (Ptr<Socket> socket)
     {
     case AODVTYPE_RREQ:
       {
+        if (m_enablePreemptive && m_nb.IsWeakLink (sender))
+          {
+            // Let copies of the RREQ received over strong links win duplicate detection
+            NS_LOG_LOGIC ("Delay RREQ received over weak link from " << sender);
+            Simulator::Schedule (m_nodeTraversalTime, &RoutingProtocol::RecvRequest, this, packet, receiver, sender);
+            break;
+          }
         RecvRequest (packet, receiver, sender);
         break;
       }
@@ -1113,6 +1817,11 @@ RoutingProtocol::RecvAodv (Ptr<Socket> socket)
         RecvReplyAck (sender);
         break;
       }
+    case AODVTYPE_BUNDLE:
+      {
+        NS_LOG_DEBUG ("Bundle within a bundle received. Drop");
+        break;
+      }
     }
 }
 
@@ -1170,12 +1879,23 @@ void
 RoutingProtocol::RecvRequest (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address src)
 {
   NS_LOG_FUNCTION (this);
-  RreqHeader rreqHeader;
-  p->RemoveHeader (rreqHeader);
-
-  // A node ignores all RREQs received from any node in its blacklist
-  RoutingTableEntry toPrev;
-  if (m_routingTable.LookupRoute (src, toPrev))
+  // RREQs received over weak links are processed later
+  if (m_depleted)
+    {
+      return;
+    }
+  RreqMessage message;
+  p->RemoveHeader (message);
+  if (!message.IsValid ())
+    {
+      NS_LOG_DEBUG ("Truncated RREQ " << p->GetUid () << ". Drop");
+      return; // drop
+    }
+  RreqHeader & rreqHeader = message.GetMessage ();
+
+  // A node ignores all RREQs received from any node in its blacklist
+  RoutingTableEntry toPrev;
+  if (m_routingTable.LookupRoute (src, toPrev))
     {
       if (toPrev.IsUnidirectional ())
         {
@@ -1191,10 +1911,27 @@ RoutingProtocol::RecvRequest (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address s
    *  Node checks to determine whether it has received a RREQ with the same Originator IP Address and RREQ ID.
    *  If such a RREQ has been received, the node silently discards the newly received RREQ.
    */
-  if (m_rreqIdCache.IsDuplicate (origin, id))
+  bool duplicate = m_rreqIdCache.IsDuplicate (origin, id);
+  if (duplicate)
     {
-      NS_LOG_DEBUG ("Ignoring RREQ due to duplicate");
-      return;
+      // Every improvement would be flooded again otherwise
+      if (UsePathMetric () && IsBetterRequest (rreqHeader, src) && !m_rreqReforwardCache.IsDuplicate (origin, id))
+        {
+          NS_LOG_DEBUG ("Process duplicate RREQ offering a better reverse route");
+        }
+      else if (IsBetterRequestCopy (rreqHeader, src))
+        {
+          NS_LOG_DEBUG ("Answer duplicate RREQ offering a better route while the source collects RREPs");
+        }
+      else
+        {
+          if (m_enableMultipath)
+            {
+              RecvDuplicateRequest (rreqHeader, receiver, src);
+            }
+          NS_LOG_DEBUG ("Ignoring RREQ due to duplicate");
+          return;
+        }
     }
 
   // Increment RREQ hop count
@@ -1218,6 +1955,8 @@ RoutingProtocol::RecvRequest (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address s
       RoutingTableEntry newEntry (/*device=*/ dev, /*dst=*/ origin, /*validSeno=*/ true, /*seqNo=*/ rreqHeader.GetOriginSeqno (),
                                               /*iface=*/ m_ipv4->GetAddress (m_ipv4->GetInterfaceForAddress (receiver), 0), /*hops=*/ hop,
                                               /*nextHop*/ src, /*timeLife=*/ Time ((2 * m_netTraversalTime - 2 * hop * m_nodeTraversalTime)));
+      newEntry.SetPathEnergy (GetPathEnergy (rreqHeader));
+      newEntry.SetMetric (GetPathMetric (rreqHeader, src));
       m_routingTable.AddRoute (newEntry);
     }
   else
@@ -1234,6 +1973,11 @@ RoutingProtocol::RecvRequest (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address s
       toOrigin.SetOutputDevice (m_ipv4->GetNetDevice (m_ipv4->GetInterfaceForAddress (receiver)));
       toOrigin.SetInterface (m_ipv4->GetAddress (m_ipv4->GetInterfaceForAddress (receiver), 0));
       toOrigin.SetHop (hop);
+      // Alternate paths were loop-free for the previous reverse path only
+      toOrigin.SetAdvertisedHops (hop);
+      toOrigin.DeleteAllAlternatePaths ();
+      toOrigin.SetPathEnergy (GetPathEnergy (rreqHeader));
+      toOrigin.SetMetric (GetPathMetric (rreqHeader, src));
       toOrigin.SetLifeTime (std::max (Time (2 * m_netTraversalTime - 2 * hop * m_nodeTraversalTime),
                                       toOrigin.GetLifeTime ()));
       m_routingTable.Update (toOrigin);
@@ -1273,6 +2017,10 @@ RoutingProtocol::RecvRequest (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address s
   //  (i)  it is itself the destination,
   if (IsMyOwnAddress (rreqHeader.GetDst ()))
     {
+      if (!duplicate && m_replyCollectionWindow > Seconds (0))
+        {
+          m_requestWindows[origin] = std::make_pair (id, Simulator::Now () + m_replyCollectionWindow);
+        }
       m_routingTable.LookupRoute (origin, toOrigin);
       NS_LOG_DEBUG ("Send reply since I am the destination");
       SendReply (rreqHeader, toOrigin);
@@ -1303,7 +2051,10 @@ RoutingProtocol::RecvRequest (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address s
       if ((rreqHeader.GetUnknownSeqno () || (int32_t (toDst.GetSeqNo ()) - int32_t (rreqHeader.GetDstSeqno ()) >= 0))
           && toDst.GetValidSeqNo () )
         {
-          if (!rreqHeader.GetDestinationOnly () && toDst.GetFlag () == VALID)
+          // An intermediate node can't tell whether the rest of the route can carry a requested rate
+          uint32_t rate = 0;
+          if (!rreqHeader.GetDestinationOnly () && toDst.GetFlag () == VALID && !m_withdrawn
+              && !rreqHeader.GetExtension (AODVEXT_BANDWIDTH, rate))
             {
               m_routingTable.LookupRoute (origin, toOrigin);
               SendReplyByIntermediateNode (toDst, toOrigin, rreqHeader.GetGratiousRrep ());
@@ -1321,6 +2072,43 @@ RoutingProtocol::RecvRequest (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address s
       NS_LOG_DEBUG ("TTL exceeded. Drop RREQ origin " << src << " destination " << dst );
       return;
     }
+  if (m_withdrawn)
+    {
+      NS_LOG_DEBUG ("Low energy. Drop RREQ origin " << origin << " destination " << dst);
+      return;
+    }
+  Time delay = Seconds (0);
+  if (m_congestionAware)
+    {
+      // Let copies of the RREQ through less loaded nodes arrive first
+      if (m_load.GetLoad () > m_congestionDropThreshold)
+        {
+          NS_LOG_DEBUG ("Node overloaded (" << m_load.GetLoad () << "). Drop RREQ origin " << origin << " destination " << dst);
+          return;
+        }
+      delay = Seconds (m_load.GetLoad () * m_congestionMaxDelay.GetSeconds ());
+    }
+  uint32_t rate = 0;
+  if (m_admissionControl && rreqHeader.GetExtension (AODVEXT_BANDWIDTH, rate)
+      && GetAvailableBandwidth (origin, dst) < (uint64_t) rate * 1000)
+    {
+      NS_LOG_DEBUG ("Can't carry " << rate << " kbps. Drop RREQ origin " << origin << " destination " << dst);
+      return;
+    }
+  if (UsePathEnergy ())
+    {
+      rreqHeader.SetExtension (GetEnergyExtension (), std::min (GetPathEnergy (rreqHeader), GetNodeEnergy ()));
+    }
+  if (UsePathMetric ())
+    {
+      rreqHeader.SetExtension (AODVEXT_PATH_METRIC, (uint32_t) std::min<uint64_t> ((uint64_t) GetPathMetric (rreqHeader, src) + GetLoadPenalty (src),
+                                                                                 std::numeric_limits<uint32_t>::max ()));
+    }
+  if (m_dutyCycle)
+    {
+      // Stay awake for the RREP
+      KeepAwake (m_pathDiscoveryTime);
+    }
 
   for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j =
          m_socketAddresses.begin (); j != m_socketAddresses.end (); ++j)
@@ -1331,9 +2119,7 @@ RoutingProtocol::RecvRequest (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address s
       SocketIpTtlTag ttl;
       ttl.SetTtl (tag.GetTtl () - 1);
       packet->AddPacketTag (ttl);
-      packet->AddHeader (rreqHeader);
-      TypeHeader tHeader (AODVTYPE_RREQ);
-      packet->AddHeader (tHeader);
+      packet->AddHeader (RreqMessage (rreqHeader));
       // Send to all-hosts broadcast if on /32 addr, subnet-directed otherwise
       Ipv4Address destination;
       if (iface.GetMask () == Ipv4Mask::GetOnes ())
@@ -1345,262 +2131,920 @@ RoutingProtocol::RecvRequest (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address s
           destination = iface.GetBroadcast ();
         }
       m_lastBcastTime = Simulator::Now ();
-      Simulator::Schedule (Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10))), &RoutingProtocol::SendTo, this, socket, packet, destination); 
+      ScheduleSendTo (AlignToListenWindow (delay + Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10)))),
+                      socket, packet, destination);
 
     }
 }
 
 void
-RoutingProtocol::SendReply (RreqHeader const & rreqHeader, RoutingTableEntry const & toOrigin)
-{
-  NS_LOG_FUNCTION (this << toOrigin.GetDestination ());
-  /*
-   * Destination node MUST increment its own sequence number by one if the sequence number in the RREQ packet is equal to that
-   * incremented value. Otherwise, the destination does not change its sequence number before generating the  RREP message.
-   */
-  if (!rreqHeader.GetUnknownSeqno () && (rreqHeader.GetDstSeqno () == m_seqNo + 1))
-    m_seqNo++;
-  RrepHeader rrepHeader ( /*prefixSize=*/ 0, /*hops=*/ 0, /*dst=*/ rreqHeader.GetDst (),
-                                          /*dstSeqNo=*/ m_seqNo, /*origin=*/ toOrigin.GetDestination (), /*lifeTime=*/ m_myRouteTimeout);
-  Ptr<Packet> packet = Create<Packet> ();
-  SocketIpTtlTag tag;
-  tag.SetTtl (toOrigin.GetHop ());
-  packet->AddPacketTag (tag);
-  packet->AddHeader (rrepHeader);
-  TypeHeader tHeader (AODVTYPE_RREP);
-  packet->AddHeader (tHeader);
-  Ptr<Socket> socket = FindSocketWithInterfaceAddress (toOrigin.GetInterface ());
-  NS_ASSERT (socket);
-  socket->SendTo (packet, 0, InetSocketAddress (toOrigin.GetNextHop (), AODV_EO_PORT));
-}
-
-void
-RoutingProtocol::SendReplyByIntermediateNode (RoutingTableEntry & toDst, RoutingTableEntry & toOrigin, bool gratRep)
+RoutingProtocol::RecvDuplicateRequest (RreqHeader const & rreqHeader, Ipv4Address receiver, Ipv4Address src)
 {
-  NS_LOG_FUNCTION (this);
-  RrepHeader rrepHeader (/*prefix size=*/ 0, /*hops=*/ toDst.GetHop (), /*dst=*/ toDst.GetDestination (), /*dst seqno=*/ toDst.GetSeqNo (),
-                                          /*origin=*/ toOrigin.GetDestination (), /*lifetime=*/ toDst.GetLifeTime ());
-  /* If the node we received a RREQ for is a neighbor we are
-   * probably facing a unidirectional link... Better request a RREP-ack
-   */
-  if (toDst.GetHop () == 1)
-    {
-      rrepHeader.SetAckRequired (true);
-      RoutingTableEntry toNextHop;
-      m_routingTable.LookupRoute (toOrigin.GetNextHop (), toNextHop);
-      toNextHop.m_ackTimer.SetFunction (&RoutingProtocol::AckTimerExpire, this);
-      toNextHop.m_ackTimer.SetArguments (toNextHop.GetDestination (), m_blackListTimeout);
-      toNextHop.m_ackTimer.SetDelay (m_nextHopWait);
-    }
-  toDst.InsertPrecursor (toOrigin.GetNextHop ());
-  toOrigin.InsertPrecursor (toDst.GetNextHop ());
-  m_routingTable.Update (toDst);
-  m_routingTable.Update (toOrigin);
-
-  Ptr<Packet> packet = Create<Packet> ();
-  SocketIpTtlTag tag;
-  tag.SetTtl (toOrigin.GetHop ());
-  packet->AddPacketTag (tag);
-  packet->AddHeader (rrepHeader);
-  TypeHeader tHeader (AODVTYPE_RREP);
-  packet->AddHeader (tHeader);
-  Ptr<Socket> socket = FindSocketWithInterfaceAddress (toOrigin.GetInterface ());
-  NS_ASSERT (socket);
-  socket->SendTo (packet, 0, InetSocketAddress (toOrigin.GetNextHop (), AODV_EO_PORT));
-
-  // Generating gratuitous RREPs
-  if (gratRep)
+  NS_LOG_FUNCTION (this << src);
+  Ipv4Address origin = rreqHeader.GetOrigin ();
+  if (IsMyOwnAddress (origin))
+    return;
+  uint16_t hop = rreqHeader.GetHopCount () + 1;
+  Time lifetime = Time (2 * m_netTraversalTime - 2 * hop * m_nodeTraversalTime);
+  if (!AddAlternatePath (origin, rreqHeader.GetOriginSeqno (), src, hop, receiver, lifetime, GetPathEnergy (rreqHeader)))
+    return;
+  // Replying over every new reverse path lets upstream nodes learn alternate forward paths
+  if (IsMyOwnAddress (rreqHeader.GetDst ()))
     {
-      RrepHeader gratRepHeader (/*prefix size=*/ 0, /*hops=*/ toOrigin.GetHop (), /*dst=*/ toOrigin.GetDestination (),
-                                                 /*dst seqno=*/ toOrigin.GetSeqNo (), /*origin=*/ toDst.GetDestination (),
-                                                 /*lifetime=*/ toOrigin.GetLifeTime ());
-      Ptr<Packet> packetToDst = Create<Packet> ();
-      SocketIpTtlTag gratTag;
-      gratTag.SetTtl (toDst.GetHop ());
-      packetToDst->AddPacketTag (gratTag);
-      packetToDst->AddHeader (gratRepHeader);
-      TypeHeader type (AODVTYPE_RREP);
-      packetToDst->AddHeader (type);
-      Ptr<Socket> socket = FindSocketWithInterfaceAddress (toDst.GetInterface ());
-      NS_ASSERT (socket);
-      NS_LOG_LOGIC ("Send gratuitous RREP " << packet->GetUid ());
-      socket->SendTo (packetToDst, 0, InetSocketAddress (toDst.GetNextHop (), AODV_EO_PORT));
+      NS_LOG_DEBUG ("Send reply to duplicate RREQ through " << src);
+      Ptr<NetDevice> dev = m_ipv4->GetNetDevice (m_ipv4->GetInterfaceForAddress (receiver));
+      RoutingTableEntry toOrigin (/*device=*/ dev, /*dst=*/ origin, /*validSeqNo=*/ true, /*seqNo=*/ rreqHeader.GetOriginSeqno (),
+                                  /*iface=*/ m_ipv4->GetAddress (m_ipv4->GetInterfaceForAddress (receiver), 0), /*hops=*/ hop,
+                                  /*nextHop=*/ src, /*lifeTime=*/ lifetime);
+      toOrigin.SetPathEnergy (GetPathEnergy (rreqHeader));
+      SendReply (rreqHeader, toOrigin);
     }
 }
 
-void
-RoutingProtocol::SendReplyAck (Ipv4Address neighbor)
+bool
+RoutingProtocol::AddAlternatePath (Ipv4Address dst, uint32_t seqNo, Ipv4Address nextHop, uint16_t hops,
+                                   Ipv4Address receiver, Time lifetime, uint32_t energy)
 {
-  NS_LOG_FUNCTION (this << " to " << neighbor);
-  RrepAckHeader h;
-  TypeHeader typeHeader (AODVTYPE_RREP_ACK);
-  Ptr<Packet> packet = Create<Packet> ();
-  SocketIpTtlTag tag;
-  tag.SetTtl (1);
-  packet->AddPacketTag (tag);
-  packet->AddHeader (h);
-  packet->AddHeader (typeHeader);
-  RoutingTableEntry toNeighbor;
-  m_routingTable.LookupRoute (neighbor, toNeighbor);
-  Ptr<Socket> socket = FindSocketWithInterfaceAddress (toNeighbor.GetInterface ());
-  NS_ASSERT (socket);
-  socket->SendTo (packet, 0, InetSocketAddress (neighbor, AODV_EO_PORT));
+  NS_LOG_FUNCTION (this << dst << nextHop << hops);
+  RoutingTableEntry rt;
+  if (!m_routingTable.LookupValidRoute (dst, rt) || !rt.GetValidSeqNo () || rt.GetSeqNo () != seqNo)
+    return false;
+  Ptr<NetDevice> dev = m_ipv4->GetNetDevice (m_ipv4->GetInterfaceForAddress (receiver));
+  Ipv4InterfaceAddress iface = m_ipv4->GetAddress (m_ipv4->GetInterfaceForAddress (receiver), 0);
+  bool added = rt.InsertAlternatePath (nextHop, dev, iface, hops, lifetime, m_maxPaths - 1, energy);
+  m_routingTable.Update (rt);
+  if (added)
+    {
+      NS_LOG_LOGIC ("Alternate path to " << dst << " through " << nextHop << " with " << hops << " hops");
+    }
+  return added;
 }
 
 void
-RoutingProtocol::RecvReply (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address sender)
+RoutingProtocol::FailoverToAlternatePaths (Ipv4Address nextHop, std::map<Ipv4Address, uint32_t> & unreachable)
 {
-  NS_LOG_FUNCTION (this << " src " << sender);
-  RrepHeader rrepHeader;
-  p->RemoveHeader (rrepHeader);
-  Ipv4Address dst = rrepHeader.GetDst ();
-  NS_LOG_LOGIC ("RREP destination " << dst << " RREP origin " << rrepHeader.GetOrigin ());
-
-  uint8_t hop = rrepHeader.GetHopCount () + 1;
-  rrepHeader.SetHopCount (hop);
-
-  // If RREP is Hello message
-  if (dst == rrepHeader.GetOrigin ())
-    {
-      ProcessHello (rrepHeader, receiver);
-      return;
-    }
-
-  /*
-   * If the route table entry to the destination is created or updated, then the following actions occur:
-   * -  the route is marked as active,
-   * -  the destination sequence number is marked as valid,
-   * -  the next hop in the route entry is assigned to be the node from which the RREP is received,
-   *    which is indicated by the source IP address field in the IP header,
-   * -  the hop count is set to the value of the hop count from RREP message + 1
-   * -  the expiry time is set to the current time plus the value of the Lifetime in the RREP message,
-   * -  and the destination sequence number is the Destination Sequence Number in the RREP message.
-   */
-  Ptr<NetDevice> dev = m_ipv4->GetNetDevice (m_ipv4->GetInterfaceForAddress (receiver));
-  RoutingTableEntry newEntry (/*device=*/ dev, /*dst=*/ dst, /*validSeqNo=*/ true, /*seqno=*/ rrepHeader.GetDstSeqno (),
-                                          /*iface=*/ m_ipv4->GetAddress (m_ipv4->GetInterfaceForAddress (receiver), 0),/*hop=*/ hop,
-                                          /*nextHop=*/ sender, /*lifeTime=*/ rrepHeader.GetLifeTime ());
-  RoutingTableEntry toDst;
-  if (m_routingTable.LookupRoute (dst, toDst))
+  NS_LOG_FUNCTION (this << nextHop);
+  for (std::map<Ipv4Address, uint32_t>::iterator i = unreachable.begin (); i != unreachable.end (); )
     {
-      /*
-       * The existing entry is updated only in the following circumstances:
-       * (i) the sequence number in the routing table is marked as invalid in route table entry.
-       */
-      if (!toDst.GetValidSeqNo ())
-        {
-          m_routingTable.Update (newEntry);
-        }
-      // (ii)the Destination Sequence Number in the RREP is greater than the node's copy of the destination sequence number and the known value is valid,
-      else if ((int32_t (rrepHeader.GetDstSeqno ()) - int32_t (toDst.GetSeqNo ())) > 0)
+      RoutingTableEntry rt;
+      if (m_routingTable.LookupValidRoute (i->first, rt) && rt.GetNextHop () == nextHop && rt.SwitchToAlternatePath ())
         {
-          m_routingTable.Update (newEntry);
+          NS_LOG_DEBUG ("Route to " << i->first << " switched from " << nextHop << " to " << rt.GetNextHop ());
+          m_routingTable.Update (rt);
+          unreachable.erase (i++);
         }
       else
         {
-          // (iii) the sequence numbers are the same, but the route is marked as inactive.
-          if ((rrepHeader.GetDstSeqno () == toDst.GetSeqNo ()) && (toDst.GetFlag () != VALID))
-            {
-              m_routingTable.Update (newEntry);
-            }
-          //TODO: _____Bu kısıma minimum energy residual değerleri karşılaştırması eklenecek.
-          // (iv)  the sequence numbers are the same, and the New Hop Count is smaller than the hop count in route table entry.
-          else if ((rrepHeader.GetDstSeqno () == toDst.GetSeqNo ()) && (hop < toDst.GetHop ()))
-            {
-              m_routingTable.Update (newEntry);
-            }
+          ++i;
         }
     }
-  else
+}
+
+uint32_t
+RoutingProtocol::GetLinkCost (Ipv4Address neighbor) const
+{
+  if (m_linkMetric == HOP_COUNT_METRIC)
     {
-      // The forward route for this destination is created if it does not already exist.
-      NS_LOG_LOGIC ("add new route");
-      m_routingTable.AddRoute (newEntry);
+      // Every hop costs as much as a perfect ETX link
+      return 256;
     }
-  // Acknowledge receipt of the RREP by sending a RREP-ACK message back
-  if (rrepHeader.GetAckRequired ())
+  // Cap keeps links without measurements usable as a last resort
+  const double maxEtx = 10;
+  double forward = 0;
+  double reverse = 0;
+  m_nb.GetDeliveryRatios (neighbor, forward, reverse);
+  // Assume a symmetric link until both directions are measured
+  if (forward == 0)
+    forward = reverse;
+  if (reverse == 0)
+    reverse = forward;
+  double etx = (forward * reverse > 0) ? std::min (1 / (forward * reverse), maxEtx) : maxEtx;
+  if (m_linkMetric == ETX_METRIC)
     {
-      SendReplyAck (sender);
-      rrepHeader.SetAckRequired (false);
+      return (uint32_t) (etx * 256);
     }
-  NS_LOG_LOGIC ("receiver " << receiver << " origin " << rrepHeader.GetOrigin ());
-  if (IsMyOwnAddress (rrepHeader.GetOrigin ()))
+  uint64_t rate = m_nb.GetRate (neighbor);
+  if (rate == 0)
     {
-      if (toDst.GetFlag () == IN_SEARCH)
-        {
-          m_routingTable.Update (newEntry);
-          m_addressReqTimer[dst].Remove ();
-          m_addressReqTimer.erase (dst);
-        }
-      m_routingTable.LookupRoute (dst, toDst);
-      SendPacketFromQueue (dst, toDst.GetRoute ());
-      return;
+      // Lowest 802.11b rate until a unicast frame from the neighbor is heard
+      rate = 1000000;
     }
+  return (uint32_t) (etx * m_ettPacketSize * 8 * 1e6 / rate);
+}
 
-  RoutingTableEntry toOrigin;
-  if (!m_routingTable.LookupRoute (rrepHeader.GetOrigin (), toOrigin) || toOrigin.GetFlag () == IN_SEARCH)
-    {
-      return; // Impossible! drop.
-    }
-  toOrigin.SetLifeTime (std::max (m_activeRouteTimeout, toOrigin.GetLifeTime ()));
-  m_routingTable.Update (toOrigin);
+uint32_t
+RoutingProtocol::GetPathMetric (RreqHeader const & rreqHeader, Ipv4Address src) const
+{
+  uint32_t metric = 0;
+  if (!UsePathMetric () || !rreqHeader.GetExtension (AODVEXT_PATH_METRIC, metric))
+    return 0;
+  return (uint32_t) std::min<uint64_t> ((uint64_t) metric + GetLinkCost (src), std::numeric_limits<uint32_t>::max ());
+}
 
-  // Update information about precursors
-  if (m_routingTable.LookupValidRoute (rrepHeader.GetDst (), toDst))
-    {
-      toDst.InsertPrecursor (toOrigin.GetNextHop ());
-      m_routingTable.Update (toDst);
+uint32_t
+RoutingProtocol::GetPathMetric (RrepHeader const & rrepHeader, Ipv4Address src) const
+{
+  uint32_t metric = 0;
+  if (!UsePathMetric () || !rrepHeader.GetExtension (AODVEXT_PATH_METRIC, metric))
+    return 0;
+  return (uint32_t) std::min<uint64_t> ((uint64_t) metric + GetLinkCost (src), std::numeric_limits<uint32_t>::max ());
+}
 
-      RoutingTableEntry toNextHopToDst;
-      m_routingTable.LookupRoute (toDst.GetNextHop (), toNextHopToDst);
-      toNextHopToDst.InsertPrecursor (toOrigin.GetNextHop ());
-      m_routingTable.Update (toNextHopToDst);
+bool
+RoutingProtocol::IsCollectingReplies (Ipv4Address dst)
+{
+  std::map<Ipv4Address, Time>::iterator i = m_replyWindows.find (dst);
+  if (i == m_replyWindows.end ())
+    return false;
+  if (i->second < Simulator::Now ())
+    {
+      m_replyWindows.erase (i);
+      return false;
+    }
+  return true;
+}
 
-      toOrigin.InsertPrecursor (toDst.GetNextHop ());
-      m_routingTable.Update (toOrigin);
+bool
+RoutingProtocol::IsBetterReply (RoutingTableEntry const & newEntry, RoutingTableEntry const & toDst) const
+{
+  if (newEntry.GetPathEnergy () != toDst.GetPathEnergy ())
+    return newEntry.GetPathEnergy () > toDst.GetPathEnergy ();
+  return UsePathMetric () ? (newEntry.GetMetric () < toDst.GetMetric ()) : (newEntry.GetHop () < toDst.GetHop ());
+}
 
-      RoutingTableEntry toNextHopToOrigin;
-      m_routingTable.LookupRoute (toOrigin.GetNextHop (), toNextHopToOrigin);
-      toNextHopToOrigin.InsertPrecursor (toDst.GetNextHop ());
-      m_routingTable.Update (toNextHopToOrigin);
-    }
-  SocketIpTtlTag tag;
-  p->RemovePacketTag(tag);
-  if (tag.GetTtl () < 2)
+bool
+RoutingProtocol::IsBetterRequestCopy (RreqHeader const & rreqHeader, Ipv4Address src)
+{
+  std::map<Ipv4Address, std::pair<uint32_t, Time> >::iterator i = m_requestWindows.find (rreqHeader.GetOrigin ());
+  if (i == m_requestWindows.end ())
+    return false;
+  if (i->second.second < Simulator::Now ())
     {
-      NS_LOG_DEBUG ("TTL exceeded. Drop RREP destination " << dst << " origin " << rrepHeader.GetOrigin ());
-      return;
+      m_requestWindows.erase (i);
+      return false;
     }
+  RoutingTableEntry toOrigin;
+  if (i->second.first != rreqHeader.GetId ()
+      || !m_routingTable.LookupValidRoute (rreqHeader.GetOrigin (), toOrigin)
+      || toOrigin.GetSeqNo () != rreqHeader.GetOriginSeqno ()
+      || toOrigin.GetNextHop () == src)
+    return false;
+  // The source compares the RREP of this copy the same way
+  RoutingTableEntry copy;
+  copy.SetHop (rreqHeader.GetHopCount () + 1);
+  copy.SetPathEnergy (GetPathEnergy (rreqHeader));
+  copy.SetMetric (GetPathMetric (rreqHeader, src));
+  return IsBetterReply (copy, toOrigin);
+}
 
-  Ptr<Packet> packet = Create<Packet> ();
-  SocketIpTtlTag ttl;
-  ttl.SetTtl (tag.GetTtl() - 1);
-  packet->AddPacketTag (ttl);
-  packet->AddHeader (rrepHeader);
-  TypeHeader tHeader (AODVTYPE_RREP);
-  packet->AddHeader (tHeader);
-  Ptr<Socket> socket = FindSocketWithInterfaceAddress (toOrigin.GetInterface ());
-  NS_ASSERT (socket);
-  socket->SendTo (packet, 0, InetSocketAddress (toOrigin.GetNextHop (), AODV_EO_PORT));
+uint32_t
+RoutingProtocol::GetLoadPenalty (Ipv4Address neighbor) const
+{
+  if (!m_congestionAware)
+    return 0;
+  return (uint32_t) (m_load.GetLoad () * m_congestionWeight * GetLinkCost (neighbor));
 }
 
 void
-RoutingProtocol::RecvReplyAck (Ipv4Address neighbor)
+RoutingProtocol::LoadTimerExpire ()
 {
   NS_LOG_FUNCTION (this);
-  RoutingTableEntry rt;
-  if(m_routingTable.LookupRoute (neighbor, rt))
-    {
-      rt.m_ackTimer.Cancel ();
-      rt.SetFlag (VALID);
-      m_routingTable.Update (rt);
-    }
+  m_load.Sample (GetMacQueueOccupancy ());
+  NS_LOG_LOGIC ("Load " << m_load.GetLoad () << " busy " << m_load.GetBusyFraction ()
+                        << " flows " << m_load.GetActiveFlows ());
+  ScheduleTimer (LOAD_TIMER, Ipv4Address (), m_loadSampleInterval);
 }
 
 void
-RoutingProtocol::ProcessHello (RrepHeader const & rrepHeader, Ipv4Address receiver )
+RoutingProtocol::SetFlowRate (Ipv4Address dst, DataRate rate)
 {
-  NS_LOG_FUNCTION (this << "from " << rrepHeader.GetDst ());
+  if (rate.GetBitRate () == 0)
+    {
+      m_flowRates.erase (dst);
+    }
+  else
+    {
+      m_flowRates[dst] = rate;
+    }
+}
+
+uint64_t
+RoutingProtocol::GetFlowRate (Ipv4Address dst) const
+{
+  std::map<Ipv4Address, DataRate>::const_iterator i = m_flowRates.find (dst);
+  return (i != m_flowRates.end ()) ? i->second.GetBitRate () : m_defaultFlowRate.GetBitRate ();
+}
+
+uint64_t
+RoutingProtocol::GetAvailableBandwidth (Ipv4Address origin, Ipv4Address dst)
+{
+  double idle = m_channelCapacity.GetBitRate () * (1 - m_load.GetBusyFraction ());
+  /*
+   * Busy fraction of the last complete sample period already includes the traffic of flows admitted
+   * before it began, at most two periods ago. Only younger reservations are subtracted, except the one
+   * of the flow itself, which a new discovery may reuse.
+   */
+  Time since = Simulator::Now () - 2 * m_loadSampleInterval;
+  double reserved = m_reservations.GetReserved (since) - m_reservations.GetReservation (origin, dst, since);
+  return (idle > reserved) ? (uint64_t) (idle - reserved) : 0;
+}
+
+void
+RoutingProtocol::ApplyTxPower (Ptr<Ipv4Route> route)
+{
+  if (!m_txPowerControl)
+    return;
+  Ptr<WifiNetDevice> wifi = route->GetOutputDevice ()->GetObject<WifiNetDevice> ();
+  if (wifi == 0)
+    return;
+  Ptr<TxPowerWifiManager> manager = DynamicCast<TxPowerWifiManager> (wifi->GetRemoteStationManager ());
+  Mac48Address mac = m_nb.GetHardwareAddress (route->GetGateway ());
+  double loss = 0;
+  if (manager == 0 || mac == Mac48Address () || !m_nb.GetPathLoss (route->GetGateway (), loss))
+    return;
+  Ptr<WifiPhy> phy = wifi->GetPhy ();
+  double required = m_rxSensitivity + loss + m_txPowerMargin;
+  uint8_t level = 0;
+  if (phy->GetNTxPower () > 1)
+    {
+      double step = (phy->GetTxPowerEnd () - phy->GetTxPowerStart ()) / (phy->GetNTxPower () - 1);
+      double steps = (step > 0) ? std::ceil ((required - phy->GetTxPowerStart ()) / step) : 0;
+      level = (uint8_t) std::min<double> (std::max<double> (steps, 0), phy->GetNTxPower () - 1);
+    }
+  if (manager->GetStationTxPowerLevel (mac) != level)
+    {
+      NS_LOG_LOGIC ("TX power level " << (uint16_t) level << " for " << route->GetGateway () << ", path loss " << loss << " dB");
+      manager->SetStationTxPowerLevel (mac, level);
+    }
+}
+
+double
+RoutingProtocol::GetMacQueueOccupancy () const
+{
+  double occupancy = 0;
+  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j =
+         m_socketAddresses.begin (); j != m_socketAddresses.end (); ++j)
+    {
+      int32_t interface = m_ipv4->GetInterfaceForAddress (j->second.GetLocal ());
+      Ptr<WifiNetDevice> wifi = m_ipv4->GetNetDevice (interface)->GetObject<WifiNetDevice> ();
+      if (wifi == 0 || wifi->GetMac () == 0)
+        continue;
+      // Non-QoS MACs queue everything in their DCF queue
+      PointerValue dca;
+      if (!wifi->GetMac ()->GetAttributeFailSafe ("DcaTxop", dca) || dca.Get<Object> () == 0)
+        continue;
+      PointerValue queue;
+      dca.Get<Object> ()->GetAttribute ("Queue", queue);
+      Ptr<WifiMacQueue> q = queue.Get<WifiMacQueue> ();
+      if (q != 0 && q->GetMaxSize () > 0)
+        {
+          occupancy = std::max (occupancy, (double) q->GetSize () / q->GetMaxSize ());
+        }
+    }
+  return occupancy;
+}
+
+bool
+RoutingProtocol::IsBetterRequest (RreqHeader const & rreqHeader, Ipv4Address src)
+{
+  RoutingTableEntry toOrigin;
+  if (IsMyOwnAddress (rreqHeader.GetOrigin ())
+      || !m_routingTable.LookupValidRoute (rreqHeader.GetOrigin (), toOrigin)
+      || toOrigin.GetSeqNo () != rreqHeader.GetOriginSeqno ()
+      || toOrigin.GetNextHop () == src)
+    return false;
+  uint32_t metric = 0;
+  if (!rreqHeader.GetExtension (AODVEXT_PATH_METRIC, metric))
+    return false;
+  return GetPathMetric (rreqHeader, src) < toOrigin.GetMetric ();
+}
+
+Ptr<Ipv4Route>
+RoutingProtocol::SelectRoute (RoutingTableEntry const & rt)
+{
+  if (!m_energyBalancing)
+    return rt.GetRoute ();
+  return rt.GetBalancedRoute (m_uniformRandomVariable->GetValue (0, 1));
+}
+
+bool
+RoutingProtocol::GetRemainingEnergy (double & remaining, double & initial) const
+{
+  remaining = 0;
+  initial = 0;
+  Ptr<EnergySourceContainer> sources = m_ipv4->GetObject<EnergySourceContainer> ();
+  if (sources == 0 || sources->GetN () == 0)
+    return false;
+  for (EnergySourceContainer::Iterator i = sources->Begin (); i != sources->End (); ++i)
+    {
+      remaining += (*i)->GetRemainingEnergy ();
+      initial += (*i)->GetInitialEnergy ();
+    }
+  return true;
+}
+
+uint32_t
+RoutingProtocol::GetResidualEnergy () const
+{
+  double remaining;
+  double initial;
+  if (!GetRemainingEnergy (remaining, initial))
+    return std::numeric_limits<uint32_t>::max ();
+  // Keep maximum value for nodes without energy source
+  return (uint32_t) std::min (remaining * 1000, std::numeric_limits<uint32_t>::max () - 1.0);
+}
+
+void
+RoutingProtocol::SetupEnergyAccounting ()
+{
+  Ptr<EnergySourceContainer> sources = m_ipv4->GetObject<EnergySourceContainer> ();
+  if (sources == 0)
+    return;
+  for (EnergySourceContainer::Iterator i = sources->Begin (); i != sources->End (); ++i)
+    {
+      DeviceEnergyModelContainer models = (*i)->FindDeviceEnergyModels ("ns3::WifiRadioEnergyModel");
+      if (models.GetN () == 0)
+        continue;
+      DoubleValue tx;
+      DoubleValue rx;
+      models.Get (0)->GetAttribute ("TxCurrentA", tx);
+      models.Get (0)->GetAttribute ("RxCurrentA", rx);
+      m_energyAccounting.SetRadio (tx.Get (), rx.Get (), (*i)->GetSupplyVoltage ());
+      return;
+    }
+  NS_LOG_LOGIC ("No WifiRadioEnergyModel, energy accounting uses its default currents");
+}
+
+void
+RoutingProtocol::FindEnergyModels ()
+{
+  m_energyModels.clear ();
+  Ptr<EnergySourceContainer> sources = m_ipv4->GetObject<EnergySourceContainer> ();
+  if (sources == 0)
+    return;
+  // Energy sources only look device energy models up by exact type
+  for (uint32_t t = 0; t < TypeId::GetRegisteredN (); ++t)
+    {
+      TypeId tid = TypeId::GetRegistered (t);
+      if (tid == DeviceEnergyModel::GetTypeId () || !tid.IsChildOf (DeviceEnergyModel::GetTypeId ()))
+        continue;
+      for (EnergySourceContainer::Iterator i = sources->Begin (); i != sources->End (); ++i)
+        {
+          DeviceEnergyModelContainer models = (*i)->FindDeviceEnergyModels (tid);
+          for (DeviceEnergyModelContainer::Iterator m = models.Begin (); m != models.End (); ++m)
+            {
+              m_energyModels.push_back (*m);
+            }
+        }
+    }
+  NS_LOG_LOGIC ("Found " << m_energyModels.size () << " device energy models");
+}
+
+uint32_t
+RoutingProtocol::GetNodeEnergy ()
+{
+  if (!m_harvestingAware)
+    return GetResidualEnergy ();
+  double remaining;
+  double initial;
+  if (!GetRemainingEnergy (remaining, initial))
+    return std::numeric_limits<uint32_t>::max ();
+  double consumed = 0;
+  for (std::vector<Ptr<DeviceEnergyModel> >::const_iterator i = m_energyModels.begin (); i != m_energyModels.end (); ++i)
+    {
+      consumed += (*i)->GetTotalEnergyConsumption ();
+    }
+  m_energyPredictor.Update (remaining, consumed);
+  NS_LOG_LOGIC ("Harvesting " << m_energyPredictor.GetHarvestRate () << " W, drain " << m_energyPredictor.GetDrainRate () << " W");
+  // Keep maximum value for nodes without energy source
+  return (uint32_t) std::min (m_energyPredictor.GetTimeToDepletion ().GetSeconds (), std::numeric_limits<uint32_t>::max () - 1.0);
+}
+
+double
+RoutingProtocol::GetEnergyFraction () const
+{
+  double remaining;
+  double initial;
+  if (!GetRemainingEnergy (remaining, initial))
+    return 1;
+  return (initial > 0) ? remaining / initial : 1;
+}
+
+void
+RoutingProtocol::RemainingEnergyChanged (double oldValue, double newValue)
+{
+  UpdateWithdrawal (GetEnergyFraction ());
+}
+
+void
+RoutingProtocol::UpdateWithdrawal (double energyFraction)
+{
+  if (!m_withdrawn && energyFraction < m_withdrawalThreshold)
+    {
+      WithdrawFromRelaying ();
+    }
+  else if (m_withdrawn && energyFraction >= m_withdrawalThreshold + m_rejoinMargin)
+    {
+      NS_LOG_LOGIC ("Energy recovered, relay again");
+      m_withdrawn = false;
+    }
+}
+
+void
+RoutingProtocol::WithdrawFromRelaying ()
+{
+  NS_LOG_FUNCTION (this);
+  m_withdrawn = true;
+  std::map<Ipv4Address, uint32_t> relayed;
+  std::vector<Ipv4Address> precursors;
+  m_routingTable.GetListOfRelayedDestinations (relayed, precursors);
+  NS_LOG_LOGIC ("Low energy, withdraw from " << relayed.size () << " relayed routes");
+  if (relayed.empty ())
+    return;
+  SendRerrForUnreachable (relayed, precursors);
+  m_routingTable.InvalidateRoutesWithDst (relayed);
+}
+
+void
+RoutingProtocol::DutyCycleTimerExpire ()
+{
+  NS_LOG_FUNCTION (this);
+  Time now = Simulator::Now ();
+  // Listen windows start at multiples of the wake interval, so all nodes share them
+  Time phase = TimeStep (now.GetTimeStep () % m_wakeInterval.GetTimeStep ());
+  if (phase < m_listenWindow)
+    {
+      SetRadiosAsleep (false);
+      if (m_helloPending)
+        {
+          m_helloPending = false;
+          SendHello ();
+        }
+      ScheduleTimer (DUTY_CYCLE_TIMER, Ipv4Address (), m_listenWindow - phase);
+      return;
+    }
+  Time next = m_wakeInterval - phase;
+  if (CanSleep ())
+    {
+      SetRadiosAsleep (true);
+    }
+  else if (m_awakeUntil > now)
+    {
+      // Try again when the node is no longer kept awake
+      next = std::min (next, m_awakeUntil - now);
+    }
+  ScheduleTimer (DUTY_CYCLE_TIMER, Ipv4Address (), next);
+}
+
+bool
+RoutingProtocol::CanSleep ()
+{
+  if (Simulator::Now () < m_awakeUntil || m_queue.GetSize () > 0 || m_repairQueue.GetSize () > 0)
+    return false;
+  // Next hop or precursor of a valid route
+  std::map<Ipv4Address, uint32_t> relayed;
+  std::vector<Ipv4Address> precursors;
+  m_routingTable.GetListOfRelayedDestinations (relayed, precursors);
+  return relayed.empty ();
+}
+
+void
+RoutingProtocol::KeepAwake (Time duration)
+{
+  m_awakeUntil = std::max (m_awakeUntil, Simulator::Now () + duration);
+  if (m_asleep)
+    {
+      SetRadiosAsleep (false);
+    }
+}
+
+void
+RoutingProtocol::SetRadiosAsleep (bool asleep)
+{
+  if (asleep == m_asleep)
+    return;
+  NS_LOG_LOGIC ((asleep ? "Sleep" : "Wake up"));
+  m_asleep = asleep;
+  for (std::map<Ptr<Socket>, Ipv4InterfaceAddress>::const_iterator j =
+         m_socketAddresses.begin (); j != m_socketAddresses.end (); ++j)
+    {
+      int32_t interface = m_ipv4->GetInterfaceForAddress (j->second.GetLocal ());
+      Ptr<WifiNetDevice> wifi = m_ipv4->GetNetDevice (interface)->GetObject<WifiNetDevice> ();
+      if (wifi == 0 || wifi->GetPhy () == 0)
+        continue;
+      if (asleep)
+        {
+          wifi->GetPhy ()->SetSleepMode ();
+        }
+      else
+        {
+          wifi->GetPhy ()->ResumeFromSleep ();
+        }
+    }
+}
+
+Time
+RoutingProtocol::AlignToListenWindow (Time delay)
+{
+  if (!m_dutyCycle)
+    return delay;
+  Time phase = TimeStep ((Simulator::Now () + delay).GetTimeStep () % m_wakeInterval.GetTimeStep ());
+  // Keep half a window for the frame to be received by sleeping nodes
+  Time half = TimeStep (m_listenWindow.GetTimeStep () / 2);
+  if (phase < half)
+    return delay;
+  Time jitter = MicroSeconds (m_uniformRandomVariable->GetInteger (0, half.GetMicroSeconds ()));
+  return delay + (m_wakeInterval - phase) + jitter;
+}
+
+void
+RoutingProtocol::HandleEnergyDepletion ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_depleted)
+    return;
+  if (m_depletionRerr)
+    {
+      // Best effort: the radio may already be off, in which case the RERR is lost. Nothing is sent
+      // once the node is depleted, so it bypasses aggregation, rate limit and jitter.
+      std::map<Ipv4Address, uint32_t> relayed;
+      std::vector<Ipv4Address> precursors;
+      m_routingTable.GetListOfRelayedDestinations (relayed, precursors);
+      if (!relayed.empty ())
+        {
+          SendRerrMessages (relayed, precursors, false, true);
+          m_routingTable.InvalidateRoutesWithDst (relayed);
+        }
+    }
+  m_depleted = true;
+  NS_LOG_LOGIC ("Energy depleted, drop " << m_queue.GetSize () + m_repairQueue.GetSize () << " buffered packets");
+  m_queue.DropAllPackets ();
+  m_repairQueue.DropAllPackets ();
+
+  m_htimer.Cancel ();
+  m_rreqRateLimitTimer.Cancel ();
+  m_rerrRateLimitTimer.Cancel ();
+  m_rerrAggregationTimer.Cancel ();
+  m_loadTimer.Cancel ();
+  m_dutyCycleTimer.Cancel ();
+  for (std::map<Ipv4Address, Timer>::iterator i = m_addressReqTimer.begin (); i != m_addressReqTimer.end (); ++i)
+    {
+      i->second.Remove ();
+    }
+  m_addressReqTimer.clear ();
+  m_deadlines.Clear ();
+  m_nb.CancelTimer ();
+
+  m_pendingRreq.clear ();
+  m_pendingRerr.clear ();
+  m_rerrAggregates.clear ();
+  m_localRepairs.clear ();
+  m_replyWindows.clear ();
+  m_requestWindows.clear ();
+  // Jittered sends and delayed RREQs still scheduled find the node depleted
+  m_bundles.clear ();
+}
+
+void
+RoutingProtocol::HandleEnergyRecharged ()
+{
+  NS_LOG_FUNCTION (this);
+  if (!m_depleted)
+    return;
+  m_depleted = false;
+  if (m_enableHello)
+    {
+      m_nb.ScheduleTimer ();
+      ScheduleTimer (HELLO_TIMER, Ipv4Address (), MilliSeconds (m_uniformRandomVariable->GetInteger (0, 100)));
+    }
+  if (UseLoadMonitor ())
+    {
+      m_load.Clear ();
+      ScheduleTimer (LOAD_TIMER, Ipv4Address (), m_loadSampleInterval);
+    }
+  if (m_dutyCycle)
+    {
+      DutyCycleTimerExpire ();
+    }
+}
+
+void
+RoutingProtocol::SendReply (RreqHeader const & rreqHeader, RoutingTableEntry const & toOrigin)
+{
+  NS_LOG_FUNCTION (this << toOrigin.GetDestination ());
+  /*
+   * Destination node MUST increment its own sequence number by one if the sequence number in the RREQ packet is equal to that
+   * incremented value. Otherwise, the destination does not change its sequence number before generating the  RREP message.
+   */
+  if (!rreqHeader.GetUnknownSeqno () && (rreqHeader.GetDstSeqno () == m_seqNo + 1))
+    IncrementSeqNo ();
+  RrepHeader rrepHeader ( /*prefixSize=*/ 0, /*hops=*/ 0, /*dst=*/ rreqHeader.GetDst (),
+                                          /*dstSeqNo=*/ m_seqNo, /*origin=*/ toOrigin.GetDestination (), /*lifeTime=*/ m_myRouteTimeout);
+  if (UsePathEnergy ())
+    rrepHeader.SetExtension (GetEnergyExtension (), GetNodeEnergy ());
+  if (UsePathMetric ())
+    rrepHeader.SetExtension (AODVEXT_PATH_METRIC, 0);
+  uint32_t rate = 0;
+  if (rreqHeader.GetExtension (AODVEXT_BANDWIDTH, rate))
+    rrepHeader.SetExtension (AODVEXT_BANDWIDTH, rate);
+  if (m_dutyCycle)
+    {
+      // Stay awake for the data which follows the RREP
+      KeepAwake (m_activeRouteTimeout);
+    }
+  Ptr<Packet> packet = Create<Packet> ();
+  SocketIpTtlTag tag;
+  tag.SetTtl (toOrigin.GetHop ());
+  packet->AddPacketTag (tag);
+  packet->AddHeader (RrepMessage (rrepHeader));
+  Ptr<Socket> socket = FindSocketWithInterfaceAddress (toOrigin.GetInterface ());
+  NS_ASSERT (socket);
+  SendTo (socket, packet, toOrigin.GetNextHop ());
+}
+
+void
+RoutingProtocol::SendReplyByIntermediateNode (RoutingTableEntry & toDst, RoutingTableEntry & toOrigin, bool gratRep)
+{
+  NS_LOG_FUNCTION (this);
+  RrepHeader rrepHeader (/*prefix size=*/ 0, /*hops=*/ toDst.GetHop (), /*dst=*/ toDst.GetDestination (), /*dst seqno=*/ toDst.GetSeqNo (),
+                                          /*origin=*/ toOrigin.GetDestination (), /*lifetime=*/ toDst.GetLifeTime ());
+  if (UsePathEnergy ())
+    {
+      // The next hop's hellos may be fresher than the path energy learned in route discovery
+      uint32_t energy = std::min (toDst.GetPathEnergy (), m_nb.GetEnergy (toDst.GetNextHop ()));
+      rrepHeader.SetExtension (GetEnergyExtension (), std::min (energy, GetNodeEnergy ()));
+    }
+  if (UsePathMetric ())
+    rrepHeader.SetExtension (AODVEXT_PATH_METRIC, (uint32_t) std::min<uint64_t> ((uint64_t) toDst.GetMetric () + GetLoadPenalty (toDst.GetNextHop ()),
+                                                                               std::numeric_limits<uint32_t>::max ()));
+  /* If the node we received a RREQ for is a neighbor we are
+   * probably facing a unidirectional link... Better request a RREP-ack
+   */
+  if (toDst.GetHop () == 1)
+    {
+      rrepHeader.SetAckRequired (true);
+      // The RREP-ACK timer is kept with the other protocol timers, not in the routing table entry
+      ScheduleTimer (RREP_ACK_TIMER, toOrigin.GetNextHop (), m_nextHopWait);
+    }
+  toDst.InsertPrecursor (toOrigin.GetNextHop ());
+  toOrigin.InsertPrecursor (toDst.GetNextHop ());
+  m_routingTable.Update (toDst);
+  m_routingTable.Update (toOrigin);
+  if (m_dutyCycle)
+    {
+      // Stay awake for the data which follows the RREP
+      KeepAwake (m_activeRouteTimeout);
+    }
+
+  Ptr<Packet> packet = Create<Packet> ();
+  SocketIpTtlTag tag;
+  tag.SetTtl (toOrigin.GetHop ());
+  packet->AddPacketTag (tag);
+  packet->AddHeader (RrepMessage (rrepHeader));
+  Ptr<Socket> socket = FindSocketWithInterfaceAddress (toOrigin.GetInterface ());
+  NS_ASSERT (socket);
+  SendTo (socket, packet, toOrigin.GetNextHop ());
+
+  // Generating gratuitous RREPs
+  if (gratRep)
+    {
+      RrepHeader gratRepHeader (/*prefix size=*/ 0, /*hops=*/ toOrigin.GetHop (), /*dst=*/ toOrigin.GetDestination (),
+                                                 /*dst seqno=*/ toOrigin.GetSeqNo (), /*origin=*/ toDst.GetDestination (),
+                                                 /*lifetime=*/ toOrigin.GetLifeTime ());
+      Ptr<Packet> packetToDst = Create<Packet> ();
+      SocketIpTtlTag gratTag;
+      gratTag.SetTtl (toDst.GetHop ());
+      packetToDst->AddPacketTag (gratTag);
+      packetToDst->AddHeader (RrepMessage (gratRepHeader));
+      Ptr<Socket> socket = FindSocketWithInterfaceAddress (toDst.GetInterface ());
+      NS_ASSERT (socket);
+      NS_LOG_LOGIC ("Send gratuitous RREP " << packet->GetUid ());
+      SendTo (socket, packetToDst, toDst.GetNextHop ());
+    }
+}
+
+void
+RoutingProtocol::SendReplyAck (Ipv4Address neighbor)
+{
+  NS_LOG_FUNCTION (this << " to " << neighbor);
+  if (m_rrepAckTemplate == 0)
+    {
+      m_rrepAckTemplate = Create<Packet> ();
+      m_rrepAckTemplate->AddHeader (RrepAckMessage ());
+      SocketIpTtlTag tag;
+      tag.SetTtl (1);
+      m_rrepAckTemplate->AddPacketTag (tag);
+    }
+  // Unicast, so sharing the UID of the template is harmless; the copy shares buffer and tags
+  Ptr<Packet> packet = m_rrepAckTemplate->Copy ();
+  RoutingTableEntry toNeighbor;
+  m_routingTable.LookupRoute (neighbor, toNeighbor);
+  Ptr<Socket> socket = FindSocketWithInterfaceAddress (toNeighbor.GetInterface ());
+  NS_ASSERT (socket);
+  SendTo (socket, packet, neighbor);
+}
+
+void
+RoutingProtocol::RecvReply (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address sender)
+{
+  NS_LOG_FUNCTION (this << " src " << sender);
+  RrepMessage message;
+  p->RemoveHeader (message);
+  if (!message.IsValid ())
+    {
+      NS_LOG_DEBUG ("Truncated RREP " << p->GetUid () << ". Drop");
+      return; // drop
+    }
+  RrepHeader & rrepHeader = message.GetMessage ();
+  Ipv4Address dst = rrepHeader.GetDst ();
+  NS_LOG_LOGIC ("RREP destination " << dst << " RREP origin " << rrepHeader.GetOrigin ());
+
+  uint8_t hop = rrepHeader.GetHopCount () + 1;
+  rrepHeader.SetHopCount (hop);
+
+  // If RREP is Hello message
+  if (dst == rrepHeader.GetOrigin ())
+    {
+      ProcessHello (rrepHeader, receiver);
+      return;
+    }
+
+  /*
+   * If the route table entry to the destination is created or updated, then the following actions occur:
+   * -  the route is marked as active,
+   * -  the destination sequence number is marked as valid,
+   * -  the next hop in the route entry is assigned to be the node from which the RREP is received,
+   *    which is indicated by the source IP address field in the IP header,
+   * -  the hop count is set to the value of the hop count from RREP message + 1
+   * -  the expiry time is set to the current time plus the value of the Lifetime in the RREP message,
+   * -  and the destination sequence number is the Destination Sequence Number in the RREP message.
+   */
+  Ptr<NetDevice> dev = m_ipv4->GetNetDevice (m_ipv4->GetInterfaceForAddress (receiver));
+  RoutingTableEntry newEntry (/*device=*/ dev, /*dst=*/ dst, /*validSeqNo=*/ true, /*seqno=*/ rrepHeader.GetDstSeqno (),
+                                          /*iface=*/ m_ipv4->GetAddress (m_ipv4->GetInterfaceForAddress (receiver), 0),/*hop=*/ hop,
+                                          /*nextHop=*/ sender, /*lifeTime=*/ rrepHeader.GetLifeTime ());
+  newEntry.SetPathEnergy (GetPathEnergy (rrepHeader));
+  uint32_t metric = GetPathMetric (rrepHeader, sender);
+  newEntry.SetMetric (metric);
+  RoutingTableEntry toDst;
+  if (m_routingTable.LookupRoute (dst, toDst))
+    {
+      /*
+       * The existing entry is updated only in the following circumstances:
+       * (i) the sequence number in the routing table is marked as invalid in route table entry.
+       */
+      if (!toDst.GetValidSeqNo ())
+        {
+          m_routingTable.Update (newEntry);
+        }
+      // (ii)the Destination Sequence Number in the RREP is greater than the node's copy of the destination sequence number and the known value is valid,
+      else if ((int32_t (rrepHeader.GetDstSeqno ()) - int32_t (toDst.GetSeqNo ())) > 0)
+        {
+          m_routingTable.Update (newEntry);
+        }
+      else
+        {
+          // (iii) the sequence numbers are the same, but the route is marked as inactive.
+          if ((rrepHeader.GetDstSeqno () == toDst.GetSeqNo ()) && (toDst.GetFlag () != VALID))
+            {
+              m_routingTable.Update (newEntry);
+            }
+          // (iv)  the sequence numbers are the same, and the New Hop Count is smaller than the hop count in route table entry.
+          // With ETX or ETT the path metric is compared instead of the hop count. While the source collects
+          // RREPs of its route discovery, path residual energy is compared first.
+          else if ((rrepHeader.GetDstSeqno () == toDst.GetSeqNo ())
+                   && ((IsMyOwnAddress (rrepHeader.GetOrigin ()) && IsCollectingReplies (dst))
+                       ? IsBetterReply (newEntry, toDst)
+                       : (UsePathMetric () ? (metric < toDst.GetMetric ()) : (hop < toDst.GetHop ()))))
+            {
+              NS_LOG_LOGIC ("Switch route to " << dst << " to next hop " << sender);
+              m_routingTable.Update (newEntry);
+            }
+          // Fresh energy report for the primary path
+          else if ((rrepHeader.GetDstSeqno () == toDst.GetSeqNo ()) && (sender == toDst.GetNextHop ()))
+            {
+              toDst.SetPathEnergy (GetPathEnergy (rrepHeader));
+              m_routingTable.Update (toDst);
+            }
+          // Otherwise the RREP may still offer an alternate path
+          else if (m_enableMultipath && (rrepHeader.GetDstSeqno () == toDst.GetSeqNo ()))
+            {
+              AddAlternatePath (dst, rrepHeader.GetDstSeqno (), sender, hop, receiver, rrepHeader.GetLifeTime (),
+                                GetPathEnergy (rrepHeader));
+            }
+        }
+    }
+  else
+    {
+      // The forward route for this destination is created if it does not already exist.
+      NS_LOG_LOGIC ("add new route");
+      m_routingTable.AddRoute (newEntry);
+    }
+  // Acknowledge receipt of the RREP by sending a RREP-ACK message back
+  if (rrepHeader.GetAckRequired ())
+    {
+      SendReplyAck (sender);
+      rrepHeader.SetAckRequired (false);
+    }
+  NS_LOG_LOGIC ("receiver " << receiver << " origin " << rrepHeader.GetOrigin ());
+  if (IsMyOwnAddress (rrepHeader.GetOrigin ()))
+    {
+      if (toDst.GetFlag () == IN_SEARCH)
+        {
+          m_routingTable.Update (newEntry);
+          CancelTimer (RREQ_RETRY_TIMER, dst);
+          // Route is used at once, later RREPs of the same discovery may still replace it
+          if (m_replyCollectionWindow > Seconds (0))
+            {
+              m_replyWindows[dst] = Simulator::Now () + m_replyCollectionWindow;
+            }
+        }
+      m_routingTable.LookupRoute (dst, toDst);
+      if (toDst.GetFlag () == VALID && m_localRepairs.find (dst) != m_localRepairs.end ())
+        {
+          FinishLocalRepair (dst);
+        }
+      SendPacketFromQueue (dst, toDst.GetRoute ());
+      return;
+    }
+
+  RoutingTableEntry toOrigin;
+  if (!m_routingTable.LookupRoute (rrepHeader.GetOrigin (), toOrigin) || toOrigin.GetFlag () == IN_SEARCH)
+    {
+      return; // Impossible! drop.
+    }
+  toOrigin.SetLifeTime (std::max (m_activeRouteTimeout, toOrigin.GetLifeTime ()));
+  m_routingTable.Update (toOrigin);
+
+  // Update information about precursors
+  if (m_routingTable.LookupValidRoute (rrepHeader.GetDst (), toDst))
+    {
+      toDst.InsertPrecursor (toOrigin.GetNextHop ());
+      m_routingTable.Update (toDst);
+
+      RoutingTableEntry toNextHopToDst;
+      m_routingTable.LookupRoute (toDst.GetNextHop (), toNextHopToDst);
+      toNextHopToDst.InsertPrecursor (toOrigin.GetNextHop ());
+      m_routingTable.Update (toNextHopToDst);
+
+      toOrigin.InsertPrecursor (toDst.GetNextHop ());
+      m_routingTable.Update (toOrigin);
+
+      RoutingTableEntry toNextHopToOrigin;
+      m_routingTable.LookupRoute (toOrigin.GetNextHop (), toNextHopToOrigin);
+      toNextHopToOrigin.InsertPrecursor (toDst.GetNextHop ());
+      m_routingTable.Update (toNextHopToOrigin);
+    }
+  SocketIpTtlTag tag;
+  p->RemovePacketTag(tag);
+  if (tag.GetTtl () < 2)
+    {
+      NS_LOG_DEBUG ("TTL exceeded. Drop RREP destination " << dst << " origin " << rrepHeader.GetOrigin ());
+      return;
+    }
+
+  uint32_t rate = 0;
+  if (m_admissionControl && rrepHeader.GetExtension (AODVEXT_BANDWIDTH, rate))
+    {
+      // Reservation lives as long as an unused route
+      m_reservations.Reserve (rrepHeader.GetOrigin (), dst, (uint64_t) rate * 1000, m_activeRouteTimeout);
+    }
+  if (UsePathEnergy ())
+    {
+      rrepHeader.SetExtension (GetEnergyExtension (), std::min (GetPathEnergy (rrepHeader), GetNodeEnergy ()));
+    }
+  if (UsePathMetric ())
+    {
+      rrepHeader.SetExtension (AODVEXT_PATH_METRIC, (uint32_t) std::min<uint64_t> ((uint64_t) metric + GetLoadPenalty (sender),
+                                                                                 std::numeric_limits<uint32_t>::max ()));
+    }
+  Ptr<Packet> packet = Create<Packet> ();
+  SocketIpTtlTag ttl;
+  ttl.SetTtl (tag.GetTtl() - 1);
+  packet->AddPacketTag (ttl);
+  packet->AddHeader (RrepMessage (rrepHeader));
+  Ptr<Socket> socket = FindSocketWithInterfaceAddress (toOrigin.GetInterface ());
+  NS_ASSERT (socket);
+  SendTo (socket, packet, toOrigin.GetNextHop ());
+}
+
+void
+RoutingProtocol::RecvReplyAck (Ipv4Address neighbor)
+{
+  NS_LOG_FUNCTION (this);
+  RoutingTableEntry rt;
+  if(m_routingTable.LookupRoute (neighbor, rt))
+    {
+      CancelTimer (RREP_ACK_TIMER, neighbor);
+      rt.SetFlag (VALID);
+      m_routingTable.Update (rt);
+    }
+}
+
+void
+RoutingProtocol::ProcessHello (RrepHeader const & rrepHeader, Ipv4Address receiver )
+{
+  NS_LOG_FUNCTION (this << "from " << rrepHeader.GetDst ());
   /*
    *  Whenever a node receives a Hello message from a neighbor, the node
    * SHOULD make sure that it has an active route to the neighbor, and
@@ -1613,6 +3057,7 @@ RoutingProtocol::ProcessHello (RrepHeader const & rrepHeader, Ipv4Address receiv
       RoutingTableEntry newEntry (/*device=*/ dev, /*dst=*/ rrepHeader.GetDst (), /*validSeqNo=*/ true, /*seqno=*/ rrepHeader.GetDstSeqno (),
                                               /*iface=*/ m_ipv4->GetAddress (m_ipv4->GetInterfaceForAddress (receiver), 0),
                                               /*hop=*/ 1, /*nextHop=*/ rrepHeader.GetDst (), /*lifeTime=*/ rrepHeader.GetLifeTime ());
+      newEntry.SetPathEnergy (GetPathEnergy (rrepHeader));
       m_routingTable.AddRoute (newEntry);
     }
   else
@@ -1625,11 +3070,23 @@ RoutingProtocol::ProcessHello (RrepHeader const & rrepHeader, Ipv4Address receiv
       toNeighbor.SetInterface (m_ipv4->GetAddress (m_ipv4->GetInterfaceForAddress (receiver), 0));
       toNeighbor.SetHop (1);
       toNeighbor.SetNextHop (rrepHeader.GetDst ());
+      uint32_t energy = 0;
+      if (rrepHeader.GetExtension (GetEnergyExtension (), energy))
+        toNeighbor.SetPathEnergy (energy);
       m_routingTable.Update (toNeighbor);
     }
   if (m_enableHello)
     {
       m_nb.Update (rrepHeader.GetDst (), Time (m_allowedHelloLoss * m_helloInterval));
+      m_nb.SetEnergy (rrepHeader.GetDst (), GetPathEnergy (rrepHeader));
+      if (m_linkMetric != HOP_COUNT_METRIC)
+        {
+          m_nb.RecordHello (rrepHeader.GetDst ());
+          // Neighbor doesn't list us if it hasn't heard our hellos
+          uint8_t ratio = 0;
+          rrepHeader.GetLinkQuality (receiver, ratio);
+          m_nb.SetForwardRatio (rrepHeader.GetDst (), ratio);
+        }
     }
 }
 
@@ -1637,58 +3094,68 @@ void
 RoutingProtocol::RecvError (Ptr<Packet> p, Ipv4Address src )
 {
   NS_LOG_FUNCTION (this << " from " << src);
-  RerrHeader rerrHeader;
-  p->RemoveHeader (rerrHeader);
+  RerrMessage message;
+  p->RemoveHeader (message);
+  if (!message.IsValid ())
+    {
+      NS_LOG_DEBUG ("Truncated RERR " << p->GetUid () << ". Drop");
+      return; // drop
+    }
+  RerrHeader & rerrHeader = message.GetMessage ();
   std::map<Ipv4Address, uint32_t> dstWithNextHopSrc;
   std::map<Ipv4Address, uint32_t> unreachable;
   m_routingTable.GetListOfDestinationWithNextHop (src, dstWithNextHopSrc);
-  std::pair<Ipv4Address, uint32_t> un;
-  while (rerrHeader.RemoveUnDestination (un))
+  for (RerrHeader::Iterator un = rerrHeader.Begin (); un != rerrHeader.End (); ++un)
     {
-      for (std::map<Ipv4Address, uint32_t>::const_iterator i =
-           dstWithNextHopSrc.begin (); i != dstWithNextHopSrc.end (); ++i)
-      {
-        if (i->first == un.first)
-          {
-            unreachable.insert (un);
-          }
-      }
+      RoutingTableEntry toDst;
+      if (m_enableMultipath && m_routingTable.LookupRoute (un->first, toDst) && toDst.DeleteAlternatePath (src))
+        {
+          m_routingTable.Update (toDst);
+        }
+      if (dstWithNextHopSrc.find (un->first) != dstWithNextHopSrc.end ())
+        {
+          // Destinations come in increasing order, so they are appended
+          unreachable.insert (unreachable.end (), *un);
+        }
     }
 
+  if (m_enableMultipath && !rerrHeader.GetNoDelete ())
+    {
+      FailoverToAlternatePaths (src, unreachable);
+    }
   std::vector<Ipv4Address> precursors;
   for (std::map<Ipv4Address, uint32_t>::const_iterator i = unreachable.begin ();
-       i != unreachable.end ();)
+       i != unreachable.end (); ++i)
+    {
+      RoutingTableEntry toDst;
+      m_routingTable.LookupRoute (i->first, toDst);
+      toDst.GetPrecursors (precursors);
+    }
+  if (rerrHeader.GetNoDelete ())
     {
-      if (!rerrHeader.AddUnDestination (i->first, i->second))
+      // The route was repaired downstream or is about to break, it remains valid. Just let upstream nodes know.
+      NS_LOG_LOGIC ("RERR with N flag from " << src << ", routes are kept");
+      if (m_enablePreemptive)
         {
-          TypeHeader typeHeader (AODVTYPE_RERR);
-          Ptr<Packet> packet = Create<Packet> ();
-          SocketIpTtlTag tag;
-          tag.SetTtl (1);
-          packet->AddPacketTag (tag);
-          packet->AddHeader (rerrHeader);
-          packet->AddHeader (typeHeader);
-          SendRerrMessage (packet, precursors);
-          rerrHeader.Clear ();
+          // Sources of the routes look for a better one
+          for (std::map<Ipv4Address, uint32_t>::const_iterator i = unreachable.begin (); i != unreachable.end (); ++i)
+            {
+              RoutingTableEntry toDst;
+              if (m_routingTable.LookupValidRoute (i->first, toDst) && toDst.IsPrecursorListEmpty ())
+                {
+                  SendPreemptiveRequest (i->first);
+                }
+            }
         }
-      else
+      if (!unreachable.empty ())
         {
-          RoutingTableEntry toDst;
-          m_routingTable.LookupRoute (i->first, toDst);
-          toDst.GetPrecursors (precursors);
-          ++i;
+          SendRerrMessages (unreachable, precursors, true);
         }
+      return;
     }
-  if (rerrHeader.GetDestCount () != 0)
+  if (!unreachable.empty ())
     {
-      TypeHeader typeHeader (AODVTYPE_RERR);
-      Ptr<Packet> packet = Create<Packet> ();
-      SocketIpTtlTag tag;
-      tag.SetTtl (1);
-      packet->AddPacketTag (tag);
-      packet->AddHeader (rerrHeader);
-      packet->AddHeader (typeHeader);
-      SendRerrMessage (packet, precursors);
+      SendRerrForUnreachable (unreachable, precursors);
     }
   m_routingTable.InvalidateRoutesWithDst (unreachable);
 }
@@ -1698,6 +3165,19 @@ RoutingProtocol::RouteRequestTimerExpire (Ipv4Address dst)
 {
   NS_LOG_LOGIC (this);
   RoutingTableEntry toDst;
+  if (m_localRepairs.find (dst) != m_localRepairs.end ())
+    {
+      // Local repair RREQ is never retried
+      if (m_routingTable.LookupValidRoute (dst, toDst))
+        {
+          FinishLocalRepair (dst);
+        }
+      else
+        {
+          LocalRepairFailed (dst);
+        }
+      return;
+    }
   if (m_routingTable.LookupValidRoute (dst, toDst))
     {
       SendPacketFromQueue (dst, toDst.GetRoute ());
@@ -1712,68 +3192,320 @@ RoutingProtocol::RouteRequestTimerExpire (Ipv4Address dst)
   if (toDst.GetRreqCnt () == m_rreqRetries)
     {
       NS_LOG_LOGIC ("route discovery to " << dst << " has been attempted RreqRetries (" << m_rreqRetries << ") times with ttl " << m_netDiameter);
-      m_addressReqTimer.erase (dst);
+      CancelTimer (RREQ_RETRY_TIMER, dst);
       m_routingTable.DeleteRoute (dst);
       NS_LOG_DEBUG ("Route not found. Drop all packets with dst " << dst);
       m_queue.DropPacketWithDst (dst);
       return;
     }
 
-  if (toDst.GetFlag () == IN_SEARCH)
+  if (toDst.GetFlag () == IN_SEARCH)
+    {
+      NS_LOG_LOGIC ("Resend RREQ to " << dst << " previous ttl " << toDst.GetHop ());
+      SendRequest (dst);
+    }
+  else
+    {
+      NS_LOG_DEBUG ("Route down. Stop search. Drop packet with destination " << dst);
+      CancelTimer (RREQ_RETRY_TIMER, dst);
+      m_routingTable.DeleteRoute (dst);
+      m_queue.DropPacketWithDst (dst);
+    }
+}
+
+void
+RoutingProtocol::HelloTimerExpire ()
+{
+  NS_LOG_FUNCTION (this);
+  Time offset = Time (Seconds (0));
+  if (m_lastBcastTime > Time (Seconds (0)))
+    {
+      offset = Simulator::Now () - m_lastBcastTime;
+      NS_LOG_DEBUG ("Hello deferred due to last bcast at:" << m_lastBcastTime);
+    }
+  else if (m_asleep)
+    {
+      // Nobody would hear it outside of a listen window anyway
+      m_helloPending = true;
+    }
+  else
+    {
+      SendHello ();
+    }
+  Time diff = m_helloInterval - offset;
+  ScheduleTimer (HELLO_TIMER, Ipv4Address (), std::max (Time (Seconds (0)), diff));
+  m_lastBcastTime = Time (Seconds (0));
+}
+
+void
+RoutingProtocol::RreqRateLimitTimerExpire ()
+{
+  NS_LOG_FUNCTION (this);
+  while (!m_pendingRreq.empty ())
+    {
+      Ipv4Address dst = m_pendingRreq.front ();
+      RoutingTableEntry toDst;
+      if (m_routingTable.LookupValidRoute (dst, toDst))
+        {
+          NS_LOG_LOGIC ("Route to " << dst << " found while RREQ was deferred");
+          m_pendingRreq.pop_front ();
+          SendPacketFromQueue (dst, toDst.GetRoute ());
+          continue;
+        }
+      if (!m_rreqBucket.Consume ())
+        {
+          ScheduleTimer (RREQ_RATE_LIMIT_TIMER, Ipv4Address (), m_rreqBucket.GetDelayLeft ());
+          return;
+        }
+      m_pendingRreq.pop_front ();
+      SendRequestMessage (dst);
+    }
+}
+
+void
+RoutingProtocol::RerrRateLimitTimerExpire ()
+{
+  NS_LOG_FUNCTION (this);
+  while (!m_pendingRerr.empty ())
+    {
+      if (!m_rerrBucket.Consume ())
+        {
+          ScheduleTimer (RERR_RATE_LIMIT_TIMER, Ipv4Address (), m_rerrBucket.GetDelayLeft ());
+          return;
+        }
+      PendingRerr rerr = m_pendingRerr.front ();
+      m_pendingRerr.pop_front ();
+      if (rerr.m_precursors.empty ())
+        {
+          TransmitRerrToOrigin (rerr.m_packet, rerr.m_origin);
+        }
+      else
+        {
+          TransmitRerrToPrecursors (rerr.m_packet, rerr.m_precursors);
+        }
+    }
+}
+
+void
+RoutingProtocol::DeferRerr (Ptr<Packet> packet, std::vector<Ipv4Address> const & precursors, Ipv4Address origin)
+{
+  NS_LOG_FUNCTION (this << origin);
+  // Don't let the backlog grow beyond one second worth of RERRs, older RERR carry fresher information anyway
+  if (m_pendingRerr.size () >= m_rerrRateLimit)
+    {
+      NS_LOG_LOGIC ("RerrRateLimit reached at " << Simulator::Now ().GetSeconds () << " with "
+                                                << m_pendingRerr.size () << " RERR pending; suppressing RERR");
+      return;
+    }
+  PendingRerr rerr;
+  rerr.m_packet = packet;
+  rerr.m_precursors = precursors;
+  rerr.m_origin = origin;
+  m_pendingRerr.push_back (rerr);
+  if (!IsTimerRunning (RERR_RATE_LIMIT_TIMER, Ipv4Address ()) && m_rerrRateLimit > 0)
+    {
+      ScheduleTimer (RERR_RATE_LIMIT_TIMER, Ipv4Address (), m_rerrBucket.GetDelayLeft ());
+    }
+  NS_LOG_LOGIC ("RerrRateLimit reached, RERR deferred, " << m_pendingRerr.size () << " pending");
+}
+
+void
+RoutingProtocol::AckTimerExpire (Ipv4Address neighbor, Time blacklistTimeout)
+{
+  NS_LOG_FUNCTION (this);
+  m_routingTable.MarkLinkAsUnidirectional (neighbor, blacklistTimeout);
+}
+
+void
+RoutingProtocol::ScheduleTimer (TimerKind kind, Ipv4Address addr, Time delay)
+{
+  NS_LOG_FUNCTION (this << kind << addr << delay.GetSeconds ());
+  if (m_depleted)
+    {
+      return;
+    }
+  if (m_coalescedTimers)
+    {
+      m_deadlines.Schedule (kind, addr, delay);
+      return;
+    }
+  switch (kind)
+    {
+    case HELLO_TIMER:
+      {
+        m_htimer.Cancel ();
+        m_htimer.Schedule (delay);
+        break;
+      }
+    case RREQ_RATE_LIMIT_TIMER:
+      {
+        m_rreqRateLimitTimer.Cancel ();
+        m_rreqRateLimitTimer.Schedule (delay);
+        break;
+      }
+    case RERR_RATE_LIMIT_TIMER:
+      {
+        m_rerrRateLimitTimer.Cancel ();
+        m_rerrRateLimitTimer.Schedule (delay);
+        break;
+      }
+    case RERR_AGGREGATION_TIMER:
+      {
+        m_rerrAggregationTimer.Cancel ();
+        m_rerrAggregationTimer.Schedule (delay);
+        break;
+      }
+    case LOAD_TIMER:
+      {
+        m_loadTimer.Cancel ();
+        m_loadTimer.Schedule (delay);
+        break;
+      }
+    case DUTY_CYCLE_TIMER:
+      {
+        m_dutyCycleTimer.Cancel ();
+        m_dutyCycleTimer.Schedule (delay);
+        break;
+      }
+    case RREQ_RETRY_TIMER:
+      {
+        if (m_addressReqTimer.find (addr) == m_addressReqTimer.end ())
+          {
+            Timer timer (Timer::CANCEL_ON_DESTROY);
+            m_addressReqTimer[addr] = timer;
+          }
+        m_addressReqTimer[addr].SetFunction (&RoutingProtocol::RouteRequestTimerExpire, this);
+        m_addressReqTimer[addr].Remove ();
+        m_addressReqTimer[addr].SetArguments (addr);
+        m_addressReqTimer[addr].Schedule (delay);
+        break;
+      }
+    default:
+      // As in upstream AODV the RREP_ACK wait isn't run by independent timers, a neighbor
+      // which doesn't acknowledge is blacklisted with CoalescedTimers only. Neighbor purge
+      // is driven by Neighbors itself
+      break;
+    }
+}
+
+void
+RoutingProtocol::CancelTimer (TimerKind kind, Ipv4Address addr)
+{
+  NS_LOG_FUNCTION (this << kind << addr);
+  if (m_coalescedTimers)
     {
-      NS_LOG_LOGIC ("Resend RREQ to " << dst << " previous ttl " << toDst.GetHop ());
-      SendRequest (dst);
+      m_deadlines.Cancel (kind, addr);
+      return;
     }
-  else
+  switch (kind)
     {
-      NS_LOG_DEBUG ("Route down. Stop search. Drop packet with destination " << dst);
-      m_addressReqTimer.erase (dst);
-      m_routingTable.DeleteRoute (dst);
-      m_queue.DropPacketWithDst (dst);
+    case HELLO_TIMER:
+      m_htimer.Cancel ();
+      break;
+    case RREQ_RATE_LIMIT_TIMER:
+      m_rreqRateLimitTimer.Cancel ();
+      break;
+    case RERR_RATE_LIMIT_TIMER:
+      m_rerrRateLimitTimer.Cancel ();
+      break;
+    case RERR_AGGREGATION_TIMER:
+      m_rerrAggregationTimer.Cancel ();
+      break;
+    case LOAD_TIMER:
+      m_loadTimer.Cancel ();
+      break;
+    case DUTY_CYCLE_TIMER:
+      m_dutyCycleTimer.Cancel ();
+      break;
+    case RREQ_RETRY_TIMER:
+      {
+        std::map<Ipv4Address, Timer>::iterator i = m_addressReqTimer.find (addr);
+        if (i != m_addressReqTimer.end ())
+          {
+            i->second.Remove ();
+            m_addressReqTimer.erase (i);
+          }
+        break;
+      }
+    default:
+      break;
     }
 }
 
-void
-RoutingProtocol::HelloTimerExpire ()
+bool
+RoutingProtocol::IsTimerRunning (TimerKind kind, Ipv4Address addr) const
 {
-  NS_LOG_FUNCTION (this);
-  Time offset = Time (Seconds (0));
-  if (m_lastBcastTime > Time (Seconds (0)))
+  if (m_coalescedTimers)
     {
-      offset = Simulator::Now () - m_lastBcastTime;
-      NS_LOG_DEBUG ("Hello deferred due to last bcast at:" << m_lastBcastTime);
+      return m_deadlines.IsRunning (kind, addr);
     }
-  else
+  switch (kind)
     {
-      SendHello ();
+    case HELLO_TIMER:
+      return m_htimer.IsRunning ();
+    case RREQ_RATE_LIMIT_TIMER:
+      return m_rreqRateLimitTimer.IsRunning ();
+    case RERR_RATE_LIMIT_TIMER:
+      return m_rerrRateLimitTimer.IsRunning ();
+    case RERR_AGGREGATION_TIMER:
+      return m_rerrAggregationTimer.IsRunning ();
+    case LOAD_TIMER:
+      return m_loadTimer.IsRunning ();
+    case DUTY_CYCLE_TIMER:
+      return m_dutyCycleTimer.IsRunning ();
+    case RREQ_RETRY_TIMER:
+      {
+        std::map<Ipv4Address, Timer>::const_iterator i = m_addressReqTimer.find (addr);
+        return (i != m_addressReqTimer.end () && i->second.IsRunning ());
+      }
+    default:
+      return false;
     }
-  m_htimer.Cancel ();
-  Time diff = m_helloInterval - offset;
-  m_htimer.Schedule (std::max (Time (Seconds (0)), diff));
-  m_lastBcastTime = Time (Seconds (0));
-}
-
-void
-RoutingProtocol::RreqRateLimitTimerExpire ()
-{
-  NS_LOG_FUNCTION (this);
-  m_rreqCount = 0;
-  m_rreqRateLimitTimer.Schedule (Seconds (1));
 }
 
 void
-RoutingProtocol::RerrRateLimitTimerExpire ()
+RoutingProtocol::ScheduleNeighborPurge (Time delay)
 {
-  NS_LOG_FUNCTION (this);
-  m_rerrCount = 0;
-  m_rerrRateLimitTimer.Schedule (Seconds (1));
+  m_deadlines.Schedule (NEIGHBOR_PURGE_TIMER, Ipv4Address (), delay);
 }
 
 void
-RoutingProtocol::AckTimerExpire (Ipv4Address neighbor, Time blacklistTimeout)
+RoutingProtocol::DeadlineExpire (uint8_t kind, Ipv4Address addr)
 {
-  NS_LOG_FUNCTION (this);
-  m_routingTable.MarkLinkAsUnidirectional (neighbor, blacklistTimeout);
+  NS_LOG_FUNCTION (this << (uint16_t) kind << addr);
+  switch (kind)
+    {
+    case HELLO_TIMER:
+      HelloTimerExpire ();
+      break;
+    case NEIGHBOR_PURGE_TIMER:
+      m_nb.Purge ();
+      break;
+    case RREQ_RATE_LIMIT_TIMER:
+      RreqRateLimitTimerExpire ();
+      break;
+    case RERR_RATE_LIMIT_TIMER:
+      RerrRateLimitTimerExpire ();
+      break;
+    case RERR_AGGREGATION_TIMER:
+      RerrAggregationTimerExpire ();
+      break;
+    case LOAD_TIMER:
+      LoadTimerExpire ();
+      break;
+    case DUTY_CYCLE_TIMER:
+      DutyCycleTimerExpire ();
+      break;
+    case RREQ_RETRY_TIMER:
+      RouteRequestTimerExpire (addr);
+      break;
+    case RREP_ACK_TIMER:
+      AckTimerExpire (addr, m_blackListTimeout);
+      break;
+    default:
+      NS_LOG_WARN ("Unknown deadline kind " << (uint16_t) kind);
+      break;
+    }
 }
 
 void
@@ -1790,15 +3522,47 @@ RoutingProtocol::SendHello ()
     {
       Ptr<Socket> socket = j->first;
       Ipv4InterfaceAddress iface = j->second;
-      RrepHeader helloHeader (/*prefix size=*/ 0, /*hops=*/ 0, /*dst=*/ iface.GetLocal (), /*dst seqno=*/ m_seqNo,
-                                               /*origin=*/ iface.GetLocal (),/*lifetime=*/ Time (m_allowedHelloLoss * m_helloInterval));
-      Ptr<Packet> packet = Create<Packet> ();
-      SocketIpTtlTag tag;
-      tag.SetTtl (1);
-      packet->AddPacketTag (tag);
-      packet->AddHeader (helloHeader);
-      TypeHeader tHeader (AODVTYPE_RREP);
-      packet->AddHeader (tHeader);
+      // Hellos without extensions only change with the sequence number and the lifetime,
+      // and the template of the interface is dropped when they do
+      Ptr<Packet> packet;
+      bool plain = (m_linkMetric == HOP_COUNT_METRIC && !m_helloEnergy);
+      std::map<Ipv4Address, std::vector<uint8_t> >::const_iterator hello = m_helloTemplates.find (iface.GetLocal ());
+      if (plain && hello != m_helloTemplates.end ())
+        {
+          packet = CreateFromTemplate (hello->second, 1);
+        }
+      else
+        {
+          RrepHeader helloHeader (/*prefix size=*/ 0, /*hops=*/ 0, /*dst=*/ iface.GetLocal (), /*dst seqno=*/ m_seqNo,
+                                                   /*origin=*/ iface.GetLocal (),/*lifetime=*/ Time (m_allowedHelloLoss * m_helloInterval));
+          if (m_linkMetric != HOP_COUNT_METRIC)
+            {
+              // Tell neighbors how well we hear them, they need it for the forward delivery ratio
+              std::map<Ipv4Address, uint8_t> ratios;
+              m_nb.GetReverseRatios (ratios);
+              for (std::map<Ipv4Address, uint8_t>::const_iterator i = ratios.begin (); i != ratios.end (); ++i)
+                {
+                  if (!helloHeader.AddLinkQuality (i->first, i->second))
+                    break;
+                }
+            }
+          if (m_helloEnergy)
+            {
+              // The hello is the reply of a one hop path, its path energy is the energy of this node
+              helloHeader.SetExtension (GetEnergyExtension (), GetNodeEnergy ());
+            }
+          packet = Create<Packet> ();
+          packet->AddHeader (RrepMessage (helloHeader));
+          if (plain)
+            {
+              std::vector<uint8_t> & bytes = m_helloTemplates[iface.GetLocal ()];
+              bytes.resize (packet->GetSize ());
+              packet->CopyData (&bytes[0], packet->GetSize ());
+            }
+          SocketIpTtlTag tag;
+          tag.SetTtl (1);
+          packet->AddPacketTag (tag);
+        }
       // Send to all-hosts broadcast if on /32 addr, subnet-directed otherwise
       Ipv4Address destination;
       if (iface.GetMask () == Ipv4Mask::GetOnes ())
@@ -1810,7 +3574,7 @@ RoutingProtocol::SendHello ()
           destination = iface.GetBroadcast ();
         }
       Time jitter = Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10)));
-      Simulator::Schedule (jitter, &RoutingProtocol::SendTo, this , socket, packet, destination);
+      ScheduleSendTo (jitter, socket, packet, destination);
     }
 }
 
@@ -1838,91 +3602,384 @@ RoutingProtocol::SendPacketFromQueue (Ipv4Address dst, Ptr<Ipv4Route> route)
     }
 }
 
+void
+RoutingProtocol::SendPacketFromRepairQueue (Ipv4Address dst, Ptr<Ipv4Route> route)
+{
+  NS_LOG_FUNCTION (this << dst);
+  QueueEntry queueEntry;
+  while (m_repairQueue.Dequeue (dst, queueEntry))
+    {
+      UnicastForwardCallback ucb = queueEntry.GetUnicastForwardCallback ();
+      ucb (route, queueEntry.GetPacket (), queueEntry.GetIpv4Header ());
+    }
+}
+
+bool
+RoutingProtocol::StartLocalRepair (Ipv4Address dst)
+{
+  NS_LOG_FUNCTION (this << dst);
+  RoutingTableEntry toDst;
+  // Only routes used by upstream nodes and close enough to the destination are repaired
+  if (!m_routingTable.LookupValidRoute (dst, toDst) || toDst.IsPrecursorListEmpty () || toDst.GetHop () > m_maxRepairTtl)
+    {
+      return false;
+    }
+  // Repair must start now, don't wait for a RREQ token
+  if (!m_pendingRreq.empty () || !m_rreqBucket.Consume ())
+    {
+      NS_LOG_LOGIC ("RreqRateLimit reached, don't repair route to " << dst);
+      return false;
+    }
+  LocalRepair repair;
+  repair.m_hops = toDst.GetHop ();
+  toDst.GetPrecursors (repair.m_precursors);
+  m_localRepairs[dst] = repair;
+
+  /*
+   * TTL = max (MIN_REPAIR_TTL, 0.5 * #hops) + LOCAL_ADD_TTL, where MIN_REPAIR_TTL is the last known hop count
+   * to the destination. The repair starts on link break, without an undeliverable packet, so #hops to
+   * its originator is unknown and MIN_REPAIR_TTL is used alone.
+   */
+  uint16_t ttl = std::min<uint16_t> (toDst.GetHop () + m_localAddTtl, m_netDiameter);
+  Time wait = 2 * m_nodeTraversalTime * (ttl + m_timeoutBuffer);
+  // To repair the link break, the node increments the sequence number for the destination
+  toDst.SetSeqNo (toDst.GetSeqNo () + 1);
+  toDst.SetFlag (IN_REPAIR);
+  toDst.SetLifeTime (wait);
+  m_routingTable.Update (toDst);
+
+  RreqHeader rreqHeader;
+  rreqHeader.SetDst (dst);
+  rreqHeader.SetDstSeqno (toDst.GetSeqNo ());
+  if (m_gratuitousReply)
+    rreqHeader.SetGratiousRrep (true);
+  if (m_destinationOnly)
+    rreqHeader.SetDestinationOnly (true);
+  NS_LOG_DEBUG ("Start local repair of route to " << dst << " with TTL " << ttl);
+  BroadcastRequest (rreqHeader, ttl);
+  ScheduleTimer (RREQ_RETRY_TIMER, dst, wait);
+  return true;
+}
+
+void
+RoutingProtocol::FinishLocalRepair (Ipv4Address dst)
+{
+  NS_LOG_FUNCTION (this << dst);
+  std::map<Ipv4Address, LocalRepair>::iterator i = m_localRepairs.find (dst);
+  if (i == m_localRepairs.end ())
+    return;
+  LocalRepair repair = i->second;
+  m_localRepairs.erase (i);
+  CancelTimer (RREQ_RETRY_TIMER, dst);
+
+  RoutingTableEntry toDst;
+  if (!m_routingTable.LookupValidRoute (dst, toDst))
+    return;
+  for (std::vector<Ipv4Address>::const_iterator j = repair.m_precursors.begin (); j != repair.m_precursors.end (); ++j)
+    {
+      toDst.InsertPrecursor (*j);
+    }
+  m_routingTable.Update (toDst);
+  NS_LOG_DEBUG ("Route to " << dst << " repaired, " << toDst.GetHop () << " hops instead of " << repair.m_hops);
+  SendPacketFromRepairQueue (dst, toDst.GetRoute ());
+  // If the repaired route is longer, upstream nodes learn it from RERR with the N flag set
+  if (toDst.GetHop () > repair.m_hops)
+    {
+      std::map<Ipv4Address, uint32_t> unreachable;
+      unreachable.insert (std::make_pair (dst, toDst.GetSeqNo ()));
+      SendRerrMessages (unreachable, repair.m_precursors, true);
+    }
+}
+
+void
+RoutingProtocol::LocalRepairFailed (Ipv4Address dst)
+{
+  NS_LOG_FUNCTION (this << dst);
+  std::map<Ipv4Address, LocalRepair>::iterator i = m_localRepairs.find (dst);
+  if (i == m_localRepairs.end ())
+    return;
+  LocalRepair repair = i->second;
+  m_localRepairs.erase (i);
+  CancelTimer (RREQ_RETRY_TIMER, dst);
+
+  NS_LOG_DEBUG ("Local repair of route to " << dst << " failed. Drop buffered packets.");
+  m_repairQueue.DropPacketWithDst (dst);
+  RoutingTableEntry toDst;
+  if (m_routingTable.LookupRoute (dst, toDst))
+    {
+      std::map<Ipv4Address, uint32_t> unreachable;
+      unreachable.insert (std::make_pair (dst, toDst.GetSeqNo ()));
+      SendRerrForUnreachable (unreachable, repair.m_precursors);
+      toDst.Invalidate (m_deletePeriod);
+      m_routingTable.Update (toDst);
+    }
+  // Own packets waiting for the repaired route need a regular route discovery now
+  if (m_queue.Find (dst))
+    {
+      SendRequest (dst);
+    }
+}
+
 void
 RoutingProtocol::SendRerrWhenBreaksLinkToNextHop (Ipv4Address nextHop)
 {
   NS_LOG_FUNCTION (this << nextHop);
-  RerrHeader rerrHeader;
   std::vector<Ipv4Address> precursors;
   std::map<Ipv4Address, uint32_t> unreachable;
 
   RoutingTableEntry toNextHop;
   if (!m_routingTable.LookupRoute (nextHop, toNextHop))
     return;
-  toNextHop.GetPrecursors (precursors);
-  rerrHeader.AddUnDestination (nextHop, toNextHop.GetSeqNo ());
   m_routingTable.GetListOfDestinationWithNextHop (nextHop, unreachable);
-  for (std::map<Ipv4Address, uint32_t>::const_iterator i = unreachable.begin (); i
-       != unreachable.end ();)
+  if (m_enableMultipath)
     {
-      if (!rerrHeader.AddUnDestination (i->first, i->second))
+      FailoverToAlternatePaths (nextHop, unreachable);
+      m_routingTable.DeleteAlternatePaths (nextHop);
+    }
+  if (m_enableLocalRepair && !m_withdrawn)
+    {
+      // Destinations repaired locally are reported only if the repair fails
+      for (std::map<Ipv4Address, uint32_t>::iterator i = unreachable.begin (); i != unreachable.end (); )
         {
-          NS_LOG_LOGIC ("Send RERR message with maximum size.");
-          TypeHeader typeHeader (AODVTYPE_RERR);
-          Ptr<Packet> packet = Create<Packet> ();
-          SocketIpTtlTag tag;
-          tag.SetTtl (1);
-          packet->AddPacketTag (tag);
-          packet->AddHeader (rerrHeader);
-          packet->AddHeader (typeHeader);
-          SendRerrMessage (packet, precursors);
-          rerrHeader.Clear ();
+          if (m_localRepairs.find (i->first) != m_localRepairs.end ()
+              || (i->first != nextHop && StartLocalRepair (i->first)))
+            {
+              unreachable.erase (i++);
+            }
+          else
+            {
+              ++i;
+            }
         }
-      else
+    }
+  // The neighbor itself is still reachable if its route failed over to another next hop
+  RoutingTableEntry toNeighbor;
+  if (!m_routingTable.LookupValidRoute (nextHop, toNeighbor) || toNeighbor.GetNextHop () == nextHop)
+    {
+      unreachable.insert (std::make_pair (nextHop, toNextHop.GetSeqNo ()));
+    }
+  if (unreachable.empty ())
+    {
+      NS_LOG_LOGIC ("Every route over " << nextHop << " failed over or is being repaired");
+      return;
+    }
+  // Only upstream nodes of the lost routes are told
+  for (std::map<Ipv4Address, uint32_t>::const_iterator i = unreachable.begin (); i
+       != unreachable.end (); ++i)
+    {
+      RoutingTableEntry toDst;
+      m_routingTable.LookupRoute (i->first, toDst);
+      toDst.GetPrecursors (precursors);
+    }
+  SendRerrForUnreachable (unreachable, precursors);
+  m_routingTable.InvalidateRoutesWithDst (unreachable);
+}
+
+void
+RoutingProtocol::SendPreemptiveWarning (Ipv4Address nextHop)
+{
+  NS_LOG_FUNCTION (this << nextHop);
+  std::map<Ipv4Address, uint32_t> endangered;
+  m_routingTable.GetListOfDestinationWithNextHop (nextHop, endangered);
+  // Route to the neighbor itself can't avoid the link
+  endangered.erase (nextHop);
+  if (m_enableMultipath)
+    {
+      FailoverToAlternatePaths (nextHop, endangered);
+      m_routingTable.DeleteAlternatePaths (nextHop);
+    }
+  std::vector<Ipv4Address> precursors;
+  std::map<Ipv4Address, uint32_t> warned;
+  for (std::map<Ipv4Address, uint32_t>::const_iterator i = endangered.begin (); i != endangered.end (); ++i)
+    {
+      RoutingTableEntry toDst;
+      if (!m_routingTable.LookupValidRoute (i->first, toDst))
+        continue;
+      if (toDst.IsPrecursorListEmpty ())
         {
-          RoutingTableEntry toDst;
-          m_routingTable.LookupRoute (i->first, toDst);
-          toDst.GetPrecursors (precursors);
-          ++i;
+          // Nobody upstream, this node is the source
+          SendPreemptiveRequest (i->first);
+          continue;
         }
+      toDst.GetPrecursors (precursors);
+      warned.insert (*i);
+    }
+  if (!warned.empty ())
+    {
+      NS_LOG_LOGIC ("Link to " << nextHop << " is about to break, warn " << precursors.size () << " precursors");
+      SendRerrMessages (warned, precursors, true);
+    }
+}
+
+void
+RoutingProtocol::SendPreemptiveRequest (Ipv4Address dst)
+{
+  NS_LOG_FUNCTION (this << dst);
+  RoutingTableEntry toDst;
+  if (!m_routingTable.LookupValidRoute (dst, toDst) || IsTimerRunning (RREQ_RETRY_TIMER, dst))
+    return;
+  // Current route keeps forwarding meanwhile, so the RREQ is never retried or queued
+  if (!m_pendingRreq.empty () || !m_rreqBucket.Consume ())
+    {
+      NS_LOG_LOGIC ("RreqRateLimit reached, no pre-emptive discovery of " << dst);
+      return;
+    }
+  RreqHeader rreqHeader;
+  rreqHeader.SetDst (dst);
+  // Only the destination may answer with a newer sequence number, intermediate nodes likely know the fading route
+  rreqHeader.SetDstSeqno (toDst.GetSeqNo () + 1);
+  uint16_t ttl = std::min<uint16_t> (toDst.GetHop () + m_ttlIncrement, m_netDiameter);
+  BroadcastRequest (rreqHeader, ttl);
+}
+
+void
+RoutingProtocol::SendRerrForUnreachable (std::map<Ipv4Address, uint32_t> const & unreachable,
+                                         std::vector<Ipv4Address> const & precursors)
+{
+  NS_LOG_FUNCTION (this << unreachable.size () << precursors.size ());
+  if (m_rerrAggregationWindow > Seconds (0))
+    {
+      AggregateRerr (unreachable, precursors);
+      return;
     }
-  if (rerrHeader.GetDestCount () != 0)
+  SendRerrMessages (unreachable, precursors, false);
+}
+
+uint32_t
+RoutingProtocol::SendRerrMessages (std::map<Ipv4Address, uint32_t> const & unreachable,
+                                   std::vector<Ipv4Address> const & precursors, bool noDelete, bool now)
+{
+  NS_LOG_FUNCTION (this);
+  uint32_t size = 0;
+  RerrHeader rerrHeader;
+  for (std::map<Ipv4Address, uint32_t>::const_iterator i = unreachable.begin (); i != unreachable.end (); )
     {
-      TypeHeader typeHeader (AODVTYPE_RERR);
+      // One RERR per MAX_DESTINATIONS destinations
+      i = rerrHeader.AddUnDestinations (i, unreachable.end ());
+      rerrHeader.SetNoDelete (noDelete);
       Ptr<Packet> packet = Create<Packet> ();
       SocketIpTtlTag tag;
       tag.SetTtl (1);
       packet->AddPacketTag (tag);
-      packet->AddHeader (rerrHeader);
-      packet->AddHeader (typeHeader);
-      SendRerrMessage (packet, precursors);
+      packet->AddHeader (RerrMessage (rerrHeader));
+      size += packet->GetSize ();
+      if (now)
+        {
+          TransmitRerrToPrecursors (packet, precursors, true);
+        }
+      else
+        {
+          SendRerrMessage (packet, precursors);
+        }
+      rerrHeader.Clear ();
     }
-  unreachable.insert (std::make_pair (nextHop, toNextHop.GetSeqNo ()));
-  m_routingTable.InvalidateRoutesWithDst (unreachable);
+  return size;
+}
+
+/// Size of RERR messages (including type header) needed to report n unreachable destinations
+static uint32_t
+GetRerrSize (uint32_t n)
+{
+  uint32_t messages = (n + 254) / 255;
+  return messages * (TypeHeader ().GetSerializedSize () + RerrHeader ().GetSerializedSize ()) + 8 * n;
 }
 
 void
-RoutingProtocol::SendRerrWhenNoRouteToForward (Ipv4Address dst,
-                                               uint32_t dstSeqNo, Ipv4Address origin)
+RoutingProtocol::AggregateRerr (std::map<Ipv4Address, uint32_t> const & unreachable,
+                                std::vector<Ipv4Address> const & precursors)
 {
   NS_LOG_FUNCTION (this);
-  // A node SHOULD NOT originate more than RERR_RATELIMIT RERR messages per second.
-  if (m_rerrCount == m_rerrRateLimit)
-    {
-      // Just make sure that the RerrRateLimit timer is running and will expire
-      NS_ASSERT (m_rerrRateLimitTimer.IsRunning ());
-      // discard the packet and return
-      NS_LOG_LOGIC ("RerrRateLimit reached at " << Simulator::Now ().GetSeconds () << " with timer delay left " 
-                                                << m_rerrRateLimitTimer.GetDelayLeft ().GetSeconds ()
-                                                << "; suppressing RERR");
+  // Group precursors by the interface the RERR is sent from
+  std::map<Ipv4Address, std::vector<Ipv4Address> > ifacePrecursors;
+  for (std::vector<Ipv4Address>::const_iterator i = precursors.begin (); i != precursors.end (); ++i)
+    {
+      RoutingTableEntry toPrecursor;
+      if (m_routingTable.LookupValidRoute (*i, toPrecursor))
+        {
+          ifacePrecursors[toPrecursor.GetInterface ().GetLocal ()].push_back (*i);
+        }
+    }
+  if (ifacePrecursors.empty ())
+    {
+      NS_LOG_LOGIC ("No precursors");
       return;
     }
+  for (std::map<Ipv4Address, std::vector<Ipv4Address> >::const_iterator i = ifacePrecursors.begin ();
+       i != ifacePrecursors.end (); ++i)
+    {
+      RerrAggregate & aggregate = m_rerrAggregates[i->first];
+      // Latest sequence number of an unreachable destination wins
+      for (std::map<Ipv4Address, uint32_t>::const_iterator j = unreachable.begin (); j != unreachable.end (); ++j)
+        {
+          aggregate.m_unreachable[j->first] = j->second;
+        }
+      for (std::vector<Ipv4Address>::const_iterator j = i->second.begin (); j != i->second.end (); ++j)
+        {
+          if (std::find (aggregate.m_precursors.begin (), aggregate.m_precursors.end (), *j) == aggregate.m_precursors.end ())
+            {
+              aggregate.m_precursors.push_back (*j);
+            }
+        }
+      aggregate.m_unaggregatedBytes += GetRerrSize (unreachable.size ());
+    }
+  if (!IsTimerRunning (RERR_AGGREGATION_TIMER, Ipv4Address ()))
+    {
+      ScheduleTimer (RERR_AGGREGATION_TIMER, Ipv4Address (), m_rerrAggregationWindow);
+    }
+}
+
+void
+RoutingProtocol::RerrAggregationTimerExpire ()
+{
+  NS_LOG_FUNCTION (this);
+  std::map<Ipv4Address, RerrAggregate> aggregates;
+  aggregates.swap (m_rerrAggregates);
+  for (std::map<Ipv4Address, RerrAggregate>::const_iterator i = aggregates.begin (); i != aggregates.end (); ++i)
+    {
+      uint32_t size = SendRerrMessages (i->second.m_unreachable, i->second.m_precursors, false);
+      NS_LOG_LOGIC ("Aggregated RERR from interface " << i->first << " reports " << i->second.m_unreachable.size ()
+                    << " destinations to " << i->second.m_precursors.size () << " precursors in " << size
+                    << " bytes instead of " << i->second.m_unaggregatedBytes);
+      if (i->second.m_unaggregatedBytes > size)
+        {
+          m_rerrBytesSaved += i->second.m_unaggregatedBytes - size;
+        }
+    }
+}
+
+void
+RoutingProtocol::SendRerrWhenNoRouteToForward (Ipv4Address dst,
+                                               uint32_t dstSeqNo, Ipv4Address origin)
+{
+  NS_LOG_FUNCTION (this);
   RerrHeader rerrHeader;
   rerrHeader.AddUnDestination (dst, dstSeqNo);
-  RoutingTableEntry toOrigin;
   Ptr<Packet> packet = Create<Packet> ();
   SocketIpTtlTag tag;
   tag.SetTtl (1);
   packet->AddPacketTag (tag);
-  packet->AddHeader (rerrHeader);
-  packet->AddHeader (TypeHeader (AODVTYPE_RERR));
+  packet->AddHeader (RerrMessage (rerrHeader));
+  // A node SHOULD NOT originate more than RERR_RATELIMIT RERR messages per second.
+  if (!m_pendingRerr.empty () || !m_rerrBucket.Consume ())
+    {
+      DeferRerr (packet, std::vector<Ipv4Address> (), origin);
+      return;
+    }
+  TransmitRerrToOrigin (packet, origin);
+}
+
+void
+RoutingProtocol::TransmitRerrToOrigin (Ptr<Packet> packet, Ipv4Address origin)
+{
+  NS_LOG_FUNCTION (this << origin);
+  RoutingTableEntry toOrigin;
   if (m_routingTable.LookupValidRoute (origin, toOrigin))
     {
       Ptr<Socket> socket = FindSocketWithInterfaceAddress (
           toOrigin.GetInterface ());
       NS_ASSERT (socket);
       NS_LOG_LOGIC ("Unicast RERR to the source of the data transmission");
-      socket->SendTo (packet, 0, InetSocketAddress (toOrigin.GetNextHop (), AODV_EO_PORT));
+      SendTo (socket, packet, toOrigin.GetNextHop ());
     }
   else
     {
@@ -1943,7 +4000,7 @@ RoutingProtocol::SendRerrWhenNoRouteToForward (Ipv4Address dst,
             { 
               destination = iface.GetBroadcast ();
             }
-          socket->SendTo (packet->Copy (), 0, InetSocketAddress (destination, AODV_EO_PORT));
+          SendTo (socket, packet->Copy (), destination);
         }
     }
 }
@@ -1959,16 +4016,19 @@ RoutingProtocol::SendRerrMessage (Ptr<Packet> packet, std::vector<Ipv4Address> p
       return;
     }
   // A node SHOULD NOT originate more than RERR_RATELIMIT RERR messages per second.
-  if (m_rerrCount == m_rerrRateLimit)
-    {
-      // Just make sure that the RerrRateLimit timer is running and will expire
-      NS_ASSERT (m_rerrRateLimitTimer.IsRunning ());
-      // discard the packet and return
-      NS_LOG_LOGIC ("RerrRateLimit reached at " << Simulator::Now ().GetSeconds () << " with timer delay left " 
-                                                << m_rerrRateLimitTimer.GetDelayLeft ().GetSeconds ()
-                                                << "; suppressing RERR");
+  if (!m_pendingRerr.empty () || !m_rerrBucket.Consume ())
+    {
+      DeferRerr (packet, precursors, Ipv4Address ());
       return;
     }
+  TransmitRerrToPrecursors (packet, precursors);
+}
+
+void
+RoutingProtocol::TransmitRerrToPrecursors (Ptr<Packet> packet, std::vector<Ipv4Address> const & precursors, bool now)
+{
+  NS_LOG_FUNCTION (this);
+  Time jitter = now ? Seconds (0) : Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10)));
   // If there is only one precursor, RERR SHOULD be unicast toward that precursor
   if (precursors.size () == 1)
     {
@@ -1978,8 +4038,10 @@ RoutingProtocol::SendRerrMessage (Ptr<Packet> packet, std::vector<Ipv4Address> p
           Ptr<Socket> socket = FindSocketWithInterfaceAddress (toPrecursor.GetInterface ());
           NS_ASSERT (socket);
           NS_LOG_LOGIC ("one precursor => unicast RERR to " << toPrecursor.GetDestination () << " from " << toPrecursor.GetInterface ().GetLocal ());
-          Simulator::Schedule (Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10))), &RoutingProtocol::SendTo, this, socket, packet, precursors.front ());
-          m_rerrCount++;
+          if (now)
+            SendTo (socket, packet, precursors.front ());
+          else
+            ScheduleSendTo (jitter, socket, packet, precursors.front ());
         }
       return;
     }
@@ -2001,7 +4063,6 @@ RoutingProtocol::SendRerrMessage (Ptr<Packet> packet, std::vector<Ipv4Address> p
       Ptr<Socket> socket = FindSocketWithInterfaceAddress (*i);
       NS_ASSERT (socket);
       NS_LOG_LOGIC ("Broadcast RERR message from interface " << i->GetLocal ());
-      // std::cout << "Broadcast RERR message from interface " << i->GetLocal () << std::endl;
       // Send to all-hosts broadcast if on /32 addr, subnet-directed otherwise
       Ptr<Packet> p = packet->Copy ();
       Ipv4Address destination;
@@ -2013,7 +4074,10 @@ RoutingProtocol::SendRerrMessage (Ptr<Packet> packet, std::vector<Ipv4Address> p
         { 
           destination = i->GetBroadcast ();
         }
-      Simulator::Schedule (Time (MilliSeconds (m_uniformRandomVariable->GetInteger (0, 10))), &RoutingProtocol::SendTo, this, socket, p, destination);
+      if (now)
+        SendTo (socket, p, destination);
+      else
+        ScheduleSendTo (jitter, socket, p, destination);
     }
 }
 
@@ -2059,7 +4123,7 @@ RoutingProtocol::DoInitialize (void)
       m_htimer.SetFunction (&RoutingProtocol::HelloTimerExpire, this);
       startTime = m_uniformRandomVariable->GetInteger (0, 100);
       NS_LOG_DEBUG ("Starting at time " << startTime << "ms");
-      m_htimer.Schedule (MilliSeconds (startTime));
+      ScheduleTimer (HELLO_TIMER, Ipv4Address (), MilliSeconds (startTime));
     }
   Ipv4RoutingProtocol::DoInitialize ();
 }
@@ -33,13 +33,25 @@
 #include "aodv_eo-packet.h"
 #include "aodv_eo-neighbor.h"
 #include "aodv_eo-dpd.h"
+#include "aodv_eo-token-bucket.h"
+#include "aodv_eo-deadline-scheduler.h"
+#include "aodv_eo-load-monitor.h"
+#include "aodv_eo-reservation.h"
+#include "aodv_eo-energy-predictor.h"
+#include "aodv_eo-energy-accounting.h"
 #include "ns3/node.h"
 #include "ns3/random-variable-stream.h"
 #include "ns3/output-stream-wrapper.h"
 #include "ns3/ipv4-routing-protocol.h"
 #include "ns3/ipv4-interface.h"
 #include "ns3/ipv4-l3-protocol.h"
+#include "ns3/traced-value.h"
+#include "ns3/data-rate.h"
+#include "ns3/device-energy-model.h"
 #include <map>
+#include <vector>
+#include <deque>
+#include <limits>
 
 namespace ns3
 {
@@ -56,12 +68,26 @@ public:
   static TypeId GetTypeId (void);
   static const uint32_t AODV_EO_PORT;
 
+  /// Route selection metric
+  enum LinkMetric
+  {
+    HOP_COUNT_METRIC,       //!< Number of hops, as in RFC 3561
+    ETX_METRIC,             //!< Expected transmission count, in units of 1/256 transmission
+    ETT_METRIC              //!< Expected transmission time, microseconds
+  };
+
   /// c-tor
   RoutingProtocol ();
   virtual ~RoutingProtocol();
   virtual void DoDispose ();
 
   // Inherited from Ipv4RoutingProtocol
+  /**
+   * Unlike the Ipv4RoutingProtocol contract, the destination of the routes returned by RouteOutput
+   * and passed to the unicast forward callback of RouteInput is the next hop, not the destination
+   * of the packet: the routes are shared per next hop by the routing table entries. IP only uses
+   * their gateway, source and output device. Callers must not modify them.
+   */
   Ptr<Ipv4Route> RouteOutput (Ptr<Packet> p, const Ipv4Header &header, Ptr<NetDevice> oif, Socket::SocketErrno &sockerr);
   bool RouteInput (Ptr<const Packet> p, const Ipv4Header &header, Ptr<const NetDevice> idev,
                    UnicastForwardCallback ucb, MulticastForwardCallback mcb,
@@ -78,6 +104,10 @@ public:
   void SetMaxQueueTime (Time t);
   uint32_t GetMaxQueueLen () const { return m_maxQueueLen; }
   void SetMaxQueueLen (uint32_t len);
+  Time GetHelloInterval () const { return m_helloInterval; }
+  void SetHelloInterval (Time t);
+  uint32_t GetAllowedHelloLoss () const { return m_allowedHelloLoss; }
+  void SetAllowedHelloLoss (uint32_t loss);
   bool GetDesinationOnlyFlag () const { return m_destinationOnly; }
   void SetDesinationOnlyFlag (bool f) { m_destinationOnly = f; }
   bool GetGratuitousReplyFlag () const { return m_gratuitousReply; }
@@ -86,6 +116,35 @@ public:
   bool GetHelloEnable () const { return m_enableHello; }
   void SetBroadcastEnable (bool f) { m_enableBroadcast = f; }
   bool GetBroadcastEnable () const { return m_enableBroadcast; }
+  uint32_t GetRreqRateLimit () const { return m_rreqRateLimit; }
+  void SetRreqRateLimit (uint32_t limit);
+  uint32_t GetRerrRateLimit () const { return m_rerrRateLimit; }
+  void SetRerrRateLimit (uint32_t limit);
+  /// Return total number of RERR bytes saved by RERR aggregation
+  uint64_t GetRerrBytesSaved () const { return m_rerrBytesSaved; }
+  /**
+   * Shut routing down: drop buffered packets with ERROR_NOROUTETOHOST, cancel all timers and
+   * ignore all traffic. Called on energy depletion with ShutdownOnDepletion.
+   */
+  void HandleEnergyDepletion ();
+  /// Resume routing after HandleEnergyDepletion
+  void HandleEnergyRecharged ();
+  /// Check that routing is shut down
+  bool IsDepleted () const { return m_depleted; }
+  /**
+   * Return energy neighbor advertised in its last hello with HelloEnergy: residual energy (mJ), or
+   * with HarvestingAware predicted time to depletion (s). Maximum value if unknown.
+   */
+  uint32_t GetNeighborEnergy (Ipv4Address neighbor) const { return m_nb.GetEnergy (neighbor); }
+  /// Return radio energy spent per message type and flow, accounted with EnergyAccounting
+  EnergyAccounting const & GetEnergyAccounting () const { return m_energyAccounting; }
+  /// Print radio energy spent per message type and flow
+  void PrintEnergyAccounting (Ptr<OutputStreamWrapper> stream) const;
+  /**
+   * Set rate requested in route discovery for flows to dst when admission control is enabled,
+   * overriding DefaultFlowRate. A zero rate removes the hint.
+   */
+  void SetFlowRate (Ipv4Address dst, DataRate rate);
 
  /**
   * Assign a fixed random variable stream number to the random variables
@@ -100,6 +159,8 @@ public:
 protected:
   virtual void DoInitialize (void);
 private:
+  /// Protocol tests drive timers and inspect state of a running node
+  friend struct RoutingProtocolTestCase;
   
   // Protocol parameters.
   uint32_t m_rreqRetries;             ///< Maximum number of retransmissions of RREQ with TTL = NetDiameter to discover a route
@@ -107,8 +168,8 @@ private:
   uint16_t m_ttlIncrement;            ///< TTL increment for each attempt using the expanding ring search for RREQ dissemination.
   uint16_t m_ttlThreshold;            ///< Maximum TTL value for expanding ring search, TTL = NetDiameter is used beyond this value.
   uint16_t m_timeoutBuffer;           ///< Provide a buffer for the timeout.
-  uint16_t m_rreqRateLimit;           ///< Maximum number of RREQ per second.
-  uint16_t m_rerrRateLimit;           ///< Maximum number of REER per second.
+  uint32_t m_rreqRateLimit;           ///< Maximum number of RREQ per second.
+  uint32_t m_rerrRateLimit;           ///< Maximum number of REER per second.
   Time m_activeRouteTimeout;          ///< Period of time during which the route is considered to be valid.
   uint32_t m_netDiameter;             ///< Net diameter measures the maximum possible number of hops between two nodes in the network
   /**
@@ -138,6 +199,46 @@ private:
   bool m_gratuitousReply;              ///< Indicates whether a gratuitous RREP should be unicast to the node originated route discovery.
   bool m_enableHello;                  ///< Indicates whether a hello messages enable
   bool m_enableBroadcast;              ///< Indicates whether a a broadcast data packets forwarding enable
+  Time m_rerrAggregationWindow;        ///< Time during which unreachable destinations are merged into common RERRs, 0 disables aggregation
+  bool m_enableLocalRepair;            ///< Indicates whether intermediate nodes repair broken links locally
+  uint16_t m_maxRepairTtl;             ///< Maximum hop count to a destination for which local repair is attempted
+  uint16_t m_localAddTtl;              ///< TTL added to the last known hop count in local repair RREQ
+  bool m_enableMultipath;              ///< Indicates whether alternate loop-free paths are kept for instant failover
+  uint32_t m_maxPaths;                 ///< Maximum number of paths per destination in multipath mode, including the primary one
+  bool m_energyBalancing;              ///< Indicates whether traffic is split across paths in proportion to their residual energy
+  bool m_enablePreemptive;             ///< Indicates whether routes are rediscovered when the signal of their next hop gets weak
+  double m_preemptiveThreshold;        ///< Smoothed signal strength (dBm) below which a link is considered about to break
+  double m_preemptiveHysteresis;       ///< Signal recovery (dB) after which a weak link is considered good again
+  LinkMetric m_linkMetric;             ///< Metric used to select routes
+  uint32_t m_linkQualityWindow;        ///< Number of hello intervals over which hello delivery ratios are measured
+  uint32_t m_ettPacketSize;            ///< Packet size (bytes) used to compute ETT
+  bool m_congestionAware;              ///< Indicates whether node load is added to route cost and loaded nodes hold back RREQs
+  Time m_loadSampleInterval;           ///< Period of node load sampling
+  uint32_t m_congestionMaxFlows;       ///< Number of relayed flows which counts as full load
+  double m_congestionWeight;           ///< Fraction of a link cost added per unit of load of the node forwarding over it
+  Time m_congestionMaxDelay;           ///< RREQ rebroadcast delay at full load
+  double m_congestionDropThreshold;    ///< Load above which RREQs are not rebroadcast
+  bool m_admissionControl;             ///< Indicates whether RREQ carry the requested rate and relays admit only flows they can carry
+  DataRate m_channelCapacity;          ///< Rate a relay can carry over an idle channel
+  DataRate m_defaultFlowRate;          ///< Rate requested for flows without a rate hint, 0 requests nothing
+  bool m_txPowerControl;               ///< Indicates whether unicast frames go out at the lowest power reaching the next hop
+  double m_txPowerMargin;              ///< Margin (dB) added to the lowest TX power reaching a neighbor
+  double m_rxSensitivity;              ///< Weakest signal (dBm) a neighbor receives, target of TX power control
+  Time m_replyCollectionWindow;        ///< Time after the first RREP during which the source switches to better RREPs, 0 disables
+  double m_withdrawalThreshold;        ///< Fraction of initial energy below which the node stops relaying, 0 disables
+  double m_rejoinMargin;               ///< Fraction of initial energy above the withdrawal threshold at which the node relays again
+  bool m_shutdownOnDepletion;          ///< Indicates whether routing shuts down when an energy source of the node is depleted
+  bool m_depletionRerr;                ///< Indicates whether a last RERR for the relayed routes is sent on shutdown
+  bool m_harvestingAware;              ///< Indicates whether predicted time to depletion replaces residual energy as path energy
+  Time m_energyRateWindow;             ///< Time constant of the harvesting and drain rate averages
+  bool m_helloEnergy;                  ///< Indicates whether hellos advertise the energy of the node
+  bool m_dutyCycle;                    ///< Indicates whether radios sleep while the node is on no active route
+  Time m_wakeInterval;                 ///< Interval between the starts of synchronized listen windows
+  Time m_listenWindow;                 ///< Duration of listen windows
+  bool m_accountEnergy;                ///< Indicates whether radio energy is accounted per message type and flow
+  bool m_compactEncoding;              ///< Indicates whether control messages are sent in the compact encoding
+  bool m_messageBundling;              ///< Indicates whether jittered control messages are bundled
+  Time m_bundleWindow;                 ///< Maximum extra delay of a message joining a bundle
   //\}
 
   /// IP protocol
@@ -153,20 +254,64 @@ private:
   RoutingTable m_routingTable;
   /// A "drop-front" queue used by the routing layer to buffer packets to which it does not have a route.
   RequestQueue m_queue;
+  /// Forwarded packets buffered while their route is being repaired locally
+  RequestQueue m_repairQueue;
+  /// State of a local repair in progress
+  struct LocalRepair
+  {
+    /// Hop count of the route before the link break
+    uint16_t m_hops;
+    /// Precursors of the route before the link break
+    std::vector<Ipv4Address> m_precursors;
+  };
+  /// Local repairs in progress, map destination -> repair state
+  std::map<Ipv4Address, LocalRepair> m_localRepairs;
   /// Broadcast ID
   uint32_t m_requestId;
   /// Request sequence number
   uint32_t m_seqNo;
   /// Handle duplicated RREQ
   IdCache m_rreqIdCache;
+  /// RREQs already forwarded again for a better reverse route, each RREQ is forwarded again once at most
+  IdCache m_rreqReforwardCache;
   /// Handle duplicated broadcast/multicast packets
   DuplicatePacketDetection m_dpd;
   /// Handle neighbors
   Neighbors m_nb;
-  /// Number of RREQs used for RREQ rate control
-  uint16_t m_rreqCount;
-  /// Number of RERRs used for RERR rate control
-  uint16_t m_rerrCount;
+  /// Token bucket used for RREQ rate control
+  TokenBucket m_rreqBucket;
+  /// Token bucket used for RERR rate control
+  TokenBucket m_rerrBucket;
+  /// Destinations waiting for a RREQ token, in order of arrival
+  std::deque<Ipv4Address> m_pendingRreq;
+  /// RERR waiting for a RERR token
+  struct PendingRerr
+  {
+    /// RERR packet
+    Ptr<Packet> m_packet;
+    /// Precursors the RERR is sent to, empty if RERR is sent towards m_origin
+    std::vector<Ipv4Address> m_precursors;
+    /// Originating node of the data packet which could not be forwarded
+    Ipv4Address m_origin;
+  };
+  /// RERRs waiting for a RERR token, in order of arrival
+  std::deque<PendingRerr> m_pendingRerr;
+  /// Unreachable destinations waiting for the end of RERR aggregation window on one interface
+  struct RerrAggregate
+  {
+    /// Unreachable destinations and their sequence numbers
+    std::map<Ipv4Address, uint32_t> m_unreachable;
+    /// Precursors reachable through the interface
+    std::vector<Ipv4Address> m_precursors;
+    /// Size of RERRs which would have been sent without aggregation
+    uint32_t m_unaggregatedBytes;
+
+    RerrAggregate () : m_unaggregatedBytes (0) {}
+  };
+  /// Pending RERR aggregates, map interface address -> aggregate
+  std::map<Ipv4Address, RerrAggregate> m_rerrAggregates;
+  /// Total number of RERR bytes saved by RERR aggregation
+  TracedValue<uint64_t> m_rerrBytesSaved;
 
 private:
   /// Start protocol operation
@@ -208,8 +353,12 @@ private:
   //\{
   /// Receive and process control packet
   void RecvAodv (Ptr<Socket> socket);
+  /// Process one control message received on interface iface from node with address sender
+  void RecvMessage (Ptr<Packet> packet, Ipv4InterfaceAddress iface, Ipv4Address sender);
   /// Receive RREQ
   void RecvRequest (Ptr<Packet> p, Ipv4Address receiver, Ipv4Address src);
+  /// Learn alternate reverse path from a duplicate RREQ, the destination also replies over the new path
+  void RecvDuplicateRequest (RreqHeader const & rreqHeader, Ipv4Address receiver, Ipv4Address src);
   /// Receive RREP
   void RecvReply (Ptr<Packet> p, Ipv4Address my,Ipv4Address src);
   /// Receive RREP_ACK
@@ -224,8 +373,12 @@ private:
   void SendPacketFromQueue (Ipv4Address dst, Ptr<Ipv4Route> route);
   /// Send hello
   void SendHello ();
-  /// Send RREQ
+  /// Send RREQ, or queue the destination if RREQ rate limit is reached
   void SendRequest (Ipv4Address dst);
+  /// Send RREQ regardless of the rate limit
+  void SendRequestMessage (Ipv4Address dst);
+  /// Broadcast RREQ from all interfaces with given TTL, origin and RREQ ID are filled in per interface
+  void BroadcastRequest (RreqHeader & rreqHeader, uint16_t ttl);
   /// Send RREP
   void SendReply (RreqHeader const & rreqHeader, RoutingTableEntry const & toOrigin);
   /** Send RREP by intermediate node
@@ -238,8 +391,183 @@ private:
   void SendReplyAck (Ipv4Address neighbor);
   /// Initiate RERR
   void SendRerrWhenBreaksLinkToNextHop (Ipv4Address nextHop);
+  ///\name Pre-emptive route maintenance
+  //\{
+  /// Warn upstream nodes with RERR (N flag set) about routes through a neighbor with fading signal
+  void SendPreemptiveWarning (Ipv4Address nextHop);
+  /// Look for a new route to dst while the current one remains in use
+  void SendPreemptiveRequest (Ipv4Address dst);
+  //\}
+  ///\name Multipath
+  //\{
+  /**
+   * Add alternate path to dst through nextHop if route to dst is valid and has the same sequence number
+   * \param receiver address of the interface path goes through
+   * \return true if a new alternate path was added
+   */
+  bool AddAlternatePath (Ipv4Address dst, uint32_t seqNo, Ipv4Address nextHop, uint16_t hops,
+                         Ipv4Address receiver, Time lifetime, uint32_t energy);
+  /// Switch routes through nextHop to alternate paths, destinations still reachable are removed from unreachable
+  void FailoverToAlternatePaths (Ipv4Address nextHop, std::map<Ipv4Address, uint32_t> & unreachable);
+  /// Return route used for the next packet to destination of rt, chosen across its paths if energy balancing is enabled
+  Ptr<Ipv4Route> SelectRoute (RoutingTableEntry const & rt);
+  //\}
+  ///\name Link metric
+  //\{
+  /// Return metric of the link to neighbor
+  uint32_t GetLinkCost (Ipv4Address neighbor) const;
+  /// Return path metric carried by RREQ plus the cost of the link to src, 0 in hop count mode
+  uint32_t GetPathMetric (RreqHeader const & rreqHeader, Ipv4Address src) const;
+  /// Return path metric carried by RREP plus the cost of the link to src, 0 in hop count mode
+  uint32_t GetPathMetric (RrepHeader const & rrepHeader, Ipv4Address src) const;
+  /// Check that duplicate RREQ from src offers a better reverse route than the current one
+  bool IsBetterRequest (RreqHeader const & rreqHeader, Ipv4Address src);
+  /// End of the RREP collection window per destination of a completed route discovery
+  std::map<Ipv4Address, Time> m_replyWindows;
+  /// Check that RREPs for a route discovery to dst completed by this node are still collected
+  bool IsCollectingReplies (Ipv4Address dst);
+  /// Check that newEntry has a higher path energy than toDst, or the same and a lower cost
+  bool IsBetterReply (RoutingTableEntry const & newEntry, RoutingTableEntry const & toDst) const;
+  /// RREQ ID and end of the window per originator during which this node, the destination, answers copies of the RREQ
+  std::map<Ipv4Address, std::pair<uint32_t, Time> > m_requestWindows;
+  /// Check that duplicate RREQ from src is a copy of a RREQ for this node received within the window over a better path
+  bool IsBetterRequestCopy (RreqHeader const & rreqHeader, Ipv4Address src);
+  /// Indicates whether RREQ/RREP carry a path metric, i.e. link metric or congestion awareness is enabled
+  bool UsePathMetric () const { return m_linkMetric != HOP_COUNT_METRIC || m_congestionAware; }
+  //\}
+  ///\name Congestion awareness
+  //\{
+  /// Node load estimator
+  LoadMonitor m_load;
+  /// Load sampling timer
+  Timer m_loadTimer;
+  /// Sample node load and reschedule load sampling timer
+  void LoadTimerExpire ();
+  /// Return the largest MAC queue occupancy of the wifi interfaces, in [0, 1]
+  double GetMacQueueOccupancy () const;
+  /// Return cost added by this node to a path forwarded over the link to neighbor, 0 unless congestion aware
+  uint32_t GetLoadPenalty (Ipv4Address neighbor) const;
+  /// Indicates whether node load is measured
+  bool UseLoadMonitor () const { return m_congestionAware || m_admissionControl; }
+  //\}
+  ///\name Admission control
+  //\{
+  /// Rate hints per destination
+  std::map<Ipv4Address, DataRate> m_flowRates;
+  /// Soft reservations of relayed flows
+  ReservationTable m_reservations;
+  /// Return rate (bps) to request for flows to dst, 0 if none
+  uint64_t GetFlowRate (Ipv4Address dst) const;
+  /// Return rate (bps) this node can still carry for flow origin -> dst
+  uint64_t GetAvailableBandwidth (Ipv4Address origin, Ipv4Address dst);
+  //\}
+  /// Set TX power of the wifi manager of the output device of route for its next hop from the path loss to it
+  void ApplyTxPower (Ptr<Ipv4Route> route);
+  ///\name Residual energy
+  //\{
+  /**
+   * Sum the energy of the energy sources of this node (J)
+   * \param remaining remaining energy
+   * \param initial initial energy
+   * \return false if the node has no energy source
+   */
+  bool GetRemainingEnergy (double & remaining, double & initial) const;
+  /// Return residual energy of this node (mJ), maximum value if the node has no energy source
+  uint32_t GetResidualEnergy () const;
+  /// Return remaining fraction of the initial energy of this node, 1 if the node has no energy source
+  double GetEnergyFraction () const;
+  /// Indicates whether the node has withdrawn from relaying because its energy is low
+  bool m_withdrawn;
+  /// Check energy against withdrawal threshold, connected to RemainingEnergy trace source of the energy sources
+  void RemainingEnergyChanged (double oldValue, double newValue);
+  /// Withdraw below the withdrawal threshold, relay again above the threshold plus the rejoin margin
+  void UpdateWithdrawal (double energyFraction);
+  /// Stop relaying and send RERR for all relayed routes so that sources reroute
+  void WithdrawFromRelaying ();
+  /// Indicates whether routing is shut down because the energy of the node is depleted
+  bool m_depleted;
+  /// Harvesting and drain rates of this node
+  EnergyPredictor m_energyPredictor;
+  /// Device energy models of the energy sources of this node
+  std::vector<Ptr<DeviceEnergyModel> > m_energyModels;
+  /// Collect the device energy models of the energy sources of this node
+  void FindEnergyModels ();
+  /**
+   * Return path energy this node contributes: residual energy (mJ), or with HarvestingAware predicted
+   * time to depletion (s). Maximum value if the node has no energy source.
+   */
+  uint32_t GetNodeEnergy ();
+  /// Return extension type path energy is advertised with
+  ExtensionType GetEnergyExtension () const { return m_harvestingAware ? AODVEXT_PATH_LIFETIME : AODVEXT_PATH_ENERGY; }
+  /// Indicates whether path energy is advertised in RREQ and RREP
+  bool UsePathEnergy () const { return m_energyBalancing || m_harvestingAware || m_replyCollectionWindow > Seconds (0); }
+  /// Return path energy carried by the message, maximum value if it is not advertised
+  template <typename T>
+  uint32_t GetPathEnergy (T const & header) const
+  {
+    uint32_t energy = std::numeric_limits<uint32_t>::max ();
+    header.GetExtension (GetEnergyExtension (), energy);
+    return energy;
+  }
+  //\}
+  ///\name Duty cycling
+  //\{
+  /// Indicates whether the radios are asleep
+  bool m_asleep;
+  /// Time until which the node stays awake for route discovery or data traffic
+  Time m_awakeUntil;
+  /// Indicates whether a hello skipped while asleep is due in the next listen window
+  bool m_helloPending;
+  /// Duty cycle timer, expires at listen window boundaries
+  Timer m_dutyCycleTimer;
+  /// Wake up at the start of a listen window, sleep at its end if possible, and reschedule the duty cycle timer
+  void DutyCycleTimerExpire ();
+  /// Check that the node is on no active route and has no buffered packets
+  bool CanSleep ();
+  /// Keep the node awake for at least duration, waking it up if it is asleep
+  void KeepAwake (Time duration);
+  /// Put the PHYs of all wifi interfaces to sleep or wake them up
+  void SetRadiosAsleep (bool asleep);
+  /// Return delay of a broadcast, postponed into the next listen window if it would fall outside of one
+  Time AlignToListenWindow (Time delay);
+  //\}
+  /// Radio energy per message type and flow
+  EnergyAccounting m_energyAccounting;
+  /// Take TX and RX currents and supply voltage for energy accounting from the WifiRadioEnergyModel of the node
+  void SetupEnergyAccounting ();
+  ///\name Local repair (RFC 3561 section 6.12)
+  //\{
+  /**
+   * Start local repair of the route to dst, broken at the next hop
+   * \return false if the route can't be repaired locally and must be reported in RERR
+   */
+  bool StartLocalRepair (Ipv4Address dst);
+  /// Restore precursors, forward buffered packets and tell upstream nodes if the repaired route is longer
+  void FinishLocalRepair (Ipv4Address dst);
+  /// Drop buffered packets, invalidate the route and send RERR
+  void LocalRepairFailed (Ipv4Address dst);
+  /// Forward packets buffered during local repair
+  void SendPacketFromRepairQueue (Ipv4Address dst, Ptr<Ipv4Route> route);
+  //\}
+  /// Report unreachable destinations to precursors, either now or at the end of RERR aggregation window
+  void SendRerrForUnreachable (std::map<Ipv4Address, uint32_t> const & unreachable, std::vector<Ipv4Address> const & precursors);
+  /**
+   * Build RERRs carrying all unreachable destinations and send them to precursors
+   * \param now send at once, without jitter and regardless of the rate limit
+   * \return total size of RERRs built
+   */
+  uint32_t SendRerrMessages (std::map<Ipv4Address, uint32_t> const & unreachable, std::vector<Ipv4Address> const & precursors,
+                             bool noDelete, bool now = false);
+  /// Merge unreachable destinations into per-interface RERR aggregates
+  void AggregateRerr (std::map<Ipv4Address, uint32_t> const & unreachable, std::vector<Ipv4Address> const & precursors);
   /// Forward RERR
   void SendRerrMessage (Ptr<Packet> packet,  std::vector<Ipv4Address> precursors);
+  /// Send RERR to precursors regardless of the rate limit, after a jitter unless now is set
+  void TransmitRerrToPrecursors (Ptr<Packet> packet, std::vector<Ipv4Address> const & precursors, bool now = false);
+  /// Send RERR towards data packet origin regardless of the rate limit
+  void TransmitRerrToOrigin (Ptr<Packet> packet, Ipv4Address origin);
+  /// Queue RERR until a RERR token is available
+  void DeferRerr (Ptr<Packet> packet, std::vector<Ipv4Address> const & precursors, Ipv4Address origin);
   /**
    * Send RERR message when no route to forward input packet. Unicast if there is reverse route to originating node, broadcast otherwise.
    * \param dst - destination node IP address
@@ -250,19 +578,25 @@ private:
   /// @}
 
   void SendTo (Ptr<Socket> socket, Ptr<Packet> packet, Ipv4Address destination);
+  /// Return packet in the encoding used on socket, a compressed copy with CompactEncoding
+  Ptr<Packet> EncodeMessage (Ptr<Socket> socket, Ptr<Packet> packet) const;
 
   /// Hello timer
   Timer m_htimer;
   /// Schedule next send of hello message
   void HelloTimerExpire ();
-  /// RREQ rate limit timer
+  /// RREQ rate limit timer, runs only while destinations wait for a RREQ token
   Timer m_rreqRateLimitTimer;
-  /// Reset RREQ count and schedule RREQ rate limit timer with delay 1 sec.
+  /// Send queued RREQs as tokens allow and reschedule RREQ rate limit timer for the next token if needed.
   void RreqRateLimitTimerExpire ();
-  /// RERR rate limit timer
+  /// RERR rate limit timer, runs only while RERRs wait for a RERR token
   Timer m_rerrRateLimitTimer;
-  /// Reset RERR count and schedule RERR rate limit timer with delay 1 sec.
+  /// Send queued RERRs as tokens allow and reschedule RERR rate limit timer for the next token if needed.
   void RerrRateLimitTimerExpire ();
+  /// RERR aggregation timer, runs only while unreachable destinations wait in RERR aggregates
+  Timer m_rerrAggregationTimer;
+  /// Send all pending RERR aggregates
+  void RerrAggregationTimerExpire ();
   /// Map IP address + RREQ timer.
   std::map<Ipv4Address, Timer> m_addressReqTimer;
   /// Handle route discovery process
@@ -270,10 +604,98 @@ private:
   /// Mark link to neighbor node as unidirectional for blacklistTimeout
   void AckTimerExpire (Ipv4Address neighbor,  Time blacklistTimeout);
 
+  /**
+   * \name Protocol timers
+   * Timers are either independent ns-3 Timers or deadlines of the per-node
+   * DeadlineScheduler, depending on CoalescedTimers attribute.
+   * \{
+   */
+  /// Timer kinds, used as DeadlineScheduler deadline kind
+  enum TimerKind
+  {
+    HELLO_TIMER = 0,
+    NEIGHBOR_PURGE_TIMER = 1,
+    RREQ_RATE_LIMIT_TIMER = 2,
+    RERR_RATE_LIMIT_TIMER = 3,
+    RREQ_RETRY_TIMER = 4,
+    RREP_ACK_TIMER = 5,
+    RERR_AGGREGATION_TIMER = 6,
+    LOAD_TIMER = 7,
+    DUTY_CYCLE_TIMER = 8
+  };
+  /// Indicates whether all timers are multiplexed onto m_deadlines
+  bool m_coalescedTimers;
+  /// Per-node deadline scheduler
+  DeadlineScheduler m_deadlines;
+  /// (Re)schedule timer of given kind for address addr (Ipv4Address () for per-node timers)
+  void ScheduleTimer (TimerKind kind, Ipv4Address addr, Time delay);
+  /// Cancel timer of given kind for address addr
+  void CancelTimer (TimerKind kind, Ipv4Address addr);
+  /// Check that timer of given kind for address addr is running
+  bool IsTimerRunning (TimerKind kind, Ipv4Address addr) const;
+  /// Schedule neighbor purge at earliest neighbor expiration, used by Neighbors when timers are coalesced
+  void ScheduleNeighborPurge (Time delay);
+  /// Dispatch expired deadline
+  void DeadlineExpire (uint8_t kind, Ipv4Address addr);
+  /// \}
+
   /// Provides uniform random variables.
   Ptr<UniformRandomVariable> m_uniformRandomVariable;  
   /// Keep track of the last bcast time
   Time m_lastBcastTime;
+
+  ///\name Control message bundling
+  //\{
+  /// Messages to be sent in one packet
+  struct Bundle
+  {
+    /// Bundle identifier
+    uint32_t m_id;
+    /// Socket of the interface the bundle is sent on
+    Ptr<Socket> m_socket;
+    /// Destination address, broadcast or neighbor
+    Ipv4Address m_destination;
+    /// IP TTL of all messages
+    uint8_t m_ttl;
+    /// Send time of the bundle, the jittered send time of its first message
+    Time m_sendTime;
+    /// Encoded messages, each with its type header
+    std::vector<Ptr<Packet> > m_messages;
+    /// Size of the bundle packet
+    uint32_t m_size;
+  };
+  /// Pending bundles
+  std::vector<Bundle> m_bundles;
+  /// Identifier of the next bundle
+  uint32_t m_nextBundleId;
+  /**
+   * Send packet on socket after delay. With MessageBundling, it joins a pending bundle to the
+   * same destination with the same TTL due within BundleWindow of its own send time if there is
+   * room for it, else it starts a new bundle.
+   */
+  void ScheduleSendTo (Time delay, Ptr<Socket> socket, Ptr<Packet> packet, Ipv4Address destination);
+  /// Send bundle with identifier id, a single message is sent without bundle header
+  void SendBundle (uint32_t id);
+  //\}
+
+  ///\name Prebuilt control messages
+  //\{
+  /**
+   * Serialized hellos without extensions by interface address, with their type header.
+   * Dropped whenever the sequence number, HelloInterval or AllowedHelloLoss changes.
+   */
+  std::map<Ipv4Address, std::vector<uint8_t> > m_helloTemplates;
+  /// Packet with RREP-ACK, its type header and TTL tag, never sent itself
+  Ptr<Packet> m_rrepAckTemplate;
+  /**
+   * Return new packet with the bytes of template, sent with IP TTL ttl. The packet gets
+   * its own UID, so that duplicate detection of broadcasts still tells the copies apart,
+   * and its buffer is filled in one pass without serializing the message again.
+   */
+  static Ptr<Packet> CreateFromTemplate (std::vector<uint8_t> const & tmpl, uint8_t ttl);
+  /// Increment own sequence number, which changes the hellos of every interface
+  void IncrementSeqNo ();
+  //\}
 };
 
 }
@@ -86,6 +86,17 @@ RequestQueue::DropPacketWithDst (Ipv4Address dst)
                                  std::bind2nd (std::ptr_fun (RequestQueue::IsEqual), dst)), m_queue.end ());
 }
 
+void
+RequestQueue::DropAllPackets ()
+{
+  NS_LOG_FUNCTION (this);
+  for (std::vector<QueueEntry>::iterator i = m_queue.begin (); i != m_queue.end (); ++i)
+    {
+      Drop (*i, "DropAllPackets ");
+    }
+  m_queue.clear ();
+}
+
 bool
 RequestQueue::Dequeue (Ipv4Address dst, QueueEntry & entry)
 {
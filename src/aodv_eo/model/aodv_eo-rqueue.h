@@ -107,6 +107,8 @@ public:
   bool Dequeue (Ipv4Address dst, QueueEntry & entry);
   /// Remove all packets with destination IP address dst
   void DropPacketWithDst (Ipv4Address dst);
+  /// Remove all packets
+  void DropAllPackets ();
   /// Finds whether a packet with destination dst exists in the queue
   bool Find (Ipv4Address dst);
   /// Number of entries
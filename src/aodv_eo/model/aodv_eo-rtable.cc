@@ -38,7 +38,7 @@ namespace ns3
 
 NS_LOG_COMPONENT_DEFINE ("Aodv_EO_RoutingTable");
 
-namespace aodv
+namespace aodv_eo
 {
 
 /*
@@ -47,22 +47,50 @@ namespace aodv
 
 RoutingTableEntry::RoutingTableEntry (Ptr<NetDevice> dev, Ipv4Address dst, bool vSeqNo, uint32_t seqNo,
                                       Ipv4InterfaceAddress iface, uint16_t hops, Ipv4Address nextHop, Time lifetime) :
-  m_ackTimer (Timer::CANCEL_ON_DESTROY),
-  m_validSeqNo (vSeqNo), m_seqNo (seqNo), m_hops (hops),
-  m_lifeTime (lifetime + Simulator::Now ()), m_iface (iface), m_flag (VALID),
-  m_reqCount (0), m_blackListState (false), m_blackListTimeout (Simulator::Now ())
+  m_lifeTime (lifetime + Simulator::Now ()), m_blackListTimeout (Simulator::Now ()),
+  m_iface (iface), m_dst (dst), m_seqNo (seqNo), m_pathEnergy (std::numeric_limits<uint32_t>::max ()),
+  m_metric (0), m_hops (hops), m_advertisedHops (hops), m_flag (VALID), m_reqCount (0),
+  m_validSeqNo (vSeqNo), m_blackListState (false)
 {
-  m_ipv4Route = Create<Ipv4Route> ();
-  m_ipv4Route->SetDestination (dst);
-  m_ipv4Route->SetGateway (nextHop);
-  m_ipv4Route->SetSource (m_iface.GetLocal ());
-  m_ipv4Route->SetOutputDevice (dev);
+  ReplaceRoute (nextHop, dev, m_iface.GetLocal ());
 }
 
 RoutingTableEntry::~RoutingTableEntry ()
 {
 }
 
+/// Create route to the next hop
+static Ptr<Ipv4Route>
+CreateRoute (Ipv4Address nextHop, Ptr<NetDevice> dev, Ipv4Address source)
+{
+  Ptr<Ipv4Route> route = Create<Ipv4Route> ();
+  route->SetDestination (nextHop);
+  route->SetGateway (nextHop);
+  route->SetSource (source);
+  route->SetOutputDevice (dev);
+  return route;
+}
+
+void
+RoutingTableEntry::ReplaceRoute (Ipv4Address nextHop, Ptr<NetDevice> dev, Ipv4Address source)
+{
+  m_ipv4Route = CreateRoute (nextHop, dev, source);
+}
+
+void
+RoutingTableEntry::SetNextHop (Ipv4Address nextHop)
+{
+  if (nextHop != GetNextHop ())
+    ReplaceRoute (nextHop, GetOutputDevice (), m_ipv4Route->GetSource ());
+}
+
+void
+RoutingTableEntry::SetOutputDevice (Ptr<NetDevice> dev)
+{
+  if (dev != GetOutputDevice ())
+    ReplaceRoute (GetNextHop (), dev, m_ipv4Route->GetSource ());
+}
+
 bool
 RoutingTableEntry::InsertPrecursor (Ipv4Address id)
 {
@@ -155,13 +183,143 @@ RoutingTableEntry::Invalidate (Time badLinkLifetime)
   m_flag = INVALID;
   m_reqCount = 0;
   m_lifeTime = badLinkLifetime + Simulator::Now ();
+  m_alternatePaths.clear ();
+}
+
+bool
+RoutingTableEntry::InsertAlternatePath (Ipv4Address nextHop, Ptr<NetDevice> dev, Ipv4InterfaceAddress iface,
+                                        uint16_t hops, Time lifetime, uint32_t maxPaths, uint32_t energy)
+{
+  NS_LOG_FUNCTION (this << nextHop << hops);
+  if (nextHop == GetNextHop () || hops > m_advertisedHops)
+    {
+      return false;
+    }
+  for (std::vector<AlternatePath>::iterator i = m_alternatePaths.begin (); i != m_alternatePaths.end (); ++i)
+    {
+      if (i->m_nextHop == nextHop)
+        {
+          if (dev != i->m_outputDevice || iface.GetLocal () != i->m_iface.GetLocal ())
+            i->m_route = CreateRoute (nextHop, dev, iface.GetLocal ());
+          i->m_outputDevice = dev;
+          i->m_iface = iface;
+          i->m_hops = hops;
+          i->m_expireTime = std::max (i->m_expireTime, lifetime + Simulator::Now ());
+          i->m_energy = energy;
+          return false;
+        }
+    }
+  if (GetAlternatePathCount () >= maxPaths)
+    {
+      return false;
+    }
+  AlternatePath path;
+  path.m_nextHop = nextHop;
+  path.m_outputDevice = dev;
+  path.m_iface = iface;
+  path.m_hops = hops;
+  path.m_expireTime = lifetime + Simulator::Now ();
+  path.m_energy = energy;
+  path.m_route = CreateRoute (nextHop, dev, iface.GetLocal ());
+  m_alternatePaths.push_back (path);
+  return true;
+}
+
+struct IsAlternatePathThrough
+{
+  Ipv4Address m_nextHop;
+  bool operator() (RoutingTableEntry::AlternatePath const & path) const
+  {
+    return (path.m_nextHop == m_nextHop);
+  }
+};
+
+struct IsAlternatePathExpired
+{
+  bool operator() (RoutingTableEntry::AlternatePath const & path) const
+  {
+    return (path.m_expireTime < Simulator::Now ());
+  }
+};
+
+bool
+RoutingTableEntry::DeleteAlternatePath (Ipv4Address nextHop)
+{
+  NS_LOG_FUNCTION (this << nextHop);
+  IsAlternatePathThrough pred;
+  pred.m_nextHop = nextHop;
+  std::vector<AlternatePath>::iterator i = std::remove_if (m_alternatePaths.begin (), m_alternatePaths.end (), pred);
+  if (i == m_alternatePaths.end ())
+    return false;
+  m_alternatePaths.erase (i, m_alternatePaths.end ());
+  return true;
+}
+
+uint32_t
+RoutingTableEntry::GetAlternatePathCount () const
+{
+  IsAlternatePathExpired expired;
+  uint32_t count = 0;
+  for (std::vector<AlternatePath>::const_iterator i = m_alternatePaths.begin (); i != m_alternatePaths.end (); ++i)
+    {
+      if (!expired (*i))
+        count++;
+    }
+  return count;
+}
+
+bool
+RoutingTableEntry::SwitchToAlternatePath ()
+{
+  NS_LOG_FUNCTION (this);
+  m_alternatePaths.erase (std::remove_if (m_alternatePaths.begin (), m_alternatePaths.end (), IsAlternatePathExpired ()),
+                          m_alternatePaths.end ());
+  if (m_alternatePaths.empty ())
+    return false;
+  std::vector<AlternatePath>::iterator best = m_alternatePaths.begin ();
+  for (std::vector<AlternatePath>::iterator i = m_alternatePaths.begin (); i != m_alternatePaths.end (); ++i)
+    {
+      if (i->m_hops < best->m_hops)
+        best = i;
+    }
+  NS_LOG_LOGIC ("Switch route to " << GetDestination () << " from " << GetNextHop () << " to " << best->m_nextHop);
+  m_ipv4Route = best->m_route;
+  m_iface = best->m_iface;
+  m_hops = best->m_hops;
+  m_lifeTime = best->m_expireTime;
+  m_pathEnergy = best->m_energy;
+  m_alternatePaths.erase (best);
+  return true;
+}
+
+Ptr<Ipv4Route>
+RoutingTableEntry::GetBalancedRoute (double u) const
+{
+  IsAlternatePathExpired expired;
+  double total = m_pathEnergy;
+  for (std::vector<AlternatePath>::const_iterator i = m_alternatePaths.begin (); i != m_alternatePaths.end (); ++i)
+    {
+      if (!expired (*i))
+        total += i->m_energy;
+    }
+  // Primary path takes the first share, so with no energy known at all it is always used
+  double x = u * total - m_pathEnergy;
+  for (std::vector<AlternatePath>::const_iterator i = m_alternatePaths.begin (); i != m_alternatePaths.end () && x >= 0; ++i)
+    {
+      if (expired (*i))
+        continue;
+      if (x < i->m_energy)
+        return i->m_route;
+      x -= i->m_energy;
+    }
+  return m_ipv4Route;
 }
 
 void
 RoutingTableEntry::Print (Ptr<OutputStreamWrapper> stream) const
 {
   std::ostream* os = stream->GetStream ();
-  *os << m_ipv4Route->GetDestination () << "\t" << m_ipv4Route->GetGateway ()
+  *os << m_dst << "\t" << m_ipv4Route->GetGateway ()
       << "\t" << m_iface.GetLocal () << "\t";
   switch (m_flag)
     {
@@ -180,6 +338,11 @@ RoutingTableEntry::Print (Ptr<OutputStreamWrapper> stream) const
         *os << "IN_SEARCH";
         break;
       }
+    case IN_REPAIR:
+      {
+        *os << "IN_REPAIR";
+        break;
+      }
     }
   *os << "\t";
   *os << std::setiosflags (std::ios::fixed) << 
@@ -239,6 +402,7 @@ RoutingTable::DeleteRoute (Ipv4Address dst)
   Purge ();
   if (m_ipv4AddressEntry.erase (dst) != 0)
     {
+      PurgeRoutes ();
       NS_LOG_LOGIC ("Route deletion to " << dst << " successful");
       return true;
     }
@@ -253,6 +417,7 @@ RoutingTable::AddRoute (RoutingTableEntry & rt)
   Purge ();
   if (rt.GetFlag () != IN_SEARCH)
     rt.SetRreqCnt (0);
+  ShareRoute (rt);
   std::pair<std::map<Ipv4Address, RoutingTableEntry>::iterator, bool> result =
     m_ipv4AddressEntry.insert (std::make_pair (rt.GetDestination (), rt));
   return result.second;
@@ -269,6 +434,7 @@ RoutingTable::Update (RoutingTableEntry & rt)
       NS_LOG_LOGIC ("Route update to " << rt.GetDestination () << " fails; not found");
       return false;
     }
+  ShareRoute (rt);
   i->second = rt;
   if (i->second.GetFlag () != IN_SEARCH)
     {
@@ -278,6 +444,48 @@ RoutingTable::Update (RoutingTableEntry & rt)
   return true;
 }
 
+bool
+RoutingTable::RouteKey::operator< (RouteKey const & o) const
+{
+  if (m_nextHop != o.m_nextHop)
+    return m_nextHop < o.m_nextHop;
+  if (m_device != o.m_device)
+    return m_device < o.m_device;
+  return m_source < o.m_source;
+}
+
+void
+RoutingTable::ShareRoute (RoutingTableEntry & rt)
+{
+  Ptr<Ipv4Route> route = rt.GetRoute ();
+  RouteKey key;
+  key.m_nextHop = route->GetGateway ();
+  key.m_device = route->GetOutputDevice ();
+  key.m_source = route->GetSource ();
+  std::map<RouteKey, Ptr<Ipv4Route> >::const_iterator i = m_routes.find (key);
+  if (i == m_routes.end ())
+    {
+      // Entries may have moved away from other next hops since a route was last added
+      PurgeRoutes ();
+      NS_LOG_LOGIC ("New route through " << key.m_nextHop);
+      i = m_routes.insert (std::make_pair (key, route)).first;
+    }
+  rt.SetRoute (i->second);
+}
+
+void
+RoutingTable::PurgeRoutes ()
+{
+  for (std::map<RouteKey, Ptr<Ipv4Route> >::iterator i = m_routes.begin (); i != m_routes.end ();)
+    {
+      // Only the map holds the route
+      if (i->second->GetReferenceCount () == 1)
+        m_routes.erase (i++);
+      else
+        ++i;
+    }
+}
+
 bool
 RoutingTable::SetEntryState (Ipv4Address id, RouteFlags state)
 {
@@ -312,6 +520,23 @@ RoutingTable::GetListOfDestinationWithNextHop (Ipv4Address nextHop, std::map<Ipv
     }
 }
 
+void
+RoutingTable::GetListOfRelayedDestinations (std::map<Ipv4Address, uint32_t> & relayed, std::vector<Ipv4Address> & precursors)
+{
+  NS_LOG_FUNCTION (this);
+  Purge ();
+  relayed.clear ();
+  for (std::map<Ipv4Address, RoutingTableEntry>::const_iterator i =
+         m_ipv4AddressEntry.begin (); i != m_ipv4AddressEntry.end (); ++i)
+    {
+      if (i->second.GetFlag () == VALID && !i->second.IsPrecursorListEmpty ())
+        {
+          relayed.insert (std::make_pair (i->first, i->second.GetSeqNo ()));
+          i->second.GetPrecursors (precursors);
+        }
+    }
+}
+
 void
 RoutingTable::InvalidateRoutesWithDst (const std::map<Ipv4Address, uint32_t> & unreachable)
 {
@@ -350,6 +575,7 @@ RoutingTable::DeleteAllRoutesFromInterface (Ipv4InterfaceAddress iface)
       else
         ++i;
     }
+  PurgeRoutes ();
 }
 
 void
@@ -358,6 +584,7 @@ RoutingTable::Purge ()
   NS_LOG_FUNCTION (this);
   if (m_ipv4AddressEntry.empty ())
     return;
+  bool erased = false;
   for (std::map<Ipv4Address, RoutingTableEntry>::iterator i =
          m_ipv4AddressEntry.begin (); i != m_ipv4AddressEntry.end ();)
     {
@@ -368,6 +595,7 @@ RoutingTable::Purge ()
               std::map<Ipv4Address, RoutingTableEntry>::iterator tmp = i;
               ++i;
               m_ipv4AddressEntry.erase (tmp);
+              erased = true;
             }
           else if (i->second.GetFlag () == VALID)
             {
@@ -383,6 +611,8 @@ RoutingTable::Purge ()
           ++i;
         }
     }
+  if (erased)
+    PurgeRoutes ();
 }
 
 void
@@ -436,6 +666,17 @@ RoutingTable::MarkLinkAsUnidirectional (Ipv4Address neighbor, Time blacklistTime
   return true;
 }
 
+void
+RoutingTable::DeleteAlternatePaths (Ipv4Address nextHop)
+{
+  NS_LOG_FUNCTION (this << nextHop);
+  for (std::map<Ipv4Address, RoutingTableEntry>::iterator i =
+         m_ipv4AddressEntry.begin (); i != m_ipv4AddressEntry.end (); ++i)
+    {
+      i->second.DeleteAlternatePath (nextHop);
+    }
+}
+
 void
 RoutingTable::Print (Ptr<OutputStreamWrapper> stream) const
 {
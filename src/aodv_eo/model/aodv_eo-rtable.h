@@ -31,10 +31,10 @@
 #include <stdint.h>
 #include <cassert>
 #include <map>
+#include <limits>
 #include <sys/types.h>
 #include "ns3/ipv4.h"
 #include "ns3/ipv4-route.h"
-#include "ns3/timer.h"
 #include "ns3/net-device.h"
 #include "ns3/output-stream-wrapper.h"
 
@@ -42,7 +42,7 @@ namespace ns3 {
 namespace aodv_eo {
 
 /**
- * \ingroup aodv
+ * \ingroup aodv_eo
  * \brief Route record states
  */
 enum RouteFlags
@@ -50,11 +50,19 @@ enum RouteFlags
   VALID = 0,          //!< VALID
   INVALID = 1,        //!< INVALID
   IN_SEARCH = 2,      //!< IN_SEARCH
+  IN_REPAIR = 3,      //!< IN_REPAIR, route is being repaired locally
 };
 
 /**
- * \ingroup aodv
+ * \ingroup aodv_eo
  * \brief Routing table entry
+ *
+ * Entries are kept small, a node may hold a reverse route to every other node. The route to
+ * the next hop is shared by all entries through the same next hop, output device and source
+ * once the entry is in a RoutingTable, the RREP-ACK timer is kept by the routing protocol,
+ * and small fields are packed at the end. On LP64 the entry takes 120 bytes plus its
+ * precursor and alternate path vectors; it used to take 192 bytes (48 of them the RREP-ACK
+ * timer) plus a 24 byte Ipv4Route of its own on the heap.
  */
 class RoutingTableEntry
 {
@@ -99,16 +107,67 @@ public:
   void GetPrecursors (std::vector<Ipv4Address> & prec) const;
   //\}
 
+  ///\name Alternate paths management (multipath mode)
+  //\{
+  /// Alternate path to the destination through another next hop
+  struct AlternatePath
+  {
+    Ipv4Address m_nextHop;
+    Ptr<NetDevice> m_outputDevice;
+    Ipv4InterfaceAddress m_iface;
+    uint16_t m_hops;
+    Time m_expireTime;
+    uint32_t m_energy;
+    Ptr<Ipv4Route> m_route;   ///< Route to m_nextHop, built once for all packets balanced onto the path
+  };
+  /**
+   * Insert alternate path or refresh existing alternate path through the same next hop.
+   * A path is loop-free and accepted only if its next hop differs from the primary one and its hop count
+   * doesn't exceed the advertised hop count of the route.
+   * \param maxPaths maximum number of alternate paths
+   * \param energy minimum residual energy along the path
+   * \return true if a new alternate path was inserted
+   */
+  bool InsertAlternatePath (Ipv4Address nextHop, Ptr<NetDevice> dev, Ipv4InterfaceAddress iface,
+                            uint16_t hops, Time lifetime, uint32_t maxPaths,
+                            uint32_t energy = std::numeric_limits<uint32_t>::max ());
+  /// Delete alternate path through nextHop, return true if found
+  bool DeleteAlternatePath (Ipv4Address nextHop);
+  /// Delete all alternate paths
+  void DeleteAllAlternatePaths () { m_alternatePaths.clear (); }
+  /// Return number of unexpired alternate paths
+  uint32_t GetAlternatePathCount () const;
+  /**
+   * Replace primary path with the shortest unexpired alternate path
+   * \return false if there is no such alternate path
+   */
+  bool SwitchToAlternatePath ();
+  /**
+   * Choose primary or one of unexpired alternate paths with probability proportional to path energy
+   * \param u uniform random value in [0, 1)
+   * \return route through the chosen path
+   */
+  Ptr<Ipv4Route> GetBalancedRoute (double u) const;
+  /// Hop count advertised for current sequence number, upper bound for hop count of alternate paths
+  void SetAdvertisedHops (uint16_t hops) { m_advertisedHops = hops; }
+  uint16_t GetAdvertisedHops () const { return m_advertisedHops; }
+  //\}
+
   /// Mark entry as "down" (i.e. disable it)
   void Invalidate (Time badLinkLifetime);
   
   // Fields
-  Ipv4Address GetDestination () const { return m_ipv4Route->GetDestination (); }
+  Ipv4Address GetDestination () const { return m_dst; }
+  /**
+   * Return route to the next hop. Its destination is the next hop, not the destination of the
+   * entry, so GetDestination of the route differs from the Ipv4Route contract; the route is handed
+   * to IP as is. It may be shared by other entries and must not be modified.
+   */
   Ptr<Ipv4Route> GetRoute () const { return m_ipv4Route; }
   void SetRoute (Ptr<Ipv4Route> r) { m_ipv4Route = r; }
-  void SetNextHop (Ipv4Address nextHop) { m_ipv4Route->SetGateway (nextHop); }
+  void SetNextHop (Ipv4Address nextHop);
   Ipv4Address GetNextHop () const { return m_ipv4Route->GetGateway (); }
-  void SetOutputDevice (Ptr<NetDevice> dev) { m_ipv4Route->SetOutputDevice (dev); }
+  void SetOutputDevice (Ptr<NetDevice> dev);
   Ptr<NetDevice> GetOutputDevice () const { return m_ipv4Route->GetOutputDevice (); }
   Ipv4InterfaceAddress GetInterface () const { return m_iface; }
   void SetInterface (Ipv4InterfaceAddress iface) { m_iface = iface; }
@@ -121,7 +180,7 @@ public:
   void SetLifeTime (Time lt) { m_lifeTime = lt + Simulator::Now (); }
   Time GetLifeTime () const { return m_lifeTime - Simulator::Now (); }
   void SetFlag (RouteFlags flag) { m_flag = flag; }
-  RouteFlags GetFlag () const { return m_flag; }
+  RouteFlags GetFlag () const { return static_cast<RouteFlags> (m_flag); }
   void SetRreqCnt (uint8_t n) { m_reqCount = n; }
   uint8_t GetRreqCnt () const { return m_reqCount; }
   void IncrementRreqCnt () { m_reqCount++; }
@@ -129,8 +188,10 @@ public:
   bool IsUnidirectional () const { return m_blackListState; }
   void SetBalcklistTimeout (Time t) { m_blackListTimeout = t; }
   Time GetBlacklistTimeout () const { return m_blackListTimeout; }
-  /// RREP_ACK timer
-  Timer m_ackTimer;
+  void SetPathEnergy (uint32_t e) { m_pathEnergy = e; }
+  uint32_t GetPathEnergy () const { return m_pathEnergy; }
+  void SetMetric (uint32_t m) { m_metric = m; }
+  uint32_t GetMetric () const { return m_metric; }
 
   /**
    * \brief Compare destination address
@@ -138,17 +199,20 @@ public:
    */
   bool operator== (Ipv4Address const  dst) const
   {
-    return (m_ipv4Route->GetDestination () == dst);
+    return (m_dst == dst);
   }
   void Print (Ptr<OutputStreamWrapper> stream) const;
 
 private:
-  /// Valid Destination Sequence Number flag
-  bool m_validSeqNo;
-  /// Destination Sequence Number, if m_validSeqNo = true
-  uint32_t m_seqNo;
-  /// Hop Count (number of hops needed to reach destination)
-  uint16_t m_hops;
+  /// Replace route, routes may be shared and are never modified
+  void ReplaceRoute (Ipv4Address nextHop, Ptr<NetDevice> dev, Ipv4Address source);
+
+  /** Route to the next hop, include
+  *   - next hop address (destination and gateway)
+  *   - source address
+  *   - output device
+  */
+  Ptr<Ipv4Route> m_ipv4Route;
   /**
   * \brief Expiration or deletion time of the route
   *	Lifetime field in the routing table plays dual role --
@@ -156,28 +220,34 @@ private:
   *	it is the deletion time.
   */
   Time m_lifeTime;
-  /** Ip route, include
-  *   - destination address
-  *   - source address
-  *   - next hop address (gateway)
-  *   - output device
-  */
-  Ptr<Ipv4Route> m_ipv4Route;
-  /// Output interface address
-  Ipv4InterfaceAddress m_iface;
-  /// Routing flags: valid, invalid or in search
-  RouteFlags m_flag;
-
+  /// Time for which the node is put into the blacklist
+  Time m_blackListTimeout;
   /// List of precursors
   std::vector<Ipv4Address> m_precursorList;
-  /// When I can send another request
-  Time m_routeRequestTimout;
+  /// Alternate paths, used in multipath mode only
+  std::vector<AlternatePath> m_alternatePaths;
+  /// Output interface address
+  Ipv4InterfaceAddress m_iface;
+  /// Destination IP address
+  Ipv4Address m_dst;
+  /// Destination Sequence Number, if m_validSeqNo = true
+  uint32_t m_seqNo;
+  /// Minimum residual energy of the nodes on the primary path (mJ), maximum value if unknown
+  uint32_t m_pathEnergy;
+  /// Accumulated link metric (ETX or ETT) of the primary path, 0 if hop count is used
+  uint32_t m_metric;
+  /// Hop Count (number of hops needed to reach destination)
+  uint16_t m_hops;
+  /// Advertised hop count
+  uint16_t m_advertisedHops;
+  /// Routing flags: valid, invalid or in search, a RouteFlags value
+  uint8_t m_flag;
   /// Number of route requests
   uint8_t m_reqCount;
+  /// Valid Destination Sequence Number flag
+  bool m_validSeqNo;
   /// Indicate if this entry is in "blacklist"
   bool m_blackListState;
-  /// Time for which the node is put into the blacklist
-  Time m_blackListTimeout;
 };
 
 /**
@@ -221,6 +291,8 @@ public:
   bool SetEntryState (Ipv4Address dst, RouteFlags state);
   /// Lookup routing entries with next hop Address dst and not empty list of precursors.
   void GetListOfDestinationWithNextHop (Ipv4Address nextHop, std::map<Ipv4Address, uint32_t> & unreachable);
+  /// Lookup valid routing entries with not empty list of precursors, i.e. routes this node relays, and collect their precursors
+  void GetListOfRelayedDestinations (std::map<Ipv4Address, uint32_t> & relayed, std::vector<Ipv4Address> & precursors);
   /**
    *   Update routing entries with this destinations as follows:
    *  1. The destination sequence number of this routing entry, if it
@@ -232,7 +304,11 @@ public:
   /// Delete all route from interface with address iface
   void DeleteAllRoutesFromInterface (Ipv4InterfaceAddress iface);
   /// Delete all entries from routing table
-  void Clear () { m_ipv4AddressEntry.clear (); }
+  void Clear ()
+  {
+    m_ipv4AddressEntry.clear ();
+    m_routes.clear ();
+  }
   /// Delete all outdated entries and invalidate valid entry if Lifetime is expired
   void Purge ();
   /** Mark entry as unidirectional (e.g. add this neighbor to "blacklist" for blacklistTimeout period)
@@ -241,6 +317,8 @@ public:
    * \return true on success
    */
   bool MarkLinkAsUnidirectional (Ipv4Address neighbor, Time blacklistTimeout);
+  /// Delete alternate paths through nextHop from all entries
+  void DeleteAlternatePaths (Ipv4Address nextHop);
   /// Print routing table
   void Print (Ptr<OutputStreamWrapper> stream) const;
 
@@ -250,6 +328,21 @@ private:
   Time m_badLinkLifetime;
   /// const version of Purge, for use by Print() method
   void Purge (std::map<Ipv4Address, RoutingTableEntry> &table) const;
+
+  /// Next hop, output device and source address of a route
+  struct RouteKey
+  {
+    Ipv4Address m_nextHop;
+    Ptr<NetDevice> m_device;
+    Ipv4Address m_source;
+    bool operator< (RouteKey const & o) const;
+  };
+  /// Routes shared by the entries through the same next hop, output device and source
+  std::map<RouteKey, Ptr<Ipv4Route> > m_routes;
+  /// Replace route of entry rt with the shared route through the same next hop, output device and source
+  void ShareRoute (RoutingTableEntry & rt);
+  /// Drop shared routes no entry uses any more
+  void PurgeRoutes ();
 };
 
 }
@@ -0,0 +1,83 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "aodv_eo-token-bucket.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ns3
+{
+namespace aodv_eo
+{
+
+TokenBucket::TokenBucket (uint32_t rate, uint32_t burst) :
+  m_rate (rate), m_burst (std::max<uint32_t> (burst, 1)), m_fullTime (Seconds (0))
+{
+}
+
+bool
+TokenBucket::Consume ()
+{
+  if (m_rate == 0)
+    return false;
+  Time now = Simulator::Now ();
+  Time full = std::max (m_fullTime, now);
+  // Bucket holds at least one token while it is less than m_burst tokens away from being full
+  if (full - now > (m_burst - 1) * GetInterval ())
+    return false;
+  m_fullTime = full + GetInterval ();
+  return true;
+}
+
+Time
+TokenBucket::GetDelayLeft () const
+{
+  if (m_rate == 0)
+    return Simulator::GetMaximumSimulationTime ();
+  Time now = Simulator::Now ();
+  Time full = std::max (m_fullTime, now);
+  Time delay = full - now - (m_burst - 1) * GetInterval ();
+  return std::max (delay, Seconds (0));
+}
+
+uint32_t
+TokenBucket::GetTokens () const
+{
+  if (m_rate == 0)
+    return 0;
+  Time now = Simulator::Now ();
+  Time full = std::max (m_fullTime, now);
+  uint32_t missing = (uint32_t) std::ceil ((full - now).GetSeconds () * m_rate);
+  return (missing >= m_burst) ? 0 : m_burst - missing;
+}
+
+void
+TokenBucket::SetRate (uint32_t rate)
+{
+  m_rate = rate;
+  Reset ();
+}
+
+void
+TokenBucket::SetBurst (uint32_t burst)
+{
+  m_burst = std::max<uint32_t> (burst, 1);
+  Reset ();
+}
+
+}
+}
@@ -0,0 +1,70 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef AODV_EO_TOKEN_BUCKET_H
+#define AODV_EO_TOKEN_BUCKET_H
+
+#include "ns3/nstime.h"
+#include "ns3/simulator.h"
+
+namespace ns3
+{
+namespace aodv_eo
+{
+/**
+ * \ingroup aodv_eo
+ *
+ * \brief Token bucket used for RREQ_RATELIMIT and RERR_RATELIMIT control.
+ *
+ * The bucket holds at most Burst tokens and is refilled with Rate tokens per second.
+ * It is implemented in its "virtual scheduling" form: instead of a token counter
+ * refilled by a periodic timer it keeps the theoretical time at which the bucket
+ * would be full again, so no event is ever needed to refill it and the time to
+ * the next token is exact.
+ */
+class TokenBucket
+{
+public:
+  /// c-tor
+  TokenBucket (uint32_t rate = 10, uint32_t burst = 10);
+  /// Take one token from the bucket if available
+  bool Consume ();
+  /// Return time left until next token is available, zero if a token is available now
+  Time GetDelayLeft () const;
+  /// Return number of whole tokens available now
+  uint32_t GetTokens () const;
+  /// Set refill rate in tokens per second, zero disables the bucket (no token is ever available)
+  void SetRate (uint32_t rate);
+  uint32_t GetRate () const { return m_rate; }
+  /// Set maximum number of tokens in the bucket
+  void SetBurst (uint32_t burst);
+  uint32_t GetBurst () const { return m_burst; }
+  /// Refill the bucket
+  void Reset () { m_fullTime = Simulator::Now (); }
+private:
+  /// Refill period of a single token
+  Time GetInterval () const { return Seconds (1.0 / m_rate); }
+  /// Tokens per second
+  uint32_t m_rate;
+  /// Bucket size
+  uint32_t m_burst;
+  /// Time when the bucket will be full again
+  Time m_fullTime;
+};
+
+}
+}
+#endif /* AODV_EO_TOKEN_BUCKET_H */
@@ -0,0 +1,165 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "aodv_eo-tx-power-wifi-manager.h"
+#include "ns3/wifi-phy.h"
+#include "ns3/uinteger.h"
+#include "ns3/log.h"
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE ("AodvEOTxPowerWifiManager");
+
+namespace aodv_eo
+{
+NS_OBJECT_ENSURE_REGISTERED (TxPowerWifiManager);
+
+TypeId
+TxPowerWifiManager::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::aodv_eo::TxPowerWifiManager")
+    .SetParent<WifiRemoteStationManager> ()
+    .SetGroupName ("Aodv_EO")
+    .AddConstructor<TxPowerWifiManager> ()
+    .AddAttribute ("DataMode", "The transmission mode to use for every data packet transmission, "
+                   "the lowest mode of the PHY if not set.",
+                   WifiModeValue (),
+                   MakeWifiModeAccessor (&TxPowerWifiManager::m_dataMode),
+                   MakeWifiModeChecker ())
+    .AddAttribute ("ControlMode", "The transmission mode to use for every RTS packet transmission, "
+                   "the lowest mode of the PHY if not set.",
+                   WifiModeValue (),
+                   MakeWifiModeAccessor (&TxPowerWifiManager::m_ctlMode),
+                   MakeWifiModeChecker ())
+  ;
+  return tid;
+}
+
+TxPowerWifiManager::TxPowerWifiManager ()
+{
+}
+
+TxPowerWifiManager::~TxPowerWifiManager ()
+{
+}
+
+void
+TxPowerWifiManager::SetupPhy (Ptr<WifiPhy> phy)
+{
+  WifiRemoteStationManager::SetupPhy (phy);
+  // Unlike a fixed default, the lowest mode exists in every standard
+  if (m_dataMode == WifiMode ())
+    m_dataMode = phy->GetMode (0);
+  if (m_ctlMode == WifiMode ())
+    m_ctlMode = phy->GetMode (0);
+  // Broadcasts and unknown stations get full power
+  SetAttribute ("DefaultTxPowerLevel", UintegerValue (phy->GetNTxPower () - 1));
+}
+
+void
+TxPowerWifiManager::SetStationTxPowerLevel (Mac48Address address, uint8_t level)
+{
+  NS_LOG_FUNCTION (this << address << (uint16_t) level);
+  m_levels[address] = level;
+}
+
+void
+TxPowerWifiManager::ResetStationTxPowerLevel (Mac48Address address)
+{
+  m_levels.erase (address);
+}
+
+uint8_t
+TxPowerWifiManager::GetStationTxPowerLevel (Mac48Address address) const
+{
+  std::map<Mac48Address, uint8_t>::const_iterator i = m_levels.find (address);
+  return (i != m_levels.end ()) ? i->second : GetDefaultTxPowerLevel ();
+}
+
+WifiRemoteStation *
+TxPowerWifiManager::DoCreateStation (void) const
+{
+  return new WifiRemoteStation ();
+}
+
+void
+TxPowerWifiManager::DoReportRxOk (WifiRemoteStation *station, double rxSnr, WifiMode txMode)
+{
+}
+
+void
+TxPowerWifiManager::DoReportRtsFailed (WifiRemoteStation *station)
+{
+}
+
+void
+TxPowerWifiManager::DoReportDataFailed (WifiRemoteStation *station)
+{
+}
+
+void
+TxPowerWifiManager::DoReportRtsOk (WifiRemoteStation *st, double ctsSnr, WifiMode ctsMode, double rtsSnr)
+{
+}
+
+void
+TxPowerWifiManager::DoReportDataOk (WifiRemoteStation *st, double ackSnr, WifiMode ackMode, double dataSnr)
+{
+}
+
+void
+TxPowerWifiManager::DoReportFinalRtsFailed (WifiRemoteStation *station)
+{
+}
+
+void
+TxPowerWifiManager::DoReportFinalDataFailed (WifiRemoteStation *station)
+{
+}
+
+WifiTxVector
+TxPowerWifiManager::DoGetDataTxVector (WifiRemoteStation *st)
+{
+  WifiTxVector txVector;
+  txVector.SetMode (m_dataMode);
+  txVector.SetTxPowerLevel (GetStationTxPowerLevel (st->m_state->m_address));
+  txVector.SetRetries (GetLongRetryCount (st));
+  txVector.SetChannelWidth (GetChannelWidth (st));
+  txVector.SetNss (1);
+  return txVector;
+}
+
+WifiTxVector
+TxPowerWifiManager::DoGetRtsTxVector (WifiRemoteStation *st)
+{
+  WifiTxVector txVector;
+  txVector.SetMode (m_ctlMode);
+  txVector.SetTxPowerLevel (GetStationTxPowerLevel (st->m_state->m_address));
+  txVector.SetRetries (GetShortRetryCount (st));
+  txVector.SetChannelWidth (GetChannelWidth (st));
+  txVector.SetNss (1);
+  return txVector;
+}
+
+bool
+TxPowerWifiManager::IsLowLatency (void) const
+{
+  return true;
+}
+
+}
+}
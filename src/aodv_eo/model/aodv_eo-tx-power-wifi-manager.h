@@ -0,0 +1,78 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef AODV_EO_TX_POWER_WIFI_MANAGER_H
+#define AODV_EO_TX_POWER_WIFI_MANAGER_H
+
+#include "ns3/wifi-remote-station-manager.h"
+#include "ns3/mac48-address.h"
+#include <map>
+
+namespace ns3
+{
+namespace aodv_eo
+{
+/**
+ * \ingroup aodv_eo
+ *
+ * \brief Constant rate wifi manager with a TX power level per remote station.
+ *
+ * Data and RTS frames to a station go out at the power level set for it by the
+ * routing protocol, all other frames (broadcasts in particular) at the highest
+ * level of the PHY. Rates are chosen like in ns3::ConstantRateWifiManager, except
+ * that DataMode and ControlMode default to the lowest mode of the PHY standard.
+ */
+class TxPowerWifiManager : public WifiRemoteStationManager
+{
+public:
+  static TypeId GetTypeId (void);
+  /// c-tor
+  TxPowerWifiManager ();
+  virtual ~TxPowerWifiManager ();
+
+  virtual void SetupPhy (Ptr<WifiPhy> phy);
+  /// Send frames to station address at TX power level
+  void SetStationTxPowerLevel (Mac48Address address, uint8_t level);
+  /// Send frames to station address at the default (highest) TX power level again
+  void ResetStationTxPowerLevel (Mac48Address address);
+  /// Return TX power level used for station address
+  uint8_t GetStationTxPowerLevel (Mac48Address address) const;
+
+private:
+  // Overridden from base class
+  virtual WifiRemoteStation* DoCreateStation (void) const;
+  virtual void DoReportRxOk (WifiRemoteStation *station, double rxSnr, WifiMode txMode);
+  virtual void DoReportRtsFailed (WifiRemoteStation *station);
+  virtual void DoReportDataFailed (WifiRemoteStation *station);
+  virtual void DoReportRtsOk (WifiRemoteStation *station, double ctsSnr, WifiMode ctsMode, double rtsSnr);
+  virtual void DoReportDataOk (WifiRemoteStation *station, double ackSnr, WifiMode ackMode, double dataSnr);
+  virtual void DoReportFinalRtsFailed (WifiRemoteStation *station);
+  virtual void DoReportFinalDataFailed (WifiRemoteStation *station);
+  virtual WifiTxVector DoGetDataTxVector (WifiRemoteStation *station);
+  virtual WifiTxVector DoGetRtsTxVector (WifiRemoteStation *station);
+  virtual bool IsLowLatency (void) const;
+
+  /// Data rate
+  WifiMode m_dataMode;
+  /// Control rate
+  WifiMode m_ctlMode;
+  /// TX power level per station
+  std::map<Mac48Address, uint8_t> m_levels;
+};
+
+}
+}
+#endif /* AODV_EO_TX_POWER_WIFI_MANAGER_H */
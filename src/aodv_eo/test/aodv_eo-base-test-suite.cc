@@ -18,15 +18,15 @@
  * Authors: Pavel Boyko <boyko@iitp.ru>
  */
 #include "ns3/test.h"
-#include "ns3/aodv-neighbor.h"
-#include "ns3/aodv-packet.h"
-#include "ns3/aodv-rqueue.h"
-#include "ns3/aodv-rtable.h"
+#include "ns3/aodv_eo-neighbor.h"
+#include "ns3/aodv_eo-packet.h"
+#include "ns3/aodv_eo-rqueue.h"
+#include "ns3/aodv_eo-rtable.h"
 #include "ns3/ipv4-route.h"
 
 namespace ns3
 {
-namespace aodv
+namespace aodv_eo
 {
 
 /// Unit test for neighbors
@@ -442,7 +442,7 @@ struct AodvRtableEntryTest : public TestCase
     rt.SetLifeTime (MilliSeconds (100));
     NS_TEST_EXPECT_MSG_EQ (rt.GetLifeTime (), MilliSeconds (100), "trivial");
     Ptr<Ipv4Route> route = rt.GetRoute ();
-    NS_TEST_EXPECT_MSG_EQ (route->GetDestination (), Ipv4Address ("1.2.3.4"), "trivial");
+    NS_TEST_EXPECT_MSG_EQ (route->GetDestination (), Ipv4Address ("1.1.1.1"), "Route is shared per next hop");
 
     NS_TEST_EXPECT_MSG_EQ (rt.InsertPrecursor (Ipv4Address ("10.0.0.1")), true, "trivial");
     NS_TEST_EXPECT_MSG_EQ (rt.IsPrecursorListEmpty (), false, "trivial");
@@ -520,10 +520,10 @@ struct AodvRtableTest : public TestCase
   }
 };
 //-----------------------------------------------------------------------------
-class AodvTestSuite : public TestSuite
+class AodvEoBaseTestSuite : public TestSuite
 {
 public:
-  AodvTestSuite () : TestSuite ("routing-aodv", UNIT)
+  AodvEoBaseTestSuite () : TestSuite ("routing-aodv_eo-base", UNIT)
   {
     AddTestCase (new NeighborTest, TestCase::QUICK);
     AddTestCase (new TypeHeaderTest, TestCase::QUICK);
@@ -536,7 +536,7 @@ public:
     AddTestCase (new AodvRtableEntryTest, TestCase::QUICK);
     AddTestCase (new AodvRtableTest, TestCase::QUICK);
   }
-} g_aodvTestSuite;
+} g_aodvEoBaseTestSuite;
 
 }
 }
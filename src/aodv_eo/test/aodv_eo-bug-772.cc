@@ -18,7 +18,7 @@
  * Authors: Pavel Boyko <boyko@iitp.ru>
  */
 
-#include "bug-772.h"
+#include "aodv_eo-bug-772.h"
 
 #include "ns3/simulator.h"
 #include "ns3/random-variable-stream.h"
@@ -35,7 +35,7 @@
 #include "ns3/abort.h"
 #include "ns3/mobility-model.h"
 #include "ns3/pcap-file.h"
-#include "ns3/aodv-helper.h"
+#include "ns3/aodv_eo-helper.h"
 #include "ns3/v4ping-helper.h"
 #include "ns3/config.h"
 #include "ns3/inet-socket-address.h"
@@ -43,7 +43,10 @@
 #include "ns3/pcap-test.h"
 #include <sstream>
 
-using namespace ns3;
+namespace ns3
+{
+namespace aodv_eo
+{
 
 //-----------------------------------------------------------------------------
 // UdpChainTest
@@ -146,8 +149,8 @@ Bug772ChainTest::CreateDevices ()
   // Assign 0 streams per channel for this configuration 
   NS_TEST_ASSERT_MSG_EQ (streamsUsed, (devices.GetN () * 6), "Stream assignment mismatch");
 
-  // 2. Setup TCP/IP & AODV
-  AodvHelper aodv; // Use default parameters here
+  // 2. Setup TCP/IP & AODV_EO
+  AodvEOHelper aodv; // Use default parameters here
   InternetStackHelper internetStack;
   internetStack.SetRoutingHelper (aodv);
   internetStack.Install (*m_nodes);
@@ -155,7 +158,7 @@ Bug772ChainTest::CreateDevices ()
   // Expect to use (3*m_size) more streams for internet stack random variables
   NS_TEST_ASSERT_MSG_EQ (streamsUsed, ((devices.GetN () * 6) + (3*m_size)), "Stream assignment mismatch");
   streamsUsed += aodv.AssignStreams (*m_nodes, streamsUsed);
-  // Expect to use m_size more streams for AODV
+  // Expect to use m_size more streams for AODV_EO
   NS_TEST_ASSERT_MSG_EQ (streamsUsed, ((devices.GetN () * 6) + (3*m_size) + m_size), "Stream assignment mismatch");
   Ipv4AddressHelper address;
   address.SetBase ("10.1.1.0", "255.255.255.0");
@@ -184,3 +187,6 @@ Bug772ChainTest::CheckResults ()
   // Check that the received packet count is 8
   NS_TEST_EXPECT_MSG_EQ (m_receivedPackets, 8, "Did not receive expected 8 packets");
 }
+
+}
+}
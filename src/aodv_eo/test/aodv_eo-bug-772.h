@@ -18,20 +18,23 @@
  * Authors: Pavel Boyko <boyko@iitp.ru>
  */
 
-#ifndef BUG_772_H
-#define BUG_772_H
+#ifndef AODV_EO_BUG_772_H
+#define AODV_EO_BUG_772_H
 
 #include "ns3/test.h"
 #include "ns3/nstime.h"
 #include "ns3/node-container.h"
 #include "ns3/socket.h"
 
-using namespace ns3;
+namespace ns3
+{
+namespace aodv_eo
+{
 
 /**
- * \ingroup aodv
+ * \ingroup aodv_eo
  * 
- * \brief AODV deferred route lookup test case (see \bugid{772})
+ * \brief AODV_EO deferred route lookup test case (see \bugid{772})
  * 
  * UDP packet transfers are delayed while a route is found and then while
  * ARP completes.  Eight packets should be sent, queued until the path
@@ -94,4 +97,7 @@ private:
   void SendData (Ptr<Socket> socket);
 };
 
-#endif /* BUG_772_H */
+}
+}
+
+#endif /* AODV_EO_BUG_772_H */
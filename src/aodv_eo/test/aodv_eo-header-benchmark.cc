@@ -0,0 +1,259 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "ns3/test.h"
+#include "ns3/aodv_eo-packet.h"
+#include "ns3/packet.h"
+#include "ns3/buffer.h"
+#include "ns3/socket.h"
+#include "ns3/system-wall-clock-ms.h"
+#include <iostream>
+#include <vector>
+
+namespace ns3
+{
+namespace aodv_eo
+{
+
+//-----------------------------------------------------------------------------
+// Benchmarks
+//-----------------------------------------------------------------------------
+/// Number of operations timed per measurement
+static const uint32_t BENCHMARK_ITERATIONS = 200000;
+
+/**
+ * Microbenchmark of the headers of one message type: serialization to a buffer,
+ * deserialization from a buffer, and adding and removing the headers on a packet,
+ * each timed for the separate type and message headers and for the fused MessageHeader.
+ * Run with ./test.py --constrain=performance or --suite=routing-aodv_eo-headers.
+ */
+template <MessageType Type, typename T>
+class HeaderBenchmark : public TestCase
+{
+public:
+  HeaderBenchmark (std::string name, T const & message)
+    : TestCase (name), m_message (message)
+  {
+  }
+private:
+  virtual void DoRun ();
+  /// Report time of both variants in ns per operation
+  void Report (std::string operation, int64_t separate, int64_t fused);
+
+  T m_message;
+};
+
+template <MessageType Type, typename T>
+void
+HeaderBenchmark<Type, T>::Report (std::string operation, int64_t separate, int64_t fused)
+{
+  std::cout << GetName () << " " << operation
+            << ": separate " << separate * 1e6 / BENCHMARK_ITERATIONS << " ns"
+            << ", fused " << fused * 1e6 / BENCHMARK_ITERATIONS << " ns" << std::endl;
+}
+
+template <MessageType Type, typename T>
+void
+HeaderBenchmark<Type, T>::DoRun ()
+{
+  TypeHeader tHeader (Type);
+  MessageHeader<Type, T> fused (m_message);
+  uint32_t size = fused.GetSerializedSize ();
+  NS_TEST_ASSERT_MSG_EQ (size, tHeader.GetSerializedSize () + m_message.GetSerializedSize (), "Same size");
+
+  // Both variants must produce the same bytes
+  Ptr<Packet> separatePacket = Create<Packet> ();
+  separatePacket->AddHeader (m_message);
+  separatePacket->AddHeader (tHeader);
+  Ptr<Packet> fusedPacket = Create<Packet> ();
+  fusedPacket->AddHeader (fused);
+  std::vector<uint8_t> separateBytes (size);
+  std::vector<uint8_t> fusedBytes (size);
+  NS_TEST_ASSERT_MSG_EQ (separatePacket->CopyData (&separateBytes[0], size), size, "Whole message");
+  NS_TEST_ASSERT_MSG_EQ (fusedPacket->CopyData (&fusedBytes[0], size), size, "Whole message");
+  NS_TEST_EXPECT_MSG_EQ ((separateBytes == fusedBytes), true, "Same bytes");
+
+  MessageHeader<Type, T> fusedCopy;
+  NS_TEST_EXPECT_MSG_EQ (fusedPacket->RemoveHeader (fusedCopy), size, "Whole message");
+  NS_TEST_EXPECT_MSG_EQ (fusedCopy.IsValid (), true, "Type matches");
+  NS_TEST_EXPECT_MSG_EQ (fusedCopy.GetMessage ().GetSerializedSize (), m_message.GetSerializedSize (), "Same message");
+
+  SystemWallClockMs clock;
+  int64_t separate;
+  int64_t fused;
+
+  // Serialize
+  clock.Start ();
+  for (uint32_t i = 0; i < BENCHMARK_ITERATIONS; ++i)
+    {
+      Buffer buffer;
+      buffer.AddAtStart (m_message.GetSerializedSize ());
+      m_message.Serialize (buffer.Begin ());
+      buffer.AddAtStart (tHeader.GetSerializedSize ());
+      tHeader.Serialize (buffer.Begin ());
+    }
+  separate = clock.End ();
+  clock.Start ();
+  for (uint32_t i = 0; i < BENCHMARK_ITERATIONS; ++i)
+    {
+      Buffer buffer;
+      buffer.AddAtStart (fused.GetSerializedSize ());
+      fused.Serialize (buffer.Begin ());
+    }
+  fused = clock.End ();
+  Report ("serialize", separate, fused);
+
+  // Deserialize
+  Buffer buffer;
+  buffer.AddAtStart (size);
+  fused.Serialize (buffer.Begin ());
+  uint32_t read = 0;
+  clock.Start ();
+  for (uint32_t i = 0; i < BENCHMARK_ITERATIONS; ++i)
+    {
+      TypeHeader t;
+      T m;
+      Buffer::Iterator start = buffer.Begin ();
+      start.Next (t.Deserialize (start));
+      read += m.Deserialize (start);
+    }
+  separate = clock.End ();
+  clock.Start ();
+  for (uint32_t i = 0; i < BENCHMARK_ITERATIONS; ++i)
+    {
+      MessageHeader<Type, T> f;
+      read += f.Deserialize (buffer.Begin ());
+    }
+  fused = clock.End ();
+  NS_TEST_EXPECT_MSG_EQ (read, BENCHMARK_ITERATIONS * (2 * size - 1), "Every message read");
+  Report ("deserialize", separate, fused);
+
+  // Add and remove on a packet
+  clock.Start ();
+  for (uint32_t i = 0; i < BENCHMARK_ITERATIONS; ++i)
+    {
+      Ptr<Packet> packet = Create<Packet> ();
+      packet->AddHeader (m_message);
+      packet->AddHeader (tHeader);
+      TypeHeader t;
+      T m;
+      packet->RemoveHeader (t);
+      packet->RemoveHeader (m);
+    }
+  separate = clock.End ();
+  clock.Start ();
+  for (uint32_t i = 0; i < BENCHMARK_ITERATIONS; ++i)
+    {
+      Ptr<Packet> packet = Create<Packet> ();
+      packet->AddHeader (fused);
+      MessageHeader<Type, T> f;
+      packet->RemoveHeader (f);
+    }
+  fused = clock.End ();
+  Report ("packet add/remove", separate, fused);
+}
+//-----------------------------------------------------------------------------
+/**
+ * Microbenchmark of the packets of a hello sent by RoutingProtocol::SendHello: built and
+ * serialized for every send, created from the bytes of the hello template, and copied
+ * from a template packet as RREP-ACKs are, which shares the UID and so only fits unicasts.
+ */
+class TemplateBenchmark : public TestCase
+{
+public:
+  TemplateBenchmark () : TestCase ("hello template")
+  {
+  }
+private:
+  virtual void DoRun ();
+};
+
+void
+TemplateBenchmark::DoRun ()
+{
+  RrepHeader hello;
+  hello.SetHello (Ipv4Address ("10.1.1.1"), 40, Seconds (2));
+  SocketIpTtlTag tag;
+  tag.SetTtl (1);
+
+  Ptr<Packet> built = Create<Packet> ();
+  built->AddHeader (RrepMessage (hello));
+  std::vector<uint8_t> bytes (built->GetSize ());
+  built->CopyData (&bytes[0], built->GetSize ());
+  Ptr<Packet> tmpl = built->Copy ();
+  tmpl->AddPacketTag (tag);
+
+  Ptr<Packet> fromBytes = Create<Packet> (&bytes[0], (uint32_t) bytes.size ());
+  NS_TEST_EXPECT_MSG_NE (fromBytes->GetUid (), built->GetUid (), "Own UID");
+  std::vector<uint8_t> sent (bytes.size ());
+  fromBytes->CopyData (&sent[0], (uint32_t) sent.size ());
+  NS_TEST_EXPECT_MSG_EQ ((sent == bytes), true, "Same bytes");
+
+  SystemWallClockMs clock;
+  clock.Start ();
+  for (uint32_t i = 0; i < BENCHMARK_ITERATIONS; ++i)
+    {
+      Ptr<Packet> packet = Create<Packet> ();
+      packet->AddHeader (RrepMessage (hello));
+      packet->AddPacketTag (tag);
+    }
+  int64_t build = clock.End ();
+  clock.Start ();
+  for (uint32_t i = 0; i < BENCHMARK_ITERATIONS; ++i)
+    {
+      Ptr<Packet> packet = Create<Packet> (&bytes[0], (uint32_t) bytes.size ());
+      packet->AddPacketTag (tag);
+    }
+  int64_t fromTemplate = clock.End ();
+  clock.Start ();
+  for (uint32_t i = 0; i < BENCHMARK_ITERATIONS; ++i)
+    {
+      Ptr<Packet> packet = tmpl->Copy ();
+    }
+  int64_t copy = clock.End ();
+  std::cout << GetName ()
+            << ": build " << build * 1e6 / BENCHMARK_ITERATIONS << " ns"
+            << ", from template " << fromTemplate * 1e6 / BENCHMARK_ITERATIONS << " ns"
+            << ", copy " << copy * 1e6 / BENCHMARK_ITERATIONS << " ns" << std::endl;
+}
+//-----------------------------------------------------------------------------
+class AodvEoHeaderBenchmarkSuite : public TestSuite
+{
+public:
+  AodvEoHeaderBenchmarkSuite () : TestSuite ("routing-aodv_eo-headers", PERFORMANCE)
+  {
+    RreqHeader rreq (/*flags*/ 0, /*reserved*/ 0, /*hopCount*/ 3, /*requestID*/ 7, /*dst*/ Ipv4Address ("10.1.1.9"),
+                     /*dstSeqNo*/ 12, /*origin*/ Ipv4Address ("10.1.1.1"), /*originSeqNo*/ 40);
+    rreq.SetExtension (AODVEXT_PATH_ENERGY, 5000);
+    AddTestCase (new HeaderBenchmark<AODVTYPE_RREQ, RreqHeader> ("RREQ", rreq), TestCase::QUICK);
+
+    RrepHeader hello;
+    hello.SetHello (Ipv4Address ("10.1.1.1"), 40, Seconds (2));
+    AddTestCase (new HeaderBenchmark<AODVTYPE_RREP, RrepHeader> ("RREP", hello), TestCase::QUICK);
+
+    RerrHeader rerr;
+    rerr.AddUnDestination (Ipv4Address ("10.1.1.9"), 13);
+    rerr.AddUnDestination (Ipv4Address ("10.1.1.10"), 5);
+    rerr.AddUnDestination (Ipv4Address ("10.1.1.11"), 21);
+    AddTestCase (new HeaderBenchmark<AODVTYPE_RERR, RerrHeader> ("RERR", rerr), TestCase::QUICK);
+
+    AddTestCase (new HeaderBenchmark<AODVTYPE_RREP_ACK, RrepAckHeader> ("RREP-ACK", RrepAckHeader ()), TestCase::QUICK);
+
+    AddTestCase (new TemplateBenchmark, TestCase::QUICK);
+  }
+} g_aodvEoHeaderBenchmarkSuite;
+
+}
+}
@@ -34,7 +34,7 @@
 #include "ns3/udp-echo-helper.h"
 #include "ns3/mobility-model.h"
 #include "ns3/pcap-file.h"
-#include "ns3/aodv-helper.h"
+#include "ns3/aodv_eo-helper.h"
 #include "ns3/v4ping.h"
 #include "ns3/config.h"
 #include "ns3/constant-position-mobility-model.h"
@@ -43,13 +43,13 @@
 
 namespace ns3
 {
-namespace aodv
+namespace aodv_eo
 {
 
 /**
- * \ingroup aodv
+ * \ingroup aodv_eo
  *
- * \brief AODV loopback UDP echo test case
+ * \brief AODV_EO loopback UDP echo test case
  */
 class LoopbackTestCase : public TestCase
 {
@@ -127,7 +127,7 @@ LoopbackTestCase::DoRun ()
   NetDeviceContainer devices = wifi.Install (wifiPhy, wifiMac, nodes); 
 
   // Setup TCP/IP & AODV
-  AodvHelper aodv; // Use default parameters here
+  AodvEOHelper aodv; // Use default parameters here
   InternetStackHelper internetStack;
   internetStack.SetRoutingHelper (aodv);
   internetStack.Install (nodes);
@@ -170,7 +170,7 @@ LoopbackTestCase::DoRun ()
 class AodvLoopbackTestSuite : public TestSuite
 {
 public:
-  AodvLoopbackTestSuite () : TestSuite ("routing-aodv-loopback", SYSTEM)
+  AodvLoopbackTestSuite () : TestSuite ("routing-aodv_eo-loopback", SYSTEM)
   {
     SetDataDir (NS_TEST_SOURCEDIR);
     // UDP Echo loopback test case
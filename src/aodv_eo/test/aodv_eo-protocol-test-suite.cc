@@ -0,0 +1,813 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "ns3/test.h"
+#include "ns3/simulator.h"
+#include "ns3/aodv_eo-helper.h"
+#include "ns3/aodv_eo-routing-protocol.h"
+#include "ns3/aodv_eo-packet.h"
+#include "ns3/mobility-helper.h"
+#include "ns3/yans-wifi-helper.h"
+#include "ns3/internet-stack-helper.h"
+#include "ns3/ipv4-address-helper.h"
+#include "ns3/ipv4-l3-protocol.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/udp-header.h"
+#include "ns3/udp-l4-protocol.h"
+#include "ns3/udp-socket-factory.h"
+#include "ns3/inet-socket-address.h"
+#include "ns3/socket.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+#include "ns3/boolean.h"
+#include "ns3/double.h"
+#include "ns3/nstime.h"
+#include <vector>
+#include <set>
+
+namespace ns3
+{
+namespace aodv_eo
+{
+
+//-----------------------------------------------------------------------------
+/**
+ * \ingroup aodv_eo
+ *
+ * Base of the tests which run AODV_EO on a chain of wifi nodes 100 m apart, each hearing
+ * only its neighbors, and drive or inspect the protocol of a node directly.
+ */
+struct RoutingProtocolTestCase : public TestCase
+{
+  RoutingProtocolTestCase (std::string name) : TestCase (name) {}
+  /// Create n nodes running AODV_EO with the attributes set on aodv
+  void CreateChain (uint32_t n, AodvEOHelper & aodv);
+  /// Run simulation until stop
+  void RunUntil (Time stop);
+  /// Return address of node i
+  Ipv4Address GetAddress (uint32_t i) const { return m_interfaces.GetAddress (i); }
+  /// Return AODV_EO of node i
+  Ptr<RoutingProtocol> GetRouting (uint32_t i) const;
+  /// Send UDP datagram from node i to node j
+  void SendData (uint32_t i, uint32_t j);
+  /// Return number of AODV_EO messages of given type sent by node i
+  uint32_t CountSent (uint32_t i, MessageType type) const;
+  /// Return number of unreachable destinations in RERRs sent by node i
+  uint32_t CountRerrDestinations (uint32_t i) const;
+
+  ///\name Protocol internals
+  //\{
+  bool LookupRoute (uint32_t i, Ipv4Address dst, RoutingTableEntry & rt) const;
+  /// Add valid route of node i to dst over nextHop used by precursor
+  void AddRoute (uint32_t i, Ipv4Address dst, Ipv4Address nextHop, uint16_t hops, Ipv4Address precursor);
+  /// Add alternate path of node i to dst over nextHop
+  void AddAlternatePath (uint32_t i, Ipv4Address dst, Ipv4Address nextHop, uint16_t hops);
+  void BreakLink (uint32_t i, Ipv4Address nextHop);
+  /// Let node i receive RREQ from node j
+  void ReceiveRequest (uint32_t i, RreqHeader const & rreqHeader, uint32_t j);
+  void ScheduleAckTimer (uint32_t i, Ipv4Address neighbor);
+  bool IsAckTimerRunning (uint32_t i, Ipv4Address neighbor) const;
+  void ReceiveAck (uint32_t i, Ipv4Address neighbor);
+  void UpdateWithdrawal (uint32_t i, double energyFraction);
+  bool IsWithdrawn (uint32_t i) const;
+  void SendHello (uint32_t i);
+  /// Increment own sequence number of node i
+  void IncrementSeqNo (uint32_t i);
+  /// Let the energy source of node i run out
+  void Deplete (uint32_t i);
+  //\}
+
+  /// Nodes of the chain
+  NodeContainer m_nodes;
+  /// Interfaces of the nodes
+  Ipv4InterfaceContainer m_interfaces;
+  /// Data sockets of the nodes
+  std::vector<Ptr<Socket> > m_sockets;
+  /// Number of datagrams received by each node
+  std::vector<uint32_t> m_received;
+  /// AODV_EO packets sent by each node, without IP and UDP headers
+  std::vector<std::vector<Ptr<Packet> > > m_control;
+
+private:
+  /// Return index of node in the chain
+  uint32_t GetIndex (Ptr<Node> node) const;
+  /// Count received datagrams
+  void ReceiveData (Ptr<Socket> socket);
+  /// Record AODV_EO packets sent, connected to Ipv4L3Protocol Tx
+  void IpTx (Ptr<const Packet> packet, Ptr<Ipv4> ipv4, uint32_t interface);
+  virtual void DoTeardown ();
+};
+
+/// Port of test datagrams
+static const uint16_t DATA_PORT = 9;
+
+void
+RoutingProtocolTestCase::CreateChain (uint32_t n, AodvEOHelper & aodv)
+{
+  m_nodes.Create (n);
+  MobilityHelper mobility;
+  mobility.SetPositionAllocator ("ns3::GridPositionAllocator",
+                                 "MinX", DoubleValue (0.0),
+                                 "MinY", DoubleValue (0.0),
+                                 "DeltaX", DoubleValue (100),
+                                 "DeltaY", DoubleValue (0),
+                                 "GridWidth", UintegerValue (n),
+                                 "LayoutType", StringValue ("RowFirst"));
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (m_nodes);
+
+  WifiMacHelper wifiMac;
+  wifiMac.SetType ("ns3::AdhocWifiMac");
+  YansWifiPhyHelper wifiPhy = YansWifiPhyHelper::Default ();
+  YansWifiChannelHelper wifiChannel = YansWifiChannelHelper::Default ();
+  wifiPhy.SetChannel (wifiChannel.Create ());
+  WifiHelper wifi;
+  wifi.SetRemoteStationManager ("ns3::ConstantRateWifiManager", "DataMode", StringValue ("OfdmRate6Mbps"), "RtsCtsThreshold", UintegerValue (0));
+  NetDeviceContainer devices = wifi.Install (wifiPhy, wifiMac, m_nodes);
+
+  InternetStackHelper internetStack;
+  internetStack.SetRoutingHelper (aodv);
+  internetStack.Install (m_nodes);
+  Ipv4AddressHelper address;
+  address.SetBase ("10.0.0.0", "255.0.0.0");
+  m_interfaces = address.Assign (devices);
+
+  m_received.assign (n, 0);
+  m_control.assign (n, std::vector<Ptr<Packet> > ());
+  for (uint32_t i = 0; i < n; ++i)
+    {
+      Ptr<Socket> socket = Socket::CreateSocket (m_nodes.Get (i), UdpSocketFactory::GetTypeId ());
+      socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), DATA_PORT));
+      socket->SetRecvCallback (MakeCallback (&RoutingProtocolTestCase::ReceiveData, this));
+      m_sockets.push_back (socket);
+      m_nodes.Get (i)->GetObject<Ipv4L3Protocol> ()->TraceConnectWithoutContext ("Tx", MakeCallback (&RoutingProtocolTestCase::IpTx, this));
+    }
+}
+
+void
+RoutingProtocolTestCase::RunUntil (Time stop)
+{
+  Simulator::Stop (stop - Simulator::Now ());
+  Simulator::Run ();
+}
+
+Ptr<RoutingProtocol>
+RoutingProtocolTestCase::GetRouting (uint32_t i) const
+{
+  return DynamicCast<RoutingProtocol> (m_nodes.Get (i)->GetObject<Ipv4> ()->GetRoutingProtocol ());
+}
+
+void
+RoutingProtocolTestCase::SendData (uint32_t i, uint32_t j)
+{
+  m_sockets[i]->SendTo (Create<Packet> (64), 0, InetSocketAddress (GetAddress (j), DATA_PORT));
+}
+
+uint32_t
+RoutingProtocolTestCase::CountSent (uint32_t i, MessageType type) const
+{
+  uint32_t count = 0;
+  for (std::vector<Ptr<Packet> >::const_iterator p = m_control[i].begin (); p != m_control[i].end (); ++p)
+    {
+      TypeHeader tHeader;
+      (*p)->PeekHeader (tHeader);
+      if (tHeader.IsValid () && tHeader.Get () == type)
+        {
+          ++count;
+        }
+    }
+  return count;
+}
+
+uint32_t
+RoutingProtocolTestCase::CountRerrDestinations (uint32_t i) const
+{
+  uint32_t count = 0;
+  for (std::vector<Ptr<Packet> >::const_iterator p = m_control[i].begin (); p != m_control[i].end (); ++p)
+    {
+      Ptr<Packet> packet = (*p)->Copy ();
+      TypeHeader tHeader;
+      packet->RemoveHeader (tHeader);
+      if (tHeader.Get () != AODVTYPE_RERR)
+        continue;
+      RerrHeader rerrHeader;
+      packet->RemoveHeader (rerrHeader);
+      count += rerrHeader.GetDestCount ();
+    }
+  return count;
+}
+
+uint32_t
+RoutingProtocolTestCase::GetIndex (Ptr<Node> node) const
+{
+  for (uint32_t i = 0; i < m_nodes.GetN (); ++i)
+    {
+      if (m_nodes.Get (i) == node)
+        return i;
+    }
+  NS_FATAL_ERROR ("Node outside of the chain");
+  return 0;
+}
+
+void
+RoutingProtocolTestCase::ReceiveData (Ptr<Socket> socket)
+{
+  while (socket->Recv ())
+    {
+      m_received[GetIndex (socket->GetNode ())]++;
+    }
+}
+
+void
+RoutingProtocolTestCase::IpTx (Ptr<const Packet> packet, Ptr<Ipv4> ipv4, uint32_t interface)
+{
+  Ptr<Packet> copy = packet->Copy ();
+  Ipv4Header ipHeader;
+  copy->RemoveHeader (ipHeader);
+  if (ipHeader.GetProtocol () != UdpL4Protocol::PROT_NUMBER)
+    return;
+  UdpHeader udpHeader;
+  copy->RemoveHeader (udpHeader);
+  if (udpHeader.GetDestinationPort () != RoutingProtocol::AODV_EO_PORT)
+    return;
+  m_control[GetIndex (ipv4->GetObject<Node> ())].push_back (copy);
+}
+
+void
+RoutingProtocolTestCase::DoTeardown ()
+{
+  for (std::vector<Ptr<Socket> >::iterator i = m_sockets.begin (); i != m_sockets.end (); ++i)
+    {
+      (*i)->Close ();
+    }
+  m_sockets.clear ();
+  m_control.clear ();
+  Simulator::Destroy ();
+  m_nodes = NodeContainer ();
+  m_interfaces = Ipv4InterfaceContainer ();
+}
+
+bool
+RoutingProtocolTestCase::LookupRoute (uint32_t i, Ipv4Address dst, RoutingTableEntry & rt) const
+{
+  return GetRouting (i)->m_routingTable.LookupRoute (dst, rt);
+}
+
+void
+RoutingProtocolTestCase::AddRoute (uint32_t i, Ipv4Address dst, Ipv4Address nextHop, uint16_t hops, Ipv4Address precursor)
+{
+  Ptr<Ipv4> ipv4 = m_nodes.Get (i)->GetObject<Ipv4> ();
+  RoutingTableEntry rt (/*device=*/ ipv4->GetNetDevice (1), /*dst=*/ dst, /*validSeqNo=*/ true, /*seqNo=*/ 1,
+                        /*iface=*/ ipv4->GetAddress (1, 0), /*hops=*/ hops, /*nextHop=*/ nextHop, /*lifetime=*/ Seconds (10));
+  rt.InsertPrecursor (precursor);
+  GetRouting (i)->m_routingTable.AddRoute (rt);
+}
+
+void
+RoutingProtocolTestCase::AddAlternatePath (uint32_t i, Ipv4Address dst, Ipv4Address nextHop, uint16_t hops)
+{
+  Ptr<Ipv4> ipv4 = m_nodes.Get (i)->GetObject<Ipv4> ();
+  RoutingTableEntry rt;
+  NS_TEST_ASSERT_MSG_EQ (GetRouting (i)->m_routingTable.LookupRoute (dst, rt), true, "Primary path exists");
+  rt.InsertAlternatePath (nextHop, ipv4->GetNetDevice (1), ipv4->GetAddress (1, 0), hops, Seconds (10), /*maxPaths=*/ 3);
+  GetRouting (i)->m_routingTable.Update (rt);
+}
+
+void
+RoutingProtocolTestCase::BreakLink (uint32_t i, Ipv4Address nextHop)
+{
+  GetRouting (i)->SendRerrWhenBreaksLinkToNextHop (nextHop);
+}
+
+void
+RoutingProtocolTestCase::ReceiveRequest (uint32_t i, RreqHeader const & rreqHeader, uint32_t j)
+{
+  Ptr<Packet> packet = Create<Packet> ();
+  SocketIpTtlTag tag;
+  tag.SetTtl (10);
+  packet->AddPacketTag (tag);
+  packet->AddHeader (RreqMessage (rreqHeader));
+  GetRouting (i)->RecvRequest (packet, GetAddress (i), GetAddress (j));
+}
+
+void
+RoutingProtocolTestCase::ScheduleAckTimer (uint32_t i, Ipv4Address neighbor)
+{
+  Ptr<RoutingProtocol> routing = GetRouting (i);
+  routing->ScheduleTimer (RoutingProtocol::RREP_ACK_TIMER, neighbor, routing->m_nextHopWait);
+}
+
+bool
+RoutingProtocolTestCase::IsAckTimerRunning (uint32_t i, Ipv4Address neighbor) const
+{
+  return GetRouting (i)->IsTimerRunning (RoutingProtocol::RREP_ACK_TIMER, neighbor);
+}
+
+void
+RoutingProtocolTestCase::ReceiveAck (uint32_t i, Ipv4Address neighbor)
+{
+  GetRouting (i)->RecvReplyAck (neighbor);
+}
+
+void
+RoutingProtocolTestCase::UpdateWithdrawal (uint32_t i, double energyFraction)
+{
+  GetRouting (i)->UpdateWithdrawal (energyFraction);
+}
+
+bool
+RoutingProtocolTestCase::IsWithdrawn (uint32_t i) const
+{
+  return GetRouting (i)->m_withdrawn;
+}
+
+void
+RoutingProtocolTestCase::SendHello (uint32_t i)
+{
+  GetRouting (i)->SendHello ();
+}
+
+void
+RoutingProtocolTestCase::IncrementSeqNo (uint32_t i)
+{
+  GetRouting (i)->IncrementSeqNo ();
+}
+
+void
+RoutingProtocolTestCase::Deplete (uint32_t i)
+{
+  GetRouting (i)->HandleEnergyDepletion ();
+}
+//-----------------------------------------------------------------------------
+/// Unit test for RREP-ACK timer, a neighbor which doesn't acknowledge a RREP is blacklisted with coalesced timers only
+struct RrepAckTimerTest : public RoutingProtocolTestCase
+{
+  RrepAckTimerTest (bool coalesced)
+    : RoutingProtocolTestCase (coalesced ? "RREP-ACK timer, coalesced timers" : "RREP-ACK timer"),
+      m_coalesced (coalesced)
+  {
+  }
+  virtual void DoRun ();
+  /// Middle node waits for RREP-ACK from both neighbors
+  void WaitForAcks ();
+  /// Last node acknowledges
+  void Acknowledge ();
+  /// Check that only the first node is blacklisted, and only with coalesced timers
+  void CheckBlacklist ();
+
+  bool m_coalesced;
+};
+
+void
+RrepAckTimerTest::DoRun ()
+{
+  AodvEOHelper aodv;
+  aodv.Set ("CoalescedTimers", BooleanValue (m_coalesced));
+  CreateChain (3, aodv);
+  // Neighbors know each other from hellos by then
+  Simulator::Schedule (Seconds (2), &RrepAckTimerTest::WaitForAcks, this);
+  Simulator::Schedule (Seconds (2.01), &RrepAckTimerTest::Acknowledge, this);
+  Simulator::Schedule (Seconds (2.1), &RrepAckTimerTest::CheckBlacklist, this);
+  RunUntil (Seconds (3));
+}
+
+void
+RrepAckTimerTest::WaitForAcks ()
+{
+  RoutingTableEntry rt;
+  NS_TEST_ASSERT_MSG_EQ (LookupRoute (1, GetAddress (0), rt), true, "Neighbor known");
+  NS_TEST_ASSERT_MSG_EQ (LookupRoute (1, GetAddress (2), rt), true, "Neighbor known");
+  ScheduleAckTimer (1, GetAddress (0));
+  ScheduleAckTimer (1, GetAddress (2));
+  NS_TEST_EXPECT_MSG_EQ (IsAckTimerRunning (1, GetAddress (0)), m_coalesced, "Timer is armed with coalesced timers");
+  NS_TEST_EXPECT_MSG_EQ (IsAckTimerRunning (1, GetAddress (2)), m_coalesced, "Timer is armed with coalesced timers");
+}
+
+void
+RrepAckTimerTest::Acknowledge ()
+{
+  ReceiveAck (1, GetAddress (2));
+  NS_TEST_EXPECT_MSG_EQ (IsAckTimerRunning (1, GetAddress (2)), false, "RREP-ACK cancels the timer");
+}
+
+void
+RrepAckTimerTest::CheckBlacklist ()
+{
+  RoutingTableEntry rt;
+  NS_TEST_ASSERT_MSG_EQ (LookupRoute (1, GetAddress (0), rt), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (rt.IsUnidirectional (), m_coalesced, "No RREP-ACK, link is blacklisted with coalesced timers");
+  NS_TEST_ASSERT_MSG_EQ (LookupRoute (1, GetAddress (2), rt), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (rt.IsUnidirectional (), false, "RREP-ACK received");
+}
+//-----------------------------------------------------------------------------
+/// Unit test for RERR aggregation, link breaks within the window are reported by one RERR
+struct RerrAggregationTest : public RoutingProtocolTestCase
+{
+  RerrAggregationTest () : RoutingProtocolTestCase ("RERR aggregation") {}
+  virtual void DoRun ();
+  /// Break links of the middle node to two next hops at once
+  void BreakLinks ();
+  /// Check the RERR sent by the middle node
+  void CheckRerr ();
+};
+
+void
+RerrAggregationTest::DoRun ()
+{
+  AodvEOHelper aodv;
+  aodv.Set ("RerrAggregationWindow", TimeValue (MilliSeconds (100)));
+  CreateChain (3, aodv);
+  Simulator::Schedule (Seconds (2), &RerrAggregationTest::BreakLinks, this);
+  Simulator::Schedule (Seconds (2.5), &RerrAggregationTest::CheckRerr, this);
+  RunUntil (Seconds (3));
+}
+
+void
+RerrAggregationTest::BreakLinks ()
+{
+  // Node 0 forwards through the middle node to two destinations behind other neighbors
+  AddRoute (1, Ipv4Address ("10.0.0.200"), Ipv4Address ("10.0.0.200"), 1, GetAddress (0));
+  AddRoute (1, Ipv4Address ("10.0.0.100"), Ipv4Address ("10.0.0.200"), 2, GetAddress (0));
+  AddRoute (1, Ipv4Address ("10.0.0.201"), Ipv4Address ("10.0.0.201"), 1, GetAddress (0));
+  AddRoute (1, Ipv4Address ("10.0.0.101"), Ipv4Address ("10.0.0.201"), 2, GetAddress (0));
+  BreakLink (1, Ipv4Address ("10.0.0.200"));
+  BreakLink (1, Ipv4Address ("10.0.0.201"));
+  NS_TEST_EXPECT_MSG_EQ (CountSent (1, AODVTYPE_RERR), 0, "RERR waits for the window to close");
+}
+
+void
+RerrAggregationTest::CheckRerr ()
+{
+  NS_TEST_EXPECT_MSG_EQ (CountSent (1, AODVTYPE_RERR), 1, "Both link breaks reported by one RERR");
+  NS_TEST_EXPECT_MSG_EQ (CountRerrDestinations (1), 4, "Next hops and destinations behind them");
+}
+//-----------------------------------------------------------------------------
+/// Unit test for local repair, only destinations at most MaxRepairTtl hops away are repaired
+struct LocalRepairTtlTest : public RoutingProtocolTestCase
+{
+  LocalRepairTtlTest () : RoutingProtocolTestCase ("Local repair limited to MaxRepairTtl") {}
+  virtual void DoRun ();
+  /// Break link of the middle node to a next hop serving a near and a far destination
+  void BreakLinks ();
+  /// Check that only the near destination is being repaired
+  void CheckRepair ();
+};
+
+void
+LocalRepairTtlTest::DoRun ()
+{
+  AodvEOHelper aodv;
+  aodv.Set ("EnableLocalRepair", BooleanValue (true));
+  aodv.Set ("MaxRepairTtl", UintegerValue (2));
+  CreateChain (3, aodv);
+  Simulator::Schedule (Seconds (2), &LocalRepairTtlTest::BreakLinks, this);
+  // Before the repair times out
+  Simulator::Schedule (Seconds (2.2), &LocalRepairTtlTest::CheckRepair, this);
+  RunUntil (Seconds (2.3));
+}
+
+void
+LocalRepairTtlTest::BreakLinks ()
+{
+  AddRoute (1, Ipv4Address ("10.0.0.200"), Ipv4Address ("10.0.0.200"), 1, GetAddress (0));
+  AddRoute (1, Ipv4Address ("10.0.0.100"), Ipv4Address ("10.0.0.200"), 2, GetAddress (0));
+  AddRoute (1, Ipv4Address ("10.0.0.101"), Ipv4Address ("10.0.0.200"), 3, GetAddress (0));
+  BreakLink (1, Ipv4Address ("10.0.0.200"));
+}
+
+void
+LocalRepairTtlTest::CheckRepair ()
+{
+  RoutingTableEntry rt;
+  NS_TEST_ASSERT_MSG_EQ (LookupRoute (1, Ipv4Address ("10.0.0.100"), rt), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (rt.GetFlag (), IN_REPAIR, "Destination within MaxRepairTtl is repaired");
+  NS_TEST_ASSERT_MSG_EQ (LookupRoute (1, Ipv4Address ("10.0.0.101"), rt), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (rt.GetFlag (), INVALID, "Destination beyond MaxRepairTtl is reported");
+  NS_TEST_EXPECT_MSG_EQ (CountSent (1, AODVTYPE_RREQ), 1, "One repair discovery");
+  NS_TEST_EXPECT_MSG_EQ (CountRerrDestinations (1), 2, "Next hop and far destination reported");
+}
+//-----------------------------------------------------------------------------
+/// Unit test for multipath failover, only destinations without an alternate path are reported and invalidated
+struct FailoverRerrTest : public RoutingProtocolTestCase
+{
+  FailoverRerrTest () : RoutingProtocolTestCase ("Failover to alternate paths on link break") {}
+  virtual void DoRun ();
+  /// Break link of the middle node to a next hop, one destination behind it has an alternate path through node 2
+  void BreakLinks ();
+  /// Check routes and RERR of the middle node
+  void CheckRerr ();
+};
+
+void
+FailoverRerrTest::DoRun ()
+{
+  AodvEOHelper aodv;
+  aodv.Set ("EnableMultipath", BooleanValue (true));
+  CreateChain (3, aodv);
+  Simulator::Schedule (Seconds (2), &FailoverRerrTest::BreakLinks, this);
+  Simulator::Schedule (Seconds (2.2), &FailoverRerrTest::CheckRerr, this);
+  RunUntil (Seconds (2.3));
+}
+
+void
+FailoverRerrTest::BreakLinks ()
+{
+  AddRoute (1, Ipv4Address ("10.0.0.200"), Ipv4Address ("10.0.0.200"), 1, GetAddress (0));
+  AddRoute (1, Ipv4Address ("10.0.0.100"), Ipv4Address ("10.0.0.200"), 2, GetAddress (0));
+  AddRoute (1, Ipv4Address ("10.0.0.101"), Ipv4Address ("10.0.0.200"), 2, GetAddress (0));
+  AddAlternatePath (1, Ipv4Address ("10.0.0.100"), GetAddress (2), 2);
+  BreakLink (1, Ipv4Address ("10.0.0.200"));
+}
+
+void
+FailoverRerrTest::CheckRerr ()
+{
+  RoutingTableEntry rt;
+  NS_TEST_ASSERT_MSG_EQ (LookupRoute (1, Ipv4Address ("10.0.0.100"), rt), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (rt.GetFlag (), VALID, "Route failed over");
+  NS_TEST_EXPECT_MSG_EQ (rt.GetNextHop (), GetAddress (2), "Route failed over");
+  NS_TEST_ASSERT_MSG_EQ (LookupRoute (1, Ipv4Address ("10.0.0.101"), rt), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (rt.GetFlag (), INVALID, "No alternate path");
+  NS_TEST_ASSERT_MSG_EQ (LookupRoute (1, Ipv4Address ("10.0.0.200"), rt), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (rt.GetFlag (), INVALID, "Lost neighbor");
+  NS_TEST_EXPECT_MSG_EQ (CountSent (1, AODVTYPE_RERR), 1, "Lost routes reported");
+  NS_TEST_EXPECT_MSG_EQ (CountRerrDestinations (1), 2, "Only lost neighbor and destination without alternate path");
+}
+//-----------------------------------------------------------------------------
+/// Unit test for RREP collection, the destination answers copies of a RREQ over better paths within the window
+struct ReplyCollectionTest : public RoutingProtocolTestCase
+{
+  ReplyCollectionTest (Time window)
+    : RoutingProtocolTestCase (window > Seconds (0) ? "Destination answers better RREQ copies" : "Destination answers first RREQ copy"),
+      m_window (window)
+  {
+  }
+  virtual void DoRun ();
+  /// Middle node, the destination, receives a copy of the RREQ from node j over a path of hops hops
+  void ReceiveCopy (uint32_t j, uint8_t hops);
+  /// Check RREPs sent and reverse route of the destination
+  void CheckReplies ();
+
+  Time m_window;
+};
+
+void
+ReplyCollectionTest::DoRun ()
+{
+  AodvEOHelper aodv;
+  aodv.Set ("EnableHello", BooleanValue (false));
+  aodv.Set ("ReplyCollectionWindow", TimeValue (m_window));
+  CreateChain (3, aodv);
+  // Copies over a long path, a shorter path and a long path again, then a short one too late
+  Simulator::Schedule (Seconds (1), &ReplyCollectionTest::ReceiveCopy, this, 0, 3);
+  Simulator::Schedule (Seconds (1.01), &ReplyCollectionTest::ReceiveCopy, this, 2, 1);
+  Simulator::Schedule (Seconds (1.02), &ReplyCollectionTest::ReceiveCopy, this, 0, 3);
+  Simulator::Schedule (Seconds (1.6), &ReplyCollectionTest::ReceiveCopy, this, 0, 0);
+  Simulator::Schedule (Seconds (1.7), &ReplyCollectionTest::CheckReplies, this);
+  RunUntil (Seconds (2));
+}
+
+void
+ReplyCollectionTest::ReceiveCopy (uint32_t j, uint8_t hops)
+{
+  RreqHeader rreq (/*flags*/ 0, /*reserved*/ 0, /*hopCount*/ hops, /*requestID*/ 1, /*dst*/ GetAddress (1),
+                   /*dstSeqNo*/ 0, /*origin*/ Ipv4Address ("10.0.0.150"), /*originSeqNo*/ 5);
+  rreq.SetUnknownSeqno (true);
+  ReceiveRequest (1, rreq, j);
+}
+
+void
+ReplyCollectionTest::CheckReplies ()
+{
+  bool collecting = (m_window > Seconds (0));
+  NS_TEST_EXPECT_MSG_EQ (CountSent (1, AODVTYPE_RREP), collecting ? 2 : 1, "Only the shorter copy is answered again");
+  RoutingTableEntry rt;
+  NS_TEST_ASSERT_MSG_EQ (LookupRoute (1, Ipv4Address ("10.0.0.150"), rt), true, "Reverse route");
+  NS_TEST_EXPECT_MSG_EQ (rt.GetNextHop (), GetAddress (collecting ? 2 : 0), "Reverse route follows the answered copy");
+}
+//-----------------------------------------------------------------------------
+/// Unit test for relay withdrawal, a withdrawn node relays again only above the threshold plus the rejoin margin
+struct RelayWithdrawalTest : public RoutingProtocolTestCase
+{
+  RelayWithdrawalTest () : RoutingProtocolTestCase ("Relay withdrawal hysteresis") {}
+  virtual void DoRun ();
+  /// Let the energy of the middle node go down and up around the threshold
+  void ChangeEnergy ();
+};
+
+void
+RelayWithdrawalTest::DoRun ()
+{
+  AodvEOHelper aodv;
+  aodv.Set ("RelayWithdrawalThreshold", DoubleValue (0.2));
+  aodv.Set ("RelayRejoinMargin", DoubleValue (0.1));
+  CreateChain (3, aodv);
+  Simulator::Schedule (Seconds (1), &RelayWithdrawalTest::ChangeEnergy, this);
+  RunUntil (Seconds (1.1));
+}
+
+void
+RelayWithdrawalTest::ChangeEnergy ()
+{
+  UpdateWithdrawal (1, 0.25);
+  NS_TEST_EXPECT_MSG_EQ (IsWithdrawn (1), false, "Above threshold");
+  UpdateWithdrawal (1, 0.19);
+  NS_TEST_EXPECT_MSG_EQ (IsWithdrawn (1), true, "Below threshold");
+  UpdateWithdrawal (1, 0.21);
+  NS_TEST_EXPECT_MSG_EQ (IsWithdrawn (1), true, "Harvested energy within the margin");
+  UpdateWithdrawal (1, 0.29);
+  NS_TEST_EXPECT_MSG_EQ (IsWithdrawn (1), true, "Still within the margin");
+  UpdateWithdrawal (1, 0.31);
+  NS_TEST_EXPECT_MSG_EQ (IsWithdrawn (1), false, "Relays again above the margin");
+  UpdateWithdrawal (1, 0.25);
+  NS_TEST_EXPECT_MSG_EQ (IsWithdrawn (1), false, "Withdraws only below the threshold");
+}
+//-----------------------------------------------------------------------------
+/// Unit test for energy depletion, the last RERR goes out at once and nothing is sent after it
+struct DepletionTest : public RoutingProtocolTestCase
+{
+  DepletionTest () : RoutingProtocolTestCase ("Depleted node sends nothing"), m_sent (0) {}
+  virtual void DoRun ();
+  /// Leave messages pending at the middle node and deplete it
+  void DepleteRelay ();
+  /// Check nothing was sent after the depletion RERR
+  void CheckSilence ();
+
+  /// Number of AODV_EO packets sent by the middle node when depleted
+  uint32_t m_sent;
+};
+
+void
+DepletionTest::DoRun ()
+{
+  AodvEOHelper aodv;
+  aodv.Set ("DepletionRerr", BooleanValue (true));
+  aodv.Set ("MessageBundling", BooleanValue (true));
+  aodv.Set ("RerrAggregationWindow", TimeValue (MilliSeconds (100)));
+  CreateChain (3, aodv);
+  Simulator::Schedule (Seconds (2), &DepletionTest::DepleteRelay, this);
+  Simulator::Schedule (Seconds (3), &DepletionTest::CheckSilence, this);
+  RunUntil (Seconds (3.5));
+}
+
+void
+DepletionTest::DepleteRelay ()
+{
+  // Node 0 forwards through the middle node, which also has an aggregated RERR and a bundled hello pending
+  AddRoute (1, Ipv4Address ("10.0.0.100"), GetAddress (2), 2, GetAddress (0));
+  AddRoute (1, Ipv4Address ("10.0.0.200"), Ipv4Address ("10.0.0.200"), 1, GetAddress (0));
+  BreakLink (1, Ipv4Address ("10.0.0.200"));
+  SendHello (1);
+  uint32_t rerrs = CountSent (1, AODVTYPE_RERR);
+  Deplete (1);
+  NS_TEST_EXPECT_MSG_EQ (CountSent (1, AODVTYPE_RERR), rerrs + 1, "Depletion RERR sent at once");
+  m_sent = m_control[1].size ();
+}
+
+void
+DepletionTest::CheckSilence ()
+{
+  NS_TEST_EXPECT_MSG_EQ (m_control[1].size (), m_sent, "Nothing sent once depleted");
+  NS_TEST_EXPECT_MSG_EQ (CountRerrDestinations (1), 1, "Only the relayed destination reported");
+}
+//-----------------------------------------------------------------------------
+/// Unit test for duty cycling, the destination of a discovered route stays awake for the data
+struct DutyCycleReplyTest : public RoutingProtocolTestCase
+{
+  DutyCycleReplyTest () : RoutingProtocolTestCase ("Duty cycled destination stays awake after RREP") {}
+  virtual void DoRun ();
+  /// Check all datagrams arrived
+  void CheckDelivery ();
+};
+
+void
+DutyCycleReplyTest::DoRun ()
+{
+  AodvEOHelper aodv;
+  aodv.Set ("DutyCycle", BooleanValue (true));
+  CreateChain (3, aodv);
+  // Route discovery starts in a listen window, the later datagrams are sent outside of it
+  Simulator::Schedule (Seconds (2), &RoutingProtocolTestCase::SendData, this, 0, 2);
+  Simulator::Schedule (Seconds (2.5), &RoutingProtocolTestCase::SendData, this, 0, 2);
+  Simulator::Schedule (Seconds (2.7), &RoutingProtocolTestCase::SendData, this, 0, 2);
+  Simulator::Schedule (Seconds (3), &DutyCycleReplyTest::CheckDelivery, this);
+  RunUntil (Seconds (3.5));
+}
+
+void
+DutyCycleReplyTest::CheckDelivery ()
+{
+  NS_TEST_EXPECT_MSG_EQ (m_received[2], 3, "Data delivered after route discovery");
+}
+//-----------------------------------------------------------------------------
+/// Unit test for hello templates, every hello is a new packet and carries the current sequence number and lifetime
+struct HelloTemplateTest : public RoutingProtocolTestCase
+{
+  HelloTemplateTest () : RoutingProtocolTestCase ("Hellos from template") {}
+  virtual void DoRun ();
+  /// Send two hellos of node 0
+  void SendHellos ();
+  /// Let node 0 change its sequence number
+  void IncrementSeqNo ();
+  /// Let node 0 allow one more hello loss, which lengthens the hello lifetime
+  void ChangeLifetime ();
+  /// Check UIDs, sequence numbers and lifetimes of the hellos sent
+  void CheckHellos ();
+};
+
+void
+HelloTemplateTest::DoRun ()
+{
+  AodvEOHelper aodv;
+  // Only the hellos sent by the test
+  aodv.Set ("EnableHello", BooleanValue (false));
+  CreateChain (2, aodv);
+  Simulator::Schedule (Seconds (1), &HelloTemplateTest::SendHellos, this);
+  Simulator::Schedule (Seconds (1.1), &HelloTemplateTest::IncrementSeqNo, this);
+  Simulator::Schedule (Seconds (1.2), &HelloTemplateTest::SendHellos, this);
+  Simulator::Schedule (Seconds (1.3), &HelloTemplateTest::ChangeLifetime, this);
+  Simulator::Schedule (Seconds (1.4), &HelloTemplateTest::SendHellos, this);
+  Simulator::Schedule (Seconds (1.5), &HelloTemplateTest::CheckHellos, this);
+  RunUntil (Seconds (2));
+}
+
+void
+HelloTemplateTest::SendHellos ()
+{
+  SendHello (0);
+  SendHello (0);
+}
+
+void
+HelloTemplateTest::IncrementSeqNo ()
+{
+  RoutingProtocolTestCase::IncrementSeqNo (0);
+}
+
+void
+HelloTemplateTest::ChangeLifetime ()
+{
+  GetRouting (0)->SetAttribute ("AllowedHelloLoss", UintegerValue (3));
+}
+
+void
+HelloTemplateTest::CheckHellos ()
+{
+  NS_TEST_ASSERT_MSG_EQ (m_control[0].size (), 6, "Every hello sent");
+  std::set<uint64_t> uids;
+  std::vector<uint32_t> seqNos;
+  std::vector<Time> lifetimes;
+  for (std::vector<Ptr<Packet> >::const_iterator p = m_control[0].begin (); p != m_control[0].end (); ++p)
+    {
+      uids.insert ((*p)->GetUid ());
+      Ptr<Packet> packet = (*p)->Copy ();
+      TypeHeader tHeader;
+      packet->RemoveHeader (tHeader);
+      NS_TEST_EXPECT_MSG_EQ (tHeader.Get (), AODVTYPE_RREP, "Hello");
+      RrepHeader helloHeader;
+      packet->RemoveHeader (helloHeader);
+      seqNos.push_back (helloHeader.GetDstSeqno ());
+      lifetimes.push_back (helloHeader.GetLifeTime ());
+    }
+  NS_TEST_EXPECT_MSG_EQ (uids.size (), 6, "Fresh UID for every hello");
+  NS_TEST_EXPECT_MSG_EQ (seqNos[1], seqNos[0], "Same sequence number, hello reused");
+  NS_TEST_EXPECT_MSG_EQ (seqNos[2], seqNos[0] + 1, "Template replaced on new sequence number");
+  NS_TEST_EXPECT_MSG_EQ (seqNos[3], seqNos[0] + 1, "New template reused");
+  NS_TEST_EXPECT_MSG_EQ (lifetimes[3], Seconds (2), "Default lifetime");
+  NS_TEST_EXPECT_MSG_EQ (lifetimes[4], Seconds (3), "Template replaced on new lifetime");
+  NS_TEST_EXPECT_MSG_EQ (lifetimes[5], Seconds (3), "New template reused");
+}
+//-----------------------------------------------------------------------------
+class AodvEoProtocolTestSuite : public TestSuite
+{
+public:
+  AodvEoProtocolTestSuite () : TestSuite ("routing-aodv_eo-protocol", SYSTEM)
+  {
+    AddTestCase (new RrepAckTimerTest (false), TestCase::QUICK);
+    AddTestCase (new RrepAckTimerTest (true), TestCase::QUICK);
+    AddTestCase (new RerrAggregationTest, TestCase::QUICK);
+    AddTestCase (new LocalRepairTtlTest, TestCase::QUICK);
+    AddTestCase (new FailoverRerrTest, TestCase::QUICK);
+    AddTestCase (new ReplyCollectionTest (Seconds (0)), TestCase::QUICK);
+    AddTestCase (new ReplyCollectionTest (MilliSeconds (500)), TestCase::QUICK);
+    AddTestCase (new RelayWithdrawalTest, TestCase::QUICK);
+    AddTestCase (new DepletionTest, TestCase::QUICK);
+    AddTestCase (new DutyCycleReplyTest, TestCase::QUICK);
+    AddTestCase (new HelloTemplateTest, TestCase::QUICK);
+  }
+} g_aodvEoProtocolTestSuite;
+
+}
+}
@@ -18,8 +18,8 @@
  * Authors: Pavel Boyko <boyko@iitp.ru>
  */
 
-#include "aodv-regression.h"
-#include "bug-772.h"
+#include "aodv_eo-regression.h"
+#include "aodv_eo-bug-772.h"
 
 #include "ns3/simulator.h"
 #include "ns3/mobility-helper.h"
@@ -33,22 +33,25 @@
 #include "ns3/abort.h"
 #include "ns3/mobility-model.h"
 #include "ns3/pcap-file.h"
-#include "ns3/aodv-helper.h"
+#include "ns3/aodv_eo-helper.h"
 #include "ns3/config.h"
 #include "ns3/pcap-test.h"
 #include "ns3/rng-seed-manager.h"
 #include "ns3/icmpv4.h"
 #include <sstream>
 
-using namespace ns3;
+namespace ns3
+{
+namespace aodv_eo
+{
 
 //-----------------------------------------------------------------------------
 // Test suite
 //-----------------------------------------------------------------------------
-class AodvRegressionTestSuite : public TestSuite
+class AodvEoRegressionTestSuite : public TestSuite
 {
 public:
-  AodvRegressionTestSuite () : TestSuite ("routing-aodv-regression", SYSTEM) 
+  AodvEoRegressionTestSuite () : TestSuite ("routing-aodv_eo-regression", SYSTEM) 
   {
     SetDataDir (NS_TEST_SOURCEDIR);
     // General RREQ-RREP-RRER test case
@@ -58,14 +61,14 @@ public:
     // \bugid{772} UDP test case
     AddTestCase (new Bug772ChainTest ("udp-chain-test", "ns3::UdpSocketFactory", Seconds (3), 10), TestCase::QUICK);
   }
-} g_aodvRegressionTestSuite;
+} g_aodvEoRegressionTestSuite;
  
 
 //-----------------------------------------------------------------------------
 // ChainRegressionTest
 //-----------------------------------------------------------------------------
 ChainRegressionTest::ChainRegressionTest (const char * const prefix, Time t, uint32_t size, Time arpAliveTimeout) : 
-  TestCase ("AODV chain regression test"),
+  TestCase ("AODV_EO chain regression test"),
   m_nodes (0),
   m_prefix (prefix),
   m_time (t),
@@ -176,8 +179,8 @@ ChainRegressionTest::CreateDevices ()
   // Assign 0 streams per channel for this configuration 
   NS_TEST_ASSERT_MSG_EQ (streamsUsed, (devices.GetN () * 6), "Stream assignment mismatch");
 
-  // 2. Setup TCP/IP & AODV
-  AodvHelper aodv; // Use default parameters here
+  // 2. Setup TCP/IP & AODV_EO
+  AodvEOHelper aodv; // Use default parameters here
   InternetStackHelper internetStack;
   internetStack.SetRoutingHelper (aodv);
   internetStack.Install (*m_nodes);
@@ -185,7 +188,7 @@ ChainRegressionTest::CreateDevices ()
   // InternetStack uses m_size more streams
   NS_TEST_ASSERT_MSG_EQ (streamsUsed, (devices.GetN () * 8) + m_size, "Stream assignment mismatch");
   streamsUsed += aodv.AssignStreams (*m_nodes, streamsUsed);
-  // AODV uses m_size more streams
+  // AODV_EO uses m_size more streams
   NS_TEST_ASSERT_MSG_EQ (streamsUsed, ((devices.GetN () * 8) + (2*m_size)), "Stream assignment mismatch");
 
   Ipv4AddressHelper address;
@@ -214,3 +217,6 @@ ChainRegressionTest::CheckResults ()
       NS_PCAP_TEST_EXPECT_EQ (m_prefix << "-" << i << "-0.pcap");
     }
 }
+
+}
+}
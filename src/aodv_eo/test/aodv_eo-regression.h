@@ -18,20 +18,23 @@
  * Authors: Pavel Boyko <boyko@iitp.ru>
  */
 
-#ifndef AODV_REGRESSION_H
-#define AODV_REGRESSION_H
+#ifndef AODV_EO_REGRESSION_H
+#define AODV_EO_REGRESSION_H
 
 #include "ns3/test.h"
 #include "ns3/nstime.h"
 #include "ns3/socket.h"
 #include "ns3/node-container.h"
 
-using namespace ns3;
+namespace ns3
+{
+namespace aodv_eo
+{
 
 /**
- * \ingroup aodv
+ * \ingroup aodv_eo
  * 
- * \brief AODV chain regression test
+ * \brief AODV_EO chain regression test
  *
  * This script creates 1-dimensional grid topology and then ping last node from the first one:
  *
@@ -195,4 +198,7 @@ private:
   void SendPing ();
 };
 
-#endif /* AODV_REGRESSION_H */
+}
+}
+
+#endif /* AODV_EO_REGRESSION_H */
@@ -0,0 +1,909 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "ns3/test.h"
+#include "ns3/aodv_eo-token-bucket.h"
+#include "ns3/aodv_eo-deadline-scheduler.h"
+#include "ns3/aodv_eo-rtable.h"
+#include "ns3/aodv_eo-packet.h"
+#include "ns3/aodv_eo-neighbor.h"
+#include "ns3/aodv_eo-load-monitor.h"
+#include "ns3/aodv_eo-reservation.h"
+#include "ns3/aodv_eo-energy-predictor.h"
+#include "ns3/aodv_eo-energy-accounting.h"
+#include "ns3/packet.h"
+#include "ns3/wifi-mac-header.h"
+#include "ns3/llc-snap-header.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/udp-header.h"
+#include <vector>
+#include <map>
+#include <limits>
+
+namespace ns3
+{
+namespace aodv_eo
+{
+
+//-----------------------------------------------------------------------------
+/// Unit test for TokenBucket
+struct TokenBucketTest : public TestCase
+{
+  TokenBucketTest () : TestCase ("TokenBucket"), bucket (10, 10) {}
+  virtual void DoRun ();
+  void CheckRefill1 ();
+  void CheckRefill2 ();
+
+  TokenBucket bucket;
+};
+
+void
+TokenBucketTest::DoRun ()
+{
+  NS_TEST_EXPECT_MSG_EQ (bucket.GetRate (), 10, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (bucket.GetBurst (), 10, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (bucket.GetTokens (), 10, "Bucket is full");
+  NS_TEST_EXPECT_MSG_EQ (bucket.GetDelayLeft (), Seconds (0), "Token available");
+  for (uint32_t i = 0; i < 10; ++i)
+    {
+      NS_TEST_EXPECT_MSG_EQ (bucket.Consume (), true, "Burst is allowed");
+    }
+  NS_TEST_EXPECT_MSG_EQ (bucket.GetTokens (), 0, "Bucket is empty");
+  NS_TEST_EXPECT_MSG_EQ (bucket.Consume (), false, "Bucket is empty");
+  NS_TEST_EXPECT_MSG_EQ (bucket.GetDelayLeft (), MilliSeconds (100), "One token per 100 ms");
+
+  Simulator::Schedule (MilliSeconds (100), &TokenBucketTest::CheckRefill1, this);
+  Simulator::Schedule (Seconds (5), &TokenBucketTest::CheckRefill2, this);
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+TokenBucketTest::CheckRefill1 ()
+{
+  NS_TEST_EXPECT_MSG_EQ (bucket.GetTokens (), 1, "Exactly one token refilled");
+  NS_TEST_EXPECT_MSG_EQ (bucket.Consume (), true, "Refilled token");
+  NS_TEST_EXPECT_MSG_EQ (bucket.Consume (), false, "No more tokens");
+  NS_TEST_EXPECT_MSG_EQ (bucket.GetDelayLeft (), MilliSeconds (100), "Next token in 100 ms");
+}
+
+void
+TokenBucketTest::CheckRefill2 ()
+{
+  NS_TEST_EXPECT_MSG_EQ (bucket.GetTokens (), 10, "Bucket never holds more than burst");
+  bucket.SetRate (0);
+  NS_TEST_EXPECT_MSG_EQ (bucket.Consume (), false, "Zero rate disables bucket");
+}
+//-----------------------------------------------------------------------------
+/// Unit test for DeadlineScheduler
+struct DeadlineSchedulerTest : public TestCase
+{
+  DeadlineSchedulerTest () : TestCase ("DeadlineScheduler") {}
+  virtual void DoRun ();
+  void Expire (uint8_t kind, Ipv4Address addr);
+  void CheckPending ();
+
+  DeadlineScheduler deadlines;
+  std::vector<std::pair<uint8_t, Time> > expired;
+};
+
+void
+DeadlineSchedulerTest::DoRun ()
+{
+  deadlines.SetCallback (MakeCallback (&DeadlineSchedulerTest::Expire, this));
+  deadlines.Schedule (1, Ipv4Address ("1.2.3.4"), Seconds (1));
+  deadlines.Schedule (2, Ipv4Address ("1.2.3.4"), Seconds (2));
+  deadlines.Schedule (3, Ipv4Address (), Seconds (3));
+  NS_TEST_EXPECT_MSG_EQ (deadlines.GetSize (), 3, "Deadlines are keyed by kind and address");
+  // Reschedule replaces pending deadline
+  deadlines.Schedule (1, Ipv4Address ("1.2.3.4"), Seconds (4));
+  NS_TEST_EXPECT_MSG_EQ (deadlines.GetSize (), 3, "Deadline rescheduled");
+  NS_TEST_EXPECT_MSG_EQ (deadlines.GetDelayLeft (1, Ipv4Address ("1.2.3.4")), Seconds (4), "Deadline rescheduled");
+  deadlines.Cancel (2, Ipv4Address ("1.2.3.4"));
+  NS_TEST_EXPECT_MSG_EQ (deadlines.IsRunning (2, Ipv4Address ("1.2.3.4")), false, "Deadline cancelled");
+  NS_TEST_EXPECT_MSG_EQ (deadlines.IsRunning (3, Ipv4Address ()), true, "Deadline pending");
+
+  Simulator::Schedule (Seconds (3.5), &DeadlineSchedulerTest::CheckPending, this);
+  Simulator::Run ();
+  NS_TEST_EXPECT_MSG_EQ (expired.size (), 4, "All deadlines expired");
+  NS_TEST_EXPECT_MSG_EQ ((uint16_t) expired[0].first, 3, "Earliest deadline first");
+  NS_TEST_EXPECT_MSG_EQ (expired[0].second, Seconds (3), "Exact expiration time");
+  NS_TEST_EXPECT_MSG_EQ ((uint16_t) expired[1].first, 1, "Rescheduled deadline");
+  NS_TEST_EXPECT_MSG_EQ (expired[1].second, Seconds (4), "Exact expiration time");
+  NS_TEST_EXPECT_MSG_EQ ((uint16_t) expired[2].first, 4, "Deadline scheduled from handler");
+  NS_TEST_EXPECT_MSG_EQ (expired[2].second, Seconds (4), "Zero delay deadline expires in the same pass");
+  NS_TEST_EXPECT_MSG_EQ ((uint16_t) expired[3].first, 5, "Deadline scheduled while idle");
+  NS_TEST_EXPECT_MSG_EQ (expired[3].second, Seconds (4.5), "Exact expiration time");
+  NS_TEST_EXPECT_MSG_EQ (deadlines.GetSize (), 0, "Nothing pending");
+  Simulator::Destroy ();
+}
+
+void
+DeadlineSchedulerTest::Expire (uint8_t kind, Ipv4Address addr)
+{
+  expired.push_back (std::make_pair (kind, Simulator::Now ()));
+  if (kind == 1)
+    {
+      deadlines.Schedule (4, addr, Seconds (0));
+    }
+}
+
+void
+DeadlineSchedulerTest::CheckPending ()
+{
+  NS_TEST_EXPECT_MSG_EQ (deadlines.GetSize (), 1, "One deadline pending");
+  deadlines.Schedule (5, Ipv4Address (), Seconds (1));
+  NS_TEST_EXPECT_MSG_EQ (deadlines.GetDelayLeft (1, Ipv4Address ("1.2.3.4")), Seconds (0.5), "Earlier deadline keeps its time");
+}
+//-----------------------------------------------------------------------------
+/// Unit test for RoutingTableEntry alternate paths
+struct AlternatePathTest : public TestCase
+{
+  AlternatePathTest () : TestCase ("AlternatePath") {}
+  virtual void DoRun ();
+};
+
+void
+AlternatePathTest::DoRun ()
+{
+  RoutingTableEntry rt (/*output device*/ 0, /*dst*/ Ipv4Address ("1.2.3.4"), /*validSeqNo*/ true, /*seqNo*/ 5,
+                        /*interface*/ Ipv4InterfaceAddress (), /*hop*/ 3, /*next hop*/ Ipv4Address ("3.3.3.3"),
+                        /*lifetime*/ Seconds (10));
+  NS_TEST_EXPECT_MSG_EQ (rt.GetAdvertisedHops (), 3, "Advertised hop count is the initial hop count");
+  NS_TEST_EXPECT_MSG_EQ (rt.SwitchToAlternatePath (), false, "No alternate path");
+  NS_TEST_EXPECT_MSG_EQ (rt.InsertAlternatePath (Ipv4Address ("3.3.3.3"), 0, Ipv4InterfaceAddress (), 3, Seconds (10), 2),
+                         false, "Primary next hop is not an alternate");
+  NS_TEST_EXPECT_MSG_EQ (rt.InsertAlternatePath (Ipv4Address ("4.4.4.4"), 0, Ipv4InterfaceAddress (), 4, Seconds (10), 2),
+                         false, "Longer than advertised path may loop");
+  NS_TEST_EXPECT_MSG_EQ (rt.InsertAlternatePath (Ipv4Address ("5.5.5.5"), 0, Ipv4InterfaceAddress (), 3, Seconds (10), 2),
+                         true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (rt.InsertAlternatePath (Ipv4Address ("5.5.5.5"), 0, Ipv4InterfaceAddress (), 3, Seconds (20), 2),
+                         false, "Existing path is refreshed");
+  NS_TEST_EXPECT_MSG_EQ (rt.InsertAlternatePath (Ipv4Address ("6.6.6.6"), 0, Ipv4InterfaceAddress (), 2, Seconds (10), 2),
+                         true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (rt.InsertAlternatePath (Ipv4Address ("7.7.7.7"), 0, Ipv4InterfaceAddress (), 1, Seconds (10), 2),
+                         false, "Too many paths");
+  NS_TEST_EXPECT_MSG_EQ (rt.GetAlternatePathCount (), 2, "trivial");
+
+  NS_TEST_EXPECT_MSG_EQ (rt.SwitchToAlternatePath (), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (rt.GetNextHop (), Ipv4Address ("6.6.6.6"), "Shortest alternate path is used");
+  NS_TEST_EXPECT_MSG_EQ (rt.GetHop (), 2, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (rt.GetAdvertisedHops (), 3, "Advertised hop count is unchanged");
+  NS_TEST_EXPECT_MSG_EQ (rt.GetAlternatePathCount (), 1, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (rt.DeleteAlternatePath (Ipv4Address ("5.5.5.5")), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (rt.DeleteAlternatePath (Ipv4Address ("5.5.5.5")), false, "Already deleted");
+  NS_TEST_EXPECT_MSG_EQ (rt.SwitchToAlternatePath (), false, "No alternate path left");
+
+  // Energy balanced path choice
+  rt.SetPathEnergy (100);
+  NS_TEST_EXPECT_MSG_EQ (rt.GetBalancedRoute (0.9), rt.GetRoute (), "Primary path only");
+  rt.InsertAlternatePath (Ipv4Address ("8.8.8.8"), 0, Ipv4InterfaceAddress (), 2, Seconds (10), 2, 300);
+  NS_TEST_EXPECT_MSG_EQ (rt.GetBalancedRoute (0.2), rt.GetRoute (), "Primary path takes first quarter");
+  NS_TEST_EXPECT_MSG_EQ (rt.GetBalancedRoute (0.3)->GetGateway (), Ipv4Address ("8.8.8.8"), "Alternate path takes the rest");
+  NS_TEST_EXPECT_MSG_EQ (rt.GetBalancedRoute (0.99)->GetDestination (), Ipv4Address ("8.8.8.8"), "Route leads to the next hop");
+  NS_TEST_EXPECT_MSG_EQ (rt.GetBalancedRoute (0.3), rt.GetBalancedRoute (0.99), "Route is built once per alternate path");
+  NS_TEST_EXPECT_MSG_EQ (rt.SwitchToAlternatePath (), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (rt.GetPathEnergy (), 300, "Path energy switched with the path");
+}
+//-----------------------------------------------------------------------------
+/// Unit test for RREQ/RREP extensions
+struct ExtensionTest : public TestCase
+{
+  ExtensionTest () : TestCase ("Extensions") {}
+  virtual void DoRun ();
+};
+
+void
+ExtensionTest::DoRun ()
+{
+  RreqHeader rreq (/*flags*/ 0, /*reserved*/ 0, /*hopCount*/ 6, /*requestID*/ 1, /*dst*/ Ipv4Address ("1.2.3.4"),
+                   /*dstSeqNo*/ 40, /*origin*/ Ipv4Address ("4.3.2.1"), /*originSeqNo*/ 10);
+  uint32_t value = 0;
+  NS_TEST_EXPECT_MSG_EQ (rreq.GetSerializedSize (), 23, "No extensions by default");
+  NS_TEST_EXPECT_MSG_EQ (rreq.GetExtension (AODVEXT_PATH_ENERGY, value), false, "trivial");
+  rreq.SetExtension (AODVEXT_PATH_ENERGY, 12345);
+  rreq.SetGratiousRrep (true);
+  NS_TEST_EXPECT_MSG_EQ (rreq.GetSerializedSize (), 30, "Count and one extension");
+  Ptr<Packet> p = Create<Packet> ();
+  p->AddHeader (rreq);
+  RreqHeader rreq2;
+  NS_TEST_EXPECT_MSG_EQ (p->RemoveHeader (rreq2), 30, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (rreq2, rreq, "Round trip serialization works");
+  NS_TEST_EXPECT_MSG_EQ (rreq2.GetExtension (AODVEXT_PATH_ENERGY, value), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (value, 12345, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (rreq2.GetGratiousRrep (), true, "Flags are kept");
+  rreq2.RemoveExtension (AODVEXT_PATH_ENERGY);
+  NS_TEST_EXPECT_MSG_EQ (rreq2.GetSerializedSize (), 23, "trivial");
+
+  RrepHeader rrep (/*prefixSize*/ 0, /*hopCount*/ 12, /*dst*/ Ipv4Address ("1.2.3.4"), /*dstSeqNo*/ 2,
+                   /*origin*/ Ipv4Address ("4.3.2.1"), /*lifetime*/ Seconds (3));
+  rrep.SetExtension (AODVEXT_PATH_ENERGY, 7);
+  rrep.SetAckRequired (true);
+  NS_TEST_EXPECT_MSG_EQ (rrep.GetSerializedSize (), 26, "Count and one extension");
+  p = Create<Packet> ();
+  p->AddHeader (rrep);
+  RrepHeader rrep2;
+  NS_TEST_EXPECT_MSG_EQ (p->RemoveHeader (rrep2), 26, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (rrep2, rrep, "Round trip serialization works");
+  NS_TEST_EXPECT_MSG_EQ (rrep2.GetAckRequired (), true, "Flags are kept");
+  rrep2.SetHello (Ipv4Address ("1.1.1.1"), 1, Seconds (1));
+  NS_TEST_EXPECT_MSG_EQ (rrep2.GetSerializedSize (), 19, "Hello has no extensions");
+
+  // Hello link quality list
+  rrep2.AddLinkQuality (Ipv4Address ("2.2.2.2"), 200);
+  rrep2.AddLinkQuality (Ipv4Address ("3.3.3.3"), 100);
+  NS_TEST_EXPECT_MSG_EQ (rrep2.GetSerializedSize (), 32, "Count, type, length and two neighbors");
+  p = Create<Packet> ();
+  p->AddHeader (rrep2);
+  RrepHeader rrep3;
+  NS_TEST_EXPECT_MSG_EQ (p->RemoveHeader (rrep3), 32, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (rrep3, rrep2, "Round trip serialization works");
+  uint8_t ratio = 0;
+  NS_TEST_EXPECT_MSG_EQ (rrep3.GetLinkQuality (Ipv4Address ("3.3.3.3"), ratio), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ ((uint16_t) ratio, 100, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (rrep3.GetLinkQuality (Ipv4Address ("4.4.4.4"), ratio), false, "Neighbor not listed");
+
+  // Truncated extension is ignored
+  p = Create<Packet> ();
+  p->AddHeader (rreq);
+  p->RemoveAtEnd (2);
+  RreqHeader rreq3;
+  NS_TEST_EXPECT_MSG_EQ (p->RemoveHeader (rreq3), 26, "Count, type and length read");
+  NS_TEST_EXPECT_MSG_EQ (rreq3.GetExtension (AODVEXT_PATH_ENERGY, value), false, "Extension doesn't fit");
+  NS_TEST_EXPECT_MSG_EQ (rreq3.GetDst (), Ipv4Address ("1.2.3.4"), "Message is kept");
+
+  // Truncated message is invalid
+  p = Create<Packet> ();
+  p->AddHeader (RrepMessage (rrep));
+  p->RemoveAtEnd (10);
+  RrepMessage message;
+  p->RemoveHeader (message);
+  NS_TEST_EXPECT_MSG_EQ (message.IsValid (), false, "Message doesn't fit");
+}
+//-----------------------------------------------------------------------------
+/// Unit test for weak link detection in Neighbors
+struct WeakLinkTest : public TestCase
+{
+  WeakLinkTest () : TestCase ("WeakLink"), nb (Seconds (1)) {}
+  virtual void DoRun ();
+  void Handler (Ipv4Address addr) { weak.push_back (addr); }
+
+  Neighbors nb;
+  std::vector<Ipv4Address> weak;
+};
+
+void
+WeakLinkTest::DoRun ()
+{
+  nb.SetWeakLinkThreshold (-90, 3);
+  nb.SetWeakLinkCallback (MakeCallback (&WeakLinkTest::Handler, this));
+  // Without ARP cache the hardware address of the neighbor is unknown
+  nb.Update (Ipv4Address ("1.2.3.4"), Seconds (10));
+  double signal = 0;
+  NS_TEST_EXPECT_MSG_EQ (nb.GetSignal (Ipv4Address ("1.2.3.4"), signal), false, "No sample yet");
+  nb.UpdateSignal (Mac48Address (), -80);
+  NS_TEST_EXPECT_MSG_EQ (nb.GetSignal (Ipv4Address ("1.2.3.4"), signal), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ_TOL (signal, -80, 1e-9, "trivial");
+  nb.UpdateSignal (Mac48Address (), -95);
+  NS_TEST_EXPECT_MSG_EQ (nb.IsWeakLink (Ipv4Address ("1.2.3.4")), false, "Smoothed signal is above threshold");
+  nb.UpdateSignal (Mac48Address (), -100);
+  NS_TEST_EXPECT_MSG_EQ (nb.IsWeakLink (Ipv4Address ("1.2.3.4")), true, "Smoothed signal fell below threshold");
+  NS_TEST_EXPECT_MSG_EQ (weak.size (), 1, "Weak link reported");
+  nb.UpdateSignal (Mac48Address (), -100);
+  NS_TEST_EXPECT_MSG_EQ (weak.size (), 1, "Weak link reported once");
+  nb.UpdateSignal (Mac48Address (), -60);
+  nb.UpdateSignal (Mac48Address (), -60);
+  NS_TEST_EXPECT_MSG_EQ (nb.IsWeakLink (Ipv4Address ("1.2.3.4")), false, "Signal recovered above hysteresis");
+  nb.Clear ();
+  Simulator::Destroy ();
+}
+//-----------------------------------------------------------------------------
+/// Unit test for hello delivery ratios in Neighbors
+struct LinkQualityTest : public TestCase
+{
+  LinkQualityTest () : TestCase ("LinkQuality"), nb (Seconds (1)) {}
+  virtual void DoRun ();
+  void CheckWindow ();
+
+  Neighbors nb;
+};
+
+void
+LinkQualityTest::DoRun ()
+{
+  nb.SetLinkQualityWindow (Seconds (1), 4);
+  nb.Update (Ipv4Address ("1.2.3.4"), Seconds (100));
+  double forward = 0;
+  double reverse = 0;
+  NS_TEST_EXPECT_MSG_EQ (nb.GetDeliveryRatios (Ipv4Address ("4.3.2.1"), forward, reverse), false, "Not a neighbor");
+  nb.RecordHello (Ipv4Address ("1.2.3.4"));
+  nb.RecordHello (Ipv4Address ("1.2.3.4"));
+  nb.RecordHello (Ipv4Address ("1.2.3.4"));
+  NS_TEST_EXPECT_MSG_EQ ((uint16_t) nb.GetReverseRatio (Ipv4Address ("1.2.3.4")), 191, "3 of 4 hellos received");
+  nb.SetForwardRatio (Ipv4Address ("1.2.3.4"), 255);
+  NS_TEST_EXPECT_MSG_EQ (nb.GetDeliveryRatios (Ipv4Address ("1.2.3.4"), forward, reverse), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ_TOL (forward, 1, 1e-9, "trivial");
+  NS_TEST_EXPECT_MSG_EQ_TOL (reverse, 0.75, 0.01, "trivial");
+  nb.RecordHello (Ipv4Address ("1.2.3.4"));
+  nb.RecordHello (Ipv4Address ("1.2.3.4"));
+  NS_TEST_EXPECT_MSG_EQ ((uint16_t) nb.GetReverseRatio (Ipv4Address ("1.2.3.4")), 255, "Ratio never exceeds 1");
+  std::map<Ipv4Address, uint8_t> ratios;
+  nb.GetReverseRatios (ratios);
+  NS_TEST_EXPECT_MSG_EQ (ratios.size (), 1, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (nb.GetRate (Ipv4Address ("1.2.3.4")), 0, "No unicast frame heard");
+
+  Simulator::Schedule (Seconds (4.5), &LinkQualityTest::CheckWindow, this);
+  Simulator::Run ();
+  nb.Clear ();
+  Simulator::Destroy ();
+}
+
+void
+LinkQualityTest::CheckWindow ()
+{
+  NS_TEST_EXPECT_MSG_EQ ((uint16_t) nb.GetReverseRatio (Ipv4Address ("1.2.3.4")), 0, "Hellos left the window");
+}
+//-----------------------------------------------------------------------------
+/// Unit test for LoadMonitor
+struct LoadMonitorTest : public TestCase
+{
+  LoadMonitorTest () : TestCase ("LoadMonitor"), monitor (Seconds (3), 4, 0.3) {}
+  virtual void DoRun ();
+  void CheckFirstSample ();
+  void CheckSecondSample ();
+
+  LoadMonitor monitor;
+};
+
+void
+LoadMonitorTest::DoRun ()
+{
+  monitor.NotifyRelayed (Ipv4Address ("1.1.1.1"), Ipv4Address ("2.2.2.2"));
+  monitor.NotifyRelayed (Ipv4Address ("1.1.1.1"), Ipv4Address ("3.3.3.3"));
+  monitor.NotifyRelayed (Ipv4Address ("1.1.1.1"), Ipv4Address ("2.2.2.2"));
+  NS_TEST_EXPECT_MSG_EQ (monitor.GetActiveFlows (), 2, "Flows are origin/destination pairs");
+  monitor.NotifyPhyState (Seconds (0), MilliSeconds (500), WifiPhy::TX);
+  monitor.NotifyPhyState (MilliSeconds (500), MilliSeconds (500), WifiPhy::IDLE);
+  NS_TEST_EXPECT_MSG_EQ (monitor.GetLoad (), 0, "No sample yet");
+
+  Simulator::Schedule (Seconds (1), &LoadMonitorTest::CheckFirstSample, this);
+  Simulator::Schedule (Seconds (5), &LoadMonitorTest::CheckSecondSample, this);
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+LoadMonitorTest::CheckFirstSample ()
+{
+  monitor.Sample (0.5);
+  NS_TEST_EXPECT_MSG_EQ_TOL (monitor.GetBusyFraction (), 0.5, 1e-9, "Idle time is not busy");
+  // (0.5 queue + 0.5 busy + 2/4 flows) / 3, weighted by 0.3
+  NS_TEST_EXPECT_MSG_EQ_TOL (monitor.GetLoad (), 0.15, 1e-9, "First sample");
+}
+
+void
+LoadMonitorTest::CheckSecondSample ()
+{
+  // Only the part after the previous sample counts
+  monitor.NotifyPhyState (MilliSeconds (500), Seconds (4), WifiPhy::CCA_BUSY);
+  monitor.Sample (0);
+  NS_TEST_EXPECT_MSG_EQ (monitor.GetActiveFlows (), 0, "Flows timed out");
+  NS_TEST_EXPECT_MSG_EQ_TOL (monitor.GetBusyFraction (), 0.875, 1e-9, "Busy time clipped to the sample period");
+  NS_TEST_EXPECT_MSG_EQ_TOL (monitor.GetLoad (), 0.3 * 0.875 / 3 + 0.7 * 0.15, 1e-9, "Moving average");
+}
+//-----------------------------------------------------------------------------
+/// Unit test for ReservationTable
+struct ReservationTest : public TestCase
+{
+  ReservationTest () : TestCase ("Reservation") {}
+  virtual void DoRun ();
+  void CheckRefreshed ();
+  void CheckExpired ();
+
+  ReservationTable reservations;
+};
+
+void
+ReservationTest::DoRun ()
+{
+  reservations.Reserve (Ipv4Address ("1.1.1.1"), Ipv4Address ("2.2.2.2"), 100000, Seconds (3));
+  reservations.Reserve (Ipv4Address ("1.1.1.1"), Ipv4Address ("3.3.3.3"), 50000, Seconds (3));
+  reservations.Reserve (Ipv4Address ("1.1.1.1"), Ipv4Address ("2.2.2.2"), 200000, Seconds (3));
+  NS_TEST_EXPECT_MSG_EQ (reservations.GetSize (), 2, "A flow has one reservation");
+  NS_TEST_EXPECT_MSG_EQ (reservations.GetReserved (), 250000, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (reservations.GetReservation (Ipv4Address ("1.1.1.1"), Ipv4Address ("2.2.2.2")), 200000, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (reservations.Refresh (Ipv4Address ("2.2.2.2"), Ipv4Address ("1.1.1.1"), Seconds (3)), false, "No reservation");
+
+  Simulator::Schedule (Seconds (2), &ReservationTest::CheckRefreshed, this);
+  Simulator::Schedule (Seconds (4), &ReservationTest::CheckExpired, this);
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+ReservationTest::CheckRefreshed ()
+{
+  NS_TEST_EXPECT_MSG_EQ (reservations.Refresh (Ipv4Address ("1.1.1.1"), Ipv4Address ("2.2.2.2"), Seconds (3)), true, "trivial");
+}
+
+void
+ReservationTest::CheckExpired ()
+{
+  NS_TEST_EXPECT_MSG_EQ (reservations.GetSize (), 1, "Reservation not refreshed expired");
+  NS_TEST_EXPECT_MSG_EQ (reservations.GetReserved (), 200000, "Refreshed reservation remains");
+  reservations.Reserve (Ipv4Address ("1.1.1.1"), Ipv4Address ("4.4.4.4"), 30000, Seconds (3));
+  reservations.Reserve (Ipv4Address ("1.1.1.1"), Ipv4Address ("2.2.2.2"), 100000, Seconds (3));
+  NS_TEST_EXPECT_MSG_EQ (reservations.GetReserved (Seconds (4)), 30000, "Replaced reservation keeps its age");
+  NS_TEST_EXPECT_MSG_EQ (reservations.GetReservation (Ipv4Address ("1.1.1.1"), Ipv4Address ("2.2.2.2"), Seconds (4)), 0, "Made before");
+  NS_TEST_EXPECT_MSG_EQ (reservations.GetReservation (Ipv4Address ("1.1.1.1"), Ipv4Address ("4.4.4.4"), Seconds (4)), 30000, "trivial");
+}
+//-----------------------------------------------------------------------------
+/// Unit test for path loss learning in Neighbors
+struct PathLossTest : public TestCase
+{
+  PathLossTest () : TestCase ("PathLoss"), nb (Seconds (1)) {}
+  virtual void DoRun ();
+  /// Let nb receive a broadcast data frame from the neighbor
+  void Receive (uint8_t level, double signal);
+
+  Neighbors nb;
+};
+
+void
+PathLossTest::Receive (uint8_t level, double signal)
+{
+  Ptr<Packet> packet = Create<Packet> (64);
+  WifiMacHeader hdr;
+  hdr.SetType (WIFI_MAC_DATA);
+  hdr.SetAddr1 (Mac48Address::GetBroadcast ());
+  hdr.SetAddr2 (Mac48Address ());
+  packet->AddHeader (hdr);
+  WifiTxVector txVector;
+  txVector.SetTxPowerLevel (level);
+  struct mpduInfo aMpdu;
+  aMpdu.type = NORMAL_MPDU;
+  aMpdu.mpduRefNumber = 0;
+  struct signalNoiseDbm signalNoise;
+  signalNoise.signal = signal;
+  signalNoise.noise = -100;
+  nb.GetMonitorSnifferRxCallback () (packet, 2412, 1, 2, WIFI_PREAMBLE_LONG, txVector, aMpdu, signalNoise);
+}
+
+void
+PathLossTest::DoRun ()
+{
+  // 1 dB per level from 10 to 20 dBm
+  nb.SetTxPowerLevels (10, 20, 11);
+  nb.Update (Ipv4Address ("1.2.3.4"), Seconds (10));
+  double loss = 0;
+  NS_TEST_EXPECT_MSG_EQ (nb.GetPathLoss (Ipv4Address ("1.2.3.4"), loss), false, "No sample yet");
+  Receive (10, -60);
+  NS_TEST_EXPECT_MSG_EQ (nb.GetPathLoss (Ipv4Address ("1.2.3.4"), loss), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ_TOL (loss, 80, 1e-9, "trivial");
+  Receive (0, -70);
+  nb.GetPathLoss (Ipv4Address ("1.2.3.4"), loss);
+  NS_TEST_EXPECT_MSG_EQ_TOL (loss, 80, 1e-9, "trivial");
+  double signal = 0;
+  nb.GetSignal (Ipv4Address ("1.2.3.4"), signal);
+  NS_TEST_EXPECT_MSG_EQ_TOL (signal, -60, 1e-9, "trivial");
+  nb.Clear ();
+  Simulator::Destroy ();
+}
+//-----------------------------------------------------------------------------
+/// Unit test for EnergyPredictor
+struct EnergyPredictorTest : public TestCase
+{
+  // No smoothing, every update replaces the rates
+  EnergyPredictorTest () : TestCase ("EnergyPredictor"), predictor (Seconds (0)) {}
+  virtual void DoRun ();
+  void CheckDraining ();
+  void CheckHarvesting ();
+
+  EnergyPredictor predictor;
+};
+
+void
+EnergyPredictorTest::DoRun ()
+{
+  predictor.Update (100, 0);
+  NS_TEST_EXPECT_MSG_EQ (predictor.GetTimeToDepletion (), Time::Max (), "No rate yet");
+
+  Simulator::Schedule (Seconds (10), &EnergyPredictorTest::CheckDraining, this);
+  Simulator::Schedule (Seconds (20), &EnergyPredictorTest::CheckHarvesting, this);
+  Simulator::Run ();
+  Simulator::Destroy ();
+}
+
+void
+EnergyPredictorTest::CheckDraining ()
+{
+  // 20 J consumed while the remaining energy fell by 10 J only
+  predictor.Update (90, 20);
+  NS_TEST_EXPECT_MSG_EQ_TOL (predictor.GetDrainRate (), 2, 1e-9, "trivial");
+  NS_TEST_EXPECT_MSG_EQ_TOL (predictor.GetHarvestRate (), 1, 1e-9, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (predictor.GetTimeToDepletion (), Seconds (90), "90 J at 1 W net");
+}
+
+void
+EnergyPredictorTest::CheckHarvesting ()
+{
+  predictor.Update (95, 25);
+  NS_TEST_EXPECT_MSG_EQ_TOL (predictor.GetDrainRate (), 0.5, 1e-9, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (predictor.GetTimeToDepletion (), Time::Max (), "Harvesting more than draining");
+}
+//-----------------------------------------------------------------------------
+/// Unit test for neighbor energy learned from hellos
+struct NeighborEnergyTest : public TestCase
+{
+  NeighborEnergyTest () : TestCase ("NeighborEnergy"), nb (Seconds (1)) {}
+  virtual void DoRun ();
+
+  Neighbors nb;
+};
+
+void
+NeighborEnergyTest::DoRun ()
+{
+  nb.SetEnergy (Ipv4Address ("1.2.3.4"), 500);
+  NS_TEST_EXPECT_MSG_EQ (nb.GetEnergy (Ipv4Address ("1.2.3.4")), std::numeric_limits<uint32_t>::max (), "Not a neighbor");
+  nb.Update (Ipv4Address ("1.2.3.4"), Seconds (10));
+  NS_TEST_EXPECT_MSG_EQ (nb.GetEnergy (Ipv4Address ("1.2.3.4")), std::numeric_limits<uint32_t>::max (), "Nothing advertised yet");
+  nb.SetEnergy (Ipv4Address ("1.2.3.4"), 500);
+  NS_TEST_EXPECT_MSG_EQ (nb.GetEnergy (Ipv4Address ("1.2.3.4")), 500, "trivial");
+  nb.Clear ();
+  Simulator::Destroy ();
+}
+//-----------------------------------------------------------------------------
+/// Unit test for EnergyAccounting
+struct EnergyAccountingTest : public TestCase
+{
+  EnergyAccountingTest () : TestCase ("EnergyAccounting") {}
+  virtual void DoRun ();
+  /// Wrap packet into UDP, IPv4 and a wifi data frame
+  Ptr<Packet> MakeFrame (Ptr<Packet> packet, uint16_t srcPort, uint16_t dstPort);
+};
+
+Ptr<Packet>
+EnergyAccountingTest::MakeFrame (Ptr<Packet> packet, uint16_t srcPort, uint16_t dstPort)
+{
+  UdpHeader udp;
+  udp.SetSourcePort (srcPort);
+  udp.SetDestinationPort (dstPort);
+  packet->AddHeader (udp);
+  Ipv4Header ip;
+  ip.SetSource (Ipv4Address ("10.0.0.1"));
+  ip.SetDestination (Ipv4Address ("10.0.0.2"));
+  ip.SetProtocol (17);
+  packet->AddHeader (ip);
+  LlcSnapHeader llc;
+  llc.SetType (0x0800);
+  packet->AddHeader (llc);
+  WifiMacHeader hdr;
+  hdr.SetType (WIFI_MAC_DATA);
+  packet->AddHeader (hdr);
+  return packet;
+}
+
+void
+EnergyAccountingTest::DoRun ()
+{
+  EnergyAccounting accounting;
+  accounting.SetRadio (1, 0.5, 2);
+
+  Ptr<Packet> hello = Create<Packet> ();
+  hello->AddHeader (RrepHeader (0, 0, Ipv4Address ("10.0.0.1"), 1, Ipv4Address ("10.0.0.1")));
+  hello->AddHeader (TypeHeader (AODVTYPE_RREP));
+  accounting.NotifyTx (MakeFrame (hello, 654, 654), MilliSeconds (1));
+  Ptr<Packet> rrep = Create<Packet> ();
+  rrep->AddHeader (RrepHeader (0, 0, Ipv4Address ("10.0.0.3"), 1, Ipv4Address ("10.0.0.1")));
+  rrep->AddHeader (TypeHeader (AODVTYPE_RREP));
+  accounting.NotifyRx (MakeFrame (rrep, 654, 654), MilliSeconds (1));
+  Ptr<Packet> data = MakeFrame (Create<Packet> (100), 49153, 9);
+  accounting.NotifyRx (data, MilliSeconds (2));
+  accounting.NotifyTx (data, MilliSeconds (2));
+
+  NS_TEST_EXPECT_MSG_EQ_TOL (accounting.GetUsage (EnergyAccounting::HELLO).m_txEnergy, 0.002, 1e-9, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (accounting.GetUsage (EnergyAccounting::HELLO).m_txFrames, 1, "trivial");
+  NS_TEST_EXPECT_MSG_EQ_TOL (accounting.GetUsage (EnergyAccounting::RREP).m_rxEnergy, 0.001, 1e-9, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (accounting.GetUsage (EnergyAccounting::RREP).m_txFrames, 0, "trivial");
+  EnergyAccounting::FlowId flow;
+  flow.m_source = Ipv4Address ("10.0.0.1");
+  flow.m_destination = Ipv4Address ("10.0.0.2");
+  flow.m_protocol = 17;
+  flow.m_sourcePort = 49153;
+  flow.m_destinationPort = 9;
+  NS_TEST_EXPECT_MSG_EQ_TOL (accounting.GetUsage (flow).m_txEnergy, 0.004, 1e-9, "trivial");
+  NS_TEST_EXPECT_MSG_EQ_TOL (accounting.GetUsage (flow).m_rxEnergy, 0.002, 1e-9, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (accounting.GetUsage (flow).m_rxBytes, data->GetSize (), "trivial");
+  NS_TEST_EXPECT_MSG_EQ (accounting.GetUsage (EnergyAccounting::OTHER).m_rxFrames, 0, "trivial");
+}
+//-----------------------------------------------------------------------------
+/// Unit test for CompactHeader
+struct CompactHeaderTest : public TestCase
+{
+  CompactHeaderTest () : TestCase ("CompactHeader") {}
+  virtual void DoRun ();
+};
+
+void
+CompactHeaderTest::DoRun ()
+{
+  Ipv4Mask mask ("255.255.255.0");
+  CompactHeader sender (Ipv4Address ("10.0.0.5"), mask);
+  CompactHeader receiver (Ipv4Address ("10.0.0.8"), mask);
+
+  RreqHeader rreq (/*flags*/ 0, /*reserved*/ 0, /*hopCount*/ 2, /*requestID*/ 3, /*dst*/ Ipv4Address ("10.0.0.9"),
+                   /*dstSeqNo*/ 0, /*origin*/ Ipv4Address ("10.0.0.1"), /*originSeqNo*/ 4);
+  rreq.SetUnknownSeqno (true);
+  Ptr<Packet> p = Create<Packet> ();
+  p->AddHeader (rreq);
+  p->AddHeader (TypeHeader (AODVTYPE_RREQ));
+  NS_TEST_EXPECT_MSG_EQ (sender.Compress (p), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (p->GetSize (), 8, "Prefix length, short addresses and one octet integers");
+  NS_TEST_EXPECT_MSG_EQ (CompactHeader::IsCompact (p), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (receiver.Decompress (p), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (p->GetSize (), 24, "RFC format restored");
+  TypeHeader tHeader;
+  p->RemoveHeader (tHeader);
+  NS_TEST_EXPECT_MSG_EQ (tHeader.Get (), AODVTYPE_RREQ, "trivial");
+  RreqHeader rreq2;
+  p->RemoveHeader (rreq2);
+  NS_TEST_EXPECT_MSG_EQ (rreq2, rreq, "Round trip works");
+
+  // Destination outside of the subnet, extension
+  rreq.SetDst (Ipv4Address ("192.168.1.1"));
+  rreq.SetExtension (AODVEXT_PATH_ENERGY, 1000);
+  p = Create<Packet> ();
+  p->AddHeader (rreq);
+  p->AddHeader (TypeHeader (AODVTYPE_RREQ));
+  sender.Compress (p);
+  NS_TEST_EXPECT_MSG_EQ (p->GetSize (), 20, "Full addresses and one extension");
+  receiver.Decompress (p);
+  p->RemoveHeader (tHeader);
+  p->RemoveHeader (rreq2);
+  NS_TEST_EXPECT_MSG_EQ (rreq2, rreq, "Round trip works");
+
+  RrepHeader hello;
+  hello.SetHello (Ipv4Address ("10.0.0.1"), 5, MilliSeconds (2000));
+  p = Create<Packet> ();
+  p->AddHeader (hello);
+  p->AddHeader (TypeHeader (AODVTYPE_RREP));
+  sender.Compress (p);
+  NS_TEST_EXPECT_MSG_EQ (p->GetSize (), 7, "Originator omitted, two octet lifetime");
+  MessageType type;
+  bool isHello = false;
+  NS_TEST_EXPECT_MSG_EQ (CompactHeader::PeekType (p, type, isHello), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (type, AODVTYPE_RREP, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (isHello, true, "trivial");
+  receiver.Decompress (p);
+  p->RemoveHeader (tHeader);
+  RrepHeader hello2;
+  p->RemoveHeader (hello2);
+  NS_TEST_EXPECT_MSG_EQ (hello2, hello, "Round trip works");
+
+  RerrHeader rerr;
+  rerr.AddUnDestination (Ipv4Address ("10.0.0.7"), 300);
+  rerr.AddUnDestination (Ipv4Address ("10.0.0.8"), 301);
+  p = Create<Packet> ();
+  p->AddHeader (rerr);
+  p->AddHeader (TypeHeader (AODVTYPE_RERR));
+  sender.Compress (p);
+  NS_TEST_EXPECT_MSG_EQ (p->GetSize (), 8, "Second sequence number delta encoded");
+  receiver.Decompress (p);
+  p->RemoveHeader (tHeader);
+  RerrHeader rerr2;
+  p->RemoveHeader (rerr2);
+  NS_TEST_EXPECT_MSG_EQ (rerr2, rerr, "Round trip works");
+
+  // Short addresses are expanded with the prefix length of the sender, not of the receiver
+  p = Create<Packet> ();
+  p->AddHeader (hello);
+  p->AddHeader (TypeHeader (AODVTYPE_RREP));
+  sender.Compress (p);
+  CompactHeader other (Ipv4Address ("10.0.0.8"), Ipv4Mask ("255.0.0.0"));
+  NS_TEST_EXPECT_MSG_EQ (other.Decompress (p), true, "trivial");
+  p->RemoveHeader (tHeader);
+  p->RemoveHeader (hello2);
+  NS_TEST_EXPECT_MSG_EQ (hello2, hello, "Round trip across subnet sizes works");
+
+  // Truncated messages aren't read past their end
+  p = Create<Packet> ();
+  p->AddHeader (rerr);
+  p->AddHeader (TypeHeader (AODVTYPE_RERR));
+  sender.Compress (p);
+  for (uint32_t size = 1; size < 8; ++size)
+    {
+      Ptr<Packet> truncated = p->CreateFragment (0, size);
+      NS_TEST_EXPECT_MSG_EQ (receiver.Decompress (truncated), false, "Truncated RERR");
+    }
+  // RREP-ACK with short addresses of a /8 subnet
+  uint8_t badPrefix[] = { 0xf0, 8 };
+  p = Create<Packet> (badPrefix, sizeof (badPrefix));
+  NS_TEST_EXPECT_MSG_EQ (receiver.Decompress (p), false, "Unsupported prefix length");
+
+  RrepAckHeader ack;
+  p = Create<Packet> ();
+  p->AddHeader (ack);
+  p->AddHeader (TypeHeader (AODVTYPE_RREP_ACK));
+  sender.Compress (p);
+  NS_TEST_EXPECT_MSG_EQ (p->GetSize (), 1, "RREP-ACK has no addresses");
+  NS_TEST_EXPECT_MSG_EQ (receiver.Decompress (p), true, "trivial");
+
+  p = Create<Packet> (10);
+  NS_TEST_EXPECT_MSG_EQ (sender.Compress (p), false, "Not an AODV_EO message");
+  NS_TEST_EXPECT_MSG_EQ (p->GetSize (), 10, "Left unchanged");
+}
+//-----------------------------------------------------------------------------
+/// Unit test for bundles of messages
+struct BundleTest : public TestCase
+{
+  BundleTest () : TestCase ("Bundle") {}
+  virtual void DoRun ();
+};
+
+void
+BundleTest::DoRun ()
+{
+  Ptr<Packet> hello = Create<Packet> ();
+  RrepHeader helloHeader;
+  helloHeader.SetHello (Ipv4Address ("10.0.0.1"), 5, Seconds (2));
+  hello->AddHeader (helloHeader);
+  hello->AddHeader (TypeHeader (AODVTYPE_RREP));
+  Ptr<Packet> rerr = Create<Packet> ();
+  RerrHeader rerrHeader;
+  rerrHeader.AddUnDestination (Ipv4Address ("10.0.0.7"), 3);
+  rerr->AddHeader (rerrHeader);
+  rerr->AddHeader (TypeHeader (AODVTYPE_RERR));
+  CompactHeader compact (Ipv4Address ("10.0.0.1"), Ipv4Mask ("255.255.255.0"));
+  compact.Compress (rerr);
+
+  Ptr<Packet> bundle = Create<Packet> ();
+  hello->AddHeader (BundleHeader (hello->GetSize ()));
+  bundle->AddAtEnd (hello);
+  rerr->AddHeader (BundleHeader (rerr->GetSize ()));
+  bundle->AddAtEnd (rerr);
+  bundle->AddHeader (TypeHeader (AODVTYPE_BUNDLE));
+  NS_TEST_EXPECT_MSG_EQ (bundle->GetSize (), 1 + 2 + 20 + 2 + 5, "Type, lengths and messages");
+  NS_TEST_EXPECT_MSG_EQ (compact.Compress (bundle), false, "Bundles aren't compressed as a whole");
+
+  TypeHeader tHeader;
+  bundle->RemoveHeader (tHeader);
+  NS_TEST_EXPECT_MSG_EQ (tHeader.IsValid (), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (tHeader.Get (), AODVTYPE_BUNDLE, "trivial");
+  BundleHeader length;
+  bundle->RemoveHeader (length);
+  NS_TEST_EXPECT_MSG_EQ (length.GetLength (), 20, "RFC format hello");
+  Ptr<Packet> message = bundle->CreateFragment (0, length.GetLength ());
+  bundle->RemoveAtStart (length.GetLength ());
+  message->RemoveHeader (tHeader);
+  RrepHeader helloHeader2;
+  message->RemoveHeader (helloHeader2);
+  NS_TEST_EXPECT_MSG_EQ (helloHeader2, helloHeader, "trivial");
+  bundle->RemoveHeader (length);
+  NS_TEST_EXPECT_MSG_EQ (length.GetLength (), bundle->GetSize (), "Compact RERR is last");
+  NS_TEST_EXPECT_MSG_EQ (compact.Decompress (bundle), true, "trivial");
+  bundle->RemoveHeader (tHeader);
+  RerrHeader rerrHeader2;
+  bundle->RemoveHeader (rerrHeader2);
+  NS_TEST_EXPECT_MSG_EQ (rerrHeader2, rerrHeader, "trivial");
+}
+//-----------------------------------------------------------------------------
+/// Unit test for RerrHeader destination list
+struct RerrDestinationsTest : public TestCase
+{
+  RerrDestinationsTest () : TestCase ("RerrDestinations") {}
+  virtual void DoRun ();
+};
+
+void
+RerrDestinationsTest::DoRun ()
+{
+  RerrHeader h;
+  h.AddUnDestination (Ipv4Address ("10.0.0.3"), 3);
+  h.AddUnDestination (Ipv4Address ("10.0.0.1"), 1);
+  h.AddUnDestination (Ipv4Address ("10.0.0.3"), 30);
+  NS_TEST_EXPECT_MSG_EQ ((uint16_t) h.GetDestCount (), 2, "Duplicate ignored");
+  NS_TEST_EXPECT_MSG_EQ (h.Begin ()->first, Ipv4Address ("10.0.0.1"), "Increasing address order");
+  NS_TEST_EXPECT_MSG_EQ ((h.Begin () + 1)->second, 3, "First sequence number is kept");
+
+  // Beyond the inline capacity
+  std::map<Ipv4Address, uint32_t> unreachable;
+  for (uint32_t i = 0; i < 300; ++i)
+    {
+      unreachable.insert (std::make_pair (Ipv4Address (0x0a010000 + 2 * i), i));
+    }
+  h.AddUnDestination (Ipv4Address (0x0a010001), 1000);
+  std::map<Ipv4Address, uint32_t>::const_iterator next = h.AddUnDestinations (unreachable.begin (), unreachable.end ());
+  NS_TEST_EXPECT_MSG_EQ ((uint16_t) h.GetDestCount (), 255, "Full");
+  NS_TEST_EXPECT_MSG_EQ (next->second, 252, "Rest is left for the next RERR");
+  NS_TEST_EXPECT_MSG_EQ ((h.Begin () + 3)->second, 1000, "Inserted in order");
+  Ptr<Packet> p = Create<Packet> ();
+  p->AddHeader (h);
+  RerrHeader h2;
+  NS_TEST_EXPECT_MSG_EQ (p->RemoveHeader (h2), 3 + 8 * 255, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (h2, h, "Round trip serialization works");
+
+  std::pair<Ipv4Address, uint32_t> un;
+  NS_TEST_EXPECT_MSG_EQ (h2.RemoveUnDestination (un), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (un.first, Ipv4Address ("10.0.0.1"), "Removed from the front");
+  NS_TEST_EXPECT_MSG_EQ ((uint16_t) h2.GetDestCount (), 254, "trivial");
+  h2.Clear ();
+  NS_TEST_EXPECT_MSG_EQ (h2.RemoveUnDestination (un), false, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (h2.AddUnDestination (Ipv4Address ("10.0.0.2"), 2), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (h2.Begin ()->second, 2, "Reusable after Clear");
+}
+//-----------------------------------------------------------------------------
+/// Unit test for routes shared by routing table entries
+struct SharedRouteTest : public TestCase
+{
+  SharedRouteTest () : TestCase ("SharedRoute") {}
+  virtual void DoRun ();
+};
+
+void
+SharedRouteTest::DoRun ()
+{
+  RoutingTable rtable (Seconds (5));
+  Ipv4InterfaceAddress iface (Ipv4Address ("10.0.0.1"), Ipv4Mask ("255.255.255.0"));
+  RoutingTableEntry rt1 (/*output device*/ 0, /*dst*/ Ipv4Address ("10.0.0.5"), /*validSeqNo*/ true, /*seqNo*/ 1,
+                         /*interface*/ iface, /*hop*/ 3, /*next hop*/ Ipv4Address ("10.0.0.2"), /*lifetime*/ Seconds (10));
+  RoutingTableEntry rt2 (/*output device*/ 0, /*dst*/ Ipv4Address ("10.0.0.6"), /*validSeqNo*/ true, /*seqNo*/ 1,
+                         /*interface*/ iface, /*hop*/ 2, /*next hop*/ Ipv4Address ("10.0.0.2"), /*lifetime*/ Seconds (10));
+  NS_TEST_EXPECT_MSG_EQ (rtable.AddRoute (rt1), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (rtable.AddRoute (rt2), true, "trivial");
+
+  RoutingTableEntry a, b;
+  NS_TEST_EXPECT_MSG_EQ (rtable.LookupRoute (Ipv4Address ("10.0.0.5"), a), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (rtable.LookupRoute (Ipv4Address ("10.0.0.6"), b), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (a.GetRoute (), b.GetRoute (), "Entries through the same next hop share the route");
+  NS_TEST_EXPECT_MSG_EQ (a.GetRoute ()->GetDestination (), Ipv4Address ("10.0.0.2"), "Route leads to the next hop");
+  NS_TEST_EXPECT_MSG_EQ (a.GetRoute ()->GetSource (), Ipv4Address ("10.0.0.1"), "trivial");
+  NS_TEST_EXPECT_MSG_EQ (a.GetDestination (), Ipv4Address ("10.0.0.5"), "Destination is kept by the entry");
+
+  b.SetNextHop (Ipv4Address ("10.0.0.3"));
+  NS_TEST_EXPECT_MSG_EQ (rtable.Update (b), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (rtable.LookupRoute (Ipv4Address ("10.0.0.5"), a), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (rtable.LookupRoute (Ipv4Address ("10.0.0.6"), b), true, "trivial");
+  NS_TEST_EXPECT_MSG_EQ (a.GetNextHop (), Ipv4Address ("10.0.0.2"), "Shared route isn't modified");
+  NS_TEST_EXPECT_MSG_EQ (b.GetNextHop (), Ipv4Address ("10.0.0.3"), "trivial");
+  NS_TEST_EXPECT_MSG_NE (a.GetRoute (), b.GetRoute (), "trivial");
+}
+//-----------------------------------------------------------------------------
+class AodvEoTestSuite : public TestSuite
+{
+public:
+  AodvEoTestSuite () : TestSuite ("routing-aodv_eo", UNIT)
+  {
+    AddTestCase (new TokenBucketTest, TestCase::QUICK);
+    AddTestCase (new DeadlineSchedulerTest, TestCase::QUICK);
+    AddTestCase (new AlternatePathTest, TestCase::QUICK);
+    AddTestCase (new ExtensionTest, TestCase::QUICK);
+    AddTestCase (new WeakLinkTest, TestCase::QUICK);
+    AddTestCase (new LinkQualityTest, TestCase::QUICK);
+    AddTestCase (new LoadMonitorTest, TestCase::QUICK);
+    AddTestCase (new ReservationTest, TestCase::QUICK);
+    AddTestCase (new PathLossTest, TestCase::QUICK);
+    AddTestCase (new EnergyPredictorTest, TestCase::QUICK);
+    AddTestCase (new NeighborEnergyTest, TestCase::QUICK);
+    AddTestCase (new EnergyAccountingTest, TestCase::QUICK);
+    AddTestCase (new CompactHeaderTest, TestCase::QUICK);
+    AddTestCase (new BundleTest, TestCase::QUICK);
+    AddTestCase (new RerrDestinationsTest, TestCase::QUICK);
+    AddTestCase (new SharedRouteTest, TestCase::QUICK);
+  }
+} g_aodvEoTestSuite;
+
+}
+}